@@ -0,0 +1,90 @@
+
+
+#include <stdint.h>
+#include "include/acpi.h"
+#include "include/lib.h"
+#include "include/paging.h"
+
+extern void terminal_writestring(const char* s);
+
+#define BDA_EBDA_SEGMENT 0x40E
+#define BIOS_AREA_START 0xE0000
+#define BIOS_AREA_END 0x100000
+
+static const acpi_rsdp_t* rsdp;
+static const acpi_header_t* rsdt;
+
+static int acpi_checksum(const void* data, uint32_t length) {
+    const uint8_t* p = data;
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < length; i++) {
+        sum += p[i];
+    }
+    return sum == 0;
+}
+
+/* Tables usually sit in identity-mapped RAM; ones above it are mapped read-only on first use. */
+static void acpi_map(uint32_t phys, uint32_t length) {
+    uint32_t page = phys & ~(PAGE_SIZE - 1);
+    uint32_t end = phys + length;
+    for (; page < end; page += PAGE_SIZE) {
+        uint32_t mapped;
+        if (paging_translate(page, &mapped) < 0) paging_map(page, page, 0);
+    }
+}
+
+static const acpi_header_t* acpi_table(uint32_t phys) {
+    acpi_map(phys, sizeof(acpi_header_t));
+    const acpi_header_t* h = (const acpi_header_t*)phys;
+    acpi_map(phys, h->length);
+    return h;
+}
+
+static const acpi_rsdp_t* acpi_scan(uint32_t start, uint32_t end) {
+    for (uint32_t p = start; p + sizeof(acpi_rsdp_t) <= end; p += 16) {
+        const acpi_rsdp_t* r = (const acpi_rsdp_t*)p;
+        if (strncmp(r->signature, "RSD PTR ", 8) == 0 && acpi_checksum(r, sizeof(acpi_rsdp_t))) {
+            return r;
+        }
+    }
+    return 0;
+}
+
+/* The EBDA pointer lives in page 0, which stays unmapped to catch NULL pointers. */
+static uint32_t acpi_ebda(void) {
+    paging_map(0, 0, 0);
+    uint32_t ebda = (uint32_t)(*(volatile uint16_t*)BDA_EBDA_SEGMENT) << 4;
+    paging_unmap(0);
+    return ebda;
+}
+
+int acpi_init(void) {
+    if (rsdt) return 0;
+
+    uint32_t ebda = acpi_ebda();
+    if (ebda >= 0x80000 && ebda < 0xA0000) rsdp = acpi_scan(ebda, ebda + 1024);
+    if (!rsdp) rsdp = acpi_scan(BIOS_AREA_START, BIOS_AREA_END);
+    if (!rsdp) return -1;
+
+    rsdt = acpi_table(rsdp->rsdt);
+    if (strncmp(rsdt->signature, "RSDT", 4) != 0 || !acpi_checksum(rsdt, rsdt->length)) {
+        terminal_writestring("ACPI: bad RSDT\n");
+        rsdt = 0;
+        return -1;
+    }
+    return 0;
+}
+
+const acpi_header_t* acpi_find_table(const char* signature) {
+    if (!rsdt) return 0;
+
+    const uint32_t* entries = (const uint32_t*)(rsdt + 1);
+    uint32_t count = (rsdt->length - sizeof(acpi_header_t)) / 4;
+    for (uint32_t i = 0; i < count; i++) {
+        const acpi_header_t* h = acpi_table(entries[i]);
+        if (strncmp(h->signature, signature, 4) == 0 && acpi_checksum(h, h->length)) {
+            return h;
+        }
+    }
+    return 0;
+}
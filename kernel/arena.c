@@ -0,0 +1,77 @@
+
+
+#include <stdint.h>
+#include <stddef.h>
+#include "include/arena.h"
+#include "include/pmm.h"
+
+extern void terminal_writestring(const char* s);
+
+static arena_t command_arena;
+static arena_t irq_arena;
+static arena_t* thread_arena = &command_arena;
+static int irq_depth;
+
+int arena_init(arena_t* arena, uint32_t size) {
+    uint32_t frames = (size + PMM_FRAME_SIZE - 1) / PMM_FRAME_SIZE;
+    arena->base = (uint8_t*)frame_alloc_contig(frames, 0);
+    arena->size = arena->base ? frames * PMM_FRAME_SIZE : 0;
+    arena->used = 0;
+    arena->peak = 0;
+    arena->failed = 0;
+    return arena->base ? 0 : -1;
+}
+
+void arena_destroy(arena_t* arena) {
+    if (arena->base) frame_free_contig((uint32_t)arena->base, arena->size / PMM_FRAME_SIZE);
+    arena->base = NULL;
+    arena->size = 0;
+    arena->used = 0;
+}
+
+void* arena_alloc(arena_t* arena, uint32_t size) {
+    uint32_t start = (arena->used + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if (!arena->base || size > arena->size || start > arena->size - size) {
+        arena->failed++;
+        return NULL;
+    }
+    arena->used = start + size;
+    if (arena->used > arena->peak) arena->peak = arena->used;
+    return arena->base + start;
+}
+
+void scratch_init(void) {
+    if (arena_init(&command_arena, SCRATCH_SIZE) < 0 || arena_init(&irq_arena, SCRATCH_IRQ_SIZE) < 0) {
+        terminal_writestring("Scratch: out of memory for arenas\n");
+    }
+}
+
+arena_t* scratch_arena(void) {
+    return irq_depth ? &irq_arena : thread_arena;
+}
+
+void scratch_set_thread_arena(arena_t* arena) {
+    thread_arena = arena ? arena : &command_arena;
+}
+
+void* scratch_alloc(uint32_t size) {
+    return arena_alloc(scratch_arena(), size);
+}
+
+uint32_t scratch_mark(void) {
+    return arena_mark(scratch_arena());
+}
+
+void scratch_release(uint32_t mark) {
+    arena_release(scratch_arena(), mark);
+}
+
+uint32_t scratch_irq_enter(void) {
+    irq_depth++;
+    return arena_mark(&irq_arena);
+}
+
+void scratch_irq_exit(uint32_t mark) {
+    arena_release(&irq_arena, mark);
+    irq_depth--;
+}
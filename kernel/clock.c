@@ -0,0 +1,310 @@
+
+
+#include <stdint.h>
+#include <io.h>
+#include "include/lib.h"
+#include "include/clock.h"
+#include "include/timer.h"
+#include "include/paging.h"
+#include "include/acpi.h"
+#include "include/sched.h"
+
+extern void terminal_writestring(const char* s);
+extern uint8_t rtc_read(uint8_t reg);
+extern int rtc_is_updating();
+
+#define CLOCK_SHIFT 24
+/* Base refresh interval; keeps deltas well inside the 32x32 bit scale. */
+#define CLOCK_UPDATE_TICKS 100
+#define CLOCK_CALIBRATE_TICKS 50
+
+#define CPUID_TSC (1 << 4)
+#define CPUID_INVARIANT_TSC (1 << 8)
+
+#define HPET_CAPABILITIES 0x000
+#define HPET_CONFIG 0x010
+#define HPET_COUNTER 0x0F0
+#define HPET_ENABLE 0x1
+#define HPET_COUNT_64 (1 << 13)
+#define HPET_MAX_PERIOD_FS 100000000
+
+#define RTC_SECONDS 0x00
+#define RTC_MINUTES 0x02
+#define RTC_HOURS 0x04
+#define RTC_DAY 0x07
+#define RTC_MONTH 0x08
+#define RTC_YEAR 0x09
+#define RTC_STATUS_B 0x0B
+#define RTC_24H 0x02
+#define RTC_BINARY 0x04
+
+static volatile uint32_t* hpet;
+
+static uint64_t clock_read_tsc(void) {
+    return rdtsc();
+}
+
+static uint64_t clock_read_hpet(void) {
+    uint32_t hi, lo;
+    do {
+        hi = hpet[HPET_COUNTER / 4 + 1];
+        lo = hpet[HPET_COUNTER / 4];
+    } while (hi != hpet[HPET_COUNTER / 4 + 1]);
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static clocksource_t clocksource_tsc = { "tsc", clock_read_tsc, ~0ULL, 0, CLOCK_SHIFT, 0, 0 };
+static clocksource_t clocksource_hpet = { "hpet", clock_read_hpet, ~0ULL, 0, CLOCK_SHIFT, 0, 0 };
+static clocksource_t clocksource_jiffies = { "jiffies", timer_ticks64, ~0ULL, TIMER_NS_PER_TICK, 0, TIMER_HZ / 1000, 1 };
+
+static clocksource_t* current = &clocksource_jiffies;
+static uint32_t tsc_mult;
+
+/* Readers retry if a tick updated the base underneath them. */
+static volatile uint32_t clock_seq;
+static uint64_t base_count;
+static uint64_t base_ns;
+
+static uint32_t last_update;
+
+static uint32_t boot_epoch;
+static uint64_t boot_ns;
+
+static uint64_t clock_scale(uint64_t delta, uint32_t mult, uint32_t shift) {
+    uint64_t ns = 0;
+    while (delta > 0xFFFFFFFFULL) {
+        ns += ((uint64_t)0x80000000 * mult) >> shift;
+        delta -= 0x80000000;
+    }
+    return ns + (((uint64_t)(uint32_t)delta * mult) >> shift);
+}
+
+uint64_t ktime_ns(void) {
+    uint32_t seq;
+    uint64_t count, ns, now;
+    clocksource_t* cs;
+
+    do {
+        seq = clock_seq;
+        cs = current;
+        count = base_count;
+        ns = base_ns;
+        now = cs->read();
+    } while ((seq & 1) || seq != clock_seq);
+
+    return ns + clock_scale((now - count) & cs->mask, cs->mult, cs->shift);
+}
+
+/* Called from the tick; folds elapsed counts into the base so deltas stay small. */
+void clock_update(void) {
+    if (timer_ticks() - last_update < CLOCK_UPDATE_TICKS) return;
+    last_update = timer_ticks();
+
+    uint64_t now = current->read();
+    clock_seq++;
+    base_ns += clock_scale((now - base_count) & current->mask, current->mult, current->shift);
+    base_count = now;
+    clock_seq++;
+}
+
+static void clock_switch(clocksource_t* cs) {
+    uint64_t ns = ktime_ns();
+
+    uint32_t flags = irq_save();
+    clock_seq++;
+    base_ns = ns;
+    base_count = cs->read();
+    current = cs;
+    clock_seq++;
+    irq_restore(flags);
+}
+
+const clocksource_t* clock_source(void) {
+    return current;
+}
+
+uint64_t clock_cycles(void) {
+    return rdtsc();
+}
+
+uint32_t clock_tsc_khz(void) {
+    return clocksource_tsc.khz;
+}
+
+uint64_t clock_cycles_to_ns(uint64_t cycles) {
+    return clock_scale(cycles, tsc_mult, CLOCK_SHIFT);
+}
+
+static uint32_t clock_cpuid_edx(uint32_t leaf) {
+    uint32_t eax = leaf, ebx, ecx = 0, edx;
+    __asm__ volatile("cpuid" : "+a"(eax), "=b"(ebx), "+c"(ecx), "=d"(edx));
+    return edx;
+}
+
+/* Needs acpi_init(), which kernel_main runs before clock_init(). */
+static uint32_t clock_find_hpet(void) {
+    const acpi_hpet_t* table = (const acpi_hpet_t*)acpi_find_table("HPET");
+    if (!table || table->address_space != ACPI_SPACE_MEMORY) return 0;
+    /* Out of reach without PAE. */
+    if (table->address >> 32) return 0;
+    return (uint32_t)table->address;
+}
+
+static void clock_hpet_init(void) {
+    uint32_t base = clock_find_hpet();
+    if (!base) return;
+    if (paging_map_range(base, base, PAGE_SIZE, PAGE_WRITE | PAGE_NOCACHE) < 0) return;
+
+    hpet = (volatile uint32_t*)base;
+    uint32_t caps = hpet[HPET_CAPABILITIES / 4];
+    uint32_t period_fs = hpet[HPET_CAPABILITIES / 4 + 1];
+    if (period_fs == 0 || period_fs > HPET_MAX_PERIOD_FS) {
+        hpet = 0;
+        return;
+    }
+    if (!(caps & HPET_COUNT_64)) clocksource_hpet.mask = 0xFFFFFFFFULL;
+
+    hpet[HPET_CONFIG / 4] |= HPET_ENABLE;
+    clocksource_hpet.mult = (uint32_t)udiv64((uint64_t)period_fs << CLOCK_SHIFT, 1000000, 0);
+    clocksource_hpet.khz = (uint32_t)udiv64(1000000000000ULL, period_fs, 0);
+    clocksource_hpet.rating = 200;
+}
+
+/* TSC cycles per PIT-tick-measured interval, scaled to mult. Returns 0 if the count is unusable. */
+static uint32_t clock_calibrate_tsc(void) {
+    uint32_t start = timer_ticks();
+    while (timer_ticks() == start) {
+        __asm__ volatile("hlt");
+    }
+    start = timer_ticks();
+    uint64_t t0 = rdtsc();
+    while (timer_ticks() - start < CLOCK_CALIBRATE_TICKS) {
+        __asm__ volatile("hlt");
+    }
+    uint64_t cycles = rdtsc() - t0;
+    if (cycles == 0 || cycles > 0xFFFFFFFFULL) return 0;
+
+    uint64_t ns = (uint64_t)CLOCK_CALIBRATE_TICKS * TIMER_NS_PER_TICK;
+    return (uint32_t)udiv64(ns << CLOCK_SHIFT, (uint32_t)cycles, 0);
+}
+
+/*
+ * The TSC is preferred when the CPU reports it invariant. Otherwise it may
+ * change rate with power states, so the HPET wins if there is one. Two
+ * calibrations that disagree by more than 1% mark the TSC unusable.
+ */
+static void clock_tsc_init(void) {
+    if (!(clock_cpuid_edx(1) & CPUID_TSC)) return;
+
+    uint32_t m1 = clock_calibrate_tsc();
+    uint32_t m2 = clock_calibrate_tsc();
+    if (!m1 || !m2) return;
+    uint32_t diff = m1 > m2 ? m1 - m2 : m2 - m1;
+    if (diff > m1 / 100) return;
+
+    tsc_mult = (m1 + m2) / 2;
+    clocksource_tsc.mult = tsc_mult;
+    clocksource_tsc.khz = (uint32_t)udiv64(1000000ULL << CLOCK_SHIFT, tsc_mult, 0);
+
+    int invariant = (clock_cpuid_edx(0x80000000) >= 0x80000007) &&
+                    (clock_cpuid_edx(0x80000007) & CPUID_INVARIANT_TSC);
+    clocksource_tsc.rating = invariant ? 300 : 100;
+}
+
+static int clock_bcd(uint8_t v, int binary) {
+    return binary ? v : (v >> 4) * 10 + (v & 0x0F);
+}
+
+static uint32_t clock_days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    int era = y / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return (uint32_t)(era * 146097 + doe - 719468);
+}
+
+void clock_to_tm(uint32_t t, clock_tm_t* tm) {
+    uint32_t days = t / 86400;
+    uint32_t secs = t % 86400;
+    tm->hour = secs / 3600;
+    tm->minute = (secs / 60) % 60;
+    tm->second = secs % 60;
+
+    int z = (int)days + 719468;
+    int era = z / 146097;
+    int doe = z - era * 146097;
+    int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int mp = (5 * doy + 2) / 153;
+    tm->day = doy - (153 * mp + 2) / 5 + 1;
+    tm->month = mp < 10 ? mp + 3 : mp - 9;
+    tm->year = yoe + era * 400 + (tm->month <= 2);
+}
+
+/* Reads the RTC until two consecutive snapshots agree, so no update lands mid-read. */
+static uint32_t clock_read_rtc(void) {
+    uint8_t now[6], prev[6];
+    const uint8_t regs[6] = { RTC_SECONDS, RTC_MINUTES, RTC_HOURS, RTC_DAY, RTC_MONTH, RTC_YEAR };
+
+    for (int i = 0; i < 6; i++) now[i] = 0xFF;
+    int same;
+    do {
+        memcpy(prev, now, sizeof(now));
+        while (rtc_is_updating());
+        same = 1;
+        for (int i = 0; i < 6; i++) {
+            now[i] = rtc_read(regs[i]);
+            if (now[i] != prev[i]) same = 0;
+        }
+    } while (!same);
+
+    uint8_t status = rtc_read(RTC_STATUS_B);
+    int binary = status & RTC_BINARY;
+    int pm = now[2] & 0x80;
+    int hour = clock_bcd(now[2] & 0x7F, binary);
+    if (!(status & RTC_24H)) {
+        hour %= 12;
+        if (pm) hour += 12;
+    }
+
+    uint32_t days = clock_days_from_civil(2000 + clock_bcd(now[5], binary),
+                                          clock_bcd(now[4], binary),
+                                          clock_bcd(now[3], binary));
+    return days * 86400 + hour * 3600 + clock_bcd(now[1], binary) * 60 + clock_bcd(now[0], binary);
+}
+
+uint32_t clock_realtime(void) {
+    return boot_epoch + (uint32_t)udiv64(ktime_ns() - boot_ns, 1000000000, 0);
+}
+
+void clock_init(void) {
+    clock_hpet_init();
+    clock_tsc_init();
+
+    clocksource_t* best = &clocksource_jiffies;
+    if (clocksource_hpet.rating > best->rating) best = &clocksource_hpet;
+    if (clocksource_tsc.rating > best->rating) best = &clocksource_tsc;
+    clock_switch(best);
+
+    boot_epoch = clock_read_rtc();
+    boot_ns = ktime_ns();
+
+    char buf[16];
+    terminal_writestring("Clock: ");
+    terminal_writestring(best->name);
+    if (clocksource_tsc.khz) {
+        terminal_writestring(", TSC ");
+        itoa((int)(clocksource_tsc.khz / 1000), buf);
+        terminal_writestring(buf);
+        terminal_writestring(" MHz");
+        if (clocksource_tsc.rating < 300) terminal_writestring(" (not invariant)");
+    }
+    if (hpet) {
+        terminal_writestring(", HPET ");
+        itoa((int)clocksource_hpet.khz, buf);
+        terminal_writestring(buf);
+        terminal_writestring(" kHz");
+    }
+    terminal_writestring("\n");
+}
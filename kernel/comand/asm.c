@@ -572,8 +572,8 @@ static void asm_read_line(char* buffer, int max) {
     static int shift_pressed = 0;
 
     while (1) {
-        if (inb(0x64) & 0x1) {
-            uint8_t scancode = inb(0x60);
+        uint8_t scancode;
+        if (kbd_read(&scancode)) {
 
             if ((scancode & 0x7F) == 42 || (scancode & 0x7F) == 54) {
                 shift_pressed = !(scancode & 0x80);
@@ -0,0 +1,106 @@
+
+
+#include <stdint.h>
+#include "include/ata.h"
+#include "include/iso9660.h"
+
+#define CDROM_CHUNK_BLOCKS 16
+
+static uint8_t cdrom_buf[CDROM_CHUNK_BLOCKS * ISO9660_BLOCK_SIZE];
+
+static iso9660_fs_t* cdrom_fs() {
+    iso9660_fs_t* fs = iso9660_get_fs();
+    if (fs) return fs;
+
+    for (uint8_t drive = 0; drive < ATA_MAX_DRIVES; drive++) {
+        if (atapi_is_present(drive) && iso9660_mount(drive) == 0) {
+            return iso9660_get_fs();
+        }
+    }
+    terminal_writestring("cdrom: no ISO9660 medium found\n");
+    return 0;
+}
+
+static void cdrom_ls(iso9660_fs_t* fs, const char* path) {
+    iso9660_entry_t dir;
+    if (iso9660_lookup(fs, path, &dir) != 0 || !dir.is_dir) {
+        terminal_writestring("cdrom: ");
+        terminal_writestring(path);
+        terminal_writestring(": No such directory\n");
+        return;
+    }
+
+    uint32_t pos = 0;
+    iso9660_entry_t entry;
+    while (iso9660_readdir(fs, &dir, &pos, &entry) > 0) {
+        terminal_writestring(entry.name);
+        if (entry.is_dir) terminal_writestring("/");
+        terminal_writestring("  ");
+    }
+    terminal_writestring("\n");
+}
+
+static void cdrom_cat(iso9660_fs_t* fs, const char* path) {
+    iso9660_entry_t file;
+    if (iso9660_lookup(fs, path, &file) != 0 || file.is_dir) {
+        terminal_writestring("cdrom: ");
+        terminal_writestring(path);
+        terminal_writestring(": No such file\n");
+        return;
+    }
+
+    uint32_t offset = 0;
+    while (offset < file.size) {
+        int n = iso9660_read(fs, &file, offset, cdrom_buf, sizeof(cdrom_buf));
+        if (n <= 0) {
+            terminal_writestring("\ncdrom: read error\n");
+            return;
+        }
+        for (int i = 0; i < n; i++) {
+            terminal_putchar(cdrom_buf[i]);
+        }
+        offset += n;
+    }
+    terminal_putchar('\n');
+}
+
+static void cmd_cdrom(const char* args) {
+    char sub[16];
+    int i = 0;
+    while (*args == ' ') args++;
+    while (args[i] && args[i] != ' ' && i < 15) {
+        sub[i] = args[i];
+        i++;
+    }
+    sub[i] = '\0';
+    const char* path = args + i;
+    while (*path == ' ') path++;
+
+    if (sub[0] != '\0' && strcmp(sub, "info") != 0 && strcmp(sub, "ls") != 0 && strcmp(sub, "cat") != 0) {
+        terminal_writestring("Usage: cdrom [info | ls [path] | cat <file>]\n");
+        return;
+    }
+
+    iso9660_fs_t* fs = cdrom_fs();
+    if (!fs) return;
+
+    if (sub[0] == '\0' || strcmp(sub, "info") == 0) {
+        char buf[16];
+        terminal_writestring("Drive hd");
+        buf[0] = 'a' + fs->drive;
+        buf[1] = '\0';
+        terminal_writestring(buf);
+        terminal_writestring(", volume ");
+        terminal_writestring(fs->volume_id);
+        terminal_writestring(", ");
+        itoa((int)(fs->volume_blocks / 512), buf);
+        terminal_writestring(buf);
+        terminal_writestring(" MB\n");
+    } else if (strcmp(sub, "ls") == 0) {
+        cdrom_ls(fs, path[0] ? path : "/");
+    } else if (path[0] == '\0') {
+        terminal_writestring("cdrom: missing file name\n");
+    } else {
+        cdrom_cat(fs, path);
+    }
+}
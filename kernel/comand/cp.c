@@ -1,8 +1,8 @@
 static void cmd_cp(const char* args) {
     const char* p = args;
-    char src_name[32];
+    char src_name[VFS_MAX_PATH];
     int j = 0;
-    while (p[j] && p[j] != ' ' && j < 31) {
+    while (p[j] && p[j] != ' ' && j < VFS_MAX_PATH - 1) {
         src_name[j] = p[j];
         j++;
     }
@@ -11,28 +11,55 @@ static void cmd_cp(const char* args) {
     const char* dest = p + j;
     while (*dest == ' ') dest++;
 
-    if (strlen(src_name) > 0 && strlen(dest) > 0) {
-        file_t* s = find_file(src_name);
-        if (s) {
-            file_t* d = find_file(dest);
-            if (!d) d = create_file(dest);
-            if (d) {
-                strcpy(d->content, s->content);
-                d->size = s->size;
-                terminal_writestring("cp: copied '");
-                terminal_writestring(src_name);
-                terminal_writestring("' to '");
-                terminal_writestring(dest);
-                terminal_writestring("'\n");
-            } else {
-                terminal_writestring("cp: failed to create destination\n");
-            }
-        } else {
-            terminal_writestring("cp: ");
-            terminal_writestring(src_name);
-            terminal_writestring(": No such file\n");
-        }
-    } else {
+    if (strlen(src_name) == 0 || strlen(dest) == 0) {
         terminal_writestring("Usage: cp <source> <dest>\n");
+        return;
+    }
+
+    int in = vfs_open(src_name, VFS_O_RDONLY);
+    if (in < 0) {
+        terminal_writestring("cp: ");
+        terminal_writestring(src_name);
+        terminal_writestring(": ");
+        terminal_writestring(vfs_strerror(in));
+        terminal_writestring("\n");
+        return;
+    }
+
+    int out = vfs_open(dest, VFS_O_WRONLY | VFS_O_CREAT | VFS_O_TRUNC);
+    if (out < 0) {
+        terminal_writestring("cp: ");
+        terminal_writestring(dest);
+        terminal_writestring(": ");
+        terminal_writestring(vfs_strerror(out));
+        terminal_writestring("\n");
+        vfs_close(in);
+        return;
+    }
+
+    char chunk[512];
+    int n;
+    int err = 0;
+    while ((n = vfs_read(in, chunk, sizeof(chunk))) > 0) {
+        int w = vfs_write(out, chunk, n);
+        if (w != n) {
+            err = w < 0 ? w : VFS_ENOSPC;
+            break;
+        }
+    }
+    if (n < 0) err = n;
+    vfs_close(in);
+    vfs_close(out);
+
+    if (err < 0) {
+        terminal_writestring("cp: ");
+        terminal_writestring(vfs_strerror(err));
+        terminal_writestring("\n");
+        return;
     }
+    terminal_writestring("cp: copied '");
+    terminal_writestring(src_name);
+    terminal_writestring("' to '");
+    terminal_writestring(dest);
+    terminal_writestring("'\n");
 }
@@ -0,0 +1,67 @@
+
+
+#include <stdint.h>
+#include "include/lib.h"
+#include "include/smp.h"
+#include "include/clock.h"
+
+static void cpus_put(uint32_t value, int width) {
+    char buf[12];
+    itoa((int)value, buf);
+    for (int i = strlen(buf); i < width; i++) {
+        terminal_putchar(' ');
+    }
+    terminal_writestring(buf);
+}
+
+static void cpus_pong(void* arg) {
+    *(volatile uint32_t*)arg = smp_cpu_id();
+}
+
+static void cpus_ping(void) {
+    for (int id = 1; id < smp_cpu_count(); id++) {
+        volatile uint32_t answer = 0xFFFFFFFF;
+        uint64_t start = clock_cycles();
+        int rc = smp_call(id, cpus_pong, (void*)&answer);
+        uint64_t ns = clock_cycles_to_ns(clock_cycles() - start);
+
+        terminal_writestring("cpu ");
+        cpus_put(id, 0);
+        if (rc < 0 || answer != (uint32_t)id) {
+            terminal_writestring(": no answer\n");
+            continue;
+        }
+        terminal_writestring(": round trip ");
+        cpus_put((uint32_t)udiv64(ns, 1000, 0), 0);
+        terminal_writestring(" us\n");
+    }
+}
+
+static void cmd_cpus(const char* args) {
+    if (strcmp(args, "-p") == 0) {
+        if (smp_online_count() == 1) {
+            terminal_writestring("cpus: no application processors\n");
+            return;
+        }
+        cpus_ping();
+        return;
+    } else if (*args) {
+        terminal_writestring("Usage: cpus [-p]\n");
+        return;
+    }
+
+    terminal_writestring("CPU APIC  STATE    INTERRUPTS   IPIS\n");
+    for (int id = 0; id < smp_cpu_count(); id++) {
+        cpu_t* cpu = smp_cpu(id);
+        cpus_put(cpu->id, 3);
+        cpus_put(cpu->apic_id, 5);
+        terminal_writestring(cpu->online ? "  online " : "  offline");
+        if (id == 0) {
+            terminal_writestring("           -");
+        } else {
+            cpus_put(cpu->interrupts, 12);
+        }
+        cpus_put(cpu->ipis, 7);
+        terminal_putchar('\n');
+    }
+}
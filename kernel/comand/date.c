@@ -1,4 +1,25 @@
+static void date_put2(int v) {
+    terminal_putchar('0' + (v / 10) % 10);
+    terminal_putchar('0' + v % 10);
+}
+
 static void cmd_date(const char* args) {
     (void)args;
-    terminal_writestring("2026-01-10\n");
+    clock_tm_t tm;
+    clock_to_tm(clock_realtime(), &tm);
+
+    char buf[12];
+    itoa(tm.year, buf);
+    terminal_writestring(buf);
+    terminal_putchar('-');
+    date_put2(tm.month);
+    terminal_putchar('-');
+    date_put2(tm.day);
+    terminal_putchar(' ');
+    date_put2(tm.hour);
+    terminal_putchar(':');
+    date_put2(tm.minute);
+    terminal_putchar(':');
+    date_put2(tm.second);
+    terminal_writestring(" UTC\n");
 }
@@ -6,7 +6,7 @@ static void cmd_help(const char* args) {
         return;
     }
 
-    terminal_writestring("Lakos OS Commands: help, man, cls, ver, pwd, ls, cd, echo, uname, date, cat, mkdir, disks, read_sector, write_sector, mount, useradd, passwd, login, userdel, crypt, whoami, touch, rm, cp, shutdown, reboot, gui, colorb\nAvailable programs: hello, test, editor, calc\nTip: <command> --help or man <command>\n");
+    terminal_writestring("Lakos OS Commands: help, man, cls, ver, pwd, ls, cd, echo, uname, date, cat, mkdir, disks, read_sector, write_sector, mount, useradd, passwd, login, userdel, crypt, whoami, touch, rm, cp, shutdown, reboot, gui, colorb, iostat, meminfo, cdrom, tar, ps, softirq, irqstat, cpus\nAvailable programs: hello, test, editor, calc\nTip: <command> --help or man <command>\n");
 }
 
 static void cmd_man(const char* args) {
@@ -75,6 +75,22 @@ static void cmd_man(const char* args) {
         terminal_writestring("cls - clear screen\nusage: cls\n");
     } else if (strcmp(args, "colorb") == 0) {
         terminal_writestring("colorb - set background color by RGB\nusage: colorb <R> <G> <B> | #RRGGBB\nformats: 255 128 0 | 0xFF 0x80 0 | 255,128,0 | #FF8000\n");
+    } else if (strcmp(args, "meminfo") == 0) {
+        terminal_writestring("meminfo - physical memory and kernel heap usage\nusage: meminfo [-s] [-l [start]]\n  -s        list allocation sites\n  -l start  begin leak tracking from now\n  -l        list allocations still live since the mark\n");
+    } else if (strcmp(args, "iostat") == 0) {
+        terminal_writestring("iostat - per-disk I/O counters and latency histograms\nusage: iostat [-l] [-z] [interval [count]]\n  -l  show log2 latency histograms\n  -z  reset counters\n");
+    } else if (strcmp(args, "cdrom") == 0) {
+        terminal_writestring("cdrom - browse the ISO9660 boot medium\nusage: cdrom [info | ls [path] | cat <file>]\n");
+    } else if (strcmp(args, "irqstat") == 0) {
+        terminal_writestring("irqstat - hardware interrupt statistics\nusage: irqstat [-l] [-z]\n  per vector in use: PIC line, interrupts taken, those no handler\n  claimed, spurious ones, average and worst handler time, handlers\n  -l  log2 histograms of handler duration, timer entry latency and\n      sections run with interrupts disabled\n  -z  reset counters\n");
+    } else if (strcmp(args, "cpus") == 0) {
+        terminal_writestring("cpus - list processors\nusage: cpus [-p]\n  per CPU: local APIC id, whether it started, and the\n  interrupts and calls it took; the bootstrap CPU's interrupts are in\n  irqstat\n  -p  run an empty call on every other CPU and show the round trip\n");
+    } else if (strcmp(args, "softirq") == 0) {
+        terminal_writestring("softirq - deferred interrupt work statistics\nusage: softirq\n  per softirq: times raised and run, average and worst run time\n  per work queue: items queued, run and waiting, deepest backlog,\n  time from queueing to start, and run time\n");
+    } else if (strcmp(args, "ps") == 0) {
+        terminal_writestring("ps - list kernel threads\nusage: ps\n  TIME is CPU time used, SWITCHES how often the thread was scheduled in\n  the last line summarizes the shell's event loop tasks\n");
+    } else if (strcmp(args, "tar") == 0) {
+        terminal_writestring("tar - extract, list or create ustar archives\nusage: tar -x <archive|@initrd> [dir]\n       tar -t <archive|@initrd>\n       tar -c <archive> <dir>\n  @initrd is the archive the kernel booted with\n");
     } else {
         terminal_writestring("man: no manual entry for '");
         terminal_writestring(args);
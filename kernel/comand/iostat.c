@@ -0,0 +1,184 @@
+
+
+#include <stdint.h>
+#include "include/ata.h"
+#include "include/timer.h"
+#include "include/event.h"
+#include "include/keyboard.h"
+
+static ata_stats_t iostat_prev[ATA_MAX_DRIVES];
+
+static void iostat_put(uint32_t value, int width) {
+    char buf[12];
+    int len = 0;
+
+    do {
+        buf[len++] = '0' + (value % 10);
+        value /= 10;
+    } while (value > 0);
+
+    for (int i = len; i < width; i++) {
+        terminal_putchar(' ');
+    }
+    while (len > 0) {
+        terminal_putchar(buf[--len]);
+    }
+}
+
+static void iostat_drive_name(int drive) {
+    char name[5];
+    name[0] = 'h';
+    name[1] = 'd';
+    name[2] = 'a' + drive;
+    name[3] = ' ';
+    name[4] = '\0';
+    terminal_writestring(name);
+}
+
+static void iostat_print_table(int delta) {
+    terminal_writestring("Device   reads  writes   rd_sec   wr_sec merges errors tmo qd maxqd busy_Mcyc\n");
+
+    for (int d = 0; d < ATA_MAX_DRIVES; d++) {
+        ata_stats_t* st = ata_get_stats(d);
+        ata_stats_t* prev = &iostat_prev[d];
+        if (!st->present && !st->reads && !st->writes) continue;
+
+        iostat_drive_name(d);
+        if (delta) {
+            iostat_put(st->reads - prev->reads, 8);
+            iostat_put(st->writes - prev->writes, 8);
+            iostat_put(st->sectors_read - prev->sectors_read, 9);
+            iostat_put(st->sectors_written - prev->sectors_written, 9);
+            iostat_put(st->merges - prev->merges, 7);
+            iostat_put(st->errors - prev->errors, 7);
+            iostat_put(st->timeouts - prev->timeouts, 4);
+        } else {
+            iostat_put(st->reads, 8);
+            iostat_put(st->writes, 8);
+            iostat_put(st->sectors_read, 9);
+            iostat_put(st->sectors_written, 9);
+            iostat_put(st->merges, 7);
+            iostat_put(st->errors, 7);
+            iostat_put(st->timeouts, 4);
+        }
+        iostat_put(st->inflight, 3);
+        iostat_put(st->max_inflight, 6);
+        uint64_t busy = delta ? st->busy_cycles - prev->busy_cycles : st->busy_cycles;
+        iostat_put((uint32_t)(busy >> 20), 10);
+        terminal_putchar('\n');
+    }
+}
+
+static void iostat_print_hist(const char* label, const uint32_t* hist) {
+    uint32_t max = 0;
+    for (int b = 0; b < ATA_LAT_BUCKETS; b++) {
+        if (hist[b] > max) max = hist[b];
+    }
+
+    terminal_writestring("  ");
+    terminal_writestring(label);
+    terminal_writestring(" latency (cycles):\n");
+    if (max == 0) {
+        terminal_writestring("    (no samples)\n");
+        return;
+    }
+
+    uint32_t step = (max + 39) / 40;
+    for (int b = 0; b < ATA_LAT_BUCKETS; b++) {
+        if (!hist[b]) continue;
+        terminal_writestring("    2^");
+        iostat_put(b, 2);
+        iostat_put(hist[b], 9);
+        terminal_writestring(" |");
+        int bar = (int)(hist[b] / step);
+        if (bar == 0) bar = 1;
+        for (int i = 0; i < bar; i++) {
+            terminal_putchar('#');
+        }
+        terminal_putchar('\n');
+    }
+}
+
+static void iostat_print_latency() {
+    for (int d = 0; d < ATA_MAX_DRIVES; d++) {
+        ata_stats_t* st = ata_get_stats(d);
+        if (!st->present && !st->reads && !st->writes) continue;
+
+        iostat_drive_name(d);
+        terminal_putchar('\n');
+        iostat_print_hist("read", st->read_hist);
+        iostat_print_hist("write", st->write_hist);
+    }
+}
+
+static int iostat_wait(int seconds) {
+    uint32_t deadline = timer_deadline(seconds * 1000);
+
+    for (;;) {
+        uint8_t scancode;
+        if (kbd_read(&scancode)) {
+            return 1;
+        }
+        int32_t left = (int32_t)(deadline - timer_ticks());
+        if (left <= 0) return 0;
+        event_loop_wait(irq_event(1), (uint32_t)left);
+    }
+}
+
+static void cmd_iostat(const char* args) {
+    int latency = 0;
+    int interval = 0;
+    int count = 0;
+    const char* p = args;
+
+    while (*p) {
+        while (*p == ' ') p++;
+        if (!*p) break;
+
+        if (strncmp(p, "-l", 2) == 0) {
+            latency = 1;
+        } else if (strncmp(p, "-z", 2) == 0) {
+            for (int d = 0; d < ATA_MAX_DRIVES; d++) {
+                ata_reset_stats(d);
+            }
+            terminal_writestring("iostat: counters reset\n");
+            return;
+        } else if (*p >= '0' && *p <= '9') {
+            if (interval == 0) interval = atoi(p);
+            else count = atoi(p);
+        } else {
+            terminal_writestring("Usage: iostat [-l] [-z] [interval [count]]\n");
+            return;
+        }
+        while (*p && *p != ' ') p++;
+    }
+
+    if (interval <= 0) {
+        iostat_print_table(0);
+        if (latency) iostat_print_latency();
+        return;
+    }
+
+    for (int d = 0; d < ATA_MAX_DRIVES; d++) {
+        iostat_prev[d] = *ata_get_stats(d);
+    }
+
+    int iteration = 0;
+    while (1) {
+        if (iostat_wait(interval)) break;
+
+        terminal_initialize();
+        terminal_writestring("iostat: every ");
+        iostat_put(interval, 0);
+        terminal_writestring("s, press any key to stop\n\n");
+        iostat_print_table(1);
+        if (latency) iostat_print_latency();
+
+        for (int d = 0; d < ATA_MAX_DRIVES; d++) {
+            iostat_prev[d] = *ata_get_stats(d);
+        }
+
+        iteration++;
+        if (count > 0 && iteration >= count) break;
+    }
+}
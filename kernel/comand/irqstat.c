@@ -0,0 +1,159 @@
+
+
+#include <stdint.h>
+#include "include/lib.h"
+#include "include/irq.h"
+#include "include/clock.h"
+#include "include/keyboard.h"
+
+static void irqstat_put(uint32_t value, int width) {
+    char buf[12];
+    itoa((int)value, buf);
+    for (int i = strlen(buf); i < width; i++) {
+        terminal_putchar(' ');
+    }
+    terminal_writestring(buf);
+}
+
+static uint32_t irqstat_us(uint64_t cycles, uint32_t count) {
+    if (count == 0) return 0;
+    uint64_t ns = clock_cycles_to_ns(udiv64(cycles, count, 0));
+    return (uint32_t)udiv64(ns, 1000, 0);
+}
+
+static void irqstat_hex(uint32_t value) {
+    char buf[11];
+    buf[0] = '0';
+    buf[1] = 'x';
+    for (int i = 0; i < 8; i++) {
+        buf[2 + i] = "0123456789ABCDEF"[(value >> (28 - i * 4)) & 0xF];
+    }
+    buf[10] = '\0';
+    terminal_writestring(buf);
+}
+
+static void irqstat_print_hist(const char* label, const uint32_t* hist) {
+    uint32_t max = 0;
+    for (int b = 0; b < IRQ_HIST_BUCKETS; b++) {
+        if (hist[b] > max) max = hist[b];
+    }
+    if (max == 0) return;
+
+    terminal_writestring("  ");
+    terminal_writestring(label);
+    terminal_writestring(" (cycles):\n");
+    uint32_t step = (max + 39) / 40;
+    for (int b = 0; b < IRQ_HIST_BUCKETS; b++) {
+        if (!hist[b]) continue;
+        terminal_writestring("    2^");
+        irqstat_put(b, 2);
+        irqstat_put(hist[b], 9);
+        terminal_writestring(" |");
+        int bar = (int)(hist[b] / step);
+        if (bar == 0) bar = 1;
+        for (int i = 0; i < bar; i++) {
+            terminal_putchar('#');
+        }
+        terminal_putchar('\n');
+    }
+}
+
+static void irqstat_print_histograms(void) {
+    for (int vec = IRQ_VECTOR_BASE; vec < IRQ_VECTORS; vec++) {
+        const irq_vector_t* v = irq_vector(vec);
+        if (!v->count) continue;
+
+        terminal_writestring("\nvector ");
+        irqstat_put(vec, 0);
+        if (v->actions) {
+            terminal_writestring(" (");
+            terminal_writestring(v->actions->name ? v->actions->name : "?");
+            terminal_putchar(')');
+        }
+        terminal_putchar('\n');
+        irqstat_print_hist("handler duration", v->duration_hist);
+        if (v->latency_count) {
+            terminal_writestring("  entry latency: ");
+            irqstat_put(v->latency_count, 0);
+            terminal_writestring(" samples, max ");
+            irqstat_put(irqstat_us(v->latency_max, 1), 0);
+            terminal_writestring(" us\n");
+            irqstat_print_hist("entry latency", v->latency_hist);
+        }
+    }
+
+    const irqs_off_stats_t* off = irqs_off_stats();
+    terminal_writestring("\ninterrupts off: ");
+    irqstat_put(off->count, 0);
+    terminal_writestring(" sections, average ");
+    irqstat_put(irqstat_us(off->cycles, off->count), 0);
+    terminal_writestring(" us, max ");
+    irqstat_put(irqstat_us(off->max_cycles, 1), 0);
+    terminal_writestring(" us at ");
+    if (off->max_site < IRQ_VECTORS) {
+        terminal_writestring("vector ");
+        irqstat_put(off->max_site, 0);
+    } else {
+        irqstat_hex(off->max_site);
+    }
+    terminal_putchar('\n');
+    irqstat_print_hist("section length", off->hist);
+}
+
+static void cmd_irqstat(const char* args) {
+    int histograms = 0;
+    const char* p = args;
+
+    while (*p) {
+        while (*p == ' ') p++;
+        if (!*p) break;
+
+        if (strncmp(p, "-l", 2) == 0) {
+            histograms = 1;
+        } else if (strncmp(p, "-z", 2) == 0) {
+            irq_reset_stats();
+            terminal_writestring("irqstat: counters reset\n");
+            return;
+        } else {
+            terminal_writestring("Usage: irqstat [-l] [-z]\n");
+            return;
+        }
+        while (*p && *p != ' ') p++;
+    }
+
+    terminal_writestring("VEC IRQ      COUNT  UNHANDLED  SPURIOUS  AVG(us)  MAX(us)  HANDLERS\n");
+    for (int vec = IRQ_VECTOR_BASE; vec < IRQ_VECTORS; vec++) {
+        uint32_t flags = irq_save();
+        irq_vector_t snap = *irq_vector(vec);
+        irq_restore(flags);
+        if (!snap.actions && !snap.count && !snap.spurious) continue;
+
+        irqstat_put(vec, 3);
+        if (vec < IRQ_APIC_BASE) {
+            irqstat_put(vec - IRQ_VECTOR_BASE, 4);
+        } else {
+            terminal_writestring("   -");
+        }
+        irqstat_put(snap.count, 11);
+        irqstat_put(snap.unhandled, 11);
+        irqstat_put(snap.spurious, 10);
+        irqstat_put(irqstat_us(snap.cycles, snap.count), 9);
+        irqstat_put(irqstat_us(snap.max_cycles, 1), 9);
+        terminal_writestring("  ");
+        for (irq_action_t* action = snap.actions; action; action = action->next) {
+            terminal_writestring(action->name ? action->name : "?");
+            terminal_putchar('(');
+            irqstat_put(action->count, 0);
+            terminal_putchar(')');
+            if (action->next) terminal_writestring(", ");
+        }
+        terminal_putchar('\n');
+    }
+
+    if (kbd_dropped()) {
+        terminal_writestring("Keyboard buffer overflows: ");
+        irqstat_put(kbd_dropped(), 0);
+        terminal_putchar('\n');
+    }
+    if (histograms) irqstat_print_histograms();
+}
@@ -4,8 +4,13 @@ static void cmd_ls(const char* args) {
         target_dir = current_dir;
     }
 
-    if (tar_archive) {
-        tar_list_directory(tar_archive, target_dir);
+    int fd = vfs_open(target_dir, VFS_O_RDONLY | VFS_O_DIRECTORY);
+    if (fd < 0) {
+        terminal_writestring("ls: ");
+        terminal_writestring(target_dir);
+        terminal_writestring(": ");
+        terminal_writestring(vfs_strerror(fd));
+        terminal_writestring("\n");
         return;
     }
 
@@ -20,39 +25,13 @@ static void cmd_ls(const char* args) {
         } \
     } while (0)
 
-    if (strcmp(target_dir, "/") == 0) {
-        for (int i = 0; i < dir_count; i++) {
-            LS_PRINT(dirs[i]); LS_PRINT("/ ");
-        }
-        if (printed > 0) { terminal_writestring("\n"); }
-    } else if (strcmp(target_dir, "/bin") == 0) {
-        LS_PRINT("hello  test  editor  calc\n");
-    } else if (strcmp(target_dir, "/home") == 0) {
-        for (int i = 0; i < home_dir_count; i++) {
-            LS_PRINT(home_dirs[i]); LS_PRINT("/ ");
-        }
-        if (printed > 0) { terminal_writestring("\n"); }
-    } else if (strncmp(target_dir, "/home/", 6) == 0) {
-        const char* dir = target_dir + 6;
-        int dir_len = 0;
-        while (dir[dir_len] && dir[dir_len] != '/') dir_len++;
-        char dir_name[32];
-        if (dir_len >= 32) dir_len = 31;
-        for (int k = 0; k < dir_len; k++) dir_name[k] = dir[k];
-        dir_name[dir_len] = '\0';
-        for (int i = 0; i < home_dir_count; i++) {
-            if (strcmp(home_dirs[i], dir_name) == 0) {
-                for (int j = 0; j < home_sub_count[i]; j++) {
-                    LS_PRINT(home_subdirs[i][j]); LS_PRINT("/ ");
-                }
-                if (printed > 0) { terminal_writestring("\n"); }
-                return;
-            }
-        }
-        LS_PRINT(".\n");
-    } else {
-        LS_PRINT(".\n");
+    vfs_dirent_t entry;
+    while (vfs_readdir(fd, &entry) > 0) {
+        LS_PRINT(entry.name);
+        LS_PRINT(entry.type == VFS_TYPE_DIR ? "/ " : " ");
     }
+    terminal_writestring("\n");
+    vfs_close(fd);
 
     #undef LS_PRINT
 }
@@ -1,11 +1,11 @@
 
 
 #include <stdint.h>
+#include "include/vfs.h"
+#include "include/kmalloc.h"
+#include "include/timer.h"
 
 extern void terminal_writestring(const char* s);
-extern void* tar_archive;
-extern void* tar_lookup(void* archive, const char* filename);
-extern int tar_get_file_size(void* archive, const char* filename);
 extern char current_dir[256];
 extern void kernel_execute_command(const char* input);
 extern int atoi(const char* s);
@@ -23,15 +23,39 @@ extern char* strcat(char* dest, const char* src);
 #define MAX_VAR_NAME 32
 #define MAX_VAR_VALUE 256
 #define MAX_SCRIPT_SIZE 4096
-#define MAX_LINES 256
 #define MAX_LINE_LEN 256
 
 static char var_names[MAX_VARS][MAX_VAR_NAME];
 static char var_values[MAX_VARS][MAX_VAR_VALUE];
 static int var_count = 0;
 
-static char script_lines[MAX_LINES][MAX_LINE_LEN];
+static char** script_lines;
 static int script_line_count = 0;
+static int script_line_capacity = 0;
+
+static void script_clear(void) {
+    for (int i = 0; i < script_line_count; i++) {
+        kfree(script_lines[i]);
+    }
+    script_line_count = 0;
+}
+
+static int script_add_line(const char* text, int len) {
+    if (script_line_count == script_line_capacity) {
+        int capacity = script_line_capacity ? script_line_capacity * 2 : 32;
+        char** grown = krealloc(script_lines, capacity * sizeof(char*));
+        if (!grown) return -1;
+        script_lines = grown;
+        script_line_capacity = capacity;
+    }
+
+    char* line = kmalloc(len + 1);
+    if (!line) return -1;
+    for (int i = 0; i < len; i++) line[i] = text[i];
+    line[len] = '\0';
+    script_lines[script_line_count++] = line;
+    return 0;
+}
 
 static int find_var(const char* name) {
     for (int i = 0; i < var_count; i++) {
@@ -409,10 +433,7 @@ static void execute_line(const char* line) {
 
     if (strncmp(line, "sleep ", 6) == 0) {
         int delay = atoi(line + 6);
-
-        for (volatile int i = 0; i < delay * 1000000; i++) {
-            __asm__ volatile("nop");
-        }
+        if (delay > 0) timer_sleep_ms(delay * 1000);
         return;
     }
 
@@ -421,47 +442,46 @@ static void execute_line(const char* line) {
     terminal_writestring("'. Use 'sh command' to execute shell commands.\n");
 }
 
-static int load_script_from_tar(const char* filename) {
-    if (!tar_archive) {
+static int load_script(const char* filename) {
+    int fd = vfs_open(filename, VFS_O_RDONLY);
+    if (fd < 0) {
         return 0;
     }
 
-    char tar_path[256];
-    if (filename[0] == '/') {
-        strcpy(tar_path, filename + 1);
-    } else if (strcmp(current_dir, "/") == 0) {
-        strcpy(tar_path, filename);
-    } else {
-        strcpy(tar_path, current_dir + 1);
-        if (tar_path[strlen(tar_path) - 1] != '/') {
-            strcat(tar_path, "/");
-        }
-        strcat(tar_path, filename);
-    }
-
-    void* data = tar_lookup(tar_archive, tar_path);
-    int size = tar_get_file_size(tar_archive, tar_path);
-
-    if (!data || size <= 0) {
+    vfs_stat_t st;
+    if (vfs_fstat(fd, &st) != 0 || st.size == 0) {
+        vfs_close(fd);
         return 0;
     }
 
-    char* script = (char*)data;
-    script_line_count = 0;
-    int line_start = 0;
-
-    for (int i = 0; i <= size && script_line_count < MAX_LINES; i++) {
-        if (i == size || script[i] == '\n') {
-            int line_len = i - line_start;
-            if (line_len >= MAX_LINE_LEN) line_len = MAX_LINE_LEN - 1;
-            strncpy(script_lines[script_line_count], script + line_start, line_len);
-            script_lines[script_line_count][line_len] = '\0';
-            script_line_count++;
-            line_start = i + 1;
+    char chunk[512];
+    char line[MAX_LINE_LEN];
+    int line_len = 0;
+    int n;
+    int ok = 1;
+    script_clear();
+
+    while (ok && (n = vfs_read(fd, chunk, sizeof(chunk))) > 0) {
+        for (int i = 0; i < n; i++) {
+            if (chunk[i] == '\n') {
+                if (script_add_line(line, line_len) < 0) {
+                    ok = 0;
+                    break;
+                }
+                line_len = 0;
+            } else if (line_len < MAX_LINE_LEN - 1) {
+                line[line_len++] = chunk[i];
+            }
         }
     }
+    if (ok && script_add_line(line, line_len) < 0) ok = 0;
 
-    return 1;
+    vfs_close(fd);
+    if (!ok) {
+        terminal_writestring("lsh: out of memory\n");
+        script_clear();
+    }
+    return ok;
 }
 
 extern void read_line(char* buffer, int max, int echo);
@@ -503,11 +523,8 @@ static void lsh_repl() {
 
         if (is_block_start(trimmed)) {
 
-            script_line_count = 0;
-
-            strncpy(script_lines[script_line_count], trimmed, MAX_LINE_LEN - 1);
-            script_lines[script_line_count][MAX_LINE_LEN - 1] = '\0';
-            script_line_count++;
+            script_clear();
+            script_add_line(trimmed, strlen(trimmed));
 
             int if_depth = 0;
             int while_depth = 0;
@@ -526,10 +543,8 @@ static void lsh_repl() {
 
                 if (strlen(trimmed) == 0) continue;
 
-                if (script_line_count < MAX_LINES) {
-                    strncpy(script_lines[script_line_count], trimmed, MAX_LINE_LEN - 1);
-                    script_lines[script_line_count][MAX_LINE_LEN - 1] = '\0';
-                    script_line_count++;
+                if (script_add_line(trimmed, strlen(trimmed)) < 0) {
+                    terminal_writestring("lsh: out of memory\n");
                 }
 
                 if (strncmp(trimmed, "if ", 3) == 0) if_depth++;
@@ -566,7 +581,7 @@ static void cmd_lsh(const char* args) {
         return;
     }
 
-    if (!load_script_from_tar(args)) {
+    if (!load_script(args)) {
         terminal_writestring("lsh: cannot load script '");
         terminal_writestring(args);
         terminal_writestring("'\n");
@@ -0,0 +1,184 @@
+
+
+#include <stdint.h>
+#include "include/lib.h"
+#include "include/pmm.h"
+#include "include/kmalloc.h"
+#include "include/arena.h"
+#include "include/tmpfs.h"
+#include "include/vfs.h"
+#include "include/paging.h"
+
+extern char kernel_end[];
+
+static uint32_t meminfo_last_allocs;
+static uint32_t meminfo_last_frees;
+
+static void meminfo_put(uint32_t value, int width) {
+    char buf[12];
+    int len = 0;
+
+    do {
+        buf[len++] = '0' + (value % 10);
+        value /= 10;
+    } while (value > 0);
+
+    for (int i = len; i < width; i++) {
+        terminal_putchar(' ');
+    }
+    while (len > 0) {
+        terminal_putchar(buf[--len]);
+    }
+}
+
+static void meminfo_line(const char* label, uint32_t kb) {
+    terminal_writestring(label);
+    meminfo_put(kb, 8);
+    terminal_writestring(" KB\n");
+}
+
+static void meminfo_site_name(const kmalloc_site_t* s) {
+    const char* file = s->file;
+    const char* slash = strrchr(file, '/');
+    if (slash) file = slash + 1;
+
+    char buf[12];
+    int len = strlen(file);
+    terminal_writestring(file);
+    if (s->line) {
+        terminal_putchar(':');
+        itoa(s->line, buf);
+        terminal_writestring(buf);
+        len += strlen(buf) + 1;
+    }
+    for (int i = len; i < 24; i++) {
+        terminal_putchar(' ');
+    }
+}
+
+static void meminfo_sites(int leaks) {
+    int shown = 0;
+
+    if (leaks) {
+        terminal_writestring("site                     tag      leaked  objects\n");
+    } else {
+        terminal_writestring("site                     tag        live     peak  objects   allocs\n");
+    }
+    for (int i = 0; i < KMALLOC_MAX_SITES; i++) {
+        const kmalloc_site_t* s = kmalloc_get_site(i);
+        if (!s) continue;
+        if (leaks && s->leak_count == 0) continue;
+
+        meminfo_site_name(s);
+        terminal_putchar(' ');
+        terminal_writestring(kmalloc_tag_name(s->tag));
+        for (int j = strlen(kmalloc_tag_name(s->tag)); j < 6; j++) {
+            terminal_putchar(' ');
+        }
+        if (leaks) {
+            meminfo_put(s->leak_bytes, 10);
+            meminfo_put(s->leak_count, 9);
+        } else {
+            meminfo_put(s->live_bytes, 10);
+            meminfo_put(s->peak_bytes, 9);
+            meminfo_put(s->live_count, 9);
+            meminfo_put(s->allocs, 9);
+        }
+        terminal_putchar('\n');
+        shown++;
+    }
+    if (shown == 0) {
+        terminal_writestring(leaks ? "no allocations outstanding since the mark\n" : "no allocations yet\n");
+    }
+}
+
+static void meminfo_summary(void) {
+    kmalloc_stats_t st;
+    kmalloc_get_stats(&st);
+
+    meminfo_line("MemTotal:    ", pmm_total_frames() * 4);
+    meminfo_line("MemFree:     ", pmm_free_frames() * 4);
+    meminfo_line("Kernel:      ", ((uint32_t)kernel_end - 0x100000) / 1024);
+    meminfo_line("Tmpfs:       ", tmpfs_pages_used() * 4);
+    meminfo_line("MmapCached:  ", vfs_mmap_resident_pages() * 4);
+    meminfo_line("LazyAnon:    ", paging_lazy_resident() * 4);
+
+    arena_t* scratch = scratch_arena();
+    meminfo_line("Scratch:     ", scratch->size / 1024);
+    meminfo_line("ScratchPeak: ", scratch->peak / 1024);
+
+    uint32_t heap_pages = st.slab_pages + st.large_pages;
+    meminfo_line("HeapPages:   ", heap_pages * 4);
+    meminfo_line("HeapLive:    ", st.live_bytes / 1024);
+    meminfo_line("HeapPeak:    ", st.peak_bytes / 1024);
+
+    terminal_writestring("HeapObjects: ");
+    meminfo_put(st.live_count, 8);
+    terminal_writestring("\nAllocs:      ");
+    meminfo_put(st.allocs - meminfo_last_allocs, 8);
+    terminal_writestring(" (+");
+    meminfo_put(st.frees - meminfo_last_frees, 0);
+    terminal_writestring(" frees) since last meminfo, ");
+    meminfo_put(st.failures, 0);
+    terminal_writestring(" failed\n");
+    meminfo_last_allocs = st.allocs;
+    meminfo_last_frees = st.frees;
+
+    if (heap_pages) {
+        terminal_writestring("Utilization: ");
+        uint32_t used = st.live_bytes / 1024;
+        meminfo_put(used * 100 / (heap_pages * 4), 8);
+        terminal_writestring(" % of heap pages hold live data\n");
+    }
+
+    terminal_writestring("\ntag         live KB  peak KB\n");
+    for (int t = 0; t < KM_TAG_COUNT; t++) {
+        if (!st.tag_peak[t]) continue;
+        terminal_writestring(kmalloc_tag_name(t));
+        for (int j = strlen(kmalloc_tag_name(t)); j < 8; j++) {
+            terminal_putchar(' ');
+        }
+        meminfo_put((st.tag_live[t] + 1023) / 1024, 10);
+        meminfo_put((st.tag_peak[t] + 1023) / 1024, 9);
+        terminal_putchar('\n');
+    }
+
+    terminal_writestring("\nclass  slabs  in use  capacity  fill%\n");
+    for (int c = 0; c < KMALLOC_CLASSES; c++) {
+        if (!st.class_slabs[c]) continue;
+        uint32_t size = kmalloc_class_size(c);
+        uint32_t capacity = st.class_slabs[c] * ((PMM_FRAME_SIZE - KMALLOC_HEADER_SIZE) / size);
+        meminfo_put(size, 5);
+        meminfo_put(st.class_slabs[c], 7);
+        meminfo_put(st.class_in_use[c], 8);
+        meminfo_put(capacity, 10);
+        meminfo_put(st.class_in_use[c] * 100 / capacity, 7);
+        terminal_putchar('\n');
+    }
+    if (st.large_pages) {
+        terminal_writestring("large pages: ");
+        meminfo_put(st.large_pages, 0);
+        terminal_putchar('\n');
+    }
+}
+
+void cmd_meminfo(const char* args) {
+    while (args && *args == ' ') args++;
+
+    if (!args || !*args) {
+        meminfo_summary();
+    } else if (strcmp(args, "-s") == 0) {
+        meminfo_sites(0);
+    } else if (strcmp(args, "-l start") == 0) {
+        kmalloc_leak_mark();
+        terminal_writestring("meminfo: leak tracking started\n");
+    } else if (strcmp(args, "-l") == 0) {
+        if (!kmalloc_leak_active()) {
+            terminal_writestring("meminfo: run 'meminfo -l start' first\n");
+            return;
+        }
+        meminfo_sites(1);
+    } else {
+        terminal_writestring("usage: meminfo [-s] [-l [start]]\n");
+    }
+}
@@ -3,6 +3,9 @@
 #include <stdint.h>
 #include "include/lib.h"
 #include "include/fat32.h"
+#include "include/vfs.h"
+#include "include/tmpfs.h"
+#include "include/pmm.h"
 
 extern void terminal_writestring(const char* s);
 
@@ -79,27 +82,40 @@ static void cmd_mount(const char* args) {
     arg3[i] = '\0';
 
     if (strcmp(arg1, "-l") == 0) {
-        terminal_writestring("Mounted FAT32 filesystems:\n");
-        int found = 0;
-        for (int j = 0; j < 4; j++) {
-            fat32_fs_t* fs = fat32_get_mounted_fs_by_index(j);
-            if (fs && fs->mounted) {
-                terminal_writestring("  ");
-                terminal_writestring(fs->mount_point);
-                terminal_writestring(" - drive ");
+        terminal_writestring("Mounted filesystems:\n");
+        for (int j = 0; j < VFS_MAX_MOUNTS; j++) {
+            vfs_mount_t* m = vfs_get_mount(j);
+            if (!m) continue;
+
+            terminal_writestring("  ");
+            terminal_writestring(m->path);
+            terminal_writestring(" - ");
+            terminal_writestring(m->ops->name);
+
+            fat32_fs_t* fs = m->ops == &fat32_vfs_ops ? (fat32_fs_t*)m->priv : 0;
+            if (fs) {
                 char buf[16];
+                terminal_writestring(", drive ");
                 itoa(fs->drive, buf);
                 terminal_writestring(buf);
                 terminal_writestring(", partition at sector ");
                 itoa(fs->partition_start, buf);
                 terminal_writestring(buf);
-                terminal_writestring("\n");
-                found = 1;
             }
+            terminal_writestring("\n");
         }
-        if (!found) {
-            terminal_writestring("  (none)\n");
-        }
+
+        char buf[16];
+        terminal_writestring("tmpfs pages in use: ");
+        itoa((int)tmpfs_pages_used(), buf);
+        terminal_writestring(buf);
+        terminal_writestring(", free memory: ");
+        itoa((int)(pmm_free_frames() * 4), buf);
+        terminal_writestring(buf);
+        terminal_writestring(" KB of ");
+        itoa((int)(pmm_total_frames() * 4), buf);
+        terminal_writestring(buf);
+        terminal_writestring(" KB\n");
         return;
     }
 
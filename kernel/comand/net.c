@@ -3,6 +3,12 @@
 #include <stdint.h>
 #include "../drivers/io.h"
 #include "../drivers/net.h"
+#include "../include/kmalloc.h"
+#include "../include/timer.h"
+#include "../include/event.h"
+
+#define PING_ARP_TIMEOUT_MS 1000
+#define PING_REPLY_TIMEOUT_MS 2000
 
 extern void terminal_writestring(const char*);
 extern void terminal_putchar(char c);
@@ -13,7 +19,6 @@ extern void rtl8139_set_gateway(uint8_t a, uint8_t b, uint8_t c, uint8_t d);
 extern void rtl8139_set_subnet(uint8_t a, uint8_t b, uint8_t c, uint8_t d);
 extern void rtl8139_set_dns(uint8_t a, uint8_t b, uint8_t c, uint8_t d);
 extern int net_ping(const uint8_t* dest_ip);
-extern void net_poll();
 extern void net_init();
 extern int net_is_available();
 extern int parse_ip(const char* str, uint8_t* ip);
@@ -183,6 +188,7 @@ typedef struct {
     uint8_t ip[4];
     uint8_t mac[6];
     int valid;
+    uint32_t updated;
 } arp_entry_t;
 
 extern int arp_get_cache(arp_entry_t* entries, int max_entries);
@@ -250,38 +256,26 @@ void cmd_ping(const char* args) {
         format_ip(arp_target_ip, buf);
         terminal_writestring(buf);
         terminal_writestring("...\n");
+        event_clear(&net_arp_event);
         send_arp_request(arp_target_ip);
 
-        terminal_writestring("[PING] Polling for ARP response...\n");
-        int poll_count = 0;
-        for (int i = 0; i < 500000; i++) {
-            net_poll();
-            poll_count++;
+        terminal_writestring("[PING] Waiting for ARP response...\n");
+        uint32_t start = ktime_get_ms();
+        uint32_t deadline = timer_deadline(PING_ARP_TIMEOUT_MS);
+        for (;;) {
+            int32_t left = (int32_t)(deadline - timer_ticks());
+            if (left <= 0) break;
+            event_loop_wait(&net_arp_event, (uint32_t)left);
             mac = arp_lookup(arp_target_ip);
-            if (mac) {
-                terminal_writestring("[PING] ARP resolved after ");
-                char num[16];
-                num[0] = '0' + (poll_count / 10000);
-                num[1] = '0' + ((poll_count / 1000) % 10);
-                num[2] = '0' + ((poll_count / 100) % 10);
-                num[3] = '0' + ((poll_count / 10) % 10);
-                num[4] = '0' + (poll_count % 10);
-                num[5] = '\0';
-                terminal_writestring(num);
-                terminal_writestring(" polls\n");
-                break;
-            }
+            if (mac) break;
+        }
+        if (mac) {
+            char num[16];
+            terminal_writestring("[PING] ARP resolved after ");
+            itoa((int)(ktime_get_ms() - start), num);
+            terminal_writestring(num);
+            terminal_writestring(" ms\n");
         }
-        terminal_writestring("[PING] Total polls: ");
-        char num[16];
-        num[0] = '0' + (poll_count / 10000);
-        num[1] = '0' + ((poll_count / 1000) % 10);
-        num[2] = '0' + ((poll_count / 100) % 10);
-        num[3] = '0' + ((poll_count / 10) % 10);
-        num[4] = '0' + (poll_count % 10);
-        num[5] = '\0';
-        terminal_writestring(num);
-        terminal_writestring("\n");
 
         if (!mac) {
             terminal_writestring("No ARP response received\n");
@@ -292,19 +286,23 @@ void cmd_ping(const char* args) {
         terminal_writestring("ARP resolved\n");
     }
 
+    event_clear(&net_echo_event);
     int result = net_ping(dest_ip);
 
     if (result) {
         terminal_writestring("Ping sent, waiting for reply...\n");
 
-        int got_reply = 0;
-        for (int i = 0; i < 2000000; i++) {
-            net_poll();
-
+        uint32_t start = ktime_get_ms();
+        if (event_loop_wait(&net_echo_event, PING_REPLY_TIMEOUT_MS)) {
+            terminal_writestring("Reply received in ");
+            itoa((int)(ktime_get_ms() - start), buf);
+            terminal_writestring(buf);
+            terminal_writestring(" ms\n");
+        } else {
+            terminal_writestring("Request timed out\n");
+            terminal_writestring("Note: QEMU user-mode networking has limited ICMP support.\n");
+            terminal_writestring("Try: ping 10.0.2.2 (gateway) or use TCP-based tests.\n");
         }
-        terminal_writestring("Done\n");
-        terminal_writestring("Note: QEMU user-mode networking has limited ICMP support.\n");
-        terminal_writestring("Try: ping 10.0.2.2 (gateway) or use TCP-based tests.\n");
     } else {
         terminal_writestring("Failed to send ping\n");
     }
@@ -402,8 +400,16 @@ void cmd_arp(const char* args) {
     terminal_writestring("IP Address      MAC Address\n");
     terminal_writestring("------------------------------\n");
 
-    arp_entry_t entries[16];
-    int count = arp_get_cache(entries, 16);
+    int count = arp_get_cache(0, 0x7FFFFFFF);
+    arp_entry_t* entries = 0;
+    if (count > 0) {
+        entries = kmalloc(count * sizeof(arp_entry_t));
+        if (!entries) {
+            terminal_writestring("arp: out of memory\n");
+            return;
+        }
+        count = arp_get_cache(entries, count);
+    }
 
     if (count == 0) {
         terminal_writestring("(No ARP entries cached)\n");
@@ -418,6 +424,7 @@ void cmd_arp(const char* args) {
             terminal_writestring("\n");
         }
     }
+    kfree(entries);
 }
 
 void cmd_nethelp(const char* args) {
@@ -0,0 +1,74 @@
+
+
+#include <stdint.h>
+#include "include/lib.h"
+#include "include/sched.h"
+#include "include/event.h"
+
+static void ps_put(uint32_t value, int width) {
+    char buf[12];
+    itoa((int)value, buf);
+    for (int i = strlen(buf); i < width; i++) {
+        terminal_putchar(' ');
+    }
+    terminal_writestring(buf);
+}
+
+static void ps_pad(const char* s, int width) {
+    terminal_writestring(s);
+    for (int i = strlen(s); i < width; i++) {
+        terminal_putchar(' ');
+    }
+}
+
+static void cmd_ps(const char* args) {
+    (void)args;
+    if (!sched_running()) {
+        terminal_writestring("ps: scheduler not running\n");
+        return;
+    }
+
+    terminal_writestring("  TID  STATE       TIME(ms)  SWITCHES  NAME\n");
+
+    int count = 0;
+    uint32_t flags = irq_save();
+    for (thread_t* t = sched_threads(); t; t = t->all_next) {
+        ps_put(t->tid, 5);
+        terminal_writestring("  ");
+        ps_pad(thread_state_name(t->state), 10);
+        ps_put((uint32_t)t->runtime, 10);
+        ps_put(t->switches, 10);
+        terminal_writestring("  ");
+        terminal_writestring(t->name);
+        terminal_putchar('\n');
+        count++;
+    }
+    irq_restore(flags);
+
+    char buf[12];
+    itoa(count, buf);
+    terminal_writestring(buf);
+    terminal_writestring(" threads, ");
+    itoa((int)sched_switches(), buf);
+    terminal_writestring(buf);
+    terminal_writestring(" context switches\n");
+
+    event_stats_t ev;
+    event_loop_stats(&ev);
+    terminal_writestring("event tasks: ");
+    itoa((int)ev.tasks, buf);
+    terminal_writestring(buf);
+    terminal_writestring(" (");
+    itoa((int)ev.ready, buf);
+    terminal_writestring(buf);
+    terminal_writestring(" ready, ");
+    itoa((int)ev.waiting, buf);
+    terminal_writestring(buf);
+    terminal_writestring(" waiting), ");
+    itoa((int)ev.runs, buf);
+    terminal_writestring(buf);
+    terminal_writestring(" runs, ");
+    itoa((int)ev.timeouts, buf);
+    terminal_writestring(buf);
+    terminal_writestring(" timeouts\n");
+}
@@ -6,7 +6,10 @@ static void cmd_read_sector(const char* args) {
     int lba = atoi(p);
     if (drive >= 0 && lba >= 0) {
         uint16_t buffer[256];
-        ata_read_sector(drive, lba, buffer);
+        if (ata_read_sector(drive, lba, buffer) != 0) {
+            terminal_writestring("read_sector: I/O error\n");
+            return;
+        }
         terminal_writestring("Sector data (first 16 words in hex):\n");
         for (int i = 0; i < 16; i++) {
             char hex[10];
@@ -0,0 +1,60 @@
+
+
+#include <stdint.h>
+#include "include/lib.h"
+#include "include/softirq.h"
+#include "include/clock.h"
+
+static void softirq_put(uint32_t value, int width) {
+    char buf[12];
+    itoa((int)value, buf);
+    for (int i = strlen(buf); i < width; i++) {
+        terminal_putchar(' ');
+    }
+    terminal_writestring(buf);
+}
+
+static void softirq_name(const char* name, int width) {
+    terminal_writestring(name);
+    for (int i = strlen(name); i < width; i++) {
+        terminal_putchar(' ');
+    }
+}
+
+static uint32_t softirq_us(uint64_t cycles, uint32_t count) {
+    if (count == 0) return 0;
+    uint64_t ns = clock_cycles_to_ns(udiv64(cycles, count, 0));
+    return (uint32_t)udiv64(ns, 1000, 0);
+}
+
+static void cmd_softirq(const char* args) {
+    (void)args;
+
+    terminal_writestring("SOFTIRQ        RAISED      RUNS   AVG(us)   MAX(us)\n");
+    for (int nr = 0; nr < SOFTIRQ_COUNT; nr++) {
+        const softirq_t* s = softirq_get(nr);
+        softirq_name(s->name, 10);
+        softirq_put(s->raised, 10);
+        softirq_put(s->runs, 10);
+        softirq_put(softirq_us(s->cycles, s->runs), 10);
+        softirq_put(softirq_us(s->max_cycles, 1), 10);
+        terminal_putchar('\n');
+    }
+
+    terminal_writestring("\nWORKQUEUE      QUEUED      DONE   PENDING  MAXDEPTH  WAIT(us)  MAXWAIT(us)  RUN(us)\n");
+    for (work_queue_t* wq = work_queues(); wq; wq = wq->next_queue) {
+        uint32_t flags = irq_save();
+        work_queue_t snap = *wq;
+        irq_restore(flags);
+
+        softirq_name(snap.name, 10);
+        softirq_put(snap.queued, 10);
+        softirq_put(snap.done, 10);
+        softirq_put(snap.depth, 10);
+        softirq_put(snap.max_depth, 10);
+        softirq_put(softirq_us(snap.wait_cycles, snap.done), 10);
+        softirq_put(softirq_us(snap.max_wait_cycles, 1), 13);
+        softirq_put(softirq_us(snap.run_cycles, snap.done), 9);
+        terminal_putchar('\n');
+    }
+}
@@ -0,0 +1,541 @@
+
+
+#include <stdint.h>
+#include "include/vfs.h"
+
+#define TAR_BLOCK_SIZE 512
+#define TAR_BUFFER_SIZE (64 * TAR_BLOCK_SIZE)
+#define TAR_MAX_DEPTH 8
+
+typedef struct {
+    char name[100];
+    char mode[8];
+    char uid[8];
+    char gid[8];
+    char size[12];
+    char mtime[12];
+    char checksum[8];
+    char typeflag;
+    char linkname[100];
+    char magic[6];
+    char version[2];
+    char uname[32];
+    char gname[32];
+    char devmajor[8];
+    char devminor[8];
+    char prefix[155];
+    char pad[12];
+} __attribute__((packed)) tar_ustar_t;
+
+/* Archive input: either a memory image (the initrd, or a mapped file) or a descriptor read through tar_buffer. */
+typedef struct {
+    int fd;
+    const uint8_t* map;
+    uint32_t size;
+    uint32_t pos;
+    uint32_t len;
+} tar_src_t;
+
+typedef struct {
+    int fd;
+    uint32_t len;
+    int error;
+} tar_out_t;
+
+typedef struct {
+    uint32_t files;
+    uint32_t dirs;
+    uint32_t bytes;
+    uint32_t errors;
+    uint32_t skipped;
+} tar_stats_t;
+
+static uint8_t tar_buffer[TAR_BUFFER_SIZE];
+
+static uint32_t tar_cmd_octal(const char* in, int width) {
+    uint32_t value = 0;
+    int i = 0;
+    while (i < width && in[i] == ' ') i++;
+    for (; i < width && in[i] >= '0' && in[i] <= '7'; i++) {
+        value = value * 8 + (in[i] - '0');
+    }
+    return value;
+}
+
+static void tar_cmd_put_octal(char* out, int width, uint32_t value) {
+    out[width - 1] = '\0';
+    for (int i = width - 2; i >= 0; i--) {
+        out[i] = '0' + (value & 7);
+        value >>= 3;
+    }
+}
+
+static uint32_t tar_cmd_checksum(const tar_ustar_t* h) {
+    const uint8_t* p = (const uint8_t*)h;
+    uint32_t sum = 0;
+    for (int i = 0; i < TAR_BLOCK_SIZE; i++) {
+        sum += (i >= 148 && i < 156) ? ' ' : p[i];
+    }
+    return sum;
+}
+
+static void tar_cmd_error(const char* path, int err) {
+    terminal_writestring("tar: ");
+    terminal_writestring(path);
+    terminal_writestring(": ");
+    terminal_writestring(vfs_strerror(err));
+    terminal_writestring("\n");
+}
+
+/* Returns up to want bytes of contiguous archive data at the current position. */
+static const uint8_t* tar_src_peek(tar_src_t* src, uint32_t want, uint32_t* got) {
+    if (src->map) {
+        uint32_t left = src->size - src->pos;
+        *got = want < left ? want : left;
+        return src->map + src->pos;
+    }
+
+    if (src->pos == src->len) {
+        int n = vfs_read(src->fd, tar_buffer, TAR_BUFFER_SIZE);
+        src->pos = 0;
+        src->len = n > 0 ? (uint32_t)n : 0;
+    }
+    uint32_t left = src->len - src->pos;
+    *got = want < left ? want : left;
+    return tar_buffer + src->pos;
+}
+
+static void tar_src_skip(tar_src_t* src, uint32_t n) {
+    src->pos += n;
+}
+
+static int tar_cmd_join(const char* dir, const char* name, char* out) {
+    int dir_len = strlen(dir);
+    if (dir_len + strlen(name) + 2 > VFS_MAX_PATH) return VFS_EINVAL;
+
+    strcpy(out, dir);
+    if (dir_len == 0 || out[dir_len - 1] != '/') strcat(out, "/");
+    strcat(out, name);
+    return 0;
+}
+
+/* Creates every missing directory along path; with file set the last component is left alone. */
+static int tar_cmd_mkdirs(const char* path, int file) {
+    char dir[VFS_MAX_PATH];
+    int len = strlen(path);
+    if (len >= VFS_MAX_PATH) return VFS_EINVAL;
+
+    for (int i = 1; i <= len; i++) {
+        if (path[i] != '/' && path[i] != '\0') continue;
+        if (path[i] == '\0' && file) break;
+
+        memcpy(dir, path, i);
+        dir[i] = '\0';
+        int r = vfs_mkdir(dir);
+        if (r < 0 && r != VFS_EEXIST) return r;
+    }
+    return 0;
+}
+
+/*
+ * Builds "prefix/name" without leading "./" or "/" and without trailing
+ * slashes into out, which holds VFS_MAX_PATH bytes. Returns -1 if a full
+ * 155-byte prefix and 100-byte name do not fit.
+ */
+static int tar_cmd_entry_name(const tar_ustar_t* h, char* out) {
+    int len = 0;
+    if (strncmp(h->magic, "ustar", 5) == 0 && h->prefix[0]) {
+        for (int i = 0; i < 155 && h->prefix[i]; i++) out[len++] = h->prefix[i];
+        out[len++] = '/';
+    }
+    for (int i = 0; i < 100 && h->name[i]; i++) {
+        if (len == VFS_MAX_PATH - 1) return -1;
+        out[len++] = h->name[i];
+    }
+    out[len] = '\0';
+
+    const char* p = out;
+    while (*p == '/' || (p[0] == '.' && p[1] == '/')) p += (*p == '/') ? 1 : 2;
+    if (p != out) {
+        int k = 0;
+        while ((out[k] = p[k]) != '\0') k++;
+    }
+
+    len = strlen(out);
+    while (len > 0 && out[len - 1] == '/') out[--len] = '\0';
+    if (len == 1 && out[0] == '.') out[0] = '\0';
+    return strlen(out);
+}
+
+/* A ".." component would let the member land outside the destination once vfs_resolve() folds it. */
+static int tar_cmd_escapes(const char* name) {
+    const char* p = name;
+    while (*p) {
+        if (p[0] == '.' && p[1] == '.' && (p[2] == '/' || p[2] == '\0')) return 1;
+        while (*p && *p != '/') p++;
+        while (*p == '/') p++;
+    }
+    return 0;
+}
+
+static int tar_cmd_write_data(tar_src_t* src, int fd, uint32_t size) {
+    uint32_t left = (size + TAR_BLOCK_SIZE - 1) & ~(TAR_BLOCK_SIZE - 1);
+    int err = 0;
+
+    while (left > 0) {
+        uint32_t got;
+        const uint8_t* data = tar_src_peek(src, left, &got);
+        if (got == 0) return VFS_EIO;
+
+        uint32_t n = got < size ? got : size;
+        if (fd >= 0 && n > 0 && err == 0) {
+            int w = vfs_write(fd, data, n);
+            if (w != (int)n) err = w < 0 ? w : VFS_ENOSPC;
+        }
+        size -= n;
+        left -= got;
+        tar_src_skip(src, got);
+    }
+    return err;
+}
+
+static void tar_cmd_extract(tar_src_t* src, const char* dest, int list, tar_stats_t* stats) {
+    char name[VFS_MAX_PATH];
+    char path[VFS_MAX_PATH];
+
+    for (;;) {
+        uint32_t got;
+        const tar_ustar_t* h = (const tar_ustar_t*)tar_src_peek(src, TAR_BLOCK_SIZE, &got);
+        if (got < TAR_BLOCK_SIZE || h->name[0] == '\0') break;
+
+        if (tar_cmd_checksum(h) != tar_cmd_octal(h->checksum, 8)) {
+            terminal_writestring("tar: bad header checksum, stopping\n");
+            stats->errors++;
+            break;
+        }
+
+        char type = h->typeflag;
+        uint32_t size = tar_cmd_octal(h->size, 12);
+        int len = tar_cmd_entry_name(h, name);
+        tar_src_skip(src, TAR_BLOCK_SIZE);
+
+        int is_dir = type == '5';
+        int is_file = type == '0' || type == '\0';
+        if (len < 0) {
+            terminal_writestring("tar: member name too long, skipping\n");
+            stats->errors++;
+            tar_cmd_write_data(src, -1, is_dir ? 0 : size);
+            continue;
+        }
+        if (len > 0 && tar_cmd_escapes(name)) {
+            terminal_writestring("tar: skipping ");
+            terminal_writestring(name);
+            terminal_writestring(": path leaves the destination\n");
+            stats->skipped++;
+            tar_cmd_write_data(src, -1, is_dir ? 0 : size);
+            continue;
+        }
+        if (len == 0 || (!is_dir && !is_file) || tar_cmd_join(dest, name, path) < 0) {
+            tar_cmd_write_data(src, -1, is_dir ? 0 : size);
+            continue;
+        }
+
+        if (list) {
+            char buf[16];
+            itoa((int)size, buf);
+            terminal_writestring(buf);
+            terminal_writestring("\t");
+            terminal_writestring(name);
+            terminal_writestring(is_dir ? "/\n" : "\n");
+            tar_cmd_write_data(src, -1, is_dir ? 0 : size);
+            if (is_dir) stats->dirs++;
+            else stats->files++;
+            stats->bytes += is_dir ? 0 : size;
+            continue;
+        }
+
+        if (is_dir) {
+            int r = tar_cmd_mkdirs(path, 0);
+            if (r < 0) {
+                tar_cmd_error(path, r);
+                stats->errors++;
+            } else {
+                stats->dirs++;
+            }
+            continue;
+        }
+
+        int fd = tar_cmd_mkdirs(path, 1);
+        if (fd == 0) fd = vfs_open(path, VFS_O_WRONLY | VFS_O_CREAT | VFS_O_TRUNC);
+        if (fd >= 0) {
+            int r = vfs_reserve(fd, size);
+            if (r < 0) {
+                vfs_close(fd);
+                fd = r;
+            }
+        }
+        if (fd < 0) {
+            tar_cmd_error(path, fd);
+            stats->errors++;
+            if (tar_cmd_write_data(src, -1, size) < 0) break;
+            continue;
+        }
+
+        int r = tar_cmd_write_data(src, fd, size);
+        vfs_close(fd);
+        if (r < 0) {
+            tar_cmd_error(path, r);
+            stats->errors++;
+            if (r == VFS_EIO) break;
+            continue;
+        }
+        stats->files++;
+        stats->bytes += size;
+    }
+}
+
+static void tar_out_flush(tar_out_t* out) {
+    if (out->len == 0) return;
+    if (out->error == 0) {
+        int w = vfs_write(out->fd, tar_buffer, out->len);
+        if (w != (int)out->len) out->error = w < 0 ? w : VFS_ENOSPC;
+    }
+    out->len = 0;
+}
+
+static void tar_out_pad(tar_out_t* out) {
+    uint32_t pad = (TAR_BLOCK_SIZE - out->len % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+    memset(tar_buffer + out->len, 0, pad);
+    out->len += pad;
+    if (out->len == TAR_BUFFER_SIZE) tar_out_flush(out);
+}
+
+static int tar_cmd_header(tar_out_t* out, const char* name, uint8_t type, uint32_t size) {
+    int len = strlen(name);
+    int split = 0;
+    if (len + (type == VFS_TYPE_DIR) > 99) {
+        for (split = len - 1; split > 0 && (name[split] != '/' || len - split - 1 > 99); split--) {}
+        if (split <= 0 || split > 154) return VFS_EINVAL;
+    }
+
+    if (TAR_BUFFER_SIZE - out->len < TAR_BLOCK_SIZE) tar_out_flush(out);
+    tar_ustar_t* h = (tar_ustar_t*)(tar_buffer + out->len);
+    memset(h, 0, TAR_BLOCK_SIZE);
+
+    if (split) {
+        memcpy(h->prefix, name, split);
+        strcpy(h->name, name + split + 1);
+    } else {
+        strcpy(h->name, name);
+    }
+    if (type == VFS_TYPE_DIR) strcat(h->name, "/");
+
+    tar_cmd_put_octal(h->mode, 8, type == VFS_TYPE_DIR ? 0755 : 0644);
+    tar_cmd_put_octal(h->uid, 8, 0);
+    tar_cmd_put_octal(h->gid, 8, 0);
+    tar_cmd_put_octal(h->size, 12, size);
+    tar_cmd_put_octal(h->mtime, 12, 0);
+    h->typeflag = type == VFS_TYPE_DIR ? '5' : '0';
+    memcpy(h->magic, "ustar", 6);
+    memcpy(h->version, "00", 2);
+    tar_cmd_put_octal(h->checksum, 7, tar_cmd_checksum(h));
+    h->checksum[7] = ' ';
+
+    out->len += TAR_BLOCK_SIZE;
+    if (out->len == TAR_BUFFER_SIZE) tar_out_flush(out);
+    return 0;
+}
+
+/* Streams a file into the output buffer, reading straight into its free space. */
+static int tar_cmd_copy_file(tar_out_t* out, const char* path, uint32_t size) {
+    int fd = vfs_open(path, VFS_O_RDONLY);
+    if (fd < 0) return fd;
+
+    uint32_t left = size;
+    while (left > 0) {
+        if (out->len == TAR_BUFFER_SIZE) tar_out_flush(out);
+        uint32_t space = TAR_BUFFER_SIZE - out->len;
+        int n = vfs_read(fd, tar_buffer + out->len, left < space ? left : space);
+        if (n <= 0) {
+            vfs_close(fd);
+            return n < 0 ? n : VFS_EIO;
+        }
+        out->len += n;
+        left -= n;
+    }
+    vfs_close(fd);
+    tar_out_pad(out);
+    return 0;
+}
+
+/* With out == 0 only adds up the archive size; otherwise writes headers and data. */
+static void tar_cmd_walk(const char* dir, const char* prefix, const char* skip, int depth,
+                         tar_out_t* out, uint32_t* total, tar_stats_t* stats) {
+    char path[VFS_MAX_PATH];
+    char name[VFS_MAX_PATH];
+    vfs_dirent_t entry;
+
+    int fd = vfs_open(dir, VFS_O_RDONLY | VFS_O_DIRECTORY);
+    if (fd < 0) {
+        if (out) tar_cmd_error(dir, fd);
+        stats->errors++;
+        return;
+    }
+
+    while (vfs_readdir(fd, &entry) > 0) {
+        if (tar_cmd_join(dir, entry.name, path) < 0) continue;
+        if (strcmp(path, skip) == 0) continue;
+        if (prefix[0]) {
+            if (tar_cmd_join(prefix, entry.name, name) < 0) continue;
+        } else {
+            strcpy(name, entry.name);
+        }
+
+        uint32_t size = entry.type == VFS_TYPE_DIR ? 0 : entry.size;
+        *total += TAR_BLOCK_SIZE + ((size + TAR_BLOCK_SIZE - 1) & ~(TAR_BLOCK_SIZE - 1));
+        if (out) {
+            int r = tar_cmd_header(out, name, entry.type, size);
+            if (r == 0 && entry.type != VFS_TYPE_DIR) {
+                r = tar_cmd_copy_file(out, path, size);
+            }
+            if (r < 0) {
+                tar_cmd_error(path, r);
+                stats->errors++;
+                if (out->error) break;
+                continue;
+            }
+            if (entry.type == VFS_TYPE_DIR) stats->dirs++;
+            else stats->files++;
+            stats->bytes += size;
+        }
+
+        if (entry.type == VFS_TYPE_DIR && depth < TAR_MAX_DEPTH) {
+            tar_cmd_walk(path, name, skip, depth + 1, out, total, stats);
+        }
+    }
+    vfs_close(fd);
+}
+
+static void tar_cmd_create(const char* archive, const char* dir, tar_stats_t* stats) {
+    char skip[VFS_MAX_PATH];
+    char root[VFS_MAX_PATH];
+    uint32_t total = 2 * TAR_BLOCK_SIZE;
+
+    if (vfs_resolve(archive, skip) < 0 || vfs_resolve(dir, root) < 0) {
+        tar_cmd_error(archive, VFS_EINVAL);
+        stats->errors++;
+        return;
+    }
+
+    tar_cmd_walk(root, "", skip, 0, 0, &total, stats);
+    stats->errors = 0;
+
+    tar_out_t out;
+    out.fd = vfs_open(archive, VFS_O_WRONLY | VFS_O_CREAT | VFS_O_TRUNC);
+    out.len = 0;
+    out.error = 0;
+    if (out.fd < 0) {
+        tar_cmd_error(archive, out.fd);
+        stats->errors++;
+        return;
+    }
+    vfs_reserve(out.fd, total);
+
+    tar_cmd_walk(root, "", skip, 0, &out, &total, stats);
+
+    if (TAR_BUFFER_SIZE - out.len < 2 * TAR_BLOCK_SIZE) tar_out_flush(&out);
+    memset(tar_buffer + out.len, 0, 2 * TAR_BLOCK_SIZE);
+    out.len += 2 * TAR_BLOCK_SIZE;
+    tar_out_flush(&out);
+    vfs_close(out.fd);
+
+    if (out.error) {
+        tar_cmd_error(archive, out.error);
+        stats->errors++;
+    }
+}
+
+static void cmd_tar(const char* args) {
+    char mode[8];
+    char archive[VFS_MAX_PATH];
+    char dir[VFS_MAX_PATH];
+    const char* p = args;
+    int i;
+
+    while (*p == ' ') p++;
+    for (i = 0; *p && *p != ' ' && i < 7; i++) mode[i] = *p++;
+    mode[i] = '\0';
+    while (*p == ' ') p++;
+    for (i = 0; *p && *p != ' ' && i < VFS_MAX_PATH - 1; i++) archive[i] = *p++;
+    archive[i] = '\0';
+    while (*p == ' ') p++;
+    for (i = 0; *p && *p != ' ' && i < VFS_MAX_PATH - 1; i++) dir[i] = *p++;
+    dir[i] = '\0';
+
+    int create = strcmp(mode, "-c") == 0;
+    int list = strcmp(mode, "-t") == 0;
+    if ((!create && !list && strcmp(mode, "-x") != 0) || archive[0] == '\0' || (create && dir[0] == '\0')) {
+        terminal_writestring("Usage: tar -x <archive|@initrd> [dir]\n");
+        terminal_writestring("       tar -t <archive|@initrd>\n");
+        terminal_writestring("       tar -c <archive> <dir>\n");
+        return;
+    }
+
+    tar_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+
+    if (create) {
+        tar_cmd_create(archive, dir, &stats);
+    } else {
+        tar_src_t src;
+        memset(&src, 0, sizeof(src));
+        src.fd = -1;
+
+        if (strcmp(archive, "@initrd") == 0) {
+            if (!tar_archive) {
+                terminal_writestring("tar: no initrd loaded\n");
+                return;
+            }
+            src.map = (const uint8_t*)tar_archive;
+            src.size = tar_archive_size;
+        } else {
+            src.fd = vfs_open(archive, VFS_O_RDONLY);
+            if (src.fd < 0) {
+                tar_cmd_error(archive, src.fd);
+                return;
+            }
+            vfs_stat_t st;
+            src.map = (const uint8_t*)vfs_map(src.fd);
+            if (src.map && vfs_fstat(src.fd, &st) == 0) src.size = st.size;
+        }
+
+        tar_cmd_extract(&src, dir[0] ? dir : ".", list, &stats);
+        if (src.fd >= 0) vfs_close(src.fd);
+    }
+
+    if (list) return;
+
+    char buf[16];
+    itoa((int)stats.files, buf);
+    terminal_writestring(buf);
+    terminal_writestring(" files, ");
+    itoa((int)stats.dirs, buf);
+    terminal_writestring(buf);
+    terminal_writestring(" directories, ");
+    itoa((int)(stats.bytes / 1024), buf);
+    terminal_writestring(buf);
+    terminal_writestring(" KB");
+    if (stats.errors) {
+        terminal_writestring(", ");
+        itoa((int)stats.errors, buf);
+        terminal_writestring(buf);
+        terminal_writestring(" errors");
+    }
+    if (stats.skipped) {
+        terminal_writestring(", ");
+        itoa((int)stats.skipped, buf);
+        terminal_writestring(buf);
+        terminal_writestring(" skipped");
+    }
+    terminal_writestring("\n");
+}
@@ -8,7 +8,10 @@ static void cmd_write_sector(const char* args) {
         uint16_t buffer[256];
         memset(buffer, 0, 512);
         buffer[0] = 0x4141; 
-        ata_write_sector(drive, lba, buffer);
+        if (ata_write_sector(drive, lba, buffer) != 0 || ata_flush(drive) != 0) {
+            terminal_writestring("write_sector: I/O error\n");
+            return;
+        }
         terminal_writestring("Sector written with test data\n");
     } else {
         terminal_writestring("Usage: write_sector <drive> <lba>\n");
@@ -5,25 +5,33 @@
 #include "include/crypt.h"
 #include "include/version.h"
 #include "include/commands.h"
+#include "include/tar.h"
+#include "include/vfs.h"
+#include "include/pmm.h"
+#define KMALLOC_TAG KM_SHELL
+#include "include/kmalloc.h"
+#include "include/arena.h"
+#include "include/paging.h"
+#include "include/clock.h"
+#include "include/timer.h"
+#include "include/event.h"
+#include "include/keyboard.h"
 #include "drivers/io.h"
 
 extern void terminal_writestring(const char* s);
 extern void terminal_putchar(char c);
 extern void terminal_initialize();
 extern void* tar_archive;
-extern void* tar_lookup(void* archive, const char* filename);
-extern int tar_check_path_exists(void* archive, const char* path);
-extern void tar_get_directories(void* archive, char directories[][256], int* count);
-extern void tar_list_directory(void* archive, const char* dirpath);
-extern int tar_get_file_size(void* archive, const char* filename);
 #define FILE_SIZE_THRESHOLD 1024
 extern void start_gui();
 extern int get_current_uid();
 extern int get_current_gid();
 extern void save_users();
 extern int ata_detect_disks();
-extern void ata_read_sector(uint8_t drive, uint32_t lba, uint16_t* buffer);
-extern void ata_write_sector(uint8_t drive, uint32_t lba, uint16_t* buffer);
+extern int ata_read_sector(uint8_t drive, uint32_t lba, uint16_t* buffer);
+extern int ata_write_sector(uint8_t drive, uint32_t lba, uint16_t* buffer);
+extern int ata_flush(uint8_t drive);
+extern int ata_flush_all(void);
 
 #define EI_NIDENT 16
 #define PT_LOAD 1
@@ -61,23 +69,6 @@ typedef struct {
     Elf32_Word p_align;
 } Elf32_Phdr;
 
-typedef struct {
-    char name[32];
-    char content[256];
-    int size;
-} file_t;
-
-static file_t files[10];
-static int file_count = 0;
-
-static char dirs[10][32];
-static int dir_count = 0;
-
-static char home_dirs[10][32];
-static int home_dir_count = 0;
-static char home_subdirs[10][10][32];
-static int home_sub_count[10] = {0};
-
 char current_dir[256] = "/";
 static char* pathbin = "/bin";
 
@@ -87,7 +78,6 @@ void execute_command_with_output(const char* command, char* output, int output_s
 void execute_command_with_input(const char* command, const char* input);
 void grep_with_output(const char* pattern, const char* filename, char* output, int output_size);
 void grep_with_input(const char* pattern, const char* input);
-static file_t* find_file(const char* name);
 
 static void append_capture(char* output, int output_size, const char* text) {
     if (!output || output_size <= 0 || !text) return;
@@ -175,8 +165,6 @@ static void append_highlighted_line(char* output, int output_size, const char* l
     append_capture(output, output_size, "\n");
 }
 
-static file_t* find_file(const char* name);
-static file_t* create_file(const char* name);
 static void shutdown();
 static void reboot();
 
@@ -213,97 +201,31 @@ static void reboot();
 #include "comand/net.c"
 #include "comand/colorb.c"
 #include "comand/lsh.c"
-
-void init_kernel_commands() {
-
-    if (tar_archive) {
-        char tar_dirs[100][256];
-        int tar_count = 0;
-        tar_get_directories(tar_archive, tar_dirs, &tar_count);
-
-        for (int i = 0; i < tar_count && dir_count < 10; i++) {
-            if (tar_dirs[i][0] == '\0') {
-                continue;
-            }
-
-            char* slash = strchr(tar_dirs[i], '/');
-            int name_len = 0;
-            if (slash) {
-                name_len = slash - tar_dirs[i];
-            } else {
-                name_len = strlen(tar_dirs[i]);
-            }
-
-            if (name_len <= 0 || name_len >= (int)sizeof(dirs[0])) {
-                continue;
-            }
-
-            char top_name[32];
-            strncpy(top_name, tar_dirs[i], name_len);
-            top_name[name_len] = '\0';
-
-            int exists = 0;
-            for (int d = 0; d < dir_count; d++) {
-                if (strcmp(dirs[d], top_name) == 0) {
-                    exists = 1;
-                    break;
-                }
-            }
-
-            if (!exists) {
-                strcpy(dirs[dir_count++], top_name);
-            }
-        }
-    } else {
-
-        strcpy(dirs[dir_count++], "bin");
-        strcpy(dirs[dir_count++], "dev");
-        strcpy(dirs[dir_count++], "home");
-    }
-}
-
-static file_t* find_file(const char* name) {
-    for (int i = 0; i < file_count; i++) {
-        if (strcmp(files[i].name, name) == 0) return &files[i];
-    }
-    return 0;
-}
-
-static file_t* create_file(const char* name) {
-    if (file_count >= 10) return 0;
-    int len = strlen(name);
-    if (len >= 32) return 0;
-    strcpy(files[file_count].name, name);
-    files[file_count].content[0] = '\0';
-    files[file_count].size = 0;
-    return &files[file_count++];
-}
+#include "comand/iostat.c"
+#include "comand/meminfo.c"
+#include "comand/cdrom.c"
+#include "comand/tar.c"
+#include "comand/ps.c"
+#include "comand/softirq.c"
+#include "comand/irqstat.c"
+#include "comand/cpus.c"
 
 static int is_file_in_path(const char* name, const char* path) {
+    char full[VFS_MAX_PATH];
+    vfs_stat_t st;
 
-    if (!tar_archive) {
+    if (strlen(path) + strlen(name) + 2 > VFS_MAX_PATH) {
         return 0;
     }
-
-    const char* clean_path = path;
-    if (clean_path[0] == '/' && clean_path[1] != '\0') {
-        clean_path++;
-    }
-    char tar_path[256];
-
-    if (clean_path[0] == '\0') {
-
-        snprintf(tar_path, sizeof(tar_path), "%s", name);
-    } else {
-        snprintf(tar_path, sizeof(tar_path), "%s/%s", clean_path, name);
-    }
-
-    void* data = tar_lookup(tar_archive, tar_path);
-    return data != 0;
+    strcpy(full, path);
+    strcat(full, "/");
+    strcat(full, name);
+    return vfs_stat(full, &st) == 0 && st.type == VFS_TYPE_FILE;
 }
 
 static void shutdown() {
     terminal_writestring("Shutting down...\n");
+    ata_flush_all();
 
     __asm__ volatile("outw %0, %1" : : "a"((uint16_t)0x2000), "Nd"((uint16_t)0xB004));
 
@@ -314,6 +236,7 @@ static void shutdown() {
 
 static void reboot() {
     terminal_writestring("Rebooting...\n");
+    ata_flush_all();
     outb(0x64, 0xFE);
 }
 
@@ -322,8 +245,8 @@ static int user_input_pos = 0;
 
 char get_char() {
     while (1) {
-        if (inb(0x64) & 0x1) {
-            uint8_t scancode = inb(0x60);
+        uint8_t scancode;
+        if (kbd_read(&scancode)) {
             if (!(scancode & 0x80)) { 
                 char c = 0;
 
@@ -364,76 +287,115 @@ char get_char() {
                     terminal_putchar(c);
                 }
             }
+        } else {
+            event_loop_idle();
         }
     }
 }
 
-static void execute_binary(const char* name) {
-    if (!tar_archive) {
-        terminal_writestring("No tar archive loaded.\n");
-        return;
-    }
-    if (strlen(name) > 250) {
-        terminal_writestring("Binary name too long.\n");
-        return;
-    }
-    char path[256];
-    strcpy(path, "bin/");
-    strcpy(path + 4, name);
-
-    void* data = tar_lookup(tar_archive, path);
-    if (!data) {
-        terminal_writestring("Binary not found in tar.\n");
-        return;
-    }
-
+static uint32_t load_elf(const void* data) {
     Elf32_Ehdr* ehdr = (Elf32_Ehdr*)data;
     if (ehdr->e_ident[0] != 0x7F || ehdr->e_ident[1] != 'E' || ehdr->e_ident[2] != 'L' || ehdr->e_ident[3] != 'F') {
         terminal_writestring("Not a valid ELF file.\n");
-        return;
+        return 0;
     }
     if (ehdr->e_machine != 3) { 
         terminal_writestring("Unsupported ELF architecture.\n");
-        return;
+        return 0;
     }
-    if (ehdr->e_entry < 0x100000) {
+    if (ehdr->e_entry < USER_LOAD_BASE || ehdr->e_entry >= USER_LOAD_END) {
         terminal_writestring("Invalid entry point address.\n");
-        return;
+        return 0;
     }
 
     Elf32_Phdr* phdr = (Elf32_Phdr*)((uint8_t*)data + ehdr->e_phoff);
     for (int i = 0; i < ehdr->e_phnum; i++) {
         if (phdr[i].p_type == PT_LOAD) {
-            if (phdr[i].p_vaddr < 0x100000) {
+            if (phdr[i].p_vaddr < USER_LOAD_BASE || phdr[i].p_vaddr >= USER_LOAD_END) {
                 terminal_writestring("Invalid load address.\n");
-                return;
+                return 0;
             }
-            if (phdr[i].p_memsz > 0x100000) { 
+            if (phdr[i].p_memsz > USER_LOAD_END - phdr[i].p_vaddr || phdr[i].p_filesz > phdr[i].p_memsz) { 
                 terminal_writestring("Program too large.\n");
-                return;
+                return 0;
             }
             memcpy((void*)phdr[i].p_vaddr, (uint8_t*)data + phdr[i].p_offset, phdr[i].p_filesz);
 
             memset((void*)(phdr[i].p_vaddr + phdr[i].p_filesz), 0, phdr[i].p_memsz - phdr[i].p_filesz);
         }
     }
+    return ehdr->e_entry;
+}
+
+#define PROGRAM_STACK_SIZE (1024 * 1024)
+
+/* Calls entry(argc, argv) with esp switched to stack_top, restoring the caller's stack afterwards. */
+static int run_on_stack(uint32_t entry, int argc, char** argv, void* stack_top) {
+    uint32_t* sp = (uint32_t*)stack_top - 4;
+    sp[0] = (uint32_t)argc;
+    sp[1] = (uint32_t)argv;
+
+    int ret;
+    __asm__ volatile(
+        "mov %%esp, %%ebx\n"
+        "mov %1, %%esp\n"
+        "call *%2\n"
+        "mov %%ebx, %%esp\n"
+        : "=a"(ret)
+        : "r"(sp), "r"(entry)
+        : "ebx", "ecx", "edx", "memory", "cc");
+    return ret;
+}
 
-    uint32_t* stack = (uint32_t*)0x200000; 
-    uint32_t* sp = &stack[255];
-    *(--sp) = 0; 
-    *(--sp) = (uint32_t)name; 
-    *(--sp) = 1; 
+static void execute_binary(const char* name) {
+    if (strlen(name) > 250) {
+        terminal_writestring("Binary name too long.\n");
+        return;
+    }
+    char path[256];
+    strcpy(path, "/bin/");
+    strcpy(path + 5, name);
 
-    typedef int (*entry_t)(int, char**);
-    entry_t entry = (entry_t)ehdr->e_entry;
-    int ret = entry(1, (char**)sp);
+    int fd = vfs_open(path, VFS_O_RDONLY);
+    if (fd < 0) {
+        terminal_writestring("Binary not found.\n");
+        return;
+    }
+    void* data = vfs_mmap(fd, 0, 0);
+    vfs_close(fd);
+    if (!data) {
+        terminal_writestring("Binary could not be mapped.\n");
+        return;
+    }
+
+    uint32_t entry_addr = load_elf(data);
+    vfs_munmap(data);
+    if (!entry_addr) return;
+
+    char* argv[2] = { (char*)name, 0 };
+
+    /*
+     * The stack is backed up front: a #PF raised by a push onto a missing
+     * stack page could not be delivered on that same stack. The guard page
+     * below it still catches an overflow.
+     */
+    uint8_t* stack = paging_alloc_lazy(PROGRAM_STACK_SIZE, PAGE_WRITE);
+    if (!stack || paging_populate(stack, PROGRAM_STACK_SIZE) < 0) {
+        if (stack) paging_free_lazy(stack);
+        terminal_writestring("Could not allocate program stack.\n");
+        return;
+    }
+    int ret = run_on_stack(entry_addr, 1, argv, stack + PROGRAM_STACK_SIZE);
+    paging_free_lazy(stack);
 
     terminal_writestring("Binary returned: ");
     terminal_putchar('0' + ret);
     terminal_writestring("\n");
 }
 
-void kernel_execute_command(const char* input) {
+#define PIPE_BUFFER_SIZE (64 * 1024)
+
+static void execute_command(const char* input) {
 
     const char* pipe_pos = strchr(input, '|');
     if (pipe_pos) {
@@ -458,8 +420,12 @@ void kernel_execute_command(const char* input) {
             right_cmd[--right_len] = '\0';
         }
 
-        char buffer[1024];
-        execute_command_with_output(left_cmd, buffer, sizeof(buffer));
+        char* buffer = scratch_alloc(PIPE_BUFFER_SIZE);
+        if (!buffer) {
+            terminal_writestring("Pipe: out of scratch memory\n");
+            return;
+        }
+        execute_command_with_output(left_cmd, buffer, PIPE_BUFFER_SIZE);
 
         execute_command_with_input(right_cmd, buffer);
         return;
@@ -546,16 +512,17 @@ void kernel_execute_command(const char* input) {
             *sep = '\0';
             const char* text = temp + 5;
             const char* filename = sep + 4;
-            file_t* f = find_file(filename);
-            if (!f) f = create_file(filename);
-            if (f) {
-                int len = strlen(text);
-                if (f->size + len + 1 < 256) {
-                    strcpy(f->content + f->size, text);
-                    f->size += len;
-                    f->content[f->size++] = '\n';
-                    f->content[f->size] = '\0';
-                }
+            int fd = vfs_open(filename, VFS_O_WRONLY | VFS_O_CREAT | VFS_O_APPEND);
+            if (fd >= 0) {
+                vfs_write(fd, text, strlen(text));
+                vfs_write(fd, "\n", 1);
+                vfs_close(fd);
+            } else {
+                terminal_writestring("echo: ");
+                terminal_writestring(filename);
+                terminal_writestring(": ");
+                terminal_writestring(vfs_strerror(fd));
+                terminal_writestring("\n");
             }
         }
     } else if (strcmp(cmd, "disks") == 0) {
@@ -604,6 +571,22 @@ void kernel_execute_command(const char* input) {
         cmd_colorb(args);
     } else if (strcmp(cmd, "lsh") == 0) {
         cmd_lsh(args);
+    } else if (strcmp(cmd, "iostat") == 0) {
+        cmd_iostat(args);
+    } else if (strcmp(cmd, "meminfo") == 0) {
+        cmd_meminfo(args);
+    } else if (strcmp(cmd, "cdrom") == 0) {
+        cmd_cdrom(args);
+    } else if (strcmp(cmd, "tar") == 0) {
+        cmd_tar(args);
+    } else if (strcmp(cmd, "ps") == 0) {
+        cmd_ps(args);
+    } else if (strcmp(cmd, "softirq") == 0) {
+        cmd_softirq(args);
+    } else if (strcmp(cmd, "irqstat") == 0) {
+        cmd_irqstat(args);
+    } else if (strcmp(cmd, "cpus") == 0) {
+        cmd_cpus(args);
     } else {
         if (is_file_in_path(cmd, pathbin)) {
             execute_binary(cmd);
@@ -615,6 +598,51 @@ void kernel_execute_command(const char* input) {
     }
 }
 
+static int grep_line(const char* line, const char* pattern, char* output, int output_size) {
+    if (line[0] == '\0' || !strstr(line, pattern)) {
+        return 0;
+    }
+    if (output) {
+        append_highlighted_line(output, output_size, line, pattern);
+    } else {
+        print_highlighted_line(line, pattern);
+    }
+    return 1;
+}
+
+/* Streams the file through a small buffer; matches are printed, or captured when output is set. */
+static int grep_file(const char* pattern, const char* filename, char* output, int output_size) {
+    int fd = vfs_open(filename, VFS_O_RDONLY);
+    if (fd < 0) {
+        return fd;
+    }
+
+    char chunk[512];
+    char line[256];
+    int line_len = 0;
+    int found = 0;
+    int n;
+
+    while ((n = vfs_read(fd, chunk, sizeof(chunk))) > 0) {
+        for (int i = 0; i < n; i++) {
+            if (chunk[i] == '\n') {
+                line[line_len] = '\0';
+                found |= grep_line(line, pattern, output, output_size);
+                line_len = 0;
+            } else if (line_len < 255) {
+                line[line_len++] = chunk[i];
+            }
+        }
+    }
+    if (line_len > 0) {
+        line[line_len] = '\0';
+        found |= grep_line(line, pattern, output, output_size);
+    }
+
+    vfs_close(fd);
+    return found;
+}
+
 void grep(const char* args) {
     if (strlen(args) == 0) {
         terminal_writestring("grep: missing pattern\n");
@@ -639,87 +667,25 @@ void grep(const char* args) {
         return;
     }
 
-    if (tar_archive) {
-        char tar_path[256];
-        if (filename[0] == '/') {
-            strcpy(tar_path, filename + 1);
-        } else if (strcmp(current_dir, "/") == 0) {
-            strcpy(tar_path, filename);
-        } else {
-            strcpy(tar_path, current_dir + 1);
-            if (tar_path[strlen(tar_path) - 1] != '/') {
-                strcat(tar_path, "/");
-            }
-            strcat(tar_path, filename);
-        }
-
-        void* data = tar_lookup(tar_archive, tar_path);
-        int size = tar_get_file_size(tar_archive, tar_path);
-        if (data && size >= 0) {
-            char* bytes = (char*)data;
-            int line_start = 0;
-            int found = 0;
-
-            for (int i = 0; i <= size; i++) {
-                if (bytes[i] == '\n' || i == size) {
-
-                    int line_len = i - line_start;
-                    if (line_len > 0) {
-                        char line[256];
-                        if (line_len >= 256) line_len = 255;
-                        strncpy(line, bytes + line_start, line_len);
-                        line[line_len] = '\0';
-
-                        if (strstr(line, pattern)) {
-                            print_highlighted_line(line, pattern);
-                            found = 1;
-                        }
-                    }
-                    line_start = i + 1;
-                }
-            }
-
-            if (!found) {
-                terminal_writestring("No matches found\n");
-            }
-            return;
-        }
-    }
-
-    file_t* f = find_file(filename);
-    if (f) {
-        int line_start = 0;
-        int found = 0;
-
-        for (int i = 0; i <= f->size; i++) {
-            if (f->content[i] == '\n' || i == f->size) {
-
-                int line_len = i - line_start;
-                if (line_len > 0) {
-                    char line[256];
-                    if (line_len >= 256) line_len = 255;
-                    strncpy(line, f->content + line_start, line_len);
-                    line[line_len] = '\0';
-
-                    if (strstr(line, pattern)) {
-                        print_highlighted_line(line, pattern);
-                        found = 1;
-                    }
-                }
-                line_start = i + 1;
-            }
-        }
-
-        if (!found) {
-            terminal_writestring("No matches found\n");
-        }
-    } else {
+    int found = grep_file(pattern, filename, 0, 0);
+    if (found < 0) {
         terminal_writestring("grep: ");
         terminal_writestring(filename);
-        terminal_writestring(": No such file\n");
+        terminal_writestring(": ");
+        terminal_writestring(vfs_strerror(found));
+        terminal_writestring("\n");
+    } else if (!found) {
+        terminal_writestring("No matches found\n");
     }
 }
 
+/* Everything a command takes from the scratch arena is released when it returns. */
+void kernel_execute_command(const char* input) {
+    uint32_t mark = scratch_mark();
+    execute_command(input);
+    scratch_release(mark);
+}
+
 void execute_command_with_output(const char* command, char* output, int output_size) {
     if (!output || output_size <= 0) {
         return;
@@ -763,93 +729,11 @@ void execute_command_with_input(const char* command, const char* input) {
 }
 
 void grep_with_output(const char* pattern, const char* filename, char* output, int output_size) {
-
-    if (tar_archive) {
-        char tar_path[256];
-        if (filename[0] == '/') {
-            strcpy(tar_path, filename + 1);
-        } else if (strcmp(current_dir, "/") == 0) {
-            strcpy(tar_path, filename);
-        } else {
-            strcpy(tar_path, current_dir + 1);
-            if (tar_path[strlen(tar_path) - 1] != '/') {
-                strcat(tar_path, "/");
-            }
-            strcat(tar_path, filename);
-        }
-
-        void* data = tar_lookup(tar_archive, tar_path);
-        int size = tar_get_file_size(tar_archive, tar_path);
-        if (data && size >= 0) {
-            char* bytes = (char*)data;
-            int line_start = 0;
-            int output_pos = 0;
-            int found = 0;
-
-            for (int i = 0; i <= size; i++) {
-                if (bytes[i] == '\n' || i == size) {
-
-                    int line_len = i - line_start;
-                    if (line_len > 0) {
-                        char line[256];
-                        if (line_len >= 256) line_len = 255;
-                        strncpy(line, bytes + line_start, line_len);
-                        line[line_len] = '\0';
-
-                        if (strstr(line, pattern)) {
-
-                            append_highlighted_line(output, output_size, line, pattern);
-                            output_pos = strlen(output);
-                            found = 1;
-                        }
-                    }
-                    line_start = i + 1;
-                }
-            }
-
-            if (!found) {
-                strcpy(output, "No matches found\n");
-            } else {
-                output[output_pos] = '\0';
-            }
-            return;
-        }
-    }
-
-    file_t* f = find_file(filename);
-    if (f) {
-        int line_start = 0;
-        int output_pos = 0;
-        int found = 0;
-
-        for (int i = 0; i <= f->size; i++) {
-            if (f->content[i] == '\n' || i == f->size) {
-
-                int line_len = i - line_start;
-                if (line_len > 0) {
-                    char line[256];
-                    if (line_len >= 256) line_len = 255;
-                    strncpy(line, f->content + line_start, line_len);
-                    line[line_len] = '\0';
-
-                    if (strstr(line, pattern)) {
-
-                        append_highlighted_line(output, output_size, line, pattern);
-                        output_pos = strlen(output);
-                        found = 1;
-                    }
-                }
-                line_start = i + 1;
-            }
-        }
-
-        if (!found) {
-            strcpy(output, "No matches found\n");
-        } else {
-            output[output_pos] = '\0';
-        }
-    } else {
+    int found = grep_file(pattern, filename, output, output_size);
+    if (found < 0) {
         strcpy(output, "grep: file not found\n");
+    } else if (!found) {
+        strcpy(output, "No matches found\n");
     }
 }
 
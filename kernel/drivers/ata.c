@@ -3,6 +3,8 @@
 #include <stdint.h>
 #include "io.h"
 #include "include/lib.h"
+#include "include/ata.h"
+#include "include/clock.h"
 
 extern void terminal_writestring(const char*);
 
@@ -49,6 +51,11 @@ static inline void outw(uint16_t port, uint16_t val) {
 #define ATA_CMD_READ 0x20
 #define ATA_CMD_WRITE 0x30
 #define ATA_CMD_IDENTIFY 0xEC
+#define ATA_CMD_CACHE_FLUSH 0xE7
+
+#define ATA_SR_ERR 0x01
+#define ATA_SR_DRQ 0x08
+#define ATA_SR_DF 0x20
 
 #define ATA_DRIVE_PRIMARY_MASTER 0
 #define ATA_DRIVE_PRIMARY_SLAVE 1
@@ -70,11 +77,113 @@ static uint16_t ata_get_drive_port(uint8_t drive) {
     return ATA_SECONDARY_DRIVE;
 }
 
+static ata_stats_t ata_stats[ATA_MAX_DRIVES];
+/* Drives written since their last cache flush. */
+static uint8_t ata_dirty[ATA_MAX_DRIVES];
+
+ata_stats_t* ata_get_stats(uint8_t drive) {
+    if (drive >= ATA_MAX_DRIVES) return 0;
+    return &ata_stats[drive];
+}
+
+void ata_reset_stats(uint8_t drive) {
+    if (drive >= ATA_MAX_DRIVES) return;
+    uint8_t present = ata_stats[drive].present;
+    memset(&ata_stats[drive], 0, sizeof(ata_stats_t));
+    ata_stats[drive].present = present;
+}
+
+int ata_lat_bucket(uint64_t cycles) {
+    uint32_t hi = (uint32_t)(cycles >> 32);
+    uint32_t lo = (uint32_t)cycles;
+    int bucket = 0;
+
+    if (hi) return ATA_LAT_BUCKETS - 1;
+    while (lo > 1 && bucket < ATA_LAT_BUCKETS - 1) {
+        lo >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+uint64_t ata_io_begin(uint8_t drive, int write, uint32_t lba, uint32_t count) {
+    ata_stats_t* st = &ata_stats[drive];
+
+    if (st->next_lba == lba && st->last_write == write && (st->reads || st->writes)) {
+        st->merges++;
+    }
+    st->next_lba = lba + count;
+    st->last_write = write;
+
+    st->inflight++;
+    if (st->inflight > st->max_inflight) st->max_inflight = st->inflight;
+
+    return rdtsc();
+}
+
+void ata_io_end(uint8_t drive, int write, uint32_t count, uint64_t start, int result) {
+    ata_stats_t* st = &ata_stats[drive];
+    uint64_t cycles = rdtsc() - start;
+    int bucket = ata_lat_bucket(cycles);
+
+    st->inflight--;
+    st->busy_cycles += cycles;
+
+    if (write) {
+        st->writes++;
+        st->write_hist[bucket]++;
+        if (result == 0) st->sectors_written += count;
+    } else {
+        st->reads++;
+        st->read_hist[bucket]++;
+        if (result == 0) st->sectors_read += count;
+    }
+}
+
+void ata_timeout_start(ata_timeout_t* t, uint32_t ms) {
+    t->cycles = (uint64_t)clock_tsc_khz() * ms;
+    t->spins = ms * ATA_SPINS_PER_MS;
+    if (t->cycles) t->start = clock_cycles();
+}
+
+int ata_timeout_expired(ata_timeout_t* t) {
+    if (t->cycles) return clock_cycles() - t->start >= t->cycles;
+    return t->spins-- == 0;
+}
+
 int ata_wait(uint8_t drive) {
-    int timeout = 100000;
+    ata_timeout_t timeout;
+    ata_timeout_start(&timeout, ATA_TIMEOUT_MS);
+    uint16_t status_port = ata_get_status_port(drive);
+    while (inb(status_port) & 0x80) {
+        if (ata_timeout_expired(&timeout)) return 0;
+    }
+    return 1;
+}
+
+static int ata_wait_drq(uint8_t drive) {
     uint16_t status_port = ata_get_status_port(drive);
-    while ((inb(status_port) & 0x80) && timeout--); 
-    return timeout > 0;
+
+    if (!ata_wait(drive)) {
+        ata_stats[drive].timeouts++;
+        return -1;
+    }
+
+    ata_timeout_t timeout;
+    ata_timeout_start(&timeout, ATA_TIMEOUT_MS);
+    uint8_t status = inb(status_port);
+    while (!(status & (ATA_SR_DRQ | ATA_SR_ERR | ATA_SR_DF))) {
+        if (ata_timeout_expired(&timeout)) {
+            ata_stats[drive].timeouts++;
+            return -1;
+        }
+        status = inb(status_port);
+    }
+    if (status & (ATA_SR_ERR | ATA_SR_DF)) {
+        ata_stats[drive].errors++;
+        return -1;
+    }
+    return 0;
 }
 
 void ata_select_drive(uint8_t drive) {
@@ -112,6 +221,8 @@ int ata_identify(uint8_t drive) {
         identify_data[i] = inw(base);
     }
 
+    ata_stats[drive].present = 1;
+
     terminal_writestring("ATA Drive ");
     char buf[4];
     buf[0] = 'h';
@@ -126,91 +237,103 @@ int ata_identify(uint8_t drive) {
     return 1;
 }
 
-void ata_read_sector(uint8_t drive, uint32_t lba, uint16_t* buffer) {
-    if (drive > 3) return;
-    if (lba > 0xFFFFFF) return; 
-
+static void ata_issue(uint8_t drive, uint32_t lba, uint8_t count, uint8_t command) {
     uint16_t base = ata_get_base(drive);
+    uint16_t drive_port = ata_get_drive_port(drive);
 
-    ata_select_drive(drive);
-    outb(base + 2, 1);  
+    outb(drive_port, 0xE0 | ((drive & 1) << 4) | ((lba >> 24) & 0x0F));
+    outb(base + 2, count);
     outb(base + 3, lba & 0xFF);
     outb(base + 4, (lba >> 8) & 0xFF);
     outb(base + 5, (lba >> 16) & 0xFF);
-    outb(base + 7, ATA_CMD_READ);
-
-    if (!ata_wait(drive)) {
-        return; 
-    }
-    uint16_t status_port = ata_get_status_port(drive);
-    uint8_t status = inb(status_port);
-    if (status & 0x01) {
-        return; 
-    }
-
-    for (int i = 0; i < 256; i++) {
-        buffer[i] = inw(base);
-    }
+    outb(base + 7, command);
 }
 
-void ata_write_sector(uint8_t drive, uint32_t lba, uint16_t* buffer) {
-    if (drive > 3) return;
-    if (lba > 0xFFFFFF) return; 
+int ata_read_sectors(uint8_t drive, uint32_t lba, uint16_t* buffer, uint8_t count) {
+    if (drive > 3) return -1;
+    if (lba > 0x0FFFFFFF) return -1;
 
     uint16_t base = ata_get_base(drive);
+    int n = count ? count : 256;
+    uint64_t start = ata_io_begin(drive, 0, lba, n);
+    int result = 0;
 
-    ata_select_drive(drive);
-    outb(base + 2, 1);  
-    outb(base + 3, lba & 0xFF);
-    outb(base + 4, (lba >> 8) & 0xFF);
-    outb(base + 5, (lba >> 16) & 0xFF);
-    outb(base + 7, ATA_CMD_WRITE);
+    ata_issue(drive, lba, count, ATA_CMD_READ);
 
-    if (!ata_wait(drive)) return; 
-    for (int i = 0; i < 256; i++) {
-        outw(base, buffer[i]);
+    for (int s = 0; s < n; s++) {
+        if (ata_wait_drq(drive) != 0) {
+            result = -1;
+            break;
+        }
+        for (int i = 0; i < 256; i++) {
+            buffer[s * 256 + i] = inw(base);
+        }
     }
-    ata_wait(drive); 
+
+    ata_io_end(drive, 0, n, start, result);
+    return result;
 }
 
-void ata_read_sectors(uint8_t drive, uint32_t lba, uint16_t* buffer, uint8_t count) {
-    if (drive > 3) return;
+int ata_write_sectors(uint8_t drive, uint32_t lba, uint16_t* buffer, uint8_t count) {
+    if (drive > 3) return -1;
+    if (lba > 0x0FFFFFFF) return -1;
 
     uint16_t base = ata_get_base(drive);
+    int n = count ? count : 256;
+    uint64_t start = ata_io_begin(drive, 1, lba, n);
+    int result = 0;
 
-    ata_select_drive(drive);
-    outb(base + 2, count);
-    outb(base + 3, lba & 0xFF);
-    outb(base + 4, (lba >> 8) & 0xFF);
-    outb(base + 5, (lba >> 16) & 0xFF);
-    outb(base + 7, ATA_CMD_READ);
+    ata_issue(drive, lba, count, ATA_CMD_WRITE);
 
-    if (!ata_wait(drive)) return; 
-    for (int s = 0; s < count; s++) {
+    for (int s = 0; s < n; s++) {
+        if (ata_wait_drq(drive) != 0) {
+            result = -1;
+            break;
+        }
         for (int i = 0; i < 256; i++) {
-            buffer[s * 256 + i] = inw(base);
+            outw(base, buffer[s * 256 + i]);
         }
     }
-}
 
-void ata_write_sectors(uint8_t drive, uint32_t lba, uint16_t* buffer, uint8_t count) {
-    if (drive > 3) return;
+    /* The data may still sit in the drive's write cache until ata_flush(). */
+    if (result == 0) ata_dirty[drive] = 1;
 
-    uint16_t base = ata_get_base(drive);
+    ata_io_end(drive, 1, n, start, result);
+    return result;
+}
+
+int ata_flush(uint8_t drive) {
+    if (drive > 3) return -1;
+    if (!ata_dirty[drive]) return 0;
 
     ata_select_drive(drive);
-    outb(base + 2, count);
-    outb(base + 3, lba & 0xFF);
-    outb(base + 4, (lba >> 8) & 0xFF);
-    outb(base + 5, (lba >> 16) & 0xFF);
-    outb(base + 7, ATA_CMD_WRITE);
+    outb(ata_get_base(drive) + 7, ATA_CMD_CACHE_FLUSH);
+    if (!ata_wait(drive)) {
+        ata_stats[drive].timeouts++;
+        return -1;
+    }
+    if (inb(ata_get_status_port(drive)) & (ATA_SR_ERR | ATA_SR_DF)) {
+        ata_stats[drive].errors++;
+        return -1;
+    }
+    ata_dirty[drive] = 0;
+    return 0;
+}
 
-    if (!ata_wait(drive)) return; 
-    for (int s = 0; s < count; s++) {
-        for (int i = 0; i < 256; i++) {
-            outw(base, buffer[s * 256 + i]);
-        }
+int ata_flush_all(void) {
+    int result = 0;
+    for (uint8_t drive = 0; drive < ATA_MAX_DRIVES; drive++) {
+        if (ata_flush(drive) != 0) result = -1;
     }
+    return result;
+}
+
+int ata_read_sector(uint8_t drive, uint32_t lba, uint16_t* buffer) {
+    return ata_read_sectors(drive, lba, buffer, 1);
+}
+
+int ata_write_sector(uint8_t drive, uint32_t lba, uint16_t* buffer) {
+    return ata_write_sectors(drive, lba, buffer, 1);
 }
 
 void ata_init() {
@@ -0,0 +1,231 @@
+
+
+#include <stdint.h>
+#include "io.h"
+#include "include/lib.h"
+#include "include/ata.h"
+
+extern void terminal_writestring(const char*);
+
+static inline uint16_t inw(uint16_t port) {
+    uint16_t ret;
+    __asm__ volatile("inw %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static inline void outw(uint16_t port, uint16_t val) {
+    __asm__ volatile("outw %0, %1" : : "a"(val), "Nd"(port));
+}
+
+#define ATAPI_BLOCK_SIZE 2048
+#define ATAPI_MAX_BLOCKS_PER_CMD 32
+
+#define ATAPI_CMD_PACKET 0xA0
+#define ATAPI_CMD_IDENTIFY_PACKET 0xA1
+#define ATAPI_OP_READ_12 0xA8
+#define ATAPI_OP_READ_CAPACITY 0x25
+
+#define ATA_SR_BSY 0x80
+#define ATA_SR_DF 0x20
+#define ATA_SR_DRQ 0x08
+#define ATA_SR_ERR 0x01
+
+static uint8_t atapi_present[ATA_MAX_DRIVES];
+static uint32_t atapi_capacity[ATA_MAX_DRIVES];
+
+static uint16_t atapi_base(uint8_t drive) {
+    return drive < 2 ? 0x1F0 : 0x170;
+}
+
+static uint16_t atapi_ctrl(uint8_t drive) {
+    return drive < 2 ? 0x3F6 : 0x376;
+}
+
+static void atapi_delay(uint8_t drive) {
+    for (int i = 0; i < 4; i++) {
+        inb(atapi_ctrl(drive));
+    }
+}
+
+static int atapi_wait_not_busy(uint8_t drive) {
+    ata_timeout_t timeout;
+    ata_timeout_start(&timeout, ATAPI_TIMEOUT_MS);
+    while (inb(atapi_base(drive) + 7) & ATA_SR_BSY) {
+        if (ata_timeout_expired(&timeout)) {
+            ata_get_stats(drive)->timeouts++;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void atapi_select(uint8_t drive) {
+    outb(atapi_base(drive) + 6, 0xA0 | ((drive & 1) << 4));
+    atapi_delay(drive);
+}
+
+static int atapi_identify(uint8_t drive) {
+    uint16_t base = atapi_base(drive);
+
+    atapi_select(drive);
+    outb(atapi_ctrl(drive), 0x02);
+    outb(base + 7, ATAPI_CMD_IDENTIFY_PACKET);
+    atapi_delay(drive);
+
+    uint8_t status = inb(base + 7);
+    if (status == 0 || status == 0xFF) {
+        return 0;
+    }
+    if (atapi_wait_not_busy(drive) != 0) {
+        return 0;
+    }
+    status = inb(base + 7);
+    if ((status & ATA_SR_ERR) || !(status & ATA_SR_DRQ)) {
+        return 0;
+    }
+
+    uint16_t identify_data[256];
+    for (int i = 0; i < 256; i++) {
+        identify_data[i] = inw(base);
+    }
+
+    if ((identify_data[0] & 0xC000) != 0x8000) {
+        return 0;
+    }
+    return ((identify_data[0] >> 8) & 0x1F) == 0x05 ? 1 : 0;
+}
+
+static int atapi_packet(uint8_t drive, const uint8_t* packet, void* buffer, uint32_t max_bytes) {
+    uint16_t base = atapi_base(drive);
+    uint16_t* out = (uint16_t*)buffer;
+    uint32_t received = 0;
+    uint16_t limit = max_bytes > 0xF800 ? 0xF800 : (uint16_t)max_bytes;
+
+    atapi_select(drive);
+    if (atapi_wait_not_busy(drive) != 0) {
+        return -1;
+    }
+
+    outb(base + 1, 0);
+    outb(base + 4, limit & 0xFF);
+    outb(base + 5, limit >> 8);
+    outb(base + 7, ATAPI_CMD_PACKET);
+    atapi_delay(drive);
+
+    if (atapi_wait_not_busy(drive) != 0) {
+        return -1;
+    }
+    uint8_t status = inb(base + 7);
+    if (status & (ATA_SR_ERR | ATA_SR_DF) || !(status & ATA_SR_DRQ)) {
+        ata_get_stats(drive)->errors++;
+        return -1;
+    }
+
+    for (int i = 0; i < 6; i++) {
+        outw(base, packet[i * 2] | (packet[i * 2 + 1] << 8));
+    }
+
+    while (1) {
+        atapi_delay(drive);
+        if (atapi_wait_not_busy(drive) != 0) {
+            return -1;
+        }
+
+        status = inb(base + 7);
+        if (status & (ATA_SR_ERR | ATA_SR_DF)) {
+            ata_get_stats(drive)->errors++;
+            return -1;
+        }
+        if (!(status & ATA_SR_DRQ)) {
+            break;
+        }
+
+        uint32_t bytes = inb(base + 4) | (inb(base + 5) << 8);
+        for (uint32_t i = 0; i < bytes / 2; i++) {
+            uint16_t word = inw(base);
+            if (received + 2 <= max_bytes) {
+                out[received / 2] = word;
+            }
+            received += 2;
+        }
+    }
+
+    return received >= max_bytes ? 0 : -1;
+}
+
+int atapi_read_blocks(uint8_t drive, uint32_t lba, uint32_t count, void* buffer) {
+    if (drive >= ATA_MAX_DRIVES || !atapi_present[drive]) return -1;
+
+    uint8_t* dst = (uint8_t*)buffer;
+
+    while (count > 0) {
+        uint32_t n = count > ATAPI_MAX_BLOCKS_PER_CMD ? ATAPI_MAX_BLOCKS_PER_CMD : count;
+        uint8_t packet[12];
+        memset(packet, 0, sizeof(packet));
+        packet[0] = ATAPI_OP_READ_12;
+        packet[2] = (lba >> 24) & 0xFF;
+        packet[3] = (lba >> 16) & 0xFF;
+        packet[4] = (lba >> 8) & 0xFF;
+        packet[5] = lba & 0xFF;
+        packet[6] = (n >> 24) & 0xFF;
+        packet[7] = (n >> 16) & 0xFF;
+        packet[8] = (n >> 8) & 0xFF;
+        packet[9] = n & 0xFF;
+
+        uint64_t start = ata_io_begin(drive, 0, lba * 4, n * 4);
+        int result = atapi_packet(drive, packet, dst, n * ATAPI_BLOCK_SIZE);
+        ata_io_end(drive, 0, n * 4, start, result);
+        if (result != 0) {
+            return -1;
+        }
+
+        dst += n * ATAPI_BLOCK_SIZE;
+        lba += n;
+        count -= n;
+    }
+    return 0;
+}
+
+static uint32_t atapi_read_capacity(uint8_t drive) {
+    uint8_t packet[12];
+    uint8_t reply[8];
+
+    memset(packet, 0, sizeof(packet));
+    packet[0] = ATAPI_OP_READ_CAPACITY;
+    if (atapi_packet(drive, packet, reply, sizeof(reply)) != 0) {
+        return 0;
+    }
+    return ((uint32_t)reply[0] << 24 | (uint32_t)reply[1] << 16 |
+            (uint32_t)reply[2] << 8 | reply[3]) + 1;
+}
+
+int atapi_is_present(uint8_t drive) {
+    if (drive >= ATA_MAX_DRIVES) return 0;
+    return atapi_present[drive];
+}
+
+int atapi_detect_drives() {
+    int count = 0;
+
+    for (uint8_t drive = 0; drive < ATA_MAX_DRIVES; drive++) {
+        if (!atapi_identify(drive)) {
+            continue;
+        }
+
+        atapi_present[drive] = 1;
+        ata_get_stats(drive)->present = 1;
+        atapi_capacity[drive] = atapi_read_capacity(drive);
+        count++;
+
+        terminal_writestring("ATAPI Drive hd");
+        char buf[12];
+        buf[0] = 'a' + drive;
+        buf[1] = '\0';
+        terminal_writestring(buf);
+        terminal_writestring(": CD-ROM, ");
+        itoa((int)(atapi_capacity[drive] / 512), buf);
+        terminal_writestring(buf);
+        terminal_writestring(" MB\n");
+    }
+    return count;
+}
@@ -0,0 +1,64 @@
+
+
+#include <stdint.h>
+#include "io.h"
+#include "include/keyboard.h"
+#include "include/irq.h"
+#include "include/sched.h"
+
+extern void terminal_writestring(const char*);
+
+#define KBC_DATA 0x60
+#define KBC_STATUS 0x64
+#define KBC_OUTPUT_FULL 0x01
+#define KBC_AUX_DATA 0x20
+
+static volatile uint8_t kbd_buffer[KBD_BUFFER_SIZE];
+static volatile uint32_t kbd_head;
+static volatile uint32_t kbd_tail;
+static volatile uint32_t kbd_lost;
+
+/* Mouse bytes also arrive through port 0x60; those are left for the IRQ 12 handler. */
+static int keyboard_irq(void* ctx) {
+    (void)ctx;
+    int handled = IRQ_NONE;
+    uint8_t status;
+
+    while ((status = inb(KBC_STATUS)) & KBC_OUTPUT_FULL) {
+        if (status & KBC_AUX_DATA) break;
+        uint8_t scancode = inb(KBC_DATA);
+        if (kbd_head - kbd_tail < KBD_BUFFER_SIZE) {
+            kbd_buffer[kbd_head % KBD_BUFFER_SIZE] = scancode;
+            kbd_head++;
+        } else {
+            kbd_lost++;
+        }
+        handled = IRQ_HANDLED;
+    }
+    return handled;
+}
+
+int kbd_read(uint8_t* scancode) {
+    uint32_t flags = irq_save();
+    if (kbd_tail == kbd_head) {
+        irq_restore(flags);
+        return 0;
+    }
+    *scancode = kbd_buffer[kbd_tail % KBD_BUFFER_SIZE];
+    kbd_tail++;
+    irq_restore(flags);
+    return 1;
+}
+
+uint32_t kbd_dropped(void) {
+    return kbd_lost;
+}
+
+void keyboard_install(void) {
+    while (inb(KBC_STATUS) & KBC_OUTPUT_FULL) {
+        inb(KBC_DATA);
+    }
+    if (irq_register(1, keyboard_irq, 0, "keyboard") < 0) {
+        terminal_writestring("Keyboard: cannot register IRQ 1\n");
+    }
+}
@@ -3,6 +3,9 @@
 #include <stdint.h>
 #include "io.h"
 #include "include/lib.h"
+#include "include/timer.h"
+#include "include/irq.h"
+#include "include/keyboard.h"
 
 extern void terminal_writestring(const char*);
 
@@ -13,13 +16,13 @@ volatile uint8_t mouse_packet[3];
 volatile int mouse_packet_index = 0;
 
 void mouse_wait(uint8_t type) {
-    uint32_t timeout = 100000;
+    uint32_t deadline = timer_deadline(100);
     if (type == 0) {
-        while (timeout--) {
+        while (!timer_expired(deadline)) {
             if ((inb(0x64) & 1) == 1) return;
         }
     } else {
-        while (timeout--) {
+        while (!timer_expired(deadline)) {
             if ((inb(0x64) & 2) == 0) return;
         }
     }
@@ -37,7 +40,17 @@ uint8_t mouse_read() {
     return inb(0x60);
 }
 
-void mouse_install() {
+void mouse_handler();
+
+/* Only aux bytes are ours; the keyboard handler takes the rest. */
+static int mouse_irq(void* ctx) {
+    (void)ctx;
+    if ((inb(0x64) & 0x21) != 0x21) return IRQ_NONE;
+    mouse_handler();
+    return IRQ_HANDLED;
+}
+
+void mouse_install(void) {
     terminal_writestring("Mouse driver loading...\n");
 
     mouse_wait(1);
@@ -57,11 +70,19 @@ void mouse_install() {
 
     mouse_write(0xF4);
     mouse_read(); 
+
+    mouse_packet_index = 0;
+    if (irq_register(12, mouse_irq, 0, "mouse") < 0) {
+        terminal_writestring("Mouse: cannot register IRQ 12\n");
+        return;
+    }
     terminal_writestring("Mouse driver loaded: 0xPS2\n");
 }
 
 void mouse_handler() {
     uint8_t data = inb(0x60);
+    /* Bit 3 is always set in the first byte; anything else means we lost sync. */
+    if (mouse_packet_index == 0 && !(data & 0x08)) return;
     mouse_packet[mouse_packet_index] = data;
     mouse_packet_index = (mouse_packet_index + 1) % 3;
     if (mouse_packet_index == 0) {
@@ -4,6 +4,7 @@
 #define NET_H
 
 #include <stdint.h>
+#include "../include/event.h"
 
 typedef struct {
     uint8_t mac[6];
@@ -30,6 +31,11 @@ int net_receive_packet(net_packet_t* packet);
 
 int net_is_available();
 
-void net_poll();
+/* Handles at most one received frame; returns its length, or 0 if none was waiting. */
+int net_poll();
+
+/* Signalled when an ARP entry is learned and when an ICMP echo reply arrives. */
+extern event_t net_arp_event;
+extern event_t net_echo_event;
 
 #endif
\ No newline at end of file
@@ -4,9 +4,13 @@
 #include "io.h"
 #include "net.h"
 #include "../include/lib.h"
+#include "../include/pmm.h"
+#include "../include/timer.h"
+#include "../include/sched.h"
+#include "../include/irq.h"
+#include "../include/softirq.h"
 
 extern void terminal_writestring(const char*);
-extern void* kmalloc(uint32_t size);
 
 #define RTL_REG_IDR0    0x00    
 #define RTL_REG_MAR0    0x08    
@@ -72,6 +76,16 @@ extern void* kmalloc(uint32_t size);
 #define TSD_OWN     0x00002000  
 #define TSD_SIZE    0x00001FFF  
 
+#define PCI_CONFIG_ADDRESS 0xCF8
+#define PCI_CONFIG_DATA    0xCFC
+#define PCI_ENABLE         0x80000000
+#define PCI_ID             0x00
+#define PCI_BAR0           0x10
+#define PCI_INTERRUPT_LINE 0x3C
+#define RTL_PCI_ID         0x813910EC
+
+#define ISR_RX_EVENTS (ISR_ROK | ISR_RER | ISR_RXOVW | ISR_FOV)
+
 #define RX_BUFFER_SIZE  8192 + 16 + 1500  
 #define TX_BUFFER_SIZE  1792
 
@@ -85,6 +99,9 @@ static struct {
     net_interface_t interface;
 } rtl_device = {0};
 
+/* Queued on system_wq by the interrupt handler whenever frames arrive. */
+static work_t* rx_work;
+
 static uint8_t tx_buffers[4][TX_BUFFER_SIZE] __attribute__((aligned(4)));
 static int tx_slot = 0;
 
@@ -116,11 +133,69 @@ static inline void rtl_write32(uint16_t reg, uint32_t val) {
     __asm__ volatile("outl %0, %1" : : "a"(val), "Nd"((uint16_t)(rtl_device.io_base + reg)));
 }
 
-static uint8_t rx_buffer_mem[RX_BUFFER_SIZE] __attribute__((aligned(4)));
+static uint32_t rtl_pci_read(uint32_t dev, uint8_t offset) {
+    uint32_t ret;
+    uint32_t addr = PCI_ENABLE | (dev << 11) | offset;
+    __asm__ volatile("outl %0, %1" : : "a"(addr), "Nd"((uint16_t)PCI_CONFIG_ADDRESS));
+    __asm__ volatile("inl %1, %0" : "=a"(ret) : "Nd"((uint16_t)PCI_CONFIG_DATA));
+    return ret;
+}
+
+/* The card is found by probing I/O ports; its interrupt line is only in PCI config space. Bus 0 only. */
+static int rtl_pci_irq(uint16_t io_base) {
+    for (uint32_t dev = 0; dev < 32; dev++) {
+        if (rtl_pci_read(dev, PCI_ID) != RTL_PCI_ID) continue;
+        if ((rtl_pci_read(dev, PCI_BAR0) & ~3u) != io_base) continue;
+        uint8_t line = rtl_pci_read(dev, PCI_INTERRUPT_LINE) & 0xFF;
+        return line < IRQ_LINES && line != IRQ_CASCADE ? line : -1;
+    }
+    return -1;
+}
+
+/* Top half: acknowledges the card and leaves the frames to rx_work. */
+static int rtl8139_irq(void* ctx) {
+    (void)ctx;
+    uint16_t isr = rtl_read16(RTL_REG_ISR);
+    if (!isr) return IRQ_NONE;
+
+    rtl_write16(RTL_REG_ISR, isr);
+    if ((isr & ISR_RX_EVENTS) && rx_work) queue_work(&system_wq, rx_work);
+    return IRQ_HANDLED;
+}
+
+/*
+ * Switches reception to interrupts: from now on work is queued on system_wq
+ * whenever frames arrive. Returns the IRQ line, or -1 if it is unknown and
+ * the caller has to keep polling.
+ */
+int rtl8139_enable_irq(work_t* work) {
+    if (!rtl_device.initialized) return -1;
+    int irq = rtl_pci_irq(rtl_device.io_base);
+    if (irq < 0) return -1;
+
+    rx_work = work;
+    rtl_write16(RTL_REG_IMR, ISR_RX_EVENTS);
+    if (irq_register(irq, rtl8139_irq, 0, "rtl8139") < 0) {
+        rtl_write16(RTL_REG_IMR, 0);
+        rx_work = 0;
+        return -1;
+    }
+    rtl_device.irq = irq;
+    return irq;
+}
+
+#define RX_BUFFER_FRAMES ((RX_BUFFER_SIZE + PMM_FRAME_SIZE - 1) / PMM_FRAME_SIZE)
 
 int rtl8139_init(uint16_t io_base) {
     rtl_device.io_base = io_base;
-    rtl_device.rx_buffer = rx_buffer_mem;
+    if (!rtl_device.rx_buffer) {
+        /* The card DMAs into the ring by physical address, so it must be contiguous. */
+        rtl_device.rx_buffer = (uint8_t*)frame_alloc_contig(RX_BUFFER_FRAMES, 0);
+        if (!rtl_device.rx_buffer) {
+            terminal_writestring("RTL8139: Out of memory for receive buffer\n");
+            return 0;
+        }
+    }
 
     terminal_writestring("RTL8139: Initializing at 0x");
     char buf[8];
@@ -135,9 +210,9 @@ int rtl8139_init(uint16_t io_base) {
 
     rtl_write8(RTL_REG_CR, CR_RST);
 
-    int timeout = 100000;
-    while ((rtl_read8(RTL_REG_CR) & CR_RST) && timeout--);
-    if (timeout == 0) {
+    uint32_t deadline = timer_deadline(100);
+    while ((rtl_read8(RTL_REG_CR) & CR_RST) && !timer_expired(deadline));
+    if (rtl_read8(RTL_REG_CR) & CR_RST) {
         terminal_writestring("RTL8139: Reset timeout\n");
         return 0;
     }
@@ -223,6 +298,13 @@ int rtl8139_send(const uint8_t* data, uint16_t length) {
         return 0;
     }
 
+    /* Claim a descriptor first: the receive thread may answer ARP and ICMP while the shell sends. */
+    uint32_t flags = irq_save();
+    int slot = tx_slot;
+    tx_slot = (tx_slot + 1) & 3;
+    irq_restore(flags);
+
+#ifdef NET_DEBUG
     terminal_writestring("[RTL8139] Sending ");
     char buf[16];
     buf[0] = '0' + (length / 1000);
@@ -232,7 +314,7 @@ int rtl8139_send(const uint8_t* data, uint16_t length) {
     buf[4] = '\0';
     terminal_writestring(buf);
     terminal_writestring(" bytes, slot ");
-    buf[0] = '0' + tx_slot;
+    buf[0] = '0' + slot;
     buf[1] = '\0';
     terminal_writestring(buf);
     terminal_writestring("\n");
@@ -246,80 +328,40 @@ int rtl8139_send(const uint8_t* data, uint16_t length) {
         terminal_writestring(buf);
     }
     terminal_writestring("\n");
+#endif
 
     for (int i = 0; i < length; i++) {
-        tx_buffers[tx_slot][i] = data[i];
+        tx_buffers[slot][i] = data[i];
     }
 
-    rtl_write32(RTL_REG_TSAD0 + tx_slot * 4, (uint32_t)tx_buffers[tx_slot]);
+    rtl_write32(RTL_REG_TSAD0 + slot * 4, (uint32_t)tx_buffers[slot]);
 
-    rtl_write32(RTL_REG_TSD0 + tx_slot * 4, length);
+    rtl_write32(RTL_REG_TSD0 + slot * 4, length);
 
-    int timeout = 100000;
-    while (!(rtl_read32(RTL_REG_TSD0 + tx_slot * 4) & TSD_TOK) && timeout--);
+    uint32_t deadline = timer_deadline(100);
+    while (!(rtl_read32(RTL_REG_TSD0 + slot * 4) & TSD_TOK) && !timer_expired(deadline));
 
-    if (timeout == 0) {
+    if (!(rtl_read32(RTL_REG_TSD0 + slot * 4) & TSD_TOK)) {
         terminal_writestring("[RTL8139] Send timeout!\n");
-    } else {
-        terminal_writestring("[RTL8139] Send OK\n");
     }
 
-    tx_slot = (tx_slot + 1) & 3;
-
     return length;
 }
 
 int rtl8139_receive(net_packet_t* packet) {
+    if (!rtl_device.initialized) return 0;
 
-    static int enter_count = 0;
-    if (enter_count < 5) {
-        terminal_writestring("[RTL8139] RX: enter receive\n");
-        enter_count++;
-    }
-
-    if (!rtl_device.initialized) {
-        terminal_writestring("[RTL8139] RX: not initialized!\n");
-        return 0;
-    }
-
-    uint16_t isr = rtl_read16(RTL_REG_ISR);
-    uint8_t cr = rtl_read8(RTL_REG_CR);
-
-    static int debug_count = 0;
-    if (debug_count < 5) {
-        terminal_writestring("[RTL8139] RX debug: ISR=0x");
-        char buf[8];
-        buf[0] = "0123456789ABCDEF"[(isr >> 12) & 0xF];
-        buf[1] = "0123456789ABCDEF"[(isr >> 8) & 0xF];
-        buf[2] = "0123456789ABCDEF"[(isr >> 4) & 0xF];
-        buf[3] = "0123456789ABCDEF"[isr & 0xF];
-        buf[4] = ' ';
-        buf[5] = 'C';
-        buf[6] = 'R';
-        buf[7] = '=';
-        buf[8] = "0123456789ABCDEF"[(cr >> 4) & 0xF];
-        buf[9] = "0123456789ABCDEF"[cr & 0xF];
-        buf[10] = '\0';
-        terminal_writestring(buf);
-        terminal_writestring("\n");
-        debug_count++;
-    }
-
-    if (isr & ISR_ROK) {
-        terminal_writestring("[RTL8139] RX: ISR indicates packet ready!\n");
-
+    if (rtl_read16(RTL_REG_ISR) & ISR_ROK) {
         rtl_write16(RTL_REG_ISR, ISR_ROK);
     }
-
-    if (cr & CR_BUFE) {
+    if (rtl_read8(RTL_REG_CR) & CR_BUFE) {
         return 0;
     }
 
-    terminal_writestring("[RTL8139] RX: Buffer not empty, reading packet\n");
-
     uint16_t status = *(uint16_t*)(rtl_device.rx_buffer + rtl_device.rx_pos);
     uint16_t length = *(uint16_t*)(rtl_device.rx_buffer + rtl_device.rx_pos + 2);
 
+#ifdef NET_DEBUG
     terminal_writestring("[RTL8139] RX: status=0x");
     char buf[8];
     buf[0] = "0123456789ABCDEF"[(status >> 12) & 0xF];
@@ -336,10 +378,9 @@ int rtl8139_receive(net_packet_t* packet) {
     buf[4] = '\0';
     terminal_writestring(buf);
     terminal_writestring("\n");
+#endif
 
     if (!(status & 0x01)) {
-        terminal_writestring("[RTL8139] RX: Error flag in status\n");
-
         rtl_device.rx_pos = (rtl_device.rx_pos + length + 4 + 3) & ~3;
         rtl_write16(RTL_REG_CAPR, rtl_device.rx_pos - 16);
         return 0;
@@ -352,16 +393,6 @@ int rtl8139_receive(net_packet_t* packet) {
     }
     packet->length = length;
 
-    terminal_writestring("[RTL8139] RX: First 16 bytes: ");
-    for (int i = 0; i < 16 && i < length; i++) {
-        buf[0] = "0123456789ABCDEF"[(packet->data[i] >> 4) & 0xF];
-        buf[1] = "0123456789ABCDEF"[packet->data[i] & 0xF];
-        buf[2] = ' ';
-        buf[3] = '\0';
-        terminal_writestring(buf);
-    }
-    terminal_writestring("\n");
-
     rtl_device.rx_pos = (rtl_device.rx_pos + length + 4 + 3) & ~3;
     if (rtl_device.rx_pos >= RX_BUFFER_SIZE) {
         rtl_device.rx_pos -= RX_BUFFER_SIZE;
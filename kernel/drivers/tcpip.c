@@ -3,12 +3,22 @@
 #include <stdint.h>
 #include "io.h"
 #include "net.h"
+#define KMALLOC_TAG KM_NET
+#include "../include/kmalloc.h"
+#include "../include/arena.h"
+#include "../include/timer.h"
+#include "../include/event.h"
+#include "../include/sched.h"
+#include "../include/softirq.h"
 
 extern void terminal_writestring(const char*);
 extern net_interface_t* rtl8139_get_interface();
 extern int rtl8139_send(const uint8_t* data, uint16_t length);
 extern int rtl8139_receive(net_packet_t* packet);
 extern int rtl8139_is_initialized();
+extern int rtl8139_enable_irq(work_t* work);
+
+/* Build with -DNET_DEBUG to trace ARP traffic and received frames on the console. */
 
 #define ETH_TYPE_IP     0x0800
 #define ETH_TYPE_ARP    0x0806
@@ -82,14 +92,38 @@ typedef struct __attribute__((packed)) {
 #define TCP_ACK 0x10
 #define TCP_URG 0x20
 
-#define ARP_CACHE_SIZE 16
+#define ARP_CACHE_INITIAL 16
+/* Entries older than this are dropped by a sweep timer so stale MACs get re-resolved. */
+#define ARP_ENTRY_TTL_MS (5 * 60 * 1000)
+#define ARP_SWEEP_MS (60 * 1000)
 typedef struct {
     uint8_t ip[4];
     uint8_t mac[6];
     int valid;
+    uint32_t updated;
 } arp_entry_t;
 
-static arp_entry_t arp_cache[ARP_CACHE_SIZE];
+static arp_entry_t* arp_cache;
+static int arp_cache_size;
+static event_task_t arp_sweep_task;
+
+/*
+ * Received frames are handled on system_wq: the NIC interrupt queues
+ * net_rx_work, which drains the ring from the kworker thread. If the card's
+ * IRQ line is unknown, the "net-rx" kernel thread polls instead. Either way
+ * the ARP cache and the transmit slots are shared with the shell's side of
+ * the stack, so they are only changed with interrupts off.
+ */
+#define NET_POLL_MS 10
+#define NET_POLL_BATCH 32
+static int net_rx_tid = -1;
+static int net_rx_irq = -1;
+static work_t net_rx_work;
+static void net_rx_thread(void* arg);
+static void net_rx_drain(void* arg);
+
+event_t net_arp_event;
+event_t net_echo_event;
 
 #define MAX_CONNECTIONS 4
 typedef struct {
@@ -140,40 +174,82 @@ static void ip_copy(uint8_t* dest, const uint8_t* src) {
 }
 
 uint8_t* arp_lookup(const uint8_t* ip) {
-    for (int i = 0; i < ARP_CACHE_SIZE; i++) {
+    uint32_t flags = irq_save();
+    uint8_t* mac = 0;
+    for (int i = 0; i < arp_cache_size; i++) {
         if (arp_cache[i].valid && ip_equal(arp_cache[i].ip, ip)) {
-            return arp_cache[i].mac;
+            mac = arp_cache[i].mac;
+            break;
         }
     }
-    return 0;
+    irq_restore(flags);
+    return mac;
 }
 
 int arp_get_cache(arp_entry_t* entries, int max_entries) {
     int count = 0;
-    for (int i = 0; i < ARP_CACHE_SIZE && count < max_entries; i++) {
+    uint32_t flags = irq_save();
+    for (int i = 0; i < arp_cache_size && count < max_entries; i++) {
         if (arp_cache[i].valid) {
-            entries[count] = arp_cache[i];
+            if (entries) entries[count] = arp_cache[i];
             count++;
         }
     }
+    irq_restore(flags);
     return count;
 }
 
+static void arp_sweep(event_task_t* task) {
+    int live = 0;
+    uint32_t flags = irq_save();
+    for (int i = 0; i < arp_cache_size; i++) {
+        if (!arp_cache[i].valid) continue;
+        if (ktime_get_ms() - arp_cache[i].updated >= ARP_ENTRY_TTL_MS) {
+            arp_cache[i].valid = 0;
+        } else {
+            live++;
+        }
+    }
+    irq_restore(flags);
+    if (live) event_task_sleep(task, ARP_SWEEP_MS);
+}
+
 void arp_add(const uint8_t* ip, const uint8_t* mac) {
-    for (int i = 0; i < ARP_CACHE_SIZE; i++) {
+    if (!arp_sweep_task.fn) event_task_init(&arp_sweep_task, "arp-sweep", arp_sweep, 0);
+    if (arp_sweep_task.state == EVENT_TASK_DONE) event_task_sleep(&arp_sweep_task, ARP_SWEEP_MS);
+
+    uint32_t flags = irq_save();
+    int slot = -1;
+    for (int i = 0; i < arp_cache_size; i++) {
         if (arp_cache[i].valid && ip_equal(arp_cache[i].ip, ip)) {
             mac_copy(arp_cache[i].mac, mac);
+            arp_cache[i].updated = ktime_get_ms();
+            irq_restore(flags);
+            event_signal(&net_arp_event);
             return;
         }
+        if (!arp_cache[i].valid && slot < 0) slot = i;
     }
-    for (int i = 0; i < ARP_CACHE_SIZE; i++) {
-        if (!arp_cache[i].valid) {
-            ip_copy(arp_cache[i].ip, ip);
-            mac_copy(arp_cache[i].mac, mac);
-            arp_cache[i].valid = 1;
+
+    if (slot < 0) {
+        int size = arp_cache_size ? arp_cache_size * 2 : ARP_CACHE_INITIAL;
+        arp_entry_t* grown = krealloc(arp_cache, size * sizeof(arp_entry_t));
+        if (!grown) {
+            irq_restore(flags);
             return;
         }
+        for (int i = arp_cache_size; i < size; i++) grown[i].valid = 0;
+        slot = arp_cache_size;
+        arp_cache = grown;
+        arp_cache_size = size;
     }
+
+    ip_copy(arp_cache[slot].ip, ip);
+    mac_copy(arp_cache[slot].mac, mac);
+    arp_cache[slot].updated = ktime_get_ms();
+    arp_cache[slot].valid = 1;
+    irq_restore(flags);
+    event_signal(&net_arp_event);
 }
 
 void send_arp_request(const uint8_t* target_ip) {
@@ -201,6 +277,7 @@ void send_arp_request(const uint8_t* target_ip) {
     for (int i = 0; i < 6; i++) arp->target_mac[i] = 0;
     ip_copy(arp->target_ip, target_ip);
 
+#ifdef NET_DEBUG
     char buf[32];
     terminal_writestring("[ARP] Sending request for ");
     format_ip(target_ip, buf);
@@ -214,14 +291,19 @@ void send_arp_request(const uint8_t* target_ip) {
     format_mac(iface->mac, buf);
     terminal_writestring(buf);
     terminal_writestring("\n");
+#endif
 
     int sent = rtl8139_send(packet, sizeof(eth_header_t) + sizeof(arp_header_t));
+#ifdef NET_DEBUG
     terminal_writestring("[ARP] Send result: ");
     buf[0] = '0' + (sent / 10);
     buf[1] = '0' + (sent % 10);
     buf[2] = '\0';
     terminal_writestring(buf);
     terminal_writestring(" bytes\n");
+#else
+    (void)sent;
+#endif
 }
 
 void send_arp_reply(const uint8_t* target_ip, const uint8_t* target_mac) {
@@ -250,15 +332,13 @@ void send_arp_reply(const uint8_t* target_ip, const uint8_t* target_mac) {
 }
 
 static void handle_arp(const uint8_t* data, int length) {
-    if (length < sizeof(arp_header_t)) {
-        terminal_writestring("[ARP] Packet too short\n");
-        return;
-    }
+    if (length < sizeof(arp_header_t)) return;
 
     arp_header_t* arp = (arp_header_t*)data;
     net_interface_t* iface = rtl8139_get_interface();
     if (!iface) return;
 
+#ifdef NET_DEBUG
     char buf[32];
     terminal_writestring("[ARP] Received packet, operation: ");
     uint16_t op = (arp->operation >> 8) | ((arp->operation & 0xFF) << 8);
@@ -284,13 +364,12 @@ static void handle_arp(const uint8_t* data, int length) {
     format_ip(iface->ip, buf);
     terminal_writestring(buf);
     terminal_writestring(")\n");
+#endif
 
     if (arp->operation == 0x0100 && ip_equal(arp->target_ip, iface->ip)) {
-        terminal_writestring("[ARP] Request for us, sending reply\n");
         send_arp_reply(arp->sender_ip, arp->sender_mac);
         arp_add(arp->sender_ip, arp->sender_mac);
     } else if (arp->operation == 0x0200) {
-        terminal_writestring("[ARP] Reply received, adding to cache\n");
         arp_add(arp->sender_ip, arp->sender_mac);
     }
 }
@@ -321,7 +400,9 @@ int send_ip_packet(const uint8_t* dest_ip, uint8_t protocol, const uint8_t* data
         return 0;  
     }
 
-    uint8_t packet[1514];
+    uint32_t mark = scratch_mark();
+    uint8_t* packet = scratch_alloc(1514);
+    if (!packet) return 0;
     eth_header_t* eth = (eth_header_t*)packet;
     ip_header_t* ip = (ip_header_t*)(packet + sizeof(eth_header_t));
 
@@ -349,11 +430,15 @@ int send_ip_packet(const uint8_t* dest_ip, uint8_t protocol, const uint8_t* data
     uint8_t* payload = packet + sizeof(eth_header_t) + sizeof(ip_header_t);
     for (int i = 0; i < length; i++) payload[i] = data[i];
 
-    return rtl8139_send(packet, sizeof(eth_header_t) + sizeof(ip_header_t) + length);
+    int sent = rtl8139_send(packet, sizeof(eth_header_t) + sizeof(ip_header_t) + length);
+    scratch_release(mark);
+    return sent;
 }
 
 static void send_icmp_reply(const uint8_t* dest_ip, uint16_t id, uint16_t seq, const uint8_t* data, int length) {
-    uint8_t packet[1500];
+    uint32_t mark = scratch_mark();
+    uint8_t* packet = scratch_alloc(1500);
+    if (!packet) return;
     icmp_header_t* icmp = (icmp_header_t*)packet;
 
     icmp->type = 0;  
@@ -368,6 +453,7 @@ static void send_icmp_reply(const uint8_t* dest_ip, uint16_t id, uint16_t seq, c
     icmp->checksum = net_checksum(packet, sizeof(icmp_header_t) + length);
 
     send_ip_packet(dest_ip, IP_PROTO_ICMP, packet, sizeof(icmp_header_t) + length);
+    scratch_release(mark);
 }
 
 static void handle_icmp(const uint8_t* src_ip, const uint8_t* data, int length) {
@@ -378,6 +464,8 @@ static void handle_icmp(const uint8_t* src_ip, const uint8_t* data, int length)
     if (icmp->type == 8) {  
         send_icmp_reply(src_ip, icmp->identifier, icmp->sequence, 
                        data + sizeof(icmp_header_t), length - sizeof(icmp_header_t));
+    } else if (icmp->type == 0) {
+        event_signal(&net_echo_event);
     }
 }
 
@@ -458,7 +546,7 @@ int net_ping(const uint8_t* dest_ip) {
 
 void net_init() {
 
-    for (int i = 0; i < ARP_CACHE_SIZE; i++) {
+    for (int i = 0; i < arp_cache_size; i++) {
         arp_cache[i].valid = 0;
     }
 
@@ -474,20 +562,26 @@ void net_init() {
         terminal_writestring("[NET] Added static ARP for QEMU gateway 10.0.2.2\n");
     }
 
+    if (net_rx_irq < 0 && net_rx_tid < 0) {
+        work_init(&net_rx_work, net_rx_drain, 0);
+        if (system_wq.tid >= 0) net_rx_irq = rtl8139_enable_irq(&net_rx_work);
+        if (net_rx_irq >= 0) {
+            /* Frames that arrived before the interrupt was enabled raised nothing. */
+            queue_work(&system_wq, &net_rx_work);
+        } else {
+            net_rx_tid = thread_create("net-rx", net_rx_thread, 0);
+        }
+    }
+
     terminal_writestring("TCP/IP stack initialized\n");
 }
 
-void net_poll() {
+int net_poll() {
     net_packet_t packet;
 
-    static int poll_debug_count = 0;
-    if (poll_debug_count < 3) {
-        terminal_writestring("[NET] Polling...\n");
-        poll_debug_count++;
-    }
-
     int received = rtl8139_receive(&packet);
     if (received > 0) {
+#ifdef NET_DEBUG
         char buf[16];
         terminal_writestring("[NET] Received packet: ");
         buf[0] = '0' + (received / 1000);
@@ -497,18 +591,34 @@ void net_poll() {
         buf[4] = '\0';
         terminal_writestring(buf);
         terminal_writestring(" bytes\n");
+#endif
+        net_process_packet(&packet);
+    }
+    return received > 0 ? received : 0;
+}
 
-        terminal_writestring("[NET] Data: ");
-        for (int i = 0; i < 16 && i < received; i++) {
-            buf[0] = "0123456789ABCDEF"[(packet.data[i] >> 4) & 0xF];
-            buf[1] = "0123456789ABCDEF"[packet.data[i] & 0xF];
-            buf[2] = ' ';
-            buf[3] = '\0';
-            terminal_writestring(buf);
-        }
-        terminal_writestring("\n");
+static void net_rx_drain(void* arg) {
+    (void)arg;
+    int frames = 0;
+    while (frames < NET_POLL_BATCH && net_poll() > 0) {
+        frames++;
+    }
+    /* Frames may be left after a full batch; requeue behind the other work rather than hog kworker. */
+    if (frames == NET_POLL_BATCH) queue_work(&system_wq, &net_rx_work);
+}
 
-        net_process_packet(&packet);
+static void net_rx_thread(void* arg) {
+    (void)arg;
+    for (;;) {
+        int frames = 0;
+        while (frames < NET_POLL_BATCH && net_poll() > 0) {
+            frames++;
+        }
+        if (frames == NET_POLL_BATCH) {
+            thread_yield();
+        } else {
+            thread_sleep_ms(NET_POLL_MS);
+        }
     }
 }
 
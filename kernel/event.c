@@ -0,0 +1,261 @@
+
+
+#include <stdint.h>
+#include "include/event.h"
+#include "include/sched.h"
+#include "include/timer.h"
+#include "include/softirq.h"
+
+static event_task_t* ready_head;
+static event_task_t* ready_tail;
+static event_t irq_events[IRQ_EVENT_COUNT];
+static volatile uint32_t irq_events_fired;
+static event_stats_t stats;
+/* Thread that last ran the loop; only it is kept from halting by ready tasks. */
+static thread_t* loop_owner;
+
+static void ready_push(event_task_t* task) {
+    task->next = 0;
+    task->prev = ready_tail;
+    if (ready_tail) {
+        ready_tail->next = task;
+    } else {
+        ready_head = task;
+    }
+    ready_tail = task;
+    task->state = EVENT_TASK_READY;
+    stats.ready++;
+}
+
+static void ready_remove(event_task_t* task) {
+    if (task->prev) {
+        task->prev->next = task->next;
+    } else {
+        ready_head = task->next;
+    }
+    if (task->next) {
+        task->next->prev = task->prev;
+    } else {
+        ready_tail = task->prev;
+    }
+    task->next = task->prev = 0;
+    stats.ready--;
+}
+
+static void task_unwait(event_task_t* task) {
+    event_t* ev = task->waiting;
+    if (ev) {
+        if (task->prev) {
+            task->prev->next = task->next;
+        } else {
+            ev->waiters = task->next;
+        }
+        if (task->next) task->next->prev = task->prev;
+        task->next = task->prev = 0;
+        task->waiting = 0;
+    }
+    stats.waiting--;
+}
+
+/* Takes a ready or waiting task off whatever list it is on. */
+static void task_detach(event_task_t* task) {
+    if (task->state == EVENT_TASK_READY) {
+        ready_remove(task);
+    } else if (task->state == EVENT_TASK_WAITING) {
+        task_unwait(task);
+        timer_cancel(&task->timer);
+    }
+}
+
+/* Common entry of the calls that (re)arm a task: accounts a new start, otherwise detaches it. */
+static void task_rearm(event_task_t* task) {
+    if (task->state == EVENT_TASK_DONE) {
+        stats.tasks++;
+    } else if (task->state != EVENT_TASK_RUNNING) {
+        task_detach(task);
+    }
+}
+
+static void event_task_timeout(void* data) {
+    event_task_t* task = data;
+    uint32_t flags = irq_save();
+    if (task->state == EVENT_TASK_WAITING) {
+        task_unwait(task);
+        task->reason = EVENT_WOKE_TIMEOUT;
+        stats.timeouts++;
+        ready_push(task);
+    }
+    irq_restore(flags);
+}
+
+void event_init(event_t* ev) {
+    ev->waiters = 0;
+    ev->pending = 0;
+    ev->signals = 0;
+}
+
+void event_signal(event_t* ev) {
+    uint32_t flags = irq_save();
+    ev->signals++;
+    if (!ev->waiters) {
+        ev->pending++;
+    }
+    while (ev->waiters) {
+        event_task_t* task = ev->waiters;
+        task_unwait(task);
+        timer_cancel(&task->timer);
+        task->reason = EVENT_WOKE_SIGNAL;
+        ready_push(task);
+    }
+    irq_restore(flags);
+}
+
+void event_clear(event_t* ev) {
+    ev->pending = 0;
+}
+
+event_t* irq_event(uint8_t irq) {
+    return &irq_events[irq % IRQ_EVENT_COUNT];
+}
+
+void irq_event_raise(uint8_t irq) {
+    uint32_t flags = irq_save();
+    irq_events_fired |= 1u << (irq % IRQ_EVENT_COUNT);
+    irq_restore(flags);
+    softirq_raise(SOFTIRQ_IRQ_EVENT);
+}
+
+/* Waking the waiters can be long with many tasks, so it happens here rather than in the top half. */
+void irq_event_run(void) {
+    uint32_t flags = irq_save();
+    uint32_t fired = irq_events_fired;
+    irq_events_fired = 0;
+    irq_restore(flags);
+
+    for (int irq = 0; irq < IRQ_EVENT_COUNT; irq++) {
+        if (fired & (1u << irq)) event_signal(&irq_events[irq]);
+    }
+}
+
+void event_task_init(event_task_t* task, const char* name, void (*fn)(event_task_t* task), void* data) {
+    task->next = task->prev = 0;
+    task->fn = fn;
+    task->data = data;
+    task->waiting = 0;
+    task->name = name;
+    task->state = EVENT_TASK_DONE;
+    task->reason = EVENT_WOKE_START;
+    task->runs = 0;
+    timer_setup(&task->timer, event_task_timeout, task);
+}
+
+void event_task_start(event_task_t* task) {
+    uint32_t flags = irq_save();
+    task_rearm(task);
+    task->reason = EVENT_WOKE_START;
+    ready_push(task);
+    irq_restore(flags);
+}
+
+void event_task_wait(event_task_t* task, event_t* ev, uint32_t timeout_ms) {
+    uint32_t flags = irq_save();
+    task_rearm(task);
+
+    if (ev && ev->pending) {
+        ev->pending = 0;
+        task->reason = EVENT_WOKE_SIGNAL;
+        ready_push(task);
+    } else {
+        task->state = EVENT_TASK_WAITING;
+        stats.waiting++;
+        if (ev) {
+            task->prev = 0;
+            task->next = ev->waiters;
+            if (ev->waiters) ev->waiters->prev = task;
+            ev->waiters = task;
+            task->waiting = ev;
+        }
+        if (timeout_ms) timer_mod(&task->timer, timeout_ms);
+    }
+    irq_restore(flags);
+}
+
+void event_task_sleep(event_task_t* task, uint32_t ms) {
+    event_task_wait(task, 0, ms ? ms : 1);
+}
+
+void event_task_yield(event_task_t* task) {
+    uint32_t flags = irq_save();
+    task_rearm(task);
+    task->reason = EVENT_WOKE_YIELD;
+    ready_push(task);
+    irq_restore(flags);
+}
+
+void event_task_cancel(event_task_t* task) {
+    uint32_t flags = irq_save();
+    if (task->state != EVENT_TASK_DONE) {
+        if (task->state != EVENT_TASK_RUNNING) task_detach(task);
+        task->state = EVENT_TASK_DONE;
+        stats.tasks--;
+    }
+    irq_restore(flags);
+}
+
+int event_loop_run(void) {
+    int ran = 0;
+    uint32_t flags = irq_save();
+    uint32_t budget = stats.ready;
+
+    loop_owner = sched_current();
+    while (budget-- > 0 && ready_head) {
+        event_task_t* task = ready_head;
+        ready_remove(task);
+        task->state = EVENT_TASK_RUNNING;
+        task->runs++;
+        stats.runs++;
+        irq_restore(flags);
+
+        task->fn(task);
+
+        flags = irq_save();
+        if (task->state == EVENT_TASK_RUNNING) {
+            task->state = EVENT_TASK_DONE;
+            stats.tasks--;
+        }
+        ran++;
+    }
+    irq_restore(flags);
+    return ran;
+}
+
+/* Checked by timer_idle() with interrupts off, so a wakeup just before the halt is not slept through. */
+int event_loop_pending(void) {
+    return ready_head != 0 && sched_current() == loop_owner;
+}
+
+void event_loop_idle(void) {
+    if (!event_loop_run()) timer_idle();
+}
+
+static void event_loop_woke(event_task_t* task) {
+    *(volatile int*)task->data = 1;
+}
+
+int event_loop_wait(event_t* ev, uint32_t timeout_ms) {
+    volatile int done = 0;
+    event_task_t task;
+
+    event_task_init(&task, "wait", event_loop_woke, (void*)&done);
+    event_task_wait(&task, ev, timeout_ms);
+    while (!done) {
+        event_loop_idle();
+    }
+    return task.reason == EVENT_WOKE_SIGNAL;
+}
+
+void event_loop_stats(event_stats_t* out) {
+    uint32_t flags = irq_save();
+    *out = stats;
+    irq_restore(flags);
+}
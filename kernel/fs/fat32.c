@@ -4,11 +4,12 @@
 #include <stddef.h>
 #include "include/lib.h"
 #include "include/fat32.h"
+#include "include/ata.h"
+#include "include/vfs.h"
+#include "include/arena.h"
 #include "drivers/io.h"
 
 extern void terminal_writestring(const char* s);
-extern void ata_read_sector(uint8_t drive, uint32_t lba, uint16_t* buffer);
-extern void ata_write_sector(uint8_t drive, uint32_t lba, uint16_t* buffer);
 
 #define MAX_FAT32_MOUNTS 4
 
@@ -17,6 +18,10 @@ static fat32_fs_t mounted_fs[MAX_FAT32_MOUNTS];
 static uint16_t sector_buffer[256];
 static uint8_t cluster_buffer[4096];  
 
+static uint8_t dir_sector[512];
+static uint32_t dir_sector_lba = 0xFFFFFFFF;
+static fat32_fs_t* dir_sector_fs = NULL;
+
 void fat32_init(void) {
     for (int i = 0; i < MAX_FAT32_MOUNTS; i++) {
         mounted_fs[i].mounted = 0;
@@ -43,16 +48,18 @@ fat32_fs_t* fat32_get_mounted_fs_by_index(int index) {
 
 static int fat32_read_sector(fat32_fs_t* fs, uint32_t sector, uint8_t* buffer) {
     uint32_t lba = fs->partition_start + sector;
-    ata_read_sector(fs->drive, lba, (uint16_t*)sector_buffer);
+    if (ata_read_sector(fs->drive, lba, (uint16_t*)sector_buffer) != 0) {
+        return -1;
+    }
     memcpy(buffer, sector_buffer, 512);
     return 0;
 }
 
 static int fat32_write_sector(fat32_fs_t* fs, uint32_t sector, const uint8_t* buffer) {
     uint32_t lba = fs->partition_start + sector;
+    dir_sector_lba = 0xFFFFFFFF;
     memcpy(sector_buffer, buffer, 512);
-    ata_write_sector(fs->drive, lba, sector_buffer);
-    return 0;
+    return ata_write_sector(fs->drive, lba, sector_buffer);
 }
 
 static int fat32_read_cluster(fat32_fs_t* fs, uint32_t cluster, uint8_t* buffer) {
@@ -127,12 +134,65 @@ static int fat32_set_fat_entry(fat32_fs_t* fs, uint32_t cluster, uint32_t value)
     return 0;
 }
 
+/* Links up to count free clusters after prev (0 starts a new chain), one FAT sector write per run. */
+static uint32_t fat32_alloc_chain(fat32_fs_t* fs, uint32_t prev, uint32_t count, uint32_t* allocated) {
+    uint32_t per_sector = fs->bytes_per_sector / 4;
+    uint32_t end = fs->total_clusters + 2;
+    uint32_t cluster = fs->next_free >= 2 && fs->next_free < end ? fs->next_free : 2;
+    uint32_t scanned = 0;
+    uint32_t first = 0;
+    uint8_t fat_sector_data[512];
+
+    *allocated = 0;
+    while (*allocated < count && scanned < fs->total_clusters) {
+        uint32_t index = cluster / per_sector;
+        if (fat32_read_sector(fs, fs->fat_start + index, fat_sector_data) != 0) {
+            break;
+        }
+        uint32_t* entries = (uint32_t*)fat_sector_data;
+        int dirty = 0;
+
+        for (; *allocated < count && cluster < end && cluster / per_sector == index; cluster++, scanned++) {
+            uint32_t* entry = &entries[cluster % per_sector];
+            if ((*entry & 0x0FFFFFFF) != FAT32_FREE_CLUSTER) continue;
+
+            *entry = (*entry & 0xF0000000) | FAT32_END_OF_CHAIN;
+            dirty = 1;
+            if (prev && prev / per_sector == index) {
+                entries[prev % per_sector] = (entries[prev % per_sector] & 0xF0000000) | cluster;
+            } else if (prev) {
+                fat32_set_fat_entry(fs, prev, cluster);
+            } else {
+                first = cluster;
+            }
+            prev = cluster;
+            (*allocated)++;
+        }
+
+        if (dirty && fat32_write_sector(fs, fs->fat_start + index, fat_sector_data) != 0) {
+            break;
+        }
+        if (cluster >= end) {
+            cluster = 2;
+        }
+    }
+
+    fs->next_free = cluster;
+    return first;
+}
+
 static uint32_t fat32_find_free_cluster(fat32_fs_t* fs) {
-    for (uint32_t cluster = 2; cluster < fs->total_clusters + 2; cluster++) {
+    uint32_t end = fs->total_clusters + 2;
+    uint32_t start = fs->next_free >= 2 && fs->next_free < end ? fs->next_free : 2;
+    uint32_t cluster = start;
+
+    do {
         if (fat32_get_next_cluster(fs, cluster) == FAT32_FREE_CLUSTER) {
+            fs->next_free = cluster;
             return cluster;
         }
-    }
+        if (++cluster >= end) cluster = 2;
+    } while (cluster != start);
     return 0;  
 }
 
@@ -152,7 +212,10 @@ int fat32_mount(uint8_t drive, uint32_t partition_start, const char* mount_point
     }
 
     fat32_boot_sector_t boot_sector;
-    ata_read_sector(drive, partition_start, (uint16_t*)sector_buffer);
+    if (ata_read_sector(drive, partition_start, (uint16_t*)sector_buffer) != 0) {
+        terminal_writestring("FAT32: Failed to read boot sector\n");
+        return -1;
+    }
     memcpy(&boot_sector, sector_buffer, sizeof(fat32_boot_sector_t));
 
     if (boot_sector.boot_signature != 0x29 && boot_sector.boot_signature != 0x28) {
@@ -191,9 +254,18 @@ int fat32_mount(uint8_t drive, uint32_t partition_start, const char* mount_point
                              boot_sector.total_sectors_32;
     uint32_t data_sectors = total_sectors - fs->data_start;
     fs->total_clusters = data_sectors / fs->sectors_per_cluster;
+    fs->next_free = 2;
 
     strncpy(fs->mount_point, mount_point, 63);
     fs->mount_point[63] = '\0';
+
+    int r = vfs_mount(mount_point, &fat32_vfs_ops, fs);
+    if (r < 0) {
+        terminal_writestring("FAT32: ");
+        terminal_writestring(vfs_strerror(r));
+        terminal_writestring("\n");
+        return -1;
+    }
     fs->mounted = 1;
 
     terminal_writestring("FAT32: Mounted ");
@@ -231,6 +303,15 @@ int fat32_unmount(const char* mount_point) {
         return -1;
     }
 
+    ata_flush(fs->drive);
+    int r = vfs_umount(mount_point);
+    if (r < 0 && r != VFS_ENOENT) {
+        terminal_writestring("FAT32: ");
+        terminal_writestring(vfs_strerror(r));
+        terminal_writestring("\n");
+        return -1;
+    }
+
     fs->mounted = 0;
     fs->mount_point[0] = '\0';
 
@@ -259,6 +340,11 @@ static void fat32_name_to_string(const uint8_t* fat_name, char* out) {
     out[j] = '\0';
 }
 
+static char fat32_upper(char c) {
+    if (c >= 'a' && c <= 'z') return c - ('a' - 'A');
+    return c;
+}
+
 static void string_to_fat_name(const char* name, uint8_t* fat_name) {
     int i = 0;
     int j = 0;
@@ -266,15 +352,16 @@ static void string_to_fat_name(const char* name, uint8_t* fat_name) {
     memset(fat_name, ' ', 11);
 
     while (name[i] && name[i] != '.' && j < 8) {
-        fat_name[j++] = name[i++] | 0x40;  
+        fat_name[j++] = fat32_upper(name[i++]);
     }
+    while (name[i] && name[i] != '.') i++;
 
     if (name[i] == '.') {
         i++;
         j = 8;
 
         while (name[i] && j < 11) {
-            fat_name[j++] = name[i++] | 0x40;  
+            fat_name[j++] = fat32_upper(name[i++]);
         }
     }
 }
@@ -283,12 +370,11 @@ static int fat32_compare_name(const uint8_t* fat_name, const char* name) {
     char fat_str[13];
     fat32_name_to_string(fat_name, fat_str);
 
-    for (int i = 0; fat_str[i] && name[i]; i++) {
-        char c1 = fat_str[i] | 0x20;  
-        char c2 = name[i] | 0x20;
-        if (c1 != c2) return 0;
+    int i = 0;
+    for (; fat_str[i] && name[i]; i++) {
+        if (fat32_upper(fat_str[i]) != fat32_upper(name[i])) return 0;
     }
-    return 1;
+    return fat_str[i] == name[i];
 }
 
 int fat32_parse_path(const char* path, char components[][FAT32_MAX_FILENAME], int max_components) {
@@ -316,9 +402,9 @@ int fat32_parse_path(const char* path, char components[][FAT32_MAX_FILENAME], in
     return count;
 }
 
-int fat32_find_entry(fat32_fs_t* fs, uint32_t dir_cluster, const char* name, 
-                     fat32_dir_entry_t* entry) {
-    uint8_t cluster_data[4096];  
+static int fat32_find_entry_at_in(fat32_fs_t* fs, uint32_t dir_cluster, const char* name,
+                                  fat32_dir_entry_t* entry, uint32_t* entry_cluster, uint32_t* entry_index,
+                                  uint8_t* cluster_data) {
     uint32_t cluster = dir_cluster;
 
     do {
@@ -346,6 +432,8 @@ int fat32_find_entry(fat32_fs_t* fs, uint32_t dir_cluster, const char* name,
                 if (entry) {
                     memcpy(entry, &entries[i], sizeof(fat32_dir_entry_t));
                 }
+                if (entry_cluster) *entry_cluster = cluster;
+                if (entry_index) *entry_index = i;
                 return 0;  
             }
         }
@@ -357,6 +445,21 @@ int fat32_find_entry(fat32_fs_t* fs, uint32_t dir_cluster, const char* name,
     return -1;  
 }
 
+static int fat32_find_entry_at(fat32_fs_t* fs, uint32_t dir_cluster, const char* name,
+                               fat32_dir_entry_t* entry, uint32_t* entry_cluster, uint32_t* entry_index) {
+    if (!fs) return -1;
+    uint32_t mark = scratch_mark();
+    uint8_t* cluster_data = scratch_alloc(fs->bytes_per_cluster);
+    int r = cluster_data ? fat32_find_entry_at_in(fs, dir_cluster, name, entry, entry_cluster, entry_index, cluster_data) : -1;
+    scratch_release(mark);
+    return r;
+}
+
+int fat32_find_entry(fat32_fs_t* fs, uint32_t dir_cluster, const char* name, 
+                     fat32_dir_entry_t* entry) {
+    return fat32_find_entry_at(fs, dir_cluster, name, entry, NULL, NULL);
+}
+
 int fat32_open(fat32_file_t* file, const char* path) {
     if (!file || !path) return -1;
 
@@ -407,21 +510,18 @@ int fat32_open(fat32_file_t* file, const char* path) {
     return -1;
 }
 
-int fat32_read(fat32_file_t* file, void* buffer, uint32_t size) {
+static int fat32_read_in(fat32_file_t* file, void* buffer, uint32_t size, uint8_t* cluster_data) {
     if (!file || !buffer || file->is_directory) return -1;
 
     uint8_t* buf = (uint8_t*)buffer;
     uint32_t bytes_read = 0;
-    uint8_t cluster_data[4096];
 
     while (bytes_read < size && file->current_offset < file->file_size) {
 
         uint32_t cluster_offset = file->current_offset % file->fs->bytes_per_cluster;
 
-        if (cluster_offset == 0 || file->current_cluster != file->first_cluster) {
-            if (fat32_read_cluster(file->fs, file->current_cluster, cluster_data) != 0) {
-                break;
-            }
+        if (fat32_read_cluster(file->fs, file->current_cluster, cluster_data) != 0) {
+            break;
         }
 
         uint32_t bytes_left_in_cluster = file->fs->bytes_per_cluster - cluster_offset;
@@ -446,12 +546,20 @@ int fat32_read(fat32_file_t* file, void* buffer, uint32_t size) {
     return bytes_read;
 }
 
-int fat32_write(fat32_file_t* file, const void* buffer, uint32_t size) {
+int fat32_read(fat32_file_t* file, void* buffer, uint32_t size) {
+    if (!file || !file->fs) return -1;
+    uint32_t mark = scratch_mark();
+    uint8_t* cluster_data = scratch_alloc(file->fs->bytes_per_cluster);
+    int r = cluster_data ? fat32_read_in(file, buffer, size, cluster_data) : -1;
+    scratch_release(mark);
+    return r;
+}
+
+static int fat32_write_in(fat32_file_t* file, const void* buffer, uint32_t size, uint8_t* cluster_data) {
     if (!file || !buffer || file->is_directory) return -1;
 
     const uint8_t* buf = (const uint8_t*)buffer;
     uint32_t bytes_written = 0;
-    uint8_t cluster_data[4096];
 
     while (bytes_written < size) {
 
@@ -501,12 +609,21 @@ int fat32_write(fat32_file_t* file, const void* buffer, uint32_t size) {
     return bytes_written;
 }
 
+int fat32_write(fat32_file_t* file, const void* buffer, uint32_t size) {
+    if (!file || !file->fs) return -1;
+    uint32_t mark = scratch_mark();
+    uint8_t* cluster_data = scratch_alloc(file->fs->bytes_per_cluster);
+    int r = cluster_data ? fat32_write_in(file, buffer, size, cluster_data) : -1;
+    scratch_release(mark);
+    return r;
+}
+
 void fat32_close(fat32_file_t* file) {
 
     (void)file;
 }
 
-int fat32_list_directory(fat32_fs_t* fs, const char* path) {
+static int fat32_list_directory_in(fat32_fs_t* fs, const char* path, uint8_t* cluster_data) {
     if (!fs || !fs->mounted) return -1;
 
     uint32_t cluster = fs->root_cluster;
@@ -525,7 +642,6 @@ int fat32_list_directory(fat32_fs_t* fs, const char* path) {
         cluster = dir.first_cluster;
     }
 
-    uint8_t cluster_data[4096];
     char name[13];
 
     do {
@@ -571,6 +687,15 @@ int fat32_list_directory(fat32_fs_t* fs, const char* path) {
     return 0;
 }
 
+int fat32_list_directory(fat32_fs_t* fs, const char* path) {
+    if (!fs) return -1;
+    uint32_t mark = scratch_mark();
+    uint8_t* cluster_data = scratch_alloc(fs->bytes_per_cluster);
+    int r = cluster_data ? fat32_list_directory_in(fs, path, cluster_data) : -1;
+    scratch_release(mark);
+    return r;
+}
+
 int fat32_exists(fat32_fs_t* fs, const char* path) {
     if (!fs || !fs->mounted) return 0;
 
@@ -579,7 +704,7 @@ int fat32_exists(fat32_fs_t* fs, const char* path) {
     return (fat32_open(&file, path) == 0) ? 1 : 0;
 }
 
-int fat32_create(fat32_fs_t* fs, const char* path) {
+static int fat32_create_in(fat32_fs_t* fs, const char* path, uint8_t* cluster_data) {
     if (!fs || !fs->mounted || !path) return -1;
 
     char components[32][FAT32_MAX_FILENAME];
@@ -613,7 +738,6 @@ int fat32_create(fat32_fs_t* fs, const char* path) {
 
     fat32_set_fat_entry(fs, new_cluster, FAT32_END_OF_CHAIN);
 
-    uint8_t cluster_data[4096];
     if (fat32_read_cluster(fs, parent_cluster, cluster_data) != 0) {
         return -1;
     }
@@ -647,7 +771,16 @@ int fat32_create(fat32_fs_t* fs, const char* path) {
     return 0;
 }
 
-int fat32_mkdir(fat32_fs_t* fs, const char* path) {
+int fat32_create(fat32_fs_t* fs, const char* path) {
+    if (!fs) return -1;
+    uint32_t mark = scratch_mark();
+    uint8_t* cluster_data = scratch_alloc(fs->bytes_per_cluster);
+    int r = cluster_data ? fat32_create_in(fs, path, cluster_data) : -1;
+    scratch_release(mark);
+    return r;
+}
+
+static int fat32_mkdir_in(fat32_fs_t* fs, const char* path, uint8_t* cluster_data) {
     if (!fs || !fs->mounted || !path) return -1;
 
     char components[32][FAT32_MAX_FILENAME];
@@ -681,7 +814,6 @@ int fat32_mkdir(fat32_fs_t* fs, const char* path) {
 
     fat32_set_fat_entry(fs, new_cluster, FAT32_END_OF_CHAIN);
 
-    uint8_t cluster_data[4096];
     memset(cluster_data, 0, fs->bytes_per_cluster);
 
     fat32_dir_entry_t* entries = (fat32_dir_entry_t*)cluster_data;
@@ -735,7 +867,16 @@ int fat32_mkdir(fat32_fs_t* fs, const char* path) {
     return 0;
 }
 
-int fat32_delete(fat32_fs_t* fs, const char* path) {
+int fat32_mkdir(fat32_fs_t* fs, const char* path) {
+    if (!fs) return -1;
+    uint32_t mark = scratch_mark();
+    uint8_t* cluster_data = scratch_alloc(fs->bytes_per_cluster);
+    int r = cluster_data ? fat32_mkdir_in(fs, path, cluster_data) : -1;
+    scratch_release(mark);
+    return r;
+}
+
+static int fat32_delete_in(fat32_fs_t* fs, const char* path, uint8_t* cluster_data) {
     if (!fs || !fs->mounted || !path) return -1;
 
     char components[32][FAT32_MAX_FILENAME];
@@ -755,7 +896,6 @@ int fat32_delete(fat32_fs_t* fs, const char* path) {
         parent_cluster = ((uint32_t)entry.cluster_high << 16) | entry.cluster_low;
     }
 
-    uint8_t cluster_data[4096];
     uint32_t cluster = parent_cluster;
     int found = 0;
     uint32_t file_cluster = 0;
@@ -812,6 +952,15 @@ int fat32_delete(fat32_fs_t* fs, const char* path) {
     return 0;
 }
 
+int fat32_delete(fat32_fs_t* fs, const char* path) {
+    if (!fs) return -1;
+    uint32_t mark = scratch_mark();
+    uint8_t* cluster_data = scratch_alloc(fs->bytes_per_cluster);
+    int r = cluster_data ? fat32_delete_in(fs, path, cluster_data) : -1;
+    scratch_release(mark);
+    return r;
+}
+
 int fat32_get_file_size(fat32_fs_t* fs, const char* path) {
     if (!fs || !fs->mounted || !path) return -1;
 
@@ -846,4 +995,340 @@ uint32_t fat32_read_cluster_chain(fat32_fs_t* fs, uint32_t start_cluster,
     }
 
     return bytes_read;
-}
\ No newline at end of file
+}
+static uint32_t fat32_entry_first_cluster(const fat32_dir_entry_t* entry) {
+    return ((uint32_t)entry->cluster_high << 16) | entry->cluster_low;
+}
+
+static uint32_t fat32_cluster_sector(fat32_fs_t* fs, uint32_t cluster) {
+    return fs->data_start + (cluster - 2) * fs->sectors_per_cluster;
+}
+
+static int fat32_valid_cluster(uint32_t cluster) {
+    return cluster >= 2 && cluster < FAT32_BAD_CLUSTER;
+}
+
+/* Node fields: fsdata[0] first cluster, fsdata[1]/[2] cluster and slot of the directory entry. */
+static void fat32_vfs_fill(fat32_fs_t* fs, const fat32_dir_entry_t* entry,
+                           uint32_t dir_cluster, uint32_t index, vfs_node_t* node) {
+    memset(node, 0, sizeof(*node));
+    node->ino = dir_cluster * (fs->bytes_per_cluster / sizeof(fat32_dir_entry_t)) + index + 1;
+    node->type = (entry->attr & FAT32_ATTR_DIRECTORY) ? VFS_TYPE_DIR : VFS_TYPE_FILE;
+    node->size = node->type == VFS_TYPE_DIR ? 0 : entry->file_size;
+    node->fsdata[0] = fat32_entry_first_cluster(entry);
+    node->fsdata[1] = dir_cluster;
+    node->fsdata[2] = index;
+}
+
+static int fat32_vfs_lookup(vfs_mount_t* mnt, const char* path, vfs_node_t* node) {
+    fat32_fs_t* fs = (fat32_fs_t*)mnt->priv;
+    char components[32][FAT32_MAX_FILENAME];
+    int count = fat32_parse_path(path, components, 32);
+
+    if (count == 0) {
+        memset(node, 0, sizeof(*node));
+        node->type = VFS_TYPE_DIR;
+        node->fsdata[0] = fs->root_cluster;
+        return 0;
+    }
+
+    uint32_t cluster = fs->root_cluster;
+    for (int i = 0; i < count; i++) {
+        fat32_dir_entry_t entry;
+        uint32_t entry_cluster, entry_index;
+
+        if (fat32_find_entry_at(fs, cluster, components[i], &entry, &entry_cluster, &entry_index) != 0) {
+            return VFS_ENOENT;
+        }
+        if (i == count - 1) {
+            fat32_vfs_fill(fs, &entry, entry_cluster, entry_index, node);
+            return 0;
+        }
+        if (!(entry.attr & FAT32_ATTR_DIRECTORY)) {
+            return VFS_ENOTDIR;
+        }
+        cluster = fat32_entry_first_cluster(&entry);
+        if (cluster < 2) {
+            cluster = fs->root_cluster;
+        }
+    }
+    return VFS_ENOENT;
+}
+
+static int fat32_vfs_update_entry(fat32_fs_t* fs, const vfs_node_t* node) {
+    uint32_t offset = node->fsdata[2] * sizeof(fat32_dir_entry_t);
+    uint32_t sector = fat32_cluster_sector(fs, node->fsdata[1]) + offset / fs->bytes_per_sector;
+    uint8_t data[512];
+
+    if (fat32_read_sector(fs, sector, data) != 0) {
+        return VFS_EIO;
+    }
+    fat32_dir_entry_t* entry = (fat32_dir_entry_t*)(data + offset % fs->bytes_per_sector);
+    entry->file_size = node->size;
+    entry->cluster_high = (node->fsdata[0] >> 16) & 0xFFFF;
+    entry->cluster_low = node->fsdata[0] & 0xFFFF;
+    return fat32_write_sector(fs, sector, data) == 0 ? 0 : VFS_EIO;
+}
+
+/* Returns the cluster holding the index-th cluster of the file, walking from the cached cursor. */
+static uint32_t fat32_vfs_cluster_at(vfs_file_t* file, uint32_t index, int allocate) {
+    fat32_fs_t* fs = (fat32_fs_t*)file->node.mnt->priv;
+    uint32_t cluster = file->node.fsdata[0];
+    uint32_t pos = 0;
+
+    if (file->cursor[1] && file->cursor[1] - 1 <= index) {
+        cluster = file->cursor[0];
+        pos = file->cursor[1] - 1;
+    }
+
+    uint32_t allocated;
+    if (!fat32_valid_cluster(cluster)) {
+        if (!allocate) return 0;
+        cluster = fat32_alloc_chain(fs, 0, 1, &allocated);
+        if (cluster == 0) return 0;
+        file->node.fsdata[0] = cluster;
+        pos = 0;
+    }
+
+    while (pos < index) {
+        uint32_t next = fat32_get_next_cluster(fs, cluster);
+        if (!fat32_valid_cluster(next)) {
+            if (!allocate) return 0;
+            fat32_alloc_chain(fs, cluster, 1, &allocated);
+            if (!allocated) return 0;
+            next = fat32_get_next_cluster(fs, cluster);
+        }
+        cluster = next;
+        pos++;
+    }
+
+    file->cursor[0] = cluster;
+    file->cursor[1] = index + 1;
+    return cluster;
+}
+
+static int fat32_vfs_transfer(vfs_file_t* file, uint8_t* buffer, uint32_t size, int write) {
+    fat32_fs_t* fs = (fat32_fs_t*)file->node.mnt->priv;
+    uint32_t bps = fs->bytes_per_sector;
+    uint32_t done = 0;
+
+    while (done < size) {
+        uint32_t offset = file->offset + done;
+        uint32_t in_cluster = offset % fs->bytes_per_cluster;
+        uint32_t cluster = fat32_vfs_cluster_at(file, offset / fs->bytes_per_cluster, write);
+        if (!cluster) break;
+
+        uint32_t sector = fat32_cluster_sector(fs, cluster) + in_cluster / bps;
+        uint32_t in_sector = in_cluster % bps;
+        uint32_t left = size - done;
+
+        /* Whole sectors go straight between the caller's buffer and the disk, across contiguous clusters. */
+        if (in_sector == 0 && left >= bps) {
+            uint32_t count = left / bps;
+            uint32_t run = fs->sectors_per_cluster - in_cluster / bps;
+            uint32_t index = offset / fs->bytes_per_cluster;
+            uint32_t last = cluster;
+            while (run < count && run + fs->sectors_per_cluster <= 255) {
+                uint32_t next = fat32_vfs_cluster_at(file, index + 1, write);
+                if (next != last + 1) break;
+                last = next;
+                index++;
+                run += fs->sectors_per_cluster;
+            }
+            if (count > run) count = run;
+            if (count > 255) count = 255;
+
+            uint32_t lba = fs->partition_start + sector;
+            int r = write ? ata_write_sectors(fs->drive, lba, (uint16_t*)(buffer + done), (uint8_t)count)
+                          : ata_read_sectors(fs->drive, lba, (uint16_t*)(buffer + done), (uint8_t)count);
+            if (r != 0) break;
+            if (write) dir_sector_lba = 0xFFFFFFFF;
+            done += count * bps;
+            continue;
+        }
+
+        uint32_t n = bps - in_sector;
+        if (n > left) n = left;
+
+        if (fat32_read_sector(fs, sector, cluster_buffer) != 0) break;
+        if (write) {
+            memcpy(cluster_buffer + in_sector, buffer + done, n);
+            if (fat32_write_sector(fs, sector, cluster_buffer) != 0) break;
+        } else {
+            memcpy(buffer + done, cluster_buffer + in_sector, n);
+        }
+        done += n;
+    }
+
+    if (done == 0) return write ? VFS_ENOSPC : VFS_EIO;
+    return (int)done;
+}
+
+static int fat32_vfs_read(vfs_file_t* file, void* buffer, uint32_t size) {
+    return fat32_vfs_transfer(file, (uint8_t*)buffer, size, 0);
+}
+
+static int fat32_vfs_write(vfs_file_t* file, const void* buffer, uint32_t size) {
+    uint32_t first = file->node.fsdata[0];
+    int n = fat32_vfs_transfer(file, (uint8_t*)buffer, size, 1);
+    if (n <= 0) return n;
+
+    if (file->offset + n > file->node.size || file->node.fsdata[0] != first) {
+        if (file->offset + n > file->node.size) {
+            file->node.size = file->offset + n;
+        }
+        if (fat32_vfs_update_entry((fat32_fs_t*)file->node.mnt->priv, &file->node) != 0) {
+            return VFS_EIO;
+        }
+    }
+    /* One cache flush per write call rather than per sector. */
+    if (ata_flush(((fat32_fs_t*)file->node.mnt->priv)->drive) != 0) return VFS_EIO;
+    return n;
+}
+
+static int fat32_vfs_truncate(vfs_file_t* file, uint32_t size) {
+    fat32_fs_t* fs = (fat32_fs_t*)file->node.mnt->priv;
+    if (size > file->node.size) return VFS_EINVAL;
+
+    uint32_t cluster = file->node.fsdata[0];
+    if (fat32_valid_cluster(cluster)) {
+        uint32_t keep = size ? (size + fs->bytes_per_cluster - 1) / fs->bytes_per_cluster : 1;
+        for (uint32_t i = 1; i < keep; i++) {
+            uint32_t next = fat32_get_next_cluster(fs, cluster);
+            if (!fat32_valid_cluster(next)) break;
+            cluster = next;
+        }
+
+        uint32_t next = fat32_get_next_cluster(fs, cluster);
+        if (fat32_valid_cluster(next)) {
+            fat32_set_fat_entry(fs, cluster, FAT32_END_OF_CHAIN);
+            while (fat32_valid_cluster(next)) {
+                uint32_t after = fat32_get_next_cluster(fs, next);
+                fat32_set_fat_entry(fs, next, FAT32_FREE_CLUSTER);
+                next = after;
+            }
+        }
+    }
+
+    file->node.size = size;
+    file->cursor[1] = 0;
+    return fat32_vfs_update_entry(fs, &file->node);
+}
+
+/* Allocates the whole chain for size bytes up front; the file size itself is left alone. */
+static int fat32_vfs_reserve(vfs_file_t* file, uint32_t size) {
+    fat32_fs_t* fs = (fat32_fs_t*)file->node.mnt->priv;
+    uint32_t want = (size + fs->bytes_per_cluster - 1) / fs->bytes_per_cluster;
+    uint32_t have = 0;
+    uint32_t last = 0;
+
+    for (uint32_t c = file->node.fsdata[0]; fat32_valid_cluster(c) && have < want; c = fat32_get_next_cluster(fs, c)) {
+        last = c;
+        have++;
+    }
+    if (have >= want) return 0;
+
+    uint32_t allocated;
+    uint32_t first = fat32_alloc_chain(fs, last, want - have, &allocated);
+    if (!last && allocated) {
+        file->node.fsdata[0] = first;
+        if (fat32_vfs_update_entry(fs, &file->node) != 0) return VFS_EIO;
+    }
+    return allocated == want - have ? 0 : VFS_ENOSPC;
+}
+
+static int fat32_vfs_readdir(vfs_file_t* file, vfs_dirent_t* out) {
+    fat32_fs_t* fs = (fat32_fs_t*)file->node.mnt->priv;
+    uint32_t per_cluster = fs->bytes_per_cluster / sizeof(fat32_dir_entry_t);
+
+    /* cursor[0] is the current directory cluster (1 once exhausted), cursor[1] the slot in it. */
+    if (file->cursor[0] == 0) {
+        file->cursor[0] = fat32_valid_cluster(file->node.fsdata[0]) ? file->node.fsdata[0] : fs->root_cluster;
+    }
+
+    while (file->cursor[0] != 1) {
+        if (file->cursor[1] >= per_cluster) {
+            uint32_t next = fat32_get_next_cluster(fs, file->cursor[0]);
+            file->cursor[0] = fat32_valid_cluster(next) ? next : 1;
+            file->cursor[1] = 0;
+            continue;
+        }
+
+        uint32_t offset = file->cursor[1] * sizeof(fat32_dir_entry_t);
+        uint32_t sector = fat32_cluster_sector(fs, file->cursor[0]) + offset / fs->bytes_per_sector;
+        if (sector != dir_sector_lba || fs != dir_sector_fs) {
+            if (fat32_read_sector(fs, sector, dir_sector) != 0) {
+                dir_sector_lba = 0xFFFFFFFF;
+                return VFS_EIO;
+            }
+            dir_sector_lba = sector;
+            dir_sector_fs = fs;
+        }
+        file->cursor[1]++;
+
+        fat32_dir_entry_t* entry = (fat32_dir_entry_t*)(dir_sector + offset % fs->bytes_per_sector);
+        if (entry->name[0] == 0x00) {
+            file->cursor[0] = 1;
+            break;
+        }
+        if (entry->name[0] == 0xE5 || entry->name[0] == '.') continue;
+        if ((entry->attr & FAT32_ATTR_LONG_NAME) == FAT32_ATTR_LONG_NAME) continue;
+        if (entry->attr & FAT32_ATTR_VOLUME_ID) continue;
+
+        fat32_name_to_string(entry->name, out->name);
+        out->type = (entry->attr & FAT32_ATTR_DIRECTORY) ? VFS_TYPE_DIR : VFS_TYPE_FILE;
+        out->size = entry->file_size;
+        return 1;
+    }
+    return 0;
+}
+
+static int fat32_valid_short_name(const char* name) {
+    int base = 0;
+    int ext = -1;
+
+    for (const char* p = name; *p; p++) {
+        if (*p == '/' || *p == ' ') return 0;
+        if (*p == '.') {
+            if (ext >= 0) return 0;
+            ext = 0;
+        } else if (ext >= 0) {
+            ext++;
+        } else {
+            base++;
+        }
+    }
+    return base > 0 && base <= 8 && ext <= 3;
+}
+
+static int fat32_vfs_create(vfs_mount_t* mnt, const char* path, uint8_t type, vfs_node_t* node) {
+    fat32_fs_t* fs = (fat32_fs_t*)mnt->priv;
+    const char* name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+
+    if (!fat32_valid_short_name(name)) return VFS_EINVAL;
+
+    int r = type == VFS_TYPE_DIR ? fat32_mkdir(fs, path) : fat32_create(fs, path);
+    if (r != 0) return VFS_EIO;
+    return fat32_vfs_lookup(mnt, path, node);
+}
+
+static int fat32_vfs_unlink(vfs_mount_t* mnt, const char* path) {
+    vfs_node_t node;
+    int r = fat32_vfs_lookup(mnt, path, &node);
+    if (r < 0) return r;
+    if (node.type == VFS_TYPE_DIR) return VFS_EISDIR;
+    return fat32_delete((fat32_fs_t*)mnt->priv, path) == 0 ? 0 : VFS_EIO;
+}
+
+const vfs_ops_t fat32_vfs_ops = {
+    .name = "fat32",
+    .lookup = fat32_vfs_lookup,
+    .read = fat32_vfs_read,
+    .write = fat32_vfs_write,
+    .readdir = fat32_vfs_readdir,
+    .create = fat32_vfs_create,
+    .unlink = fat32_vfs_unlink,
+    .truncate = fat32_vfs_truncate,
+    .reserve = fat32_vfs_reserve,
+};
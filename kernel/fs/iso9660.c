@@ -0,0 +1,330 @@
+
+
+#include <stdint.h>
+#include <stddef.h>
+#include "include/lib.h"
+#include "include/ata.h"
+#include "include/iso9660.h"
+#include "include/vfs.h"
+
+extern void terminal_writestring(const char* s);
+
+#define ISO9660_PVD_LBA 16
+#define ISO9660_VD_PRIMARY 1
+#define ISO9660_VD_TERMINATOR 255
+#define ISO9660_FLAG_DIR 0x02
+
+static iso9660_fs_t iso_fs;
+
+extern const vfs_ops_t iso9660_vfs_ops;
+
+static uint8_t dir_block[ISO9660_BLOCK_SIZE];
+static uint32_t dir_block_lba = 0xFFFFFFFF;
+static uint8_t bounce_block[ISO9660_BLOCK_SIZE];
+
+static uint32_t read_le32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static char to_lower(char c) {
+    if (c >= 'A' && c <= 'Z') return c + ('a' - 'A');
+    return c;
+}
+
+static int name_equal(const char* a, const char* b, int len) {
+    for (int i = 0; i < len; i++) {
+        if (to_lower(a[i]) != to_lower(b[i])) return 0;
+    }
+    return b[len] == '\0';
+}
+
+static int iso9660_read_dir_block(iso9660_fs_t* fs, uint32_t lba) {
+    if (lba == dir_block_lba) {
+        return 0;
+    }
+    if (atapi_read_blocks(fs->drive, lba, 1, dir_block) != 0) {
+        dir_block_lba = 0xFFFFFFFF;
+        return -1;
+    }
+    dir_block_lba = lba;
+    return 0;
+}
+
+static int iso9660_rr_name(const uint8_t* record, char* out) {
+    uint8_t rec_len = record[0];
+    uint8_t name_len = record[32];
+    int off = 33 + name_len + ((name_len & 1) ? 0 : 1);
+    int found = 0;
+    int out_len = 0;
+
+    while (off + 4 <= rec_len) {
+        const uint8_t* su = record + off;
+        uint8_t su_len = su[2];
+        if (su_len < 4 || off + su_len > rec_len) break;
+
+        if (su[0] == 'N' && su[1] == 'M' && su_len > 5) {
+            int n = su_len - 5;
+            if (out_len + n >= ISO9660_MAX_NAME) n = ISO9660_MAX_NAME - 1 - out_len;
+            memcpy(out + out_len, su + 5, n);
+            out_len += n;
+            out[out_len] = '\0';
+            found = 1;
+            if (!(su[4] & 0x01)) break;
+        }
+        off += su_len;
+    }
+    return found;
+}
+
+static void iso9660_parse_record(iso9660_fs_t* fs, const uint8_t* record, iso9660_entry_t* entry) {
+    uint8_t name_len = record[32];
+    const char* name = (const char*)record + 33;
+
+    entry->extent = read_le32(record + 2);
+    entry->size = read_le32(record + 10);
+    entry->is_dir = (record[25] & ISO9660_FLAG_DIR) ? 1 : 0;
+
+    if (fs->rock_ridge && iso9660_rr_name(record, entry->name)) {
+        return;
+    }
+
+    int len = 0;
+    for (int i = 0; i < name_len && name[i] != ';' && len < ISO9660_MAX_NAME - 1; i++) {
+        entry->name[len++] = to_lower(name[i]);
+    }
+    if (len > 0 && entry->name[len - 1] == '.') {
+        len--;
+    }
+    entry->name[len] = '\0';
+}
+
+int iso9660_readdir(iso9660_fs_t* fs, const iso9660_entry_t* dir, uint32_t* pos, iso9660_entry_t* entry) {
+    if (!fs || !fs->mounted || !dir || !dir->is_dir) return -1;
+
+    while (*pos < dir->size) {
+        uint32_t lba = dir->extent + *pos / ISO9660_BLOCK_SIZE;
+        uint32_t off = *pos % ISO9660_BLOCK_SIZE;
+
+        if (iso9660_read_dir_block(fs, lba) != 0) {
+            return -1;
+        }
+
+        const uint8_t* record = dir_block + off;
+        uint8_t rec_len = record[0];
+        if (rec_len == 0 || off + rec_len > ISO9660_BLOCK_SIZE) {
+            *pos = (*pos / ISO9660_BLOCK_SIZE + 1) * ISO9660_BLOCK_SIZE;
+            continue;
+        }
+        *pos += rec_len;
+
+        if (record[32] == 1 && (record[33] == 0 || record[33] == 1)) {
+            continue;
+        }
+
+        iso9660_parse_record(fs, record, entry);
+        return 1;
+    }
+    return 0;
+}
+
+int iso9660_lookup(iso9660_fs_t* fs, const char* path, iso9660_entry_t* entry) {
+    if (!fs || !fs->mounted || !path || !entry) return -1;
+
+    iso9660_entry_t current = fs->root;
+    const char* p = path;
+
+    while (*p) {
+        while (*p == '/') p++;
+        if (!*p) break;
+
+        const char* comp = p;
+        int comp_len = 0;
+        while (p[comp_len] && p[comp_len] != '/') comp_len++;
+        p += comp_len;
+
+        if (!current.is_dir) {
+            return -1;
+        }
+
+        uint32_t pos = 0;
+        iso9660_entry_t child;
+        int found = 0;
+        while (iso9660_readdir(fs, &current, &pos, &child) > 0) {
+            if (name_equal(comp, child.name, comp_len)) {
+                found = 1;
+                break;
+            }
+        }
+        if (!found) {
+            return -1;
+        }
+        current = child;
+    }
+
+    *entry = current;
+    return 0;
+}
+
+int iso9660_read(iso9660_fs_t* fs, const iso9660_entry_t* file, uint32_t offset, void* buffer, uint32_t size) {
+    if (!fs || !fs->mounted || !file || !buffer || file->is_dir) return -1;
+    if (offset >= file->size) return 0;
+    if (size > file->size - offset) size = file->size - offset;
+
+    uint8_t* dst = (uint8_t*)buffer;
+    uint32_t done = 0;
+
+    uint32_t head = offset % ISO9660_BLOCK_SIZE;
+    if (head) {
+        uint32_t n = ISO9660_BLOCK_SIZE - head;
+        if (n > size) n = size;
+        if (atapi_read_blocks(fs->drive, file->extent + offset / ISO9660_BLOCK_SIZE, 1, bounce_block) != 0) {
+            return -1;
+        }
+        memcpy(dst, bounce_block + head, n);
+        done += n;
+    }
+
+    uint32_t whole = (size - done) / ISO9660_BLOCK_SIZE;
+    if (whole) {
+        uint32_t lba = file->extent + (offset + done) / ISO9660_BLOCK_SIZE;
+        if (atapi_read_blocks(fs->drive, lba, whole, dst + done) != 0) {
+            return done ? (int)done : -1;
+        }
+        done += whole * ISO9660_BLOCK_SIZE;
+    }
+
+    if (done < size) {
+        uint32_t lba = file->extent + (offset + done) / ISO9660_BLOCK_SIZE;
+        if (atapi_read_blocks(fs->drive, lba, 1, bounce_block) != 0) {
+            return (int)done;
+        }
+        memcpy(dst + done, bounce_block, size - done);
+        done = size;
+    }
+
+    return (int)done;
+}
+
+iso9660_fs_t* iso9660_get_fs(void) {
+    return iso_fs.mounted ? &iso_fs : NULL;
+}
+
+int iso9660_mount(uint8_t drive) {
+    if (!atapi_is_present(drive)) {
+        return -1;
+    }
+
+    for (uint32_t lba = ISO9660_PVD_LBA; lba < ISO9660_PVD_LBA + 16; lba++) {
+        if (atapi_read_blocks(drive, lba, 1, dir_block) != 0) {
+            terminal_writestring("ISO9660: Failed to read volume descriptor\n");
+            return -1;
+        }
+        dir_block_lba = 0xFFFFFFFF;
+
+        if (strncmp((const char*)dir_block + 1, "CD001", 5) != 0) {
+            terminal_writestring("ISO9660: No volume descriptor found\n");
+            return -1;
+        }
+        if (dir_block[0] == ISO9660_VD_TERMINATOR) {
+            break;
+        }
+        if (dir_block[0] != ISO9660_VD_PRIMARY) {
+            continue;
+        }
+
+        uint16_t block_size = dir_block[128] | (dir_block[129] << 8);
+        if (block_size != ISO9660_BLOCK_SIZE) {
+            terminal_writestring("ISO9660: Unsupported logical block size\n");
+            return -1;
+        }
+
+        iso_fs.drive = drive;
+        iso_fs.volume_blocks = read_le32(dir_block + 80);
+        memcpy(iso_fs.volume_id, dir_block + 40, 32);
+        iso_fs.volume_id[32] = '\0';
+        for (int i = 31; i >= 0 && iso_fs.volume_id[i] == ' '; i--) {
+            iso_fs.volume_id[i] = '\0';
+        }
+
+        const uint8_t* root = dir_block + 156;
+        iso_fs.root.extent = read_le32(root + 2);
+        iso_fs.root.size = read_le32(root + 10);
+        iso_fs.root.is_dir = 1;
+        iso_fs.root.name[0] = '/';
+        iso_fs.root.name[1] = '\0';
+        iso_fs.mounted = 1;
+
+        /* Rock Ridge volumes tag the root "." entry with a SUSP "SP" marker. */
+        iso_fs.rock_ridge = 0;
+        if (iso9660_read_dir_block(&iso_fs, iso_fs.root.extent) == 0) {
+            const uint8_t* dot = dir_block;
+            int su = 33 + dot[32] + ((dot[32] & 1) ? 0 : 1);
+            if (su + 7 <= dot[0] && dot[su] == 'S' && dot[su + 1] == 'P') {
+                iso_fs.rock_ridge = 1;
+            }
+        }
+
+        vfs_mount(ISO9660_MOUNT_POINT, &iso9660_vfs_ops, &iso_fs);
+
+        terminal_writestring("ISO9660: Mounted volume ");
+        terminal_writestring(iso_fs.volume_id);
+        terminal_writestring(iso_fs.rock_ridge ? " (Rock Ridge)\n" : "\n");
+        return 0;
+    }
+
+    terminal_writestring("ISO9660: No primary volume descriptor\n");
+    return -1;
+}
+
+static void iso9660_vfs_fill(const iso9660_entry_t* entry, vfs_node_t* node) {
+    memset(node, 0, sizeof(*node));
+    node->ino = entry->extent;
+    node->type = entry->is_dir ? VFS_TYPE_DIR : VFS_TYPE_FILE;
+    node->size = entry->is_dir ? 0 : entry->size;
+    node->fsdata[0] = entry->extent;
+    node->fsdata[1] = entry->size;
+}
+
+static void iso9660_vfs_entry(const vfs_node_t* node, iso9660_entry_t* entry) {
+    entry->extent = node->fsdata[0];
+    entry->size = node->fsdata[1];
+    entry->is_dir = node->type == VFS_TYPE_DIR;
+    entry->name[0] = '\0';
+}
+
+static int iso9660_vfs_lookup(vfs_mount_t* mnt, const char* path, vfs_node_t* node) {
+    iso9660_entry_t entry;
+    if (iso9660_lookup((iso9660_fs_t*)mnt->priv, path, &entry) != 0) {
+        return VFS_ENOENT;
+    }
+    iso9660_vfs_fill(&entry, node);
+    return 0;
+}
+
+static int iso9660_vfs_read(vfs_file_t* file, void* buffer, uint32_t size) {
+    iso9660_entry_t entry;
+    iso9660_vfs_entry(&file->node, &entry);
+    int n = iso9660_read((iso9660_fs_t*)file->node.mnt->priv, &entry, file->offset, buffer, size);
+    return n < 0 ? VFS_EIO : n;
+}
+
+static int iso9660_vfs_readdir(vfs_file_t* file, vfs_dirent_t* out) {
+    iso9660_entry_t dir, entry;
+    iso9660_vfs_entry(&file->node, &dir);
+
+    int r = iso9660_readdir((iso9660_fs_t*)file->node.mnt->priv, &dir, &file->cursor[0], &entry);
+    if (r <= 0) return r < 0 ? VFS_EIO : 0;
+
+    strncpy(out->name, entry.name, VFS_MAX_NAME - 1);
+    out->name[VFS_MAX_NAME - 1] = '\0';
+    out->type = entry.is_dir ? VFS_TYPE_DIR : VFS_TYPE_FILE;
+    out->size = entry.size;
+    return 1;
+}
+
+const vfs_ops_t iso9660_vfs_ops = {
+    .name = "iso9660",
+    .lookup = iso9660_vfs_lookup,
+    .read = iso9660_vfs_read,
+    .readdir = iso9660_vfs_readdir,
+};
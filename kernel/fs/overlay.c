@@ -0,0 +1,353 @@
+
+
+#include <stdint.h>
+#include <stddef.h>
+#include "include/lib.h"
+#include "include/vfs.h"
+#include "include/tmpfs.h"
+#include "include/overlay.h"
+
+/*
+ * Writable view over a read-only lower layer (the tar initrd) with a tmpfs
+ * upper layer. Node fsdata: [0] layer mask, [1] upper ino, [2] lower ino,
+ * [3] lower fsdata[0]. Anything present in the lower layer keeps the lower
+ * ino, so copying a file up does not change its identity.
+ *
+ * Files are copied up when opened for writing, but only as a tmpfs node
+ * backed by the lower data: pages are duplicated the first time they are
+ * written. Deletions of lower entries leave whiteout nodes in the upper layer.
+ */
+#define OVL_UPPER 0x01
+#define OVL_LOWER 0x02
+#define OVL_LOWER_INO 0x80000000u
+
+typedef struct {
+    vfs_mount_t lower;
+    vfs_mount_t upper;
+    uint8_t used;
+} overlay_t;
+
+static overlay_t overlay;
+
+static void overlay_upper_node(overlay_t* ov, const vfs_node_t* node, vfs_node_t* out) {
+    memset(out, 0, sizeof(*out));
+    out->mnt = &ov->upper;
+    out->ino = node->fsdata[1];
+    out->type = node->type;
+    out->size = node->size;
+}
+
+static void overlay_lower_node(overlay_t* ov, const vfs_node_t* node, vfs_node_t* out) {
+    memset(out, 0, sizeof(*out));
+    out->mnt = &ov->lower;
+    out->ino = node->fsdata[2];
+    out->type = node->type;
+    out->size = node->size;
+    out->fsdata[0] = node->fsdata[3];
+}
+
+static int overlay_join(const char* dir, const char* name, char* out) {
+    int dir_len = strlen(dir);
+    if (dir_len + strlen(name) + 2 > VFS_MAX_PATH) return VFS_EINVAL;
+
+    strcpy(out, dir);
+    if (dir_len) strcat(out, "/");
+    strcat(out, name);
+    return 0;
+}
+
+static const char* overlay_rel(vfs_file_t* file) {
+    int len = file->node.mnt->path_len;
+    const char* rel = file->path + (len == 1 ? 0 : len);
+    while (*rel == '/') rel++;
+    return rel;
+}
+
+static int overlay_lookup(vfs_mount_t* mnt, const char* path, vfs_node_t* node) {
+    overlay_t* ov = (overlay_t*)mnt->priv;
+    vfs_node_t up, low;
+
+    /* ENOTDIR from the upper layer means a whiteout or file hides the path. */
+    int ru = ov->upper.ops->lookup(&ov->upper, path, &up);
+    if (ru == 0 && up.type == TMPFS_TYPE_WHITEOUT) return VFS_ENOENT;
+    if (ru < 0 && ru != VFS_ENOENT) return VFS_ENOENT;
+
+    int rl = ov->lower.ops->lookup(&ov->lower, path, &low);
+    if (ru < 0 && rl < 0) return VFS_ENOENT;
+    if (ru == 0 && rl == 0 && up.type != low.type) rl = VFS_ENOENT;
+
+    memset(node, 0, sizeof(*node));
+    if (ru == 0) {
+        node->type = up.type;
+        node->size = up.size;
+        node->ino = up.ino;
+        node->fsdata[0] |= OVL_UPPER;
+        node->fsdata[1] = up.ino;
+    }
+    if (rl == 0) {
+        if (ru < 0) {
+            node->type = low.type;
+            node->size = low.size;
+        }
+        node->ino = low.ino | OVL_LOWER_INO;
+        node->fsdata[0] |= OVL_LOWER;
+        node->fsdata[2] = low.ino;
+        node->fsdata[3] = low.fsdata[0];
+    }
+    return 0;
+}
+
+/* Makes sure every directory above path exists in the upper layer. */
+static int overlay_copy_up_parents(overlay_t* ov, const char* path) {
+    char dir[VFS_MAX_PATH];
+    vfs_node_t node;
+    int len = 0;
+
+    for (;;) {
+        while (path[len] && path[len] != '/') len++;
+        if (!path[len]) return 0;
+
+        memcpy(dir, path, len);
+        dir[len] = '\0';
+        if (ov->upper.ops->lookup(&ov->upper, dir, &node) != 0) {
+            int r = ov->upper.ops->create(&ov->upper, dir, VFS_TYPE_DIR, &node);
+            if (r < 0) return r;
+        }
+        len++;
+    }
+}
+
+static int overlay_copy_up(overlay_t* ov, const char* path, vfs_node_t* node) {
+    vfs_node_t lower, up;
+    overlay_lower_node(ov, node, &lower);
+
+    const void* data = ov->lower.ops->map(&lower);
+    if (!data && node->size) return VFS_EIO;
+
+    int r = overlay_copy_up_parents(ov, path);
+    if (r < 0) return r;
+    r = ov->upper.ops->create(&ov->upper, path, VFS_TYPE_FILE, &up);
+    if (r < 0) return r;
+    r = tmpfs_set_backing(&ov->upper, up.ino, data, node->size);
+    if (r < 0) return r;
+
+    node->fsdata[0] |= OVL_UPPER;
+    node->fsdata[1] = up.ino;
+    return 0;
+}
+
+/* A directory recreated over a whiteout must not show the old lower entries. */
+static int overlay_hide_lower(overlay_t* ov, const char* path) {
+    vfs_file_t dir;
+    vfs_dirent_t entry;
+    vfs_node_t node;
+    char child[VFS_MAX_PATH];
+
+    memset(&dir, 0, sizeof(dir));
+    if (ov->lower.ops->lookup(&ov->lower, path, &dir.node) != 0 || dir.node.type != VFS_TYPE_DIR) {
+        return 0;
+    }
+    dir.node.mnt = &ov->lower;
+
+    while (ov->lower.ops->readdir(&dir, &entry) > 0) {
+        if (overlay_join(path, entry.name, child) < 0) continue;
+        int r = ov->upper.ops->create(&ov->upper, child, TMPFS_TYPE_WHITEOUT, &node);
+        if (r < 0 && r != VFS_EEXIST) return r;
+    }
+    return 0;
+}
+
+/* cursor[0..1] belong to the layer being listed; cursor[2] is 0 for upper, 1 for lower. */
+static int overlay_next(overlay_t* ov, const vfs_node_t* node, const char* path, uint32_t* cursor, vfs_dirent_t* entry) {
+    vfs_file_t inner;
+    int r = 0;
+
+    inner.cursor[0] = cursor[0];
+    inner.cursor[1] = cursor[1];
+
+    if (cursor[2] == 0) {
+        if (node->fsdata[0] & OVL_UPPER) {
+            overlay_upper_node(ov, node, &inner.node);
+            while ((r = ov->upper.ops->readdir(&inner, entry)) > 0) {
+                if (entry->type == TMPFS_TYPE_WHITEOUT) continue;
+                cursor[0] = inner.cursor[0];
+                cursor[1] = inner.cursor[1];
+                return 1;
+            }
+            if (r < 0) return r;
+        }
+        cursor[2] = 1;
+        inner.cursor[0] = 0;
+        inner.cursor[1] = 0;
+    }
+
+    if (!(node->fsdata[0] & OVL_LOWER)) return 0;
+
+    overlay_lower_node(ov, node, &inner.node);
+    while ((r = ov->lower.ops->readdir(&inner, entry)) > 0) {
+        char child[VFS_MAX_PATH];
+        vfs_node_t up;
+        if (overlay_join(path, entry->name, child) == 0 &&
+            ov->upper.ops->lookup(&ov->upper, child, &up) == 0) {
+            continue;
+        }
+        break;
+    }
+    cursor[0] = inner.cursor[0];
+    cursor[1] = inner.cursor[1];
+    return r;
+}
+
+static int overlay_readdir(vfs_file_t* file, vfs_dirent_t* entry) {
+    return overlay_next((overlay_t*)file->node.mnt->priv, &file->node, overlay_rel(file), file->cursor, entry);
+}
+
+static int overlay_open(vfs_file_t* file) {
+    vfs_mount_t* mnt = file->node.mnt;
+    const char* rel = overlay_rel(file);
+
+    /* The cached node may predate a copy-up, so look the path up again. */
+    int r = overlay_lookup(mnt, rel, &file->node);
+    if (r < 0) return r;
+    file->node.mnt = mnt;
+
+    if ((file->flags & VFS_O_ACCMODE) == VFS_O_RDONLY || file->node.type != VFS_TYPE_FILE) return 0;
+    if (file->node.fsdata[0] & OVL_UPPER) return 0;
+    return overlay_copy_up((overlay_t*)mnt->priv, rel, &file->node);
+}
+
+static int overlay_read(vfs_file_t* file, void* buffer, uint32_t size) {
+    overlay_t* ov = (overlay_t*)file->node.mnt->priv;
+    vfs_file_t inner;
+    inner.offset = file->offset;
+
+    if (file->node.fsdata[0] & OVL_UPPER) {
+        overlay_upper_node(ov, &file->node, &inner.node);
+        return ov->upper.ops->read(&inner, buffer, size);
+    }
+    overlay_lower_node(ov, &file->node, &inner.node);
+    return ov->lower.ops->read(&inner, buffer, size);
+}
+
+static int overlay_write(vfs_file_t* file, const void* buffer, uint32_t size) {
+    overlay_t* ov = (overlay_t*)file->node.mnt->priv;
+    vfs_file_t inner;
+    if (!(file->node.fsdata[0] & OVL_UPPER)) return VFS_EROFS;
+
+    overlay_upper_node(ov, &file->node, &inner.node);
+    inner.offset = file->offset;
+    int n = ov->upper.ops->write(&inner, buffer, size);
+    file->node.size = inner.node.size;
+    return n;
+}
+
+static int overlay_truncate(vfs_file_t* file, uint32_t size) {
+    overlay_t* ov = (overlay_t*)file->node.mnt->priv;
+    vfs_file_t inner;
+    if (!(file->node.fsdata[0] & OVL_UPPER)) return VFS_EROFS;
+
+    overlay_upper_node(ov, &file->node, &inner.node);
+    int r = ov->upper.ops->truncate(&inner, size);
+    file->node.size = inner.node.size;
+    return r;
+}
+
+static int overlay_create(vfs_mount_t* mnt, const char* path, uint8_t type, vfs_node_t* node) {
+    overlay_t* ov = (overlay_t*)mnt->priv;
+    vfs_node_t up;
+    int replaced = 0;
+
+    int r = overlay_copy_up_parents(ov, path);
+    if (r < 0) return r;
+
+    if (ov->upper.ops->lookup(&ov->upper, path, &up) == 0 && up.type == TMPFS_TYPE_WHITEOUT) {
+        ov->upper.ops->unlink(&ov->upper, path);
+        replaced = 1;
+    }
+
+    r = ov->upper.ops->create(&ov->upper, path, type, &up);
+    if (r < 0) return r;
+    if (replaced && type == VFS_TYPE_DIR) {
+        r = overlay_hide_lower(ov, path);
+        if (r < 0) return r;
+    }
+    return overlay_lookup(mnt, path, node);
+}
+
+static int overlay_unlink(vfs_mount_t* mnt, const char* path) {
+    overlay_t* ov = (overlay_t*)mnt->priv;
+    vfs_node_t node, up;
+
+    int r = overlay_lookup(mnt, path, &node);
+    if (r < 0) return r;
+
+    if (node.type == VFS_TYPE_DIR) {
+        vfs_dirent_t entry;
+        uint32_t cursor[3] = {0, 0, 0};
+        if (overlay_next(ov, &node, path, cursor, &entry) > 0) return VFS_ENOTEMPTY;
+
+        /* Only whiteouts can be left in the upper copy of an empty directory. */
+        if (node.fsdata[0] & OVL_UPPER) {
+            vfs_file_t dir;
+            char child[VFS_MAX_PATH];
+            memset(&dir, 0, sizeof(dir));
+            overlay_upper_node(ov, &node, &dir.node);
+            while (ov->upper.ops->readdir(&dir, &entry) > 0) {
+                if (overlay_join(path, entry.name, child) == 0) {
+                    ov->upper.ops->unlink(&ov->upper, child);
+                }
+            }
+        }
+    }
+
+    if (node.fsdata[0] & OVL_UPPER) {
+        r = ov->upper.ops->unlink(&ov->upper, path);
+        if (r < 0) return r;
+    }
+    if (node.fsdata[0] & OVL_LOWER) {
+        r = overlay_copy_up_parents(ov, path);
+        if (r < 0) return r;
+        r = ov->upper.ops->create(&ov->upper, path, TMPFS_TYPE_WHITEOUT, &up);
+        if (r < 0) return r;
+    }
+    return 0;
+}
+
+static const void* overlay_map(vfs_node_t* node) {
+    overlay_t* ov = (overlay_t*)node->mnt->priv;
+    vfs_node_t lower;
+    if (node->fsdata[0] & OVL_UPPER) return NULL;
+    overlay_lower_node(ov, node, &lower);
+    return ov->lower.ops->map(&lower);
+}
+
+const vfs_ops_t overlay_vfs_ops = {
+    .name = "overlay",
+    .lookup = overlay_lookup,
+    .read = overlay_read,
+    .write = overlay_write,
+    .readdir = overlay_readdir,
+    .create = overlay_create,
+    .unlink = overlay_unlink,
+    .truncate = overlay_truncate,
+    .map = overlay_map,
+    .open = overlay_open,
+};
+
+int overlay_mount(const char* path, const vfs_ops_t* lower_ops, void* lower_priv) {
+    if (overlay.used) return VFS_EBUSY;
+    if (!lower_ops || !lower_ops->map || !lower_ops->readdir) return VFS_EINVAL;
+
+    int r = tmpfs_attach(&overlay.upper);
+    if (r < 0) return r;
+
+    memset(&overlay.lower, 0, sizeof(overlay.lower));
+    overlay.lower.ops = lower_ops;
+    overlay.lower.priv = lower_priv;
+    overlay.lower.used = 1;
+
+    r = vfs_mount(path, &overlay_vfs_ops, &overlay);
+    if (r < 0) return r;
+    overlay.used = 1;
+    return 0;
+}
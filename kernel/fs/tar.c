@@ -3,6 +3,10 @@
 #include <stdint.h>
 #include <stddef.h>
 #include "include/lib.h"
+#include "include/tar.h"
+#include "include/vfs.h"
+#define KMALLOC_TAG KM_FS
+#include "include/kmalloc.h"
 
 extern void terminal_writestring(const char* s);
 
@@ -19,6 +23,34 @@ struct tar_header {
     char magic[6];
 } __attribute__((packed));
 
+/*
+ * The index is sized from the archive: one entry per member plus the root,
+ * grown when the archive leaves out parent directories. Paths point into
+ * the member headers, so the archive must outlive the index.
+ */
+typedef struct {
+    const char* path;
+    int len;
+    uint32_t hash;
+    struct tar_header* header;
+    void* data;
+    uint32_t size;
+    uint8_t is_dir;
+    int parent;
+    int first_child;
+    int last_child;
+    int next_sibling;
+    int next_hash;
+} tar_index_entry_t;
+
+static tar_index_entry_t* tar_index = 0;
+static int tar_index_capacity = 0;
+static int* tar_index_buckets = 0;
+static uint32_t tar_index_bucket_mask = 0;
+static int tar_index_count = 0;
+static int tar_index_overflow = 0;
+static void* tar_indexed_archive = 0;
+
 static unsigned int get_size(const char *in) {
     unsigned int size = 0;
     int i = 0;
@@ -31,150 +63,306 @@ static unsigned int get_size(const char *in) {
     return size;
 }
 
-static int tar_path_exists(void* archive, const char* path) {
-    if (!path) {
-        return 0;
-    }
+static unsigned char* tar_next_header(unsigned char* ptr) {
+    struct tar_header* header = (struct tar_header*)ptr;
+    unsigned int size = get_size(header->size);
+    return ptr + ((size + 511) / 512 + 1) * 512;
+}
 
-    const char* norm = path;
-    if (norm[0] == '/') {
-        norm++;
+/* Like tar_normalize(), for a member name that need not be NUL-terminated at 100 characters. */
+static const char* tar_header_path(struct tar_header* header, int* len) {
+    const char* name = header->name;
+    int n = 0;
+    while (n < 100 && name[n]) n++;
+    while (n > 0 && name[0] == '/') {
+        name++;
+        n--;
     }
-
-    char path_buf[256];
-    int path_len = strlen(norm);
-    while (path_len > 0 && norm[path_len - 1] == '/') {
-        path_len--;
+    if (n >= 2 && name[0] == '.' && name[1] == '/') {
+        name += 2;
+        n -= 2;
     }
-    if (path_len >= 255) {
-        path_len = 255;
+    while (n > 0 && name[n - 1] == '/') n--;
+    *len = n;
+    return name;
+}
+
+static int tar_header_is_dir(struct tar_header* header) {
+    int n = 0;
+    while (n < 100 && header->name[n]) n++;
+    return header->typeflag == '5' || header->typeflag == 'D' ||
+           (n > 0 && header->name[n - 1] == '/');
+}
+
+static uint32_t tar_hash(const char* path, int len) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        hash ^= (uint8_t)path[i];
+        hash *= 16777619u;
     }
-    strncpy(path_buf, norm, path_len);
-    path_buf[path_len] = '\0';
+    return hash;
+}
 
-    if (path_buf[0] == '\0') {
-        return 1; 
+/* Strips a leading "/" or "./" and trailing slashes; returns the usable length. */
+static const char* tar_normalize(const char* path, int* len) {
+    if (!path) {
+        *len = 0;
+        return "";
     }
+    while (path[0] == '/') path++;
+    if (path[0] == '.' && path[1] == '/') path += 2;
 
-    unsigned char* ptr = (unsigned char*)archive;
+    int n = strlen(path);
+    while (n > 0 && path[n - 1] == '/') n--;
+    *len = n;
+    return path;
+}
 
-    while (ptr[0] != '\0') {
-        struct tar_header* header = (struct tar_header*)ptr;
+static int tar_index_find(const char* path, int len) {
+    uint32_t hash = tar_hash(path, len);
+    int idx = tar_index_buckets[hash & tar_index_bucket_mask];
 
-        if (strcmp(header->name, path_buf) == 0) {
-            return 1; 
+    while (idx >= 0) {
+        tar_index_entry_t* e = &tar_index[idx];
+        if (e->hash == hash && e->len == len && strncmp(e->path, path, len) == 0) {
+            return idx;
         }
+        idx = e->next_hash;
+    }
+    return -1;
+}
 
-        int name_len = strlen(header->name);
-        if (name_len > 0 && header->name[name_len - 1] == '/' &&
-            name_len - 1 == path_len &&
-            strncmp(header->name, path_buf, path_len) == 0) {
-            return 1;
+static int tar_index_add(const char* path, int len, int is_dir) {
+    int idx = tar_index_find(path, len);
+    if (idx >= 0) {
+        if (is_dir) tar_index[idx].is_dir = 1;
+        return idx;
+    }
+
+    int parent = 0;
+    if (len > 0) {
+        int slash = len - 1;
+        while (slash >= 0 && path[slash] != '/') slash--;
+        parent = slash > 0 ? tar_index_add(path, slash, 1) : 0;
+        if (parent < 0) {
+            return -1;
         }
+    }
 
-        name_len = strlen(header->name);
-        if (name_len < path_len && 
-            strncmp(header->name, path_buf, name_len) == 0 &&
-            path_buf[name_len] == '/') {
-            return 1; 
+    if (tar_index_count == tar_index_capacity) {
+        tar_index_entry_t* grown = krealloc(tar_index, tar_index_capacity * 2 * sizeof(tar_index_entry_t));
+        if (!grown) {
+            tar_index_overflow = 1;
+            return -1;
         }
+        tar_index = grown;
+        tar_index_capacity *= 2;
+    }
 
-        unsigned int size = get_size(header->size);
-        ptr += ((size + 511) / 512 + 1) * 512;
+    idx = tar_index_count++;
+    tar_index_entry_t* e = &tar_index[idx];
+    e->path = path;
+    e->len = len;
+    e->hash = tar_hash(path, len);
+    e->header = NULL;
+    e->data = NULL;
+    e->size = 0;
+    e->is_dir = is_dir ? 1 : 0;
+    e->parent = parent;
+    e->first_child = -1;
+    e->last_child = -1;
+    e->next_sibling = -1;
+
+    int bucket = e->hash & tar_index_bucket_mask;
+    e->next_hash = tar_index_buckets[bucket];
+    tar_index_buckets[bucket] = idx;
+
+    if (idx != 0) {
+        tar_index_entry_t* p = &tar_index[parent];
+        if (p->last_child >= 0) {
+            tar_index[p->last_child].next_sibling = idx;
+        } else {
+            p->first_child = idx;
+        }
+        p->last_child = idx;
     }
-    return 0; 
+    return idx;
 }
 
-static int tar_add_directory(char directories[][256], int* count, const char* name, int len) {
-    if (len <= 0 || *count >= 100) {
+int tar_index_build(void* archive) {
+    kfree(tar_index);
+    kfree(tar_index_buckets);
+    tar_index = 0;
+    tar_index_buckets = 0;
+    tar_index_capacity = 0;
+    tar_index_count = 0;
+    tar_index_overflow = 0;
+    tar_indexed_archive = 0;
+    if (!archive) {
         return 0;
     }
 
-    char temp[256];
-    if (len >= 256) {
-        len = 255;
+    int members = 0;
+    for (unsigned char* ptr = (unsigned char*)archive; ptr[0] != '\0'; ptr = tar_next_header(ptr)) {
+        members++;
     }
-    strncpy(temp, name, len);
-    temp[len] = '\0';
 
-    if (temp[0] == '.' && temp[1] == '/') {
-        int shift = 2;
-        int i = 0;
-        while (temp[shift + i] != '\0') {
-            temp[i] = temp[shift + i];
-            i++;
-        }
-        temp[i] = '\0';
+    uint32_t buckets = 16;
+    while (buckets < (uint32_t)members) buckets <<= 1;
+    tar_index_capacity = members + 1;
+    tar_index = kmalloc(tar_index_capacity * sizeof(tar_index_entry_t));
+    tar_index_buckets = kmalloc(buckets * sizeof(int));
+    if (!tar_index || !tar_index_buckets) {
+        kfree(tar_index);
+        kfree(tar_index_buckets);
+        tar_index = 0;
+        tar_index_buckets = 0;
+        tar_index_capacity = 0;
+        tar_indexed_archive = archive;
+        tar_index_overflow = 1;
+        terminal_writestring("TAR: no memory for the index, falling back to archive scans\n");
+        return 0;
+    }
+    tar_index_bucket_mask = buckets - 1;
+    for (uint32_t i = 0; i < buckets; i++) {
+        tar_index_buckets[i] = -1;
     }
 
-    if (temp[0] == '\0') {
-        return 0;
+    tar_index_add("", 0, 1);
+
+    unsigned char* ptr = (unsigned char*)archive;
+    while (ptr[0] != '\0') {
+        struct tar_header* header = (struct tar_header*)ptr;
+        int len;
+        const char* path = tar_header_path(header, &len);
+        int is_dir = tar_header_is_dir(header);
+
+        /* A path that appears twice is the later member's, as tar extracts it. */
+        if (len > 0) {
+            int idx = tar_index_add(path, len, is_dir);
+            if (idx >= 0) {
+                tar_index[idx].header = header;
+                tar_index[idx].data = ptr + 512;
+                tar_index[idx].size = is_dir ? 0 : get_size(header->size);
+                tar_index[idx].is_dir = is_dir || tar_index[idx].first_child >= 0;
+            }
+        }
+
+        ptr = tar_next_header(ptr);
     }
 
-    int tlen = strlen(temp);
-    while (tlen > 0 && temp[tlen - 1] == '/') {
-        temp[tlen - 1] = '\0';
-        tlen--;
+    tar_indexed_archive = archive;
+    if (tar_index_overflow) {
+        terminal_writestring("TAR: index incomplete, falling back to archive scans\n");
     }
-    if (tlen == 0) {
-        return 0;
+    return tar_index_count;
+}
+
+static int tar_index_usable(void* archive) {
+    return archive && archive == tar_indexed_archive && !tar_index_overflow;
+}
+
+static struct tar_header* tar_scan(void* archive, const char* path, int len) {
+    unsigned char* ptr = (unsigned char*)archive;
+    struct tar_header* found = NULL;
+
+    while (ptr[0] != '\0') {
+        struct tar_header* header = (struct tar_header*)ptr;
+        int name_len;
+        const char* name = tar_header_path(header, &name_len);
+        if (name_len == len && strncmp(name, path, len) == 0) {
+            found = header;
+        }
+        ptr = tar_next_header(ptr);
     }
+    return found;
+}
 
-    for (int i = 0; i < *count; i++) {
-        if (strcmp(directories[i], temp) == 0) {
-            return 0;
+void* tar_find(void* archive, const char* path, int* size) {
+    if (!archive) return NULL;
+
+    int len;
+    const char* norm = tar_normalize(path, &len);
+    if (len == 0) return NULL;
+
+    if (tar_index_usable(archive)) {
+        int idx = tar_index_find(norm, len);
+        if (idx < 0 || tar_index[idx].is_dir || !tar_index[idx].header) {
+            return NULL;
         }
+        if (size) *size = (int)tar_index[idx].size;
+        return tar_index[idx].data;
     }
 
-    strcpy(directories[*count], temp);
-    (*count)++;
-    return 1;
+    struct tar_header* header = tar_scan(archive, norm, len);
+    if (!header || tar_header_is_dir(header)) {
+        return NULL;
+    }
+    if (size) *size = (int)get_size(header->size);
+    return (unsigned char*)header + 512;
 }
 
-static void tar_add_parent_directories(char directories[][256], int* count, const char* name, int len) {
-    if (len <= 0) {
-        return;
+void* tar_lookup(void* archive, const char* filename) {
+    return tar_find(archive, filename, NULL);
+}
+
+int tar_get_file_size(void* archive, const char* filename) {
+    int size = -1;
+    if (!tar_find(archive, filename, &size)) {
+        return -1;
     }
+    return size;
+}
 
-    int limit = len;
-    if (limit >= 256) {
-        limit = 255;
+int tar_check_path_exists(void* archive, const char* path) {
+    int len;
+    const char* norm = tar_normalize(path, &len);
+    if (len == 0) {
+        return 1;
     }
 
-    char temp[256];
-    strncpy(temp, name, limit);
-    temp[limit] = '\0';
+    if (tar_index_usable(archive)) {
+        return tar_index_find(norm, len) >= 0;
+    }
 
-    for (int i = 0; temp[i] != '\0'; i++) {
-        if (temp[i] == '/') {
-            tar_add_directory(directories, count, temp, i);
+    unsigned char* ptr = (unsigned char*)archive;
+    while (ptr && ptr[0] != '\0') {
+        struct tar_header* header = (struct tar_header*)ptr;
+        int name_len;
+        const char* name = tar_header_path(header, &name_len);
+        if (name_len >= len && strncmp(name, norm, len) == 0 &&
+            (name_len == len || name[len] == '/')) {
+            return 1;
         }
+        ptr = tar_next_header(ptr);
     }
-    tar_add_directory(directories, count, temp, strlen(temp));
+    return 0;
 }
 
-static void tar_get_all_directories(void* archive, char directories[][256], int* count) {
-    unsigned char* ptr = (unsigned char*)archive;
-    *count = 0;
-
-    while (ptr[0] != '\0') {
-        struct tar_header* header = (struct tar_header*)ptr;
+int tar_is_directory(void* archive, const char* path) {
+    int len;
+    const char* norm = tar_normalize(path, &len);
+    if (len == 0) {
+        return 1;
+    }
+    if (!archive || archive != tar_indexed_archive) {
+        return 0;
+    }
+    int idx = tar_index_find(norm, len);
+    return idx >= 0 && tar_index[idx].is_dir;
+}
 
-        if (header->name[0] != '\0') {
-            int name_len = strlen(header->name);
-            if (header->typeflag == '5' || header->typeflag == 'D') {
-                tar_add_parent_directories(directories, count, header->name, name_len);
-            } else {
-                char* last_slash = strrchr(header->name, '/');
-                if (last_slash != NULL) {
-                    int dir_len = last_slash - header->name;
-                    tar_add_parent_directories(directories, count, header->name, dir_len);
-                }
-            }
-        }
+void tar_get_directories(void* archive, char directories[][256], int* count) {
+    *count = 0;
+    if (!archive || archive != tar_indexed_archive) {
+        return;
+    }
 
-        unsigned int size = get_size(header->size);
-        ptr += ((size + 511) / 512 + 1) * 512;
+    for (int i = 1; i < tar_index_count && *count < 100; i++) {
+        if (!tar_index[i].is_dir) continue;
+        memcpy(directories[*count], tar_index[i].path, tar_index[i].len);
+        directories[*count][tar_index[i].len] = '\0';
+        (*count)++;
     }
 }
 
@@ -192,164 +380,183 @@ void tar_list_files(void* archive) {
             terminal_writestring("\n");
         }
 
-        unsigned int size = get_size(header->size);
-        ptr += ((size + 511) / 512 + 1) * 512;
+        ptr = tar_next_header(ptr);
     }
 }
 
-static int tar_add_list_entry(char entries[][256], int* count, const char* name) {
-    if (!name || name[0] == '\0' || *count >= 100) {
-        return 0;
+void tar_list_directory(void* archive, const char* dirpath) {
+    if (!archive || archive != tar_indexed_archive) {
+        return;
     }
 
-    for (int i = 0; i < *count; i++) {
-        if (strcmp(entries[i], name) == 0) {
-            return 0;
+    int len;
+    const char* norm = tar_normalize(dirpath ? dirpath : "", &len);
+    int idx = tar_index_find(norm, len);
+
+    if (idx >= 0 && tar_index[idx].is_dir) {
+        int parent_len = len ? len + 1 : 0;
+        char name[101];
+        for (int c = tar_index[idx].first_child; c >= 0; c = tar_index[c].next_sibling) {
+            memcpy(name, tar_index[c].path + parent_len, tar_index[c].len - parent_len);
+            name[tar_index[c].len - parent_len] = '\0';
+            terminal_writestring(name);
+            terminal_writestring(tar_index[c].is_dir ? "/ " : " ");
         }
     }
+    terminal_writestring("\n");
+}
 
-    strncpy(entries[*count], name, 255);
-    entries[*count][255] = '\0';
-    (*count)++;
-    return 1;
+int tar_index_entries(void) {
+    return tar_index_count;
 }
 
-void tar_list_directory(void* archive, const char* dirpath) {
-    unsigned char* ptr = (unsigned char*)archive;
-    if (!ptr) {
-        return;
+/*
+ * Without a usable index the mount works from the archive alone. A
+ * directory node keeps a member name that starts with its path in
+ * fsdata[1] and the path length in fsdata[2]; readdir keeps the offset of
+ * the next member to look at in cursor[0].
+ */
+
+/* The first component of name below dir, or NULL if name is not inside dir. */
+static const char* tar_scan_child(const char* name, int name_len, const char* dir, int dir_len, int* child_len) {
+    if (dir_len > 0) {
+        if (name_len <= dir_len || name[dir_len] != '/' || strncmp(name, dir, dir_len) != 0) {
+            return NULL;
+        }
+        name += dir_len + 1;
+        name_len -= dir_len + 1;
     }
+    if (name_len == 0) return NULL;
 
-    const char* norm = dirpath ? dirpath : "";
-    if (norm[0] == '/') {
-        norm++;
-    }
+    int n = 0;
+    while (n < name_len && name[n] != '/') n++;
+    *child_len = n;
+    return name;
+}
 
-    char base[256];
-    int base_len = strlen(norm);
-    while (base_len > 0 && norm[base_len - 1] == '/') {
-        base_len--;
+static int tar_scan_lookup(void* archive, const char* path, int len, vfs_node_t* node) {
+    if (len == 0) {
+        node->type = VFS_TYPE_DIR;
+        return 0;
     }
-    if (base_len >= 255) {
-        base_len = 255;
+
+    int size = 0;
+    void* data = tar_find(archive, path, &size);
+    if (data) {
+        node->type = VFS_TYPE_FILE;
+        node->size = (uint32_t)size;
+        node->ino = (uint32_t)data;
+        node->fsdata[0] = (uint32_t)data;
+        return 0;
     }
-    strncpy(base, norm, base_len);
-    base[base_len] = '\0';
 
-    char prefix[256];
-    prefix[0] = '\0';
-    if (base[0] != '\0') {
-        strcpy(prefix, base);
-        if (prefix[strlen(prefix) - 1] != '/') {
-            strcat(prefix, "/");
+    for (unsigned char* ptr = (unsigned char*)archive; ptr[0] != '\0'; ptr = tar_next_header(ptr)) {
+        int name_len;
+        const char* name = tar_header_path((struct tar_header*)ptr, &name_len);
+        if (name_len >= len && strncmp(name, path, len) == 0 &&
+            (name_len == len || name[len] == '/')) {
+            node->type = VFS_TYPE_DIR;
+            node->ino = (uint32_t)name;
+            node->fsdata[1] = (uint32_t)name;
+            node->fsdata[2] = (uint32_t)len;
+            return 0;
         }
     }
-    int prefix_len = strlen(prefix);
+    return VFS_ENOENT;
+}
 
-    char entries[100][256];
-    int entry_count = 0;
+/* Each child is reported at the last member that mentions it, so a repeated file shows its final size. */
+static int tar_scan_readdir(vfs_file_t* file, vfs_dirent_t* entry) {
+    unsigned char* archive = (unsigned char*)file->node.mnt->priv;
+    const char* dir = (const char*)file->node.fsdata[1];
+    int dir_len = (int)file->node.fsdata[2];
+    unsigned char* ptr = archive + file->cursor[0];
 
     while (ptr[0] != '\0') {
         struct tar_header* header = (struct tar_header*)ptr;
-
-        if (header->name[0] != '\0') {
-            const char* name = header->name;
-            int name_len = strlen(name);
-            int name_is_dir = (header->typeflag == '5' || header->typeflag == 'D' ||
-                               (name_len > 0 && name[name_len - 1] == '/'));
-
-            if (prefix_len == 0) {
-                const char* slash = strchr(name, '/');
-                int comp_len = slash ? (int)(slash - name) : name_len;
-                if (comp_len > 0) {
-                    char entry[256];
-                    if (comp_len >= 255) comp_len = 255;
-                    strncpy(entry, name, comp_len);
-                    entry[comp_len] = '\0';
-
-                    int is_dir = (slash != NULL) || name_is_dir;
-                    if (is_dir && strlen(entry) < 255) {
-                        strcat(entry, "/");
-                    }
-                    tar_add_list_entry(entries, &entry_count, entry);
-                }
-            } else if (strncmp(name, prefix, prefix_len) == 0) {
-                const char* rest = name + prefix_len;
-                if (rest[0] != '\0') {
-                    const char* slash = strchr(rest, '/');
-                    int comp_len = slash ? (int)(slash - rest) : (int)strlen(rest);
-                    if (comp_len > 0) {
-                        char entry[256];
-                        if (comp_len >= 255) comp_len = 255;
-                        strncpy(entry, rest, comp_len);
-                        entry[comp_len] = '\0';
-
-                        int is_dir = (slash != NULL) || name_is_dir;
-                        if (is_dir && strlen(entry) < 255) {
-                            strcat(entry, "/");
-                        }
-                        tar_add_list_entry(entries, &entry_count, entry);
-                    }
-                }
-            }
+        unsigned char* next = tar_next_header(ptr);
+        int name_len, child_len;
+        const char* name = tar_header_path(header, &name_len);
+        const char* child = tar_scan_child(name, name_len, dir, dir_len, &child_len);
+        ptr = next;
+        if (!child) continue;
+
+        int later = 0;
+        for (unsigned char* p = next; p[0] != '\0' && !later; p = tar_next_header(p)) {
+            int other_len, other_child_len;
+            const char* other = tar_header_path((struct tar_header*)p, &other_len);
+            const char* other_child = tar_scan_child(other, other_len, dir, dir_len, &other_child_len);
+            later = other_child && other_child_len == child_len && strncmp(other_child, child, child_len) == 0;
         }
-
-        unsigned int size = get_size(header->size);
-        ptr += ((size + 511) / 512 + 1) * 512;
+        if (later) continue;
+
+        int is_dir = child + child_len < name + name_len || tar_header_is_dir(header);
+        int n = child_len < VFS_MAX_NAME - 1 ? child_len : VFS_MAX_NAME - 1;
+        memcpy(entry->name, child, n);
+        entry->name[n] = '\0';
+        entry->type = is_dir ? VFS_TYPE_DIR : VFS_TYPE_FILE;
+        entry->size = is_dir ? 0 : get_size(header->size);
+        file->cursor[0] = (uint32_t)(ptr - archive);
+        return 1;
     }
+    file->cursor[0] = (uint32_t)(ptr - archive);
+    return 0;
+}
+
+static int tar_vfs_lookup(vfs_mount_t* mnt, const char* path, vfs_node_t* node) {
+    int len;
+    const char* norm = tar_normalize(path, &len);
 
-    for (int i = 0; i < entry_count; i++) {
-        terminal_writestring(entries[i]);
-        terminal_writestring(" ");
+    memset(node, 0, sizeof(*node));
+    if (!tar_index_usable(mnt->priv)) {
+        return tar_scan_lookup(mnt->priv, norm, len, node);
     }
-    terminal_writestring("\n");
-}
 
-int tar_check_path_exists(void* archive, const char* path) {
-    return tar_path_exists(archive, path);
-}
+    int idx = tar_index_find(norm, len);
+    if (idx < 0) return VFS_ENOENT;
 
-void tar_get_directories(void* archive, char directories[][256], int* count) {
-    tar_get_all_directories(archive, directories, count);
+    node->ino = (uint32_t)idx;
+    node->type = tar_index[idx].is_dir ? VFS_TYPE_DIR : VFS_TYPE_FILE;
+    node->size = tar_index[idx].size;
+    node->fsdata[0] = (uint32_t)tar_index[idx].data;
+    return 0;
 }
 
-void* tar_lookup(void* archive, const char* filename) {
-    unsigned char* ptr = (unsigned char*)archive;
+static int tar_vfs_read(vfs_file_t* file, void* buffer, uint32_t size) {
+    const uint8_t* data = (const uint8_t*)file->node.fsdata[0];
+    if (!data) return VFS_EIO;
+    memcpy(buffer, data + file->offset, size);
+    return (int)size;
+}
 
-    while (ptr[0] != '\0') {
-        struct tar_header* header = (struct tar_header*)ptr;
-        int match = 1;
-        int i;
-        for (i = 0; filename[i] != '\0'; i++) {
-            if (header->name[i] != filename[i]) {
-                match = 0;
-                break;
-            }
-        }
-        if (match) {
-            if (header->name[i] == '\0' || header->name[i] == ' ') {
-                return (void*)(ptr + 512);
-            }
-        }
+static int tar_vfs_readdir(vfs_file_t* file, vfs_dirent_t* entry) {
+    if (!tar_index_usable(file->node.mnt->priv)) return tar_scan_readdir(file, entry);
 
-        unsigned int size = get_size(header->size);
-        ptr += ((size + 511) / 512 + 1) * 512;
-    }
-    return NULL;
-}
+    int idx = (int)file->node.ino;
+    int c = file->cursor[1] ? (int)file->cursor[0] : tar_index[idx].first_child;
+    if (c < 0) return 0;
 
-int tar_get_file_size(void* archive, const char* filename) {
-    unsigned char* ptr = (unsigned char*)archive;
+    int parent_len = idx ? tar_index[idx].len + 1 : 0;
+    int name_len = tar_index[c].len - parent_len;
+    if (name_len > VFS_MAX_NAME - 1) name_len = VFS_MAX_NAME - 1;
+    memcpy(entry->name, tar_index[c].path + parent_len, name_len);
+    entry->name[name_len] = '\0';
+    entry->type = tar_index[c].is_dir ? VFS_TYPE_DIR : VFS_TYPE_FILE;
+    entry->size = tar_index[c].size;
 
-    while (ptr[0] != '\0') {
-        struct tar_header* header = (struct tar_header*)ptr;
-        if (strcmp(header->name, filename) == 0) {
-            return (int)get_size(header->size);
-        }
+    file->cursor[0] = (uint32_t)tar_index[c].next_sibling;
+    file->cursor[1] = 1;
+    return 1;
+}
 
-        unsigned int size = get_size(header->size);
-        ptr += ((size + 511) / 512 + 1) * 512;
-    }
+static const void* tar_vfs_map(vfs_node_t* node) {
+    return (const void*)node->fsdata[0];
+}
 
-    return -1;
-}
\ No newline at end of file
+const vfs_ops_t tar_vfs_ops = {
+    .name = "tar",
+    .lookup = tar_vfs_lookup,
+    .read = tar_vfs_read,
+    .readdir = tar_vfs_readdir,
+    .map = tar_vfs_map,
+};
@@ -0,0 +1,403 @@
+
+
+#include <stdint.h>
+#include <stddef.h>
+#include "include/lib.h"
+#include "include/vfs.h"
+#include "include/tmpfs.h"
+#include "include/pmm.h"
+#define KMALLOC_TAG KM_FS
+#include "include/kmalloc.h"
+
+/*
+ * Node 0 is never handed out so that 0 can mean "none" in the link fields.
+ * Directory entries live in one hash table keyed by (parent, name); each
+ * directory also keeps a doubly linked child list for readdir.
+ * A file may have a read-only backing buffer: pages that were never written
+ * read from it, and are filled from it when first written.
+ */
+typedef struct {
+    char name[TMPFS_MAX_NAME];
+    uint16_t parent;
+    uint16_t hash_next;
+    uint16_t first_child;
+    uint16_t next_sibling;
+    uint16_t prev_sibling;
+    uint8_t type;
+    uint8_t used;
+    uint32_t size;
+    uint8_t* direct[TMPFS_DIRECT_PAGES];
+    uint8_t** indirect;
+    const uint8_t* backing;
+    uint32_t backing_size;
+} tmpfs_node_t;
+
+typedef struct {
+    uint16_t root;
+    uint8_t used;
+} tmpfs_t;
+
+/* Nodes come from the heap a slab at a time and are never returned; freed ones go on free_nodes. */
+static tmpfs_node_t* slabs[TMPFS_MAX_NODES / TMPFS_SLAB_NODES];
+static uint16_t hash_table[TMPFS_HASH_SIZE];
+static uint16_t free_nodes;
+static uint32_t node_watermark = 1;
+static tmpfs_t instances[TMPFS_MAX_INSTANCES];
+
+static uint32_t pages_used;
+
+static uint8_t* tmpfs_page_alloc(void) {
+    uint8_t* page = (uint8_t*)frame_alloc();
+    if (!page) return NULL;
+    memset(page, 0, TMPFS_PAGE_SIZE);
+    pages_used++;
+    return page;
+}
+
+static void tmpfs_page_free(uint8_t* page) {
+    frame_free((uint32_t)page);
+    pages_used--;
+}
+
+uint32_t tmpfs_pages_used(void) {
+    return pages_used;
+}
+
+static inline tmpfs_node_t* tmpfs_node(uint16_t idx) {
+    return &slabs[idx / TMPFS_SLAB_NODES][idx % TMPFS_SLAB_NODES];
+}
+
+static uint16_t tmpfs_node_alloc(void) {
+    uint16_t idx;
+    if (free_nodes) {
+        idx = free_nodes;
+        free_nodes = tmpfs_node(idx)->hash_next;
+    } else if (node_watermark < TMPFS_MAX_NODES) {
+        tmpfs_node_t** slab = &slabs[node_watermark / TMPFS_SLAB_NODES];
+        if (!*slab) {
+            *slab = kmalloc(TMPFS_SLAB_NODES * sizeof(tmpfs_node_t));
+            if (!*slab) return 0;
+        }
+        idx = (uint16_t)node_watermark++;
+    } else {
+        return 0;
+    }
+    memset(tmpfs_node(idx), 0, sizeof(tmpfs_node_t));
+    tmpfs_node(idx)->used = 1;
+    return idx;
+}
+
+static void tmpfs_node_free(uint16_t idx) {
+    tmpfs_node(idx)->used = 0;
+    tmpfs_node(idx)->hash_next = free_nodes;
+    free_nodes = idx;
+}
+
+static uint32_t tmpfs_hash(uint16_t parent, const char* name, int len) {
+    uint32_t h = 2166136261u ^ parent;
+    h *= 16777619u;
+    for (int i = 0; i < len; i++) {
+        h ^= (uint8_t)name[i];
+        h *= 16777619u;
+    }
+    return h & (TMPFS_HASH_SIZE - 1);
+}
+
+static uint16_t tmpfs_find_child(uint16_t parent, const char* name, int len) {
+    uint16_t idx = hash_table[tmpfs_hash(parent, name, len)];
+    while (idx) {
+        tmpfs_node_t* n = tmpfs_node(idx);
+        if (n->parent == parent && strncmp(n->name, name, len) == 0 && n->name[len] == '\0') {
+            return idx;
+        }
+        idx = n->hash_next;
+    }
+    return 0;
+}
+
+static void tmpfs_link(uint16_t parent, uint16_t idx) {
+    tmpfs_node_t* n = tmpfs_node(idx);
+    uint32_t bucket = tmpfs_hash(parent, n->name, strlen(n->name));
+
+    n->parent = parent;
+    n->hash_next = hash_table[bucket];
+    hash_table[bucket] = idx;
+
+    n->prev_sibling = 0;
+    n->next_sibling = tmpfs_node(parent)->first_child;
+    if (n->next_sibling) tmpfs_node(n->next_sibling)->prev_sibling = idx;
+    tmpfs_node(parent)->first_child = idx;
+}
+
+static void tmpfs_unlink_node(uint16_t idx) {
+    tmpfs_node_t* n = tmpfs_node(idx);
+    uint16_t* link = &hash_table[tmpfs_hash(n->parent, n->name, strlen(n->name))];
+    while (*link && *link != idx) link = &tmpfs_node(*link)->hash_next;
+    if (*link) *link = n->hash_next;
+
+    if (n->prev_sibling) tmpfs_node(n->prev_sibling)->next_sibling = n->next_sibling;
+    else tmpfs_node(n->parent)->first_child = n->next_sibling;
+    if (n->next_sibling) tmpfs_node(n->next_sibling)->prev_sibling = n->prev_sibling;
+}
+
+/* Returns the page holding byte offset index * TMPFS_PAGE_SIZE, or NULL for a hole. */
+static uint8_t* tmpfs_page(tmpfs_node_t* n, uint32_t index, int allocate) {
+    uint32_t offset = index * TMPFS_PAGE_SIZE;
+    uint8_t** slot;
+    if (index < TMPFS_DIRECT_PAGES) {
+        slot = &n->direct[index];
+    } else {
+        index -= TMPFS_DIRECT_PAGES;
+        if (index >= TMPFS_INDIRECT_PAGES) return NULL;
+        if (!n->indirect) {
+            if (!allocate) return NULL;
+            n->indirect = (uint8_t**)tmpfs_page_alloc();
+            if (!n->indirect) return NULL;
+        }
+        slot = &n->indirect[index];
+    }
+    if (!*slot && allocate) {
+        *slot = tmpfs_page_alloc();
+        if (*slot && n->backing && offset < n->backing_size) {
+            uint32_t len = n->backing_size - offset;
+            memcpy(*slot, n->backing + offset, len < TMPFS_PAGE_SIZE ? len : TMPFS_PAGE_SIZE);
+        }
+    }
+    return *slot;
+}
+
+/* Drops every page at or beyond index first. */
+static void tmpfs_free_pages(tmpfs_node_t* n, uint32_t first) {
+    for (uint32_t i = first; i < TMPFS_DIRECT_PAGES; i++) {
+        if (n->direct[i]) {
+            tmpfs_page_free(n->direct[i]);
+            n->direct[i] = NULL;
+        }
+    }
+    if (!n->indirect) return;
+
+    uint32_t start = first > TMPFS_DIRECT_PAGES ? first - TMPFS_DIRECT_PAGES : 0;
+    for (uint32_t i = start; i < TMPFS_INDIRECT_PAGES; i++) {
+        if (n->indirect[i]) {
+            tmpfs_page_free(n->indirect[i]);
+            n->indirect[i] = NULL;
+        }
+    }
+    if (start == 0) {
+        tmpfs_page_free((uint8_t*)n->indirect);
+        n->indirect = NULL;
+    }
+}
+
+/* Walks path from the root; on return *last points at the final component. */
+static int tmpfs_walk(tmpfs_t* fs, const char* path, int stop_before_last, const char** last) {
+    uint16_t cur = fs->root;
+    const char* p = path;
+
+    while (*p) {
+        int len = 0;
+        while (p[len] && p[len] != '/') len++;
+        if (stop_before_last && p[len] == '\0') break;
+
+        if (tmpfs_node(cur)->type != VFS_TYPE_DIR) return VFS_ENOTDIR;
+        cur = tmpfs_find_child(cur, p, len);
+        if (!cur) return VFS_ENOENT;
+
+        p += len;
+        while (*p == '/') p++;
+    }
+    if (last) *last = p;
+    return cur;
+}
+
+static void tmpfs_fill_node(uint16_t idx, vfs_node_t* node) {
+    memset(node, 0, sizeof(*node));
+    node->ino = idx;
+    node->type = tmpfs_node(idx)->type;
+    node->size = tmpfs_node(idx)->size;
+}
+
+static int tmpfs_lookup(vfs_mount_t* mnt, const char* path, vfs_node_t* node) {
+    int idx = tmpfs_walk((tmpfs_t*)mnt->priv, path, 0, NULL);
+    if (idx < 0) return idx;
+    tmpfs_fill_node((uint16_t)idx, node);
+    return 0;
+}
+
+static int tmpfs_create(vfs_mount_t* mnt, const char* path, uint8_t type, vfs_node_t* node) {
+    const char* name;
+    int parent = tmpfs_walk((tmpfs_t*)mnt->priv, path, 1, &name);
+    if (parent < 0) return parent;
+    if (tmpfs_node(parent)->type != VFS_TYPE_DIR) return VFS_ENOTDIR;
+
+    int len = strlen(name);
+    if (len == 0 || len >= TMPFS_MAX_NAME) return VFS_EINVAL;
+    if (tmpfs_find_child((uint16_t)parent, name, len)) return VFS_EEXIST;
+
+    uint16_t idx = tmpfs_node_alloc();
+    if (!idx) return VFS_ENOSPC;
+
+    strcpy(tmpfs_node(idx)->name, name);
+    tmpfs_node(idx)->type = type;
+    tmpfs_link((uint16_t)parent, idx);
+    tmpfs_fill_node(idx, node);
+    return 0;
+}
+
+static int tmpfs_unlink(vfs_mount_t* mnt, const char* path) {
+    int idx = tmpfs_walk((tmpfs_t*)mnt->priv, path, 0, NULL);
+    if (idx < 0) return idx;
+
+    tmpfs_node_t* n = tmpfs_node(idx);
+    if (n->first_child) return VFS_ENOTEMPTY;
+
+    tmpfs_unlink_node((uint16_t)idx);
+    tmpfs_free_pages(n, 0);
+    tmpfs_node_free((uint16_t)idx);
+    return 0;
+}
+
+static int tmpfs_read(vfs_file_t* file, void* buffer, uint32_t size) {
+    tmpfs_node_t* n = tmpfs_node(file->node.ino);
+    uint8_t* dst = (uint8_t*)buffer;
+    uint32_t pos = file->offset;
+    uint32_t done = 0;
+
+    while (done < size) {
+        uint32_t off = pos % TMPFS_PAGE_SIZE;
+        uint32_t chunk = TMPFS_PAGE_SIZE - off;
+        if (chunk > size - done) chunk = size - done;
+
+        uint8_t* page = tmpfs_page(n, pos / TMPFS_PAGE_SIZE, 0);
+        if (page) {
+            memcpy(dst + done, page + off, chunk);
+        } else if (pos < n->backing_size) {
+            uint32_t len = n->backing_size - pos;
+            if (len > chunk) len = chunk;
+            memcpy(dst + done, n->backing + pos, len);
+            memset(dst + done + len, 0, chunk - len);
+        } else {
+            memset(dst + done, 0, chunk);
+        }
+
+        done += chunk;
+        pos += chunk;
+    }
+    return (int)done;
+}
+
+static int tmpfs_write(vfs_file_t* file, const void* buffer, uint32_t size) {
+    tmpfs_node_t* n = tmpfs_node(file->node.ino);
+    const uint8_t* src = (const uint8_t*)buffer;
+    uint32_t pos = file->offset;
+    uint32_t done = 0;
+
+    if (pos >= TMPFS_MAX_FILE_SIZE) return VFS_ENOSPC;
+    if (size > TMPFS_MAX_FILE_SIZE - pos) size = TMPFS_MAX_FILE_SIZE - pos;
+
+    while (done < size) {
+        uint32_t off = pos % TMPFS_PAGE_SIZE;
+        uint32_t chunk = TMPFS_PAGE_SIZE - off;
+        if (chunk > size - done) chunk = size - done;
+
+        uint8_t* page = tmpfs_page(n, pos / TMPFS_PAGE_SIZE, 1);
+        if (!page) break;
+        memcpy(page + off, src + done, chunk);
+
+        done += chunk;
+        pos += chunk;
+    }
+
+    if (pos > n->size) n->size = pos;
+    file->node.size = n->size;
+    return done ? (int)done : VFS_ENOSPC;
+}
+
+static int tmpfs_truncate(vfs_file_t* file, uint32_t size) {
+    tmpfs_node_t* n = tmpfs_node(file->node.ino);
+    if (size > TMPFS_MAX_FILE_SIZE) return VFS_EINVAL;
+
+    if (size < n->size) {
+        tmpfs_free_pages(n, (size + TMPFS_PAGE_SIZE - 1) / TMPFS_PAGE_SIZE);
+        uint32_t tail = size % TMPFS_PAGE_SIZE;
+        uint8_t* page = tail ? tmpfs_page(n, size / TMPFS_PAGE_SIZE, 0) : NULL;
+        if (page) memset(page + tail, 0, TMPFS_PAGE_SIZE - tail);
+    }
+    if (size < n->backing_size) n->backing_size = size;
+    n->size = size;
+    file->node.size = size;
+    return 0;
+}
+
+static int tmpfs_readdir(vfs_file_t* file, vfs_dirent_t* entry) {
+    uint16_t idx = file->cursor[1] ? (uint16_t)file->cursor[0] : tmpfs_node(file->node.ino)->first_child;
+    file->cursor[1] = 1;
+    if (!idx) return 0;
+
+    tmpfs_node_t* n = tmpfs_node(idx);
+    strcpy(entry->name, n->name);
+    entry->type = n->type;
+    entry->size = n->size;
+    file->cursor[0] = n->next_sibling;
+    return 1;
+}
+
+const vfs_ops_t tmpfs_ops = {
+    .name = "tmpfs",
+    .lookup = tmpfs_lookup,
+    .read = tmpfs_read,
+    .write = tmpfs_write,
+    .readdir = tmpfs_readdir,
+    .create = tmpfs_create,
+    .unlink = tmpfs_unlink,
+    .truncate = tmpfs_truncate,
+};
+
+static tmpfs_t* tmpfs_instance(void) {
+    for (int i = 0; i < TMPFS_MAX_INSTANCES; i++) {
+        tmpfs_t* fs = &instances[i];
+        if (fs->used) continue;
+
+        if (!fs->root) {
+            fs->root = tmpfs_node_alloc();
+            if (!fs->root) return NULL;
+            tmpfs_node(fs->root)->type = VFS_TYPE_DIR;
+        }
+        return fs;
+    }
+    return NULL;
+}
+
+int tmpfs_mount(const char* path) {
+    tmpfs_t* fs = tmpfs_instance();
+    if (!fs) return VFS_ENOSPC;
+
+    int r = vfs_mount(path, &tmpfs_ops, fs);
+    if (r < 0) return r;
+    fs->used = 1;
+    return 0;
+}
+
+int tmpfs_attach(vfs_mount_t* mnt) {
+    tmpfs_t* fs = tmpfs_instance();
+    if (!fs) return VFS_ENOSPC;
+
+    memset(mnt, 0, sizeof(*mnt));
+    mnt->ops = &tmpfs_ops;
+    mnt->priv = fs;
+    mnt->used = 1;
+    fs->used = 1;
+    return 0;
+}
+
+int tmpfs_set_backing(vfs_mount_t* mnt, uint32_t ino, const void* data, uint32_t size) {
+    if (mnt->ops != &tmpfs_ops || ino == 0 || ino >= node_watermark) return VFS_EINVAL;
+
+    tmpfs_node_t* n = tmpfs_node(ino);
+    if (!n->used || n->type != VFS_TYPE_FILE || n->size != 0) return VFS_EINVAL;
+
+    n->backing = (const uint8_t*)data;
+    n->backing_size = data ? size : 0;
+    n->size = size;
+    return 0;
+}
@@ -0,0 +1,670 @@
+
+
+#include <stdint.h>
+#include <stddef.h>
+#include "include/lib.h"
+#include "include/vfs.h"
+#include "include/paging.h"
+#include "include/pmm.h"
+
+extern char current_dir[256];
+
+typedef struct {
+    char path[VFS_MAX_PATH];
+    uint32_t hash;
+    vfs_node_t node;
+    uint8_t valid;
+} vfs_cache_entry_t;
+
+static vfs_mount_t vfs_mounts[VFS_MAX_MOUNTS];
+static vfs_file_t vfs_files[VFS_MAX_FDS];
+static vfs_cache_entry_t vfs_cache[VFS_CACHE_SIZE];
+
+#define VFS_MAP_SLOT_SIZE (MMAP_SIZE / VFS_MAX_MAPS)
+
+typedef struct {
+    vfs_file_t file;
+    uint32_t base;
+    uint32_t offset;
+    uint32_t length;
+    uint32_t pages;
+    uint8_t direct;
+    uint8_t used;
+} vfs_mapping_t;
+
+static vfs_mapping_t vfs_maps[VFS_MAX_MAPS];
+static uint32_t vfs_resident[VFS_MAP_RESIDENT];
+static uint32_t vfs_resident_head;
+static uint32_t vfs_resident_count;
+
+static uint32_t vfs_hash(const char* path) {
+    uint32_t hash = 2166136261u;
+    while (*path) {
+        hash ^= (uint8_t)*path++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void vfs_init(void) {
+    memset(vfs_mounts, 0, sizeof(vfs_mounts));
+    memset(vfs_files, 0, sizeof(vfs_files));
+    memset(vfs_cache, 0, sizeof(vfs_cache));
+}
+
+/* Makes path absolute against current_dir and folds ".", ".." and repeated slashes. */
+int vfs_resolve(const char* path, char* out) {
+    if (!path || !out) return VFS_EINVAL;
+
+    char joined[VFS_MAX_PATH * 2];
+    if (path[0] == '/') {
+        if (strlen(path) >= (int)sizeof(joined)) return VFS_EINVAL;
+        strcpy(joined, path);
+    } else {
+        if (strlen(current_dir) + strlen(path) + 2 > (int)sizeof(joined)) return VFS_EINVAL;
+        strcpy(joined, current_dir);
+        strcat(joined, "/");
+        strcat(joined, path);
+    }
+
+    int len = 0;
+    const char* p = joined;
+    out[0] = '/';
+    out[1] = '\0';
+
+    while (*p) {
+        while (*p == '/') p++;
+        if (!*p) break;
+
+        const char* comp = p;
+        int comp_len = 0;
+        while (p[comp_len] && p[comp_len] != '/') comp_len++;
+        p += comp_len;
+
+        if (comp_len == 1 && comp[0] == '.') {
+            continue;
+        }
+        if (comp_len == 2 && comp[0] == '.' && comp[1] == '.') {
+            while (len > 0 && out[len] != '/') len--;
+            out[len > 0 ? len : 1] = '\0';
+            if (len == 0) out[0] = '/';
+            continue;
+        }
+
+        if (len + 1 + comp_len >= VFS_MAX_PATH) return VFS_EINVAL;
+        out[len++] = '/';
+        memcpy(out + len, comp, comp_len);
+        len += comp_len;
+        out[len] = '\0';
+    }
+    return 0;
+}
+
+static vfs_mount_t* vfs_find_mount(const char* abs, const char** rel) {
+    vfs_mount_t* best = NULL;
+
+    for (int i = 0; i < VFS_MAX_MOUNTS; i++) {
+        vfs_mount_t* m = &vfs_mounts[i];
+        if (!m->used) continue;
+        if (best && m->path_len <= best->path_len) continue;
+
+        if (m->path_len == 1) {
+            best = m;
+        } else if (strncmp(abs, m->path, m->path_len) == 0 &&
+                   (abs[m->path_len] == '\0' || abs[m->path_len] == '/')) {
+            best = m;
+        }
+    }
+
+    if (best && rel) {
+        const char* r = abs + (best->path_len == 1 ? 0 : best->path_len);
+        while (*r == '/') r++;
+        *rel = r;
+    }
+    return best;
+}
+
+static void vfs_cache_insert(const char* abs, uint32_t hash, const vfs_node_t* node) {
+    vfs_cache_entry_t* e = &vfs_cache[hash & (VFS_CACHE_SIZE - 1)];
+    strcpy(e->path, abs);
+    e->hash = hash;
+    e->node = *node;
+    e->valid = 1;
+}
+
+static void vfs_cache_invalidate(const char* abs) {
+    vfs_cache_entry_t* e = &vfs_cache[vfs_hash(abs) & (VFS_CACHE_SIZE - 1)];
+    if (e->valid && strcmp(e->path, abs) == 0) {
+        e->valid = 0;
+    }
+}
+
+static void vfs_cache_flush(void) {
+    for (int i = 0; i < VFS_CACHE_SIZE; i++) {
+        vfs_cache[i].valid = 0;
+    }
+}
+
+void vfs_cache_update(const vfs_node_t* node) {
+    for (int i = 0; i < VFS_CACHE_SIZE; i++) {
+        vfs_node_t* n = &vfs_cache[i].node;
+        if (vfs_cache[i].valid && n->mnt == node->mnt && n->ino == node->ino) {
+            *n = *node;
+        }
+    }
+    for (int i = 0; i < VFS_MAX_FDS; i++) {
+        vfs_node_t* n = &vfs_files[i].node;
+        if (vfs_files[i].used && n->mnt == node->mnt && n->ino == node->ino) {
+            *n = *node;
+        }
+    }
+}
+
+static int vfs_lookup_abs(const char* abs, vfs_node_t* node) {
+    uint32_t hash = vfs_hash(abs);
+    vfs_cache_entry_t* e = &vfs_cache[hash & (VFS_CACHE_SIZE - 1)];
+    if (e->valid && e->hash == hash && strcmp(e->path, abs) == 0) {
+        *node = e->node;
+        return 0;
+    }
+
+    const char* rel;
+    vfs_mount_t* mnt = vfs_find_mount(abs, &rel);
+    if (!mnt) return VFS_ENOENT;
+
+    int r = mnt->ops->lookup(mnt, rel, node);
+    if (r < 0) return r;
+    node->mnt = mnt;
+
+    vfs_cache_insert(abs, hash, node);
+    return 0;
+}
+
+int vfs_lookup(const char* path, vfs_node_t* node) {
+    char abs[VFS_MAX_PATH];
+    int r = vfs_resolve(path, abs);
+    if (r < 0) return r;
+    return vfs_lookup_abs(abs, node);
+}
+
+int vfs_mount(const char* path, const vfs_ops_t* ops, void* priv) {
+    char abs[VFS_MAX_PATH];
+    if (!ops || !ops->lookup || vfs_resolve(path, abs) < 0) return VFS_EINVAL;
+    if (strlen(abs) >= (int)sizeof(vfs_mounts[0].path)) return VFS_EINVAL;
+
+    vfs_mount_t* slot = NULL;
+    for (int i = 0; i < VFS_MAX_MOUNTS; i++) {
+        if (vfs_mounts[i].used && strcmp(vfs_mounts[i].path, abs) == 0) {
+            return VFS_EBUSY;
+        }
+        if (!vfs_mounts[i].used && !slot) {
+            slot = &vfs_mounts[i];
+        }
+    }
+    if (!slot) return VFS_ENOSPC;
+
+    strcpy(slot->path, abs);
+    slot->path_len = strlen(abs);
+    slot->ops = ops;
+    slot->priv = priv;
+    slot->used = 1;
+
+    vfs_cache_flush();
+    return 0;
+}
+
+int vfs_umount(const char* path) {
+    char abs[VFS_MAX_PATH];
+    if (vfs_resolve(path, abs) < 0) return VFS_EINVAL;
+
+    for (int i = 0; i < VFS_MAX_MOUNTS; i++) {
+        vfs_mount_t* m = &vfs_mounts[i];
+        if (!m->used || strcmp(m->path, abs) != 0) continue;
+
+        for (int fd = 0; fd < VFS_MAX_FDS; fd++) {
+            if (vfs_files[fd].used && vfs_files[fd].node.mnt == m) {
+                return VFS_EBUSY;
+            }
+        }
+        m->used = 0;
+        vfs_cache_flush();
+        return 0;
+    }
+    return VFS_ENOENT;
+}
+
+vfs_mount_t* vfs_get_mount(int index) {
+    if (index < 0 || index >= VFS_MAX_MOUNTS || !vfs_mounts[index].used) {
+        return NULL;
+    }
+    return &vfs_mounts[index];
+}
+
+static vfs_file_t* vfs_get_file(int fd) {
+    if (fd < 0 || fd >= VFS_MAX_FDS || !vfs_files[fd].used) {
+        return NULL;
+    }
+    return &vfs_files[fd];
+}
+
+int vfs_open(const char* path, uint32_t flags) {
+    char abs[VFS_MAX_PATH];
+    vfs_node_t node;
+    int writable = (flags & VFS_O_ACCMODE) != VFS_O_RDONLY;
+
+    int r = vfs_resolve(path, abs);
+    if (r < 0) return r;
+
+    r = vfs_lookup_abs(abs, &node);
+    if (r == VFS_ENOENT && (flags & VFS_O_CREAT)) {
+        const char* rel;
+        vfs_mount_t* mnt = vfs_find_mount(abs, &rel);
+        if (!mnt) return VFS_ENOENT;
+        if (!mnt->ops->create) return VFS_EROFS;
+
+        r = mnt->ops->create(mnt, rel, VFS_TYPE_FILE, &node);
+        if (r < 0) return r;
+        node.mnt = mnt;
+        vfs_cache_insert(abs, vfs_hash(abs), &node);
+    } else if (r < 0) {
+        return r;
+    }
+
+    if (node.type == VFS_TYPE_DIR && writable) return VFS_EISDIR;
+    if (node.type != VFS_TYPE_DIR && (flags & VFS_O_DIRECTORY)) return VFS_ENOTDIR;
+    if (writable && !node.mnt->ops->write) return VFS_EROFS;
+
+    int fd = -1;
+    for (int i = 0; i < VFS_MAX_FDS; i++) {
+        if (!vfs_files[i].used) {
+            fd = i;
+            break;
+        }
+    }
+    if (fd < 0) return VFS_EMFILE;
+
+    vfs_file_t* f = &vfs_files[fd];
+    memset(f, 0, sizeof(*f));
+    f->node = node;
+    strcpy(f->path, abs);
+    f->flags = flags;
+    f->used = 1;
+
+    if (node.mnt->ops->open) {
+        r = node.mnt->ops->open(f);
+        if (r < 0) {
+            f->used = 0;
+            return r;
+        }
+        vfs_cache_insert(abs, vfs_hash(abs), &f->node);
+    }
+
+    if ((flags & VFS_O_TRUNC) && writable && f->node.size > 0) {
+        if (!node.mnt->ops->truncate) {
+            f->used = 0;
+            return VFS_EROFS;
+        }
+        r = node.mnt->ops->truncate(f, 0);
+        if (r < 0) {
+            f->used = 0;
+            return r;
+        }
+        vfs_cache_update(&f->node);
+    }
+    return fd;
+}
+
+int vfs_close(int fd) {
+    vfs_file_t* f = vfs_get_file(fd);
+    if (!f) return VFS_EBADF;
+    f->used = 0;
+    return 0;
+}
+
+int vfs_read(int fd, void* buffer, uint32_t size) {
+    vfs_file_t* f = vfs_get_file(fd);
+    if (!f || !buffer) return VFS_EBADF;
+    if ((f->flags & VFS_O_ACCMODE) == VFS_O_WRONLY) return VFS_EBADF;
+    if (f->node.type == VFS_TYPE_DIR) return VFS_EISDIR;
+    if (!f->node.mnt->ops->read) return VFS_EINVAL;
+
+    if (f->offset >= f->node.size) return 0;
+    if (size > f->node.size - f->offset) size = f->node.size - f->offset;
+    if (size == 0) return 0;
+
+    int n = f->node.mnt->ops->read(f, buffer, size);
+    if (n > 0) f->offset += n;
+    return n;
+}
+
+int vfs_write(int fd, const void* buffer, uint32_t size) {
+    vfs_file_t* f = vfs_get_file(fd);
+    if (!f || !buffer) return VFS_EBADF;
+    if ((f->flags & VFS_O_ACCMODE) == VFS_O_RDONLY) return VFS_EBADF;
+    if (size == 0) return 0;
+
+    if (f->flags & VFS_O_APPEND) {
+        f->offset = f->node.size;
+    }
+
+    uint32_t old_size = f->node.size;
+    int n = f->node.mnt->ops->write(f, buffer, size);
+    if (n > 0) f->offset += n;
+    if (f->node.size != old_size) {
+        vfs_cache_update(&f->node);
+    }
+    return n;
+}
+
+int vfs_seek(int fd, int offset, int whence) {
+    vfs_file_t* f = vfs_get_file(fd);
+    if (!f) return VFS_EBADF;
+
+    int base;
+    if (whence == VFS_SEEK_SET) base = 0;
+    else if (whence == VFS_SEEK_CUR) base = (int)f->offset;
+    else if (whence == VFS_SEEK_END) base = (int)f->node.size;
+    else return VFS_EINVAL;
+
+    int pos = base + offset;
+    if (pos < 0 || (uint32_t)pos > f->node.size) return VFS_EINVAL;
+    f->offset = (uint32_t)pos;
+    return pos;
+}
+
+int vfs_reserve(int fd, uint32_t size) {
+    vfs_file_t* f = vfs_get_file(fd);
+    if (!f) return VFS_EBADF;
+    if ((f->flags & VFS_O_ACCMODE) == VFS_O_RDONLY) return VFS_EBADF;
+    if (!f->node.mnt->ops->reserve) return 0;
+
+    int r = f->node.mnt->ops->reserve(f, size);
+    vfs_cache_update(&f->node);
+    return r;
+}
+
+/* Mount points are listed after the backend's own entries so "ls /" shows them. */
+static int vfs_readdir_mounts(vfs_file_t* f, vfs_dirent_t* entry) {
+    int dir_len = strlen(f->path);
+
+    while (f->mount_pos - 1 < VFS_MAX_MOUNTS) {
+        vfs_mount_t* m = &vfs_mounts[f->mount_pos - 1];
+        f->mount_pos++;
+
+        if (!m->used || m->path_len <= 1) continue;
+
+        const char* name;
+        if (dir_len == 1) {
+            name = m->path + 1;
+        } else if (strncmp(m->path, f->path, dir_len) == 0 && m->path[dir_len] == '/') {
+            name = m->path + dir_len + 1;
+        } else {
+            continue;
+        }
+        if (name[0] == '\0' || strchr(name, '/')) continue;
+
+        vfs_node_t existing;
+        const char* rel = m->path + (f->node.mnt->path_len == 1 ? 1 : f->node.mnt->path_len + 1);
+        if (f->node.mnt->ops->lookup(f->node.mnt, rel, &existing) == 0) continue;
+
+        strncpy(entry->name, name, VFS_MAX_NAME - 1);
+        entry->name[VFS_MAX_NAME - 1] = '\0';
+        entry->type = VFS_TYPE_DIR;
+        entry->size = 0;
+        return 1;
+    }
+    return 0;
+}
+
+int vfs_readdir(int fd, vfs_dirent_t* entry) {
+    vfs_file_t* f = vfs_get_file(fd);
+    if (!f || !entry) return VFS_EBADF;
+    if (f->node.type != VFS_TYPE_DIR) return VFS_ENOTDIR;
+
+    if (f->mount_pos == 0) {
+        int r = f->node.mnt->ops->readdir ? f->node.mnt->ops->readdir(f, entry) : 0;
+        if (r != 0) return r;
+        f->mount_pos = 1;
+    }
+    return vfs_readdir_mounts(f, entry);
+}
+
+int vfs_fstat(int fd, vfs_stat_t* st) {
+    vfs_file_t* f = vfs_get_file(fd);
+    if (!f || !st) return VFS_EBADF;
+    st->type = f->node.type;
+    st->size = f->node.size;
+    st->ino = f->node.ino;
+    return 0;
+}
+
+const void* vfs_map(int fd) {
+    vfs_file_t* f = vfs_get_file(fd);
+    if (!f || f->node.type != VFS_TYPE_FILE || !f->node.mnt->ops->map) {
+        return NULL;
+    }
+    return f->node.mnt->ops->map(&f->node);
+}
+
+static void vfs_mmap_evict(void) {
+    while (vfs_resident_count > 0) {
+        uint32_t virt = vfs_resident[vfs_resident_head];
+        vfs_resident_head = (vfs_resident_head + 1) % VFS_MAP_RESIDENT;
+        vfs_resident_count--;
+        if (!virt) continue;
+
+        uint32_t frame = paging_unmap(virt);
+        if (frame) {
+            frame_free(frame);
+            return;
+        }
+    }
+}
+
+uint32_t vfs_mmap_resident_pages(void) {
+    return vfs_resident_count;
+}
+
+void* vfs_mmap(int fd, uint32_t offset, uint32_t length) {
+    vfs_file_t* f = vfs_get_file(fd);
+    if (!f || f->node.type != VFS_TYPE_FILE) return NULL;
+    if ((f->flags & VFS_O_ACCMODE) == VFS_O_WRONLY) return NULL;
+    if (offset >= f->node.size) return NULL;
+    if (length == 0 || length > f->node.size - offset) {
+        length = f->node.size - offset;
+    }
+
+    int slot = -1;
+    for (int i = 0; i < VFS_MAX_MAPS; i++) {
+        if (!vfs_maps[i].used) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) return NULL;
+
+    vfs_mapping_t* m = &vfs_maps[slot];
+    const vfs_ops_t* ops = f->node.mnt->ops;
+    const uint8_t* data = ops->map ? (const uint8_t*)ops->map(&f->node) : NULL;
+    uint32_t base = MMAP_BASE + slot * VFS_MAP_SLOT_SIZE;
+
+    if (data) {
+        uint32_t start = (uint32_t)(data + offset);
+        uint32_t first = start & ~0xFFF;
+        uint32_t pages = (start + length - first + PAGE_SIZE - 1) / PAGE_SIZE;
+        if (pages > VFS_MAP_SLOT_SIZE / PAGE_SIZE) return NULL;
+
+        for (uint32_t i = 0; i < pages; i++) {
+            if (paging_map(base + i * PAGE_SIZE, first + i * PAGE_SIZE, PAGE_PRESENT) < 0) {
+                while (i-- > 0) paging_unmap(base + i * PAGE_SIZE);
+                return NULL;
+            }
+        }
+        m->file = *f;
+        m->base = base;
+        m->offset = offset;
+        m->length = length;
+        m->pages = pages;
+        m->direct = 1;
+        m->used = 1;
+        return (void*)(base + (start & 0xFFF));
+    }
+
+    if (!ops->read) return NULL;
+    uint32_t pages = (length + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (pages > VFS_MAP_SLOT_SIZE / PAGE_SIZE) return NULL;
+
+    m->file = *f;
+    m->base = base;
+    m->offset = offset;
+    m->length = length;
+    m->pages = pages;
+    m->direct = 0;
+    m->used = 1;
+    return (void*)base;
+}
+
+int vfs_munmap(void* addr) {
+    uint32_t virt = (uint32_t)addr;
+    if (virt < MMAP_BASE || virt >= MMAP_BASE + MMAP_SIZE) return VFS_EINVAL;
+
+    vfs_mapping_t* m = &vfs_maps[(virt - MMAP_BASE) / VFS_MAP_SLOT_SIZE];
+    if (!m->used) return VFS_EINVAL;
+
+    for (uint32_t i = 0; i < m->pages; i++) {
+        uint32_t frame = paging_unmap(m->base + i * PAGE_SIZE);
+        if (frame && !m->direct) frame_free(frame);
+    }
+
+    if (!m->direct) {
+        uint32_t end = m->base + m->pages * PAGE_SIZE;
+        for (uint32_t i = 0; i < vfs_resident_count; i++) {
+            uint32_t* slot = &vfs_resident[(vfs_resident_head + i) % VFS_MAP_RESIDENT];
+            if (*slot >= m->base && *slot < end) *slot = 0;
+        }
+    }
+
+    m->used = 0;
+    return 0;
+}
+
+/* Called from the page fault handler for not-present pages. */
+int vfs_mmap_fault(uint32_t addr) {
+    if (addr < MMAP_BASE || addr >= MMAP_BASE + MMAP_SIZE) return VFS_EINVAL;
+
+    vfs_mapping_t* m = &vfs_maps[(addr - MMAP_BASE) / VFS_MAP_SLOT_SIZE];
+    if (!m->used || m->direct) return VFS_EINVAL;
+
+    uint32_t page = (addr - m->base) / PAGE_SIZE;
+    if (page >= m->pages) return VFS_EINVAL;
+
+    if (vfs_resident_count == VFS_MAP_RESIDENT) vfs_mmap_evict();
+    uint32_t frame = frame_alloc();
+    if (!frame) {
+        vfs_mmap_evict();
+        frame = frame_alloc();
+        if (!frame) return VFS_ENOSPC;
+    }
+
+    uint32_t want = m->length - page * PAGE_SIZE;
+    if (want > PAGE_SIZE) want = PAGE_SIZE;
+    m->file.offset = m->offset + page * PAGE_SIZE;
+
+    int n = m->file.node.mnt->ops->read(&m->file, (void*)frame, want);
+    if (n < 0) {
+        frame_free(frame);
+        return VFS_EIO;
+    }
+    memset((uint8_t*)frame + n, 0, PAGE_SIZE - n);
+
+    uint32_t virt = m->base + page * PAGE_SIZE;
+    if (paging_map(virt, frame, PAGE_PRESENT) < 0) {
+        frame_free(frame);
+        return VFS_ENOSPC;
+    }
+
+    vfs_resident[(vfs_resident_head + vfs_resident_count) % VFS_MAP_RESIDENT] = virt;
+    vfs_resident_count++;
+    return 0;
+}
+
+int vfs_stat(const char* path, vfs_stat_t* st) {
+    vfs_node_t node;
+    int r = vfs_lookup(path, &node);
+    if (r < 0) return r;
+    if (st) {
+        st->type = node.type;
+        st->size = node.size;
+        st->ino = node.ino;
+    }
+    return 0;
+}
+
+int vfs_mkdir(const char* path) {
+    char abs[VFS_MAX_PATH];
+    vfs_node_t node;
+
+    int r = vfs_resolve(path, abs);
+    if (r < 0) return r;
+    if (vfs_lookup_abs(abs, &node) == 0) return VFS_EEXIST;
+
+    const char* rel;
+    vfs_mount_t* mnt = vfs_find_mount(abs, &rel);
+    if (!mnt) return VFS_ENOENT;
+    if (!mnt->ops->create) return VFS_EROFS;
+
+    r = mnt->ops->create(mnt, rel, VFS_TYPE_DIR, &node);
+    if (r < 0) return r;
+    node.mnt = mnt;
+    vfs_cache_insert(abs, vfs_hash(abs), &node);
+    return 0;
+}
+
+int vfs_unlink(const char* path) {
+    char abs[VFS_MAX_PATH];
+    vfs_node_t node;
+
+    int r = vfs_resolve(path, abs);
+    if (r < 0) return r;
+    r = vfs_lookup_abs(abs, &node);
+    if (r < 0) return r;
+
+    const char* rel;
+    vfs_mount_t* mnt = vfs_find_mount(abs, &rel);
+    if (!mnt) return VFS_ENOENT;
+    if (rel[0] == '\0') return VFS_EBUSY;
+    if (!mnt->ops->unlink) return VFS_EROFS;
+
+    for (int i = 0; i < VFS_MAX_FDS; i++) {
+        if (vfs_files[i].used && vfs_files[i].node.mnt == mnt && vfs_files[i].node.ino == node.ino) {
+            return VFS_EBUSY;
+        }
+    }
+    for (int i = 0; i < VFS_MAX_MAPS; i++) {
+        if (vfs_maps[i].used && vfs_maps[i].file.node.mnt == mnt && vfs_maps[i].file.node.ino == node.ino) {
+            return VFS_EBUSY;
+        }
+    }
+
+    r = mnt->ops->unlink(mnt, rel);
+    if (r < 0) return r;
+    vfs_cache_invalidate(abs);
+    return 0;
+}
+
+const char* vfs_strerror(int err) {
+    switch (err) {
+        case VFS_ENOENT: return "No such file or directory";
+        case VFS_ENOTDIR: return "Not a directory";
+        case VFS_EISDIR: return "Is a directory";
+        case VFS_EEXIST: return "File exists";
+        case VFS_EROFS: return "Read-only file system";
+        case VFS_ENOSPC: return "No space left";
+        case VFS_EMFILE: return "Too many open files";
+        case VFS_EBADF: return "Bad file descriptor";
+        case VFS_EIO: return "I/O error";
+        case VFS_EBUSY: return "Resource busy";
+        case VFS_ENOTEMPTY: return "Directory not empty";
+        default: return "Invalid argument";
+    }
+}
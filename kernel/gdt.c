@@ -2,30 +2,76 @@
 
 #include "include/gdt.h"
 
-gdt_entry_t gdt_entries[3];
-gdt_ptr_t   gdt_ptr;
+static cpu_gdt_t boot_gdt;
+static uint8_t boot_fault_stack[FAULT_STACK_SIZE] __attribute__((aligned(16)));
+
+/* Set by fault_task_init(); CPUs started later get their fault task from these. */
+static void (*fault_entry)(void);
+static uint32_t fault_cr3;
 
 extern void gdt_flush(uint32_t);
+extern void idt_set_gate(uint8_t num, uint32_t base, uint16_t sel, uint8_t flags);
+
+void gdt_set_gate(gdt_entry_t* entries, int32_t num, uint32_t base, uint32_t limit, uint8_t access, uint8_t gran) {
+    entries[num].base_low    = (base & 0xFFFF);
+    entries[num].base_middle = (base >> 16) & 0xFF;
+    entries[num].base_high   = (base >> 24) & 0xFF;
+
+    entries[num].limit_low   = (limit & 0xFFFF);
+    entries[num].granularity = (limit >> 16) & 0x0F;
+
+    entries[num].granularity |= gran & 0xF0;
+    entries[num].access      = access;
+}
+
+static void fault_tss_setup(cpu_gdt_t* g) {
+    tss_t* t = &g->fault_tss;
+    t->cr3 = fault_cr3;
+    t->eip = (uint32_t)fault_entry;
+    t->eflags = 0x2;
+    t->esp = (uint32_t)g->fault_stack + FAULT_STACK_SIZE;
+    t->cs = GDT_KERNEL_CODE;
+    t->ss = t->ds = t->es = t->fs = t->gs = GDT_KERNEL_DATA;
+    t->iomap_base = sizeof(tss_t);
+}
+
+void gdt_cpu_init(cpu_gdt_t* g, uint8_t* fault_stack) {
+    g->ptr.limit = (sizeof(gdt_entry_t) * GDT_ENTRIES) - 1;
+    g->ptr.base  = (uint32_t)&g->entries;
+    g->fault_stack = fault_stack;
 
-void gdt_set_gate(int32_t num, uint32_t base, uint32_t limit, uint8_t access, uint8_t gran) {
-    gdt_entries[num].base_low    = (base & 0xFFFF);
-    gdt_entries[num].base_middle = (base >> 16) & 0xFF;
-    gdt_entries[num].base_high   = (base >> 24) & 0xFF;
+    gdt_set_gate(g->entries, 0, 0, 0, 0, 0);
+    gdt_set_gate(g->entries, 1, 0, 0xFFFFFFFF, 0x9A, 0xCF);
+    gdt_set_gate(g->entries, 2, 0, 0xFFFFFFFF, 0x92, 0xCF);
+    gdt_set_gate(g->entries, 3, (uint32_t)&g->tss, sizeof(tss_t) - 1, 0x89, 0x00);
+    gdt_set_gate(g->entries, 4, (uint32_t)&g->fault_tss, sizeof(tss_t) - 1, 0x89, 0x00);
+    if (fault_entry) fault_tss_setup(g);
 
-    gdt_entries[num].limit_low   = (limit & 0xFFFF);
-    gdt_entries[num].granularity = (limit >> 16) & 0x0F;
+    gdt_flush((uint32_t)&g->ptr);
 
-    gdt_entries[num].granularity |= gran & 0xF0;
-    gdt_entries[num].access      = access;
+    g->tss.ss0 = GDT_KERNEL_DATA;
+    g->tss.iomap_base = sizeof(tss_t);
+    __asm__ volatile("ltr %w0" : : "r"(GDT_KERNEL_TSS));
 }
 
 void init_gdt() {
-    gdt_ptr.limit = (sizeof(gdt_entry_t) * 3) - 1;
-    gdt_ptr.base  = (uint32_t)&gdt_entries;
+    gdt_cpu_init(&boot_gdt, boot_fault_stack);
+}
 
-    gdt_set_gate(0, 0, 0, 0, 0);                
-    gdt_set_gate(1, 0, 0xFFFFFFFF, 0x9A, 0xCF); 
-    gdt_set_gate(2, 0, 0xFFFFFFFF, 0x92, 0xCF); 
+cpu_gdt_t* gdt_boot(void) {
+    return &boot_gdt;
+}
+
+/*
+ * Routes page faults through a task gate so the handler always starts on its
+ * own stack. A fault raised while pushing onto a lazily populated stack page
+ * could not be delivered on that same stack and would end in a triple fault.
+ * Must run after paging is enabled, since the task switch reloads CR3.
+ */
+void fault_task_init(void (*entry)(void)) {
+    __asm__ volatile("mov %%cr3, %0" : "=r"(fault_cr3));
+    fault_entry = entry;
+    fault_tss_setup(&boot_gdt);
 
-    gdt_flush((uint32_t)&gdt_ptr);
-}
\ No newline at end of file
+    idt_set_gate(14, 0, GDT_FAULT_TSS, 0x85);
+}
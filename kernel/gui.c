@@ -2,6 +2,7 @@
 
 #include <stdint.h>
 #include <io.h>
+#include "include/keyboard.h"
 
 extern void vga_set_mode_13h();
 extern void vga_clear_screen(uint8_t color);
@@ -41,8 +42,8 @@ void gui_main() {
 
         vga_fill_rectangle(mouse_x, mouse_y, 5, 5, 0); 
 
-        if (inb(0x64) & 0x1) {
-            uint8_t scancode = inb(0x60);
+        uint8_t scancode;
+        if (kbd_read(&scancode)) {
             if (!(scancode & 0x80)) { 
                 if (scancode == 0x4B) mouse_x -= 5; 
                 if (scancode == 0x4D) mouse_x += 5; 
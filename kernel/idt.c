@@ -20,8 +20,9 @@ struct idt_entry idt[256];
 struct idt_ptr idtp;
 
 extern void idt_load(uint32_t ptr);
-extern void irq1(); 
-extern void irq12(); 
+extern void irq_spurious();
+extern uint32_t isr_stub_table[32];
+extern uint32_t irq_stub_table[224];
 
 void idt_set_gate(uint8_t num, uint32_t base, uint16_t sel, uint8_t flags) {
     idt[num].base_low = (base & 0xFFFF);
@@ -36,28 +37,15 @@ void idt_init() {
     idtp.base = (uint32_t)&idt;
 
     for(int i = 0; i < 256; i++) idt_set_gate(i, 0, 0, 0);
+    for(int i = 0; i < 32; i++) idt_set_gate(i, isr_stub_table[i], 0x08, 0x8E);
+    for(int i = 32; i < 255; i++) idt_set_gate(i, irq_stub_table[i - 32], 0x08, 0x8E);
+    /* The local APIC does not expect an EOI for its spurious vector. */
+    idt_set_gate(255, (uint32_t)irq_spurious, 0x08, 0x8E);
 
     idt_load((uint32_t)&idtp);
 }
 
-void irq_install() {
-
-    outb(0x20, 0x11);
-    outb(0xA0, 0x11);
-
-    outb(0x21, 0x20); 
-    outb(0xA1, 0x28); 
-
-    outb(0x21, 0x04);
-    outb(0xA1, 0x02);
-
-    outb(0x21, 0x01);
-    outb(0xA1, 0x01);
-
-    outb(0x21, 0xFD); 
-    outb(0xA1, 0xEF); 
-
-    idt_set_gate(33, (uint32_t)irq1, 0x08, 0x8E);
-
-    idt_set_gate(44, (uint32_t)irq12, 0x08, 0x8E);
-}
\ No newline at end of file
+/* Application processors share the bootstrap CPU's table. */
+void idt_cpu_init(void) {
+    idt_load((uint32_t)&idtp);
+}
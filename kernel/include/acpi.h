@@ -0,0 +1,73 @@
+
+
+#ifndef ACPI_H
+#define ACPI_H
+
+#include <stdint.h>
+
+typedef struct {
+    char signature[8];
+    uint8_t checksum;
+    char oem_id[6];
+    uint8_t revision;
+    uint32_t rsdt;
+} __attribute__((packed)) acpi_rsdp_t;
+
+typedef struct {
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed)) acpi_header_t;
+
+/* Multiple APIC Description Table ("APIC"); variable-length entries follow. */
+typedef struct {
+    acpi_header_t header;
+    uint32_t lapic_address;
+    uint32_t flags;
+} __attribute__((packed)) acpi_madt_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t length;
+} __attribute__((packed)) acpi_madt_entry_t;
+
+#define MADT_LAPIC 0
+#define MADT_IOAPIC 1
+
+typedef struct {
+    acpi_madt_entry_t entry;
+    uint8_t processor_id;
+    uint8_t apic_id;
+    uint32_t flags;
+} __attribute__((packed)) acpi_madt_lapic_t;
+
+#define MADT_LAPIC_ENABLED 0x1
+
+/* HPET Description Table ("HPET"); the base is a generic address structure. */
+typedef struct {
+    acpi_header_t header;
+    uint32_t event_timer_block_id;
+    uint8_t address_space;
+    uint8_t register_bit_width;
+    uint8_t register_bit_offset;
+    uint8_t access_size;
+    uint64_t address;
+    uint8_t hpet_number;
+    uint16_t minimum_tick;
+    uint8_t page_protection;
+} __attribute__((packed)) acpi_hpet_t;
+
+#define ACPI_SPACE_MEMORY 0
+
+/* Finds the RSDP in the EBDA or the BIOS area; returns -1 if there is none. */
+int acpi_init(void);
+/* Returns the first table with the given signature, checksum verified, or NULL. */
+const acpi_header_t* acpi_find_table(const char* signature);
+
+#endif
@@ -0,0 +1,53 @@
+
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdint.h>
+
+#define ARENA_ALIGN 16
+
+/* Scratch space for the running command, and a separate one for interrupt handlers. */
+#define SCRATCH_SIZE (1024 * 1024)
+#define SCRATCH_IRQ_SIZE (64 * 1024)
+/* Every kernel thread other than the shell gets its own, smaller, arena. */
+#define SCRATCH_THREAD_SIZE (64 * 1024)
+
+typedef struct {
+    uint8_t* base;
+    uint32_t size;
+    uint32_t used;
+    uint32_t peak;
+    uint32_t failed;
+} arena_t;
+
+int arena_init(arena_t* arena, uint32_t size);
+void arena_destroy(arena_t* arena);
+void* arena_alloc(arena_t* arena, uint32_t size);
+
+static inline uint32_t arena_mark(const arena_t* arena) {
+    return arena->used;
+}
+
+static inline void arena_release(arena_t* arena, uint32_t mark) {
+    if (mark < arena->used) arena->used = mark;
+}
+
+/*
+ * The scratch_* calls pick the arena for the current context. Memory stays
+ * valid until the caller releases back to a mark taken before allocating;
+ * each shell command and each interrupt releases everything on exit.
+ */
+void scratch_init(void);
+arena_t* scratch_arena(void);
+void* scratch_alloc(uint32_t size);
+uint32_t scratch_mark(void);
+void scratch_release(uint32_t mark);
+
+/* Called by the scheduler on every switch; NULL selects the shell's arena. */
+void scratch_set_thread_arena(arena_t* arena);
+
+uint32_t scratch_irq_enter(void);
+void scratch_irq_exit(uint32_t mark);
+
+#endif
@@ -0,0 +1,67 @@
+
+
+#ifndef ATA_H
+#define ATA_H
+
+#include <stdint.h>
+
+#define ATA_MAX_DRIVES 4
+#define ATA_LAT_BUCKETS 32
+
+/* How long a command may keep the drive busy before it counts as a timeout. */
+#define ATA_TIMEOUT_MS 500
+#define ATAPI_TIMEOUT_MS 1000
+/* Polls per millisecond when there is no calibrated TSC to time the wait with. */
+#define ATA_SPINS_PER_MS 1000
+
+/*
+ * Busy waits are timed in TSC cycles, not jiffies: they also run with
+ * interrupts off, e.g. from the page fault task, where jiffies stand still.
+ */
+typedef struct {
+    uint64_t start;
+    uint64_t cycles;
+    uint32_t spins;
+} ata_timeout_t;
+
+typedef struct {
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t sectors_read;
+    uint32_t sectors_written;
+    uint32_t merges;
+    uint32_t errors;
+    uint32_t timeouts;
+    uint32_t inflight;
+    uint32_t max_inflight;
+    uint64_t busy_cycles;
+    uint32_t read_hist[ATA_LAT_BUCKETS];
+    uint32_t write_hist[ATA_LAT_BUCKETS];
+    uint32_t next_lba;
+    uint8_t last_write;
+    uint8_t present;
+} ata_stats_t;
+
+int ata_identify(uint8_t drive);
+int ata_detect_disks();
+int ata_read_sector(uint8_t drive, uint32_t lba, uint16_t* buffer);
+int ata_write_sector(uint8_t drive, uint32_t lba, uint16_t* buffer);
+int ata_read_sectors(uint8_t drive, uint32_t lba, uint16_t* buffer, uint8_t count);
+int ata_write_sectors(uint8_t drive, uint32_t lba, uint16_t* buffer, uint8_t count);
+/* Writes stay in the drive's cache until these; callers flush at the end of a batch. */
+int ata_flush(uint8_t drive);
+int ata_flush_all(void);
+
+ata_stats_t* ata_get_stats(uint8_t drive);
+void ata_reset_stats(uint8_t drive);
+int ata_lat_bucket(uint64_t cycles);
+void ata_timeout_start(ata_timeout_t* t, uint32_t ms);
+int ata_timeout_expired(ata_timeout_t* t);
+uint64_t ata_io_begin(uint8_t drive, int write, uint32_t lba, uint32_t count);
+void ata_io_end(uint8_t drive, int write, uint32_t count, uint64_t start, int result);
+
+int atapi_detect_drives();
+int atapi_is_present(uint8_t drive);
+int atapi_read_blocks(uint8_t drive, uint32_t lba, uint32_t count, void* buffer);
+
+#endif
@@ -0,0 +1,48 @@
+
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+
+/*
+ * A clocksource is a free-running counter plus the scale that turns counts
+ * into nanoseconds: ns = (delta * mult) >> shift.
+ */
+typedef struct {
+    const char* name;
+    uint64_t (*read)(void);
+    uint64_t mask;
+    uint32_t mult;
+    uint32_t shift;
+    uint32_t khz;
+    int rating;
+} clocksource_t;
+
+typedef struct {
+    int year;
+    int month;
+    int day;
+    int hour;
+    int minute;
+    int second;
+} clock_tm_t;
+
+/* Calibrates the TSC and probes the HPET; needs the timer tick running. */
+void clock_init(void);
+void clock_update(void);
+const clocksource_t* clock_source(void);
+
+/* Monotonic nanoseconds since boot from the best available clocksource. */
+uint64_t ktime_ns(void);
+
+/* Raw TSC and its calibrated conversion, for latency measurements. */
+uint64_t clock_cycles(void);
+uint32_t clock_tsc_khz(void);
+uint64_t clock_cycles_to_ns(uint64_t cycles);
+
+/* Wall-clock seconds since 1970, from the RTC read once at boot. */
+uint32_t clock_realtime(void);
+void clock_to_tm(uint32_t t, clock_tm_t* tm);
+
+#endif
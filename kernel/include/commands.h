@@ -3,13 +3,13 @@
 #ifndef COMMANDS_H
 #define COMMANDS_H
 
+#include <stdint.h>
+
 void kernel_execute_command(const char* input);
-void init_kernel_commands();
 
 extern char current_dir[256];
 
 extern void* tar_archive;
-extern int tar_check_path_exists(void* archive, const char* path);
-extern void tar_get_directories(void* archive, char directories[][256], int* count);
+extern uint32_t tar_archive_size;
 
 #endif
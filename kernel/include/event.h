@@ -0,0 +1,105 @@
+
+
+#ifndef EVENT_H
+#define EVENT_H
+
+#include <stdint.h>
+#include "timer.h"
+
+/*
+ * Cooperative event loop. A task is a callback plus its own state; each run
+ * does a bounded amount of work and ends by arming a wait on an event, a
+ * timeout or both. A task that arms nothing is finished. Tasks carry no stack
+ * of their own and waiting costs nothing but a list link and a wheel timer,
+ * so thousands of them are cheap. Task structures belong to the caller and
+ * must stay valid until the task has finished.
+ *
+ * The loop is serviced by the shell thread: event_loop_idle() runs whatever
+ * is ready, and halts when nothing is.
+ */
+
+#define IRQ_EVENT_COUNT 16
+
+typedef enum {
+    EVENT_TASK_DONE,
+    EVENT_TASK_READY,
+    EVENT_TASK_WAITING,
+    EVENT_TASK_RUNNING
+} event_task_state_t;
+
+/* Why a task was last woken. */
+typedef enum {
+    EVENT_WOKE_START,
+    EVENT_WOKE_SIGNAL,
+    EVENT_WOKE_TIMEOUT,
+    EVENT_WOKE_YIELD
+} event_reason_t;
+
+struct event;
+
+typedef struct event_task {
+    struct event_task* next;    /* ready list or waiter list link */
+    struct event_task* prev;
+    void (*fn)(struct event_task* task);
+    void* data;
+    struct event* waiting;
+    ktimer_t timer;
+    const char* name;
+    uint8_t state;
+    uint8_t reason;
+    uint32_t runs;
+} event_task_t;
+
+/*
+ * A readiness source. Signalling wakes every task waiting on it; with no
+ * waiters the signal is remembered, so the next wait returns at once and a
+ * signal between checking for work and waiting is never lost.
+ */
+typedef struct event {
+    event_task_t* waiters;
+    uint32_t pending;
+    uint32_t signals;
+} event_t;
+
+typedef struct {
+    uint32_t tasks;             /* started and not yet finished */
+    uint32_t ready;
+    uint32_t waiting;
+    uint32_t runs;
+    uint32_t timeouts;
+} event_stats_t;
+
+void event_init(event_t* ev);
+/* Safe from interrupt handlers, timer callbacks and any thread. */
+void event_signal(event_t* ev);
+/* Drops remembered signals, e.g. before sending a request whose answer will be waited for. */
+void event_clear(event_t* ev);
+/* Signalled, from the irq-event softirq, after each interrupt on the given PIC line. */
+event_t* irq_event(uint8_t irq);
+/* Top-half side: notes that the line fired and raises the softirq. */
+void irq_event_raise(uint8_t irq);
+void irq_event_run(void);
+
+void event_task_init(event_task_t* task, const char* name, void (*fn)(event_task_t* task), void* data);
+void event_task_start(event_task_t* task);
+/* Runs the task again after ev is signalled or timeout_ms pass; ev may be NULL, a zero timeout means none. */
+void event_task_wait(event_task_t* task, event_t* ev, uint32_t timeout_ms);
+void event_task_sleep(event_task_t* task, uint32_t ms);
+/* Runs the task again after everything that is ready now. */
+void event_task_yield(event_task_t* task);
+/* Stops a task whatever it is waiting for. */
+void event_task_cancel(event_task_t* task);
+
+/* Runs each task that is ready on entry once; returns how many ran. */
+int event_loop_run(void);
+int event_loop_pending(void);
+/* Runs ready tasks, or halts until the next interrupt if there are none. */
+void event_loop_idle(void);
+/*
+ * Keeps the loop going until ev is signalled (returns 1) or timeout_ms pass
+ * (returns 0). For commands that need an answer before they can continue.
+ */
+int event_loop_wait(event_t* ev, uint32_t timeout_ms);
+void event_loop_stats(event_stats_t* stats);
+
+#endif
@@ -4,6 +4,7 @@
 #define FAT32_H
 
 #include <stdint.h>
+#include "vfs.h"
 
 typedef struct {
     uint8_t  jmp_boot[3];
@@ -90,6 +91,7 @@ typedef struct {
     uint32_t bytes_per_cluster;
     uint32_t fat_size;
     uint32_t total_clusters;
+    uint32_t next_free;
     uint16_t reserved_sector_count;
     uint8_t num_fats;
     uint8_t mounted;
@@ -146,4 +148,6 @@ int fat32_find_entry(fat32_fs_t* fs, uint32_t dir_cluster, const char* name,
 
 int fat32_parse_path(const char* path, char components[][FAT32_MAX_FILENAME], int max_components);
 
+extern const vfs_ops_t fat32_vfs_ops;
+
 #endif 
\ No newline at end of file
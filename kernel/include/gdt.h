@@ -1,5 +1,8 @@
 
 
+#ifndef GDT_H
+#define GDT_H
+
 #include <stdint.h>
 
 struct gdt_entry_struct {
@@ -19,4 +22,53 @@ struct gdt_ptr_struct {
 typedef struct gdt_entry_struct gdt_entry_t;
 typedef struct gdt_ptr_struct gdt_ptr_t;
 
-void init_gdt();
\ No newline at end of file
+#define GDT_KERNEL_CODE 0x08
+#define GDT_KERNEL_DATA 0x10
+#define GDT_KERNEL_TSS  0x18
+#define GDT_FAULT_TSS   0x20
+
+#define GDT_ENTRIES 5
+
+#define FAULT_STACK_SIZE (16 * 1024)
+
+/* 32-bit task state segment, used only for the hardware task switch into the page fault handler. */
+typedef struct {
+    uint32_t prev_task;
+    uint32_t esp0, ss0, esp1, ss1, esp2, ss2;
+    uint32_t cr3, eip, eflags;
+    uint32_t eax, ecx, edx, ebx, esp, ebp, esi, edi;
+    uint32_t es, cs, ss, ds, fs, gs;
+    uint32_t ldt;
+    uint16_t trap;
+    uint16_t iomap_base;
+} __attribute__((packed)) tss_t;
+
+/*
+ * Descriptor tables of one CPU. The TSS selectors are the same on every CPU,
+ * so the page fault task gate in the shared IDT switches to the faulting
+ * CPU's own fault task and stack.
+ */
+typedef struct {
+    gdt_entry_t entries[GDT_ENTRIES];
+    gdt_ptr_t ptr;
+    /* Holds the interrupted kernel context while the page fault task runs. */
+    tss_t tss;
+    tss_t fault_tss;
+    uint8_t* fault_stack;
+    void* cpu;                  /* per-CPU data, see smp.h */
+} cpu_gdt_t;
+
+void init_gdt();
+/* Builds g and loads it on the calling CPU; fault_stack is FAULT_STACK_SIZE bytes. */
+void gdt_cpu_init(cpu_gdt_t* g, uint8_t* fault_stack);
+cpu_gdt_t* gdt_boot(void);
+void fault_task_init(void (*entry)(void));
+
+/* Tables of the calling CPU, found through its GDT register. */
+static inline cpu_gdt_t* gdt_current(void) {
+    gdt_ptr_t gdtr;
+    __asm__ volatile("sgdt %0" : "=m"(gdtr));
+    return (cpu_gdt_t*)gdtr.base;
+}
+
+#endif
@@ -22,4 +22,17 @@ struct idt_ptr_struct {
 
 typedef struct idt_ptr_struct idt_ptr_t;
 
+/* Stack frame built by the interrupt and exception stubs in interrupts.asm, lowest address first. */
+typedef struct {
+    uint32_t ds;
+    uint32_t edi, esi, ebp, esp, ebx, edx, ecx, eax;
+    uint32_t int_no, err_code;
+    uint32_t eip, cs, eflags;
+} interrupt_regs_t;
+
+void idt_cpu_init(void);
+void exception_handler(interrupt_regs_t* regs);
+/* entry is the TSC read by the stub. */
+void isr_handler(interrupt_regs_t* regs, uint64_t entry);
+
 #endif
@@ -0,0 +1,105 @@
+
+
+#ifndef IRQ_H
+#define IRQ_H
+
+#include <stdint.h>
+
+/*
+ * Hardware interrupt dispatch. Every vector from 32 up has a stub in
+ * interrupts.asm that ends in isr_handler(), which hands the vector to
+ * irq_dispatch(). Drivers attach handlers to a PIC line with irq_register(),
+ * or to a local APIC vector with irq_register_vector(); several handlers may
+ * share one line and are called in registration order. Handlers run with
+ * interrupts disabled before the EOI, so they should only acknowledge the
+ * device and hand the rest to a softirq, work queue or event.
+ */
+
+#define IRQ_VECTOR_BASE 32
+#define IRQ_LINES 16
+#define IRQ_CASCADE 2
+/* Vectors above the PIC range are delivered by the local APIC. */
+#define IRQ_APIC_BASE (IRQ_VECTOR_BASE + IRQ_LINES)
+#define IRQ_VECTORS 256
+/* Handlers that can be registered at once, over all vectors. */
+#define IRQ_MAX_ACTIONS 32
+/* log2 buckets of TSC cycles; the last one also takes everything longer. */
+#define IRQ_HIST_BUCKETS 32
+
+/* Handler results: shared lines need to know whether anyone claimed the interrupt. */
+#define IRQ_NONE 0
+#define IRQ_HANDLED 1
+
+typedef int (*irq_handler_t)(void* ctx);
+
+typedef struct irq_action {
+    struct irq_action* next;
+    irq_handler_t handler;
+    void* ctx;
+    const char* name;
+    uint32_t count;             /* interrupts this handler claimed */
+} irq_action_t;
+
+typedef struct {
+    irq_action_t* actions;
+    uint32_t count;
+    uint32_t unhandled;         /* no handler claimed it */
+    uint32_t spurious;          /* 8259 IRQ 7/15 with nothing in service */
+    uint64_t cycles;            /* spent in the handler chain */
+    uint64_t max_cycles;
+    uint32_t duration_hist[IRQ_HIST_BUCKETS];
+    /* Entry latency: from the hardware raising the interrupt to the stub, where the source can tell. */
+    uint32_t latency_count;
+    uint64_t latency_max;
+    uint32_t latency_hist[IRQ_HIST_BUCKETS];
+} irq_vector_t;
+
+/*
+ * Stretches with interrupts disabled: from irq_save() with IF set, an
+ * interrupt entry or a bare cli, to the matching irq_restore(), sti or iret.
+ * max_site is the code address that disabled them for the longest one, or
+ * the vector number when that was an interrupt handler.
+ */
+typedef struct {
+    uint32_t count;
+    uint64_t cycles;
+    uint64_t max_cycles;
+    uint32_t max_site;
+    uint32_t hist[IRQ_HIST_BUCKETS];
+} irqs_off_stats_t;
+
+/* Remaps the 8259s to IRQ_VECTOR_BASE with every line masked except the cascade. */
+void irq_install(void);
+
+/* Returns 0, or -1 if the line is out of range or no action slot is free. Unmasks the line. */
+int irq_register(uint8_t irq, irq_handler_t handler, void* ctx, const char* name);
+int irq_register_vector(uint8_t vector, irq_handler_t handler, void* ctx, const char* name);
+/* Removes the handler; the line is masked again once nothing is left on it. */
+void irq_unregister(uint8_t irq, irq_handler_t handler, void* ctx);
+
+void irq_mask(uint8_t irq);
+void irq_unmask(uint8_t irq);
+
+/* Called from isr_handler() with interrupts disabled; runs the handlers and acknowledges the vector. */
+void irq_dispatch(uint8_t vector);
+
+const irq_vector_t* irq_vector(uint8_t vector);
+const irqs_off_stats_t* irqs_off_stats(void);
+void irq_reset_stats(void);
+
+/* TSC read by the interrupt stub on entry to the interrupt being handled. */
+uint64_t irq_entry_cycles(void);
+/* For handlers whose device says how long ago it raised the interrupt; cycles are counted to the stub. */
+void irq_latency_sample(uint8_t vector, uint64_t cycles);
+
+/*
+ * Interrupts-off tracing. irq_save() and irq_restore() call these; code that
+ * uses cli and sti directly must call irq_trace_off() right after the cli and
+ * irq_trace_on() right before the sti.
+ */
+void irq_trace_off(void);
+void irq_trace_on(void);
+/* Opens the section of an interrupt handler at the stub's entry timestamp. */
+void irq_trace_entry(uint8_t vector, uint64_t entry);
+
+#endif
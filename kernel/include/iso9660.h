@@ -0,0 +1,37 @@
+
+#ifndef ISO9660_H
+#define ISO9660_H
+
+#include <stdint.h>
+
+#define ISO9660_BLOCK_SIZE 2048
+#define ISO9660_MAX_NAME 128
+#define ISO9660_MOUNT_POINT "/cdrom"
+
+typedef struct {
+    uint32_t extent;
+    uint32_t size;
+    uint8_t is_dir;
+    char name[ISO9660_MAX_NAME];
+} iso9660_entry_t;
+
+typedef struct {
+    uint8_t drive;
+    uint8_t mounted;
+    uint8_t rock_ridge;
+    uint32_t volume_blocks;
+    char volume_id[33];
+    iso9660_entry_t root;
+} iso9660_fs_t;
+
+int iso9660_mount(uint8_t drive);
+
+iso9660_fs_t* iso9660_get_fs(void);
+
+int iso9660_lookup(iso9660_fs_t* fs, const char* path, iso9660_entry_t* entry);
+
+int iso9660_readdir(iso9660_fs_t* fs, const iso9660_entry_t* dir, uint32_t* pos, iso9660_entry_t* entry);
+
+int iso9660_read(iso9660_fs_t* fs, const iso9660_entry_t* file, uint32_t offset, void* buffer, uint32_t size);
+
+#endif
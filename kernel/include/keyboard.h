@@ -0,0 +1,21 @@
+
+
+#ifndef KEYBOARD_H
+#define KEYBOARD_H
+
+#include <stdint.h>
+
+/* Scancodes held between the IRQ 1 handler and the readers; later keys are dropped when full. */
+#define KBD_BUFFER_SIZE 128
+
+/* Drains the controller and takes IRQ 1. */
+void keyboard_install(void);
+
+/* Takes the oldest buffered scancode; returns 0 if there is none. */
+int kbd_read(uint8_t* scancode);
+uint32_t kbd_dropped(void);
+
+/* Starts the PS/2 mouse and takes IRQ 12. */
+void mouse_install(void);
+
+#endif
@@ -0,0 +1,81 @@
+
+
+#ifndef KMALLOC_H
+#define KMALLOC_H
+
+#include <stdint.h>
+
+/* Power-of-two size classes from 16 bytes; anything larger gets whole pages. */
+#define KMALLOC_MIN_SHIFT 4
+#define KMALLOC_CLASSES 7
+#define KMALLOC_MAX_SMALL (1 << (KMALLOC_MIN_SHIFT + KMALLOC_CLASSES - 1))
+#define KMALLOC_HEADER_SIZE 32
+
+/* Set to 1 to add checked guard bytes after every object and poison freed memory. */
+#ifndef KMALLOC_REDZONE
+#define KMALLOC_REDZONE 0
+#endif
+
+#define KMALLOC_MAX_SITES 128
+
+/* Subsystem a call site is charged to; a file sets KMALLOC_TAG before including this header. */
+enum {
+    KM_OTHER,
+    KM_MM,
+    KM_FS,
+    KM_NET,
+    KM_SHELL,
+    KM_DRIVER,
+    KM_TAG_COUNT
+};
+
+#ifndef KMALLOC_TAG
+#define KMALLOC_TAG KM_OTHER
+#endif
+
+typedef struct {
+    const char* file;
+    int line;
+    uint8_t tag;
+    uint32_t live_bytes;
+    uint32_t live_count;
+    uint32_t peak_bytes;
+    uint32_t allocs;
+    uint32_t leak_bytes;
+    uint32_t leak_count;
+} kmalloc_site_t;
+
+typedef struct {
+    uint32_t live_bytes;
+    uint32_t peak_bytes;
+    uint32_t live_count;
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t failures;
+    uint32_t slab_pages;
+    uint32_t large_pages;
+    uint32_t class_slabs[KMALLOC_CLASSES];
+    uint32_t class_in_use[KMALLOC_CLASSES];
+    uint32_t tag_live[KM_TAG_COUNT];
+    uint32_t tag_peak[KM_TAG_COUNT];
+} kmalloc_stats_t;
+
+void* kmalloc_at(uint32_t size, int tag, const char* file, int line);
+void* kzalloc_at(uint32_t size, int tag, const char* file, int line);
+void* krealloc_at(void* ptr, uint32_t size, int tag, const char* file, int line);
+void kfree(void* ptr);
+
+#define kmalloc(size) kmalloc_at((size), KMALLOC_TAG, __FILE__, __LINE__)
+#define kzalloc(size) kzalloc_at((size), KMALLOC_TAG, __FILE__, __LINE__)
+#define krealloc(ptr, size) krealloc_at((ptr), (size), KMALLOC_TAG, __FILE__, __LINE__)
+
+void kmalloc_get_stats(kmalloc_stats_t* stats);
+const kmalloc_site_t* kmalloc_get_site(int index);
+const char* kmalloc_tag_name(int tag);
+uint32_t kmalloc_class_size(int cls);
+
+/* Allocations made after kmalloc_leak_mark() and still live are counted in leak_bytes/leak_count. */
+void kmalloc_leak_mark(void);
+int kmalloc_leak_active(void);
+
+#endif
@@ -19,6 +19,7 @@ char* strrchr(const char* s, int c);
 char* strcat(char* dest, const char* src);
 char* strncpy(char* dest, const char* src, unsigned int n);
 void itoa(int n, char* buf);
+uint64_t udiv64(uint64_t n, uint32_t d, uint32_t* rem);
 void tar_list_directory(void* archive, const char* dirpath);
 int snprintf(char* str, unsigned int size, const char* format, ...);
 void terminal_capture_begin(char* buffer, int size);
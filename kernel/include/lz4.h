@@ -0,0 +1,15 @@
+
+
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <stdint.h>
+
+#define LZ4_FRAME_MAGIC 0x184D2204
+
+int lz4_is_frame(const void* src, uint32_t src_size);
+int lz4_frame_content_size(const void* src, uint32_t src_size, uint32_t* size);
+int lz4_decompress_block(const uint8_t* src, uint32_t src_size, uint8_t* dst_start, uint8_t* dst, uint32_t dst_cap);
+int lz4_decompress_frame(const void* src, uint32_t src_size, void* dst, uint32_t dst_cap);
+
+#endif
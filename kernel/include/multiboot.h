@@ -9,6 +9,15 @@
 #define MULTIBOOT_HEADER_MAGIC                  0x1BADB002
 #define MULTIBOOT_BOOTLOADER_MAGIC              0x2BADB002
 
+#define MULTIBOOT_PAGE_ALIGN                    0x00000001
+#define MULTIBOOT_MEMORY_INFO                   0x00000002
+
+#define MULTIBOOT_INFO_MEMORY                   0x00000001
+#define MULTIBOOT_INFO_MODS                     0x00000008
+#define MULTIBOOT_INFO_MEM_MAP                  0x00000040
+
+#define MULTIBOOT_MEMORY_AVAILABLE              1
+
 struct multiboot_module {
     uint32_t mod_start;
     uint32_t mod_end;
@@ -51,7 +60,15 @@ struct multiboot_info {
     uint16_t vbe_interface_off;
     uint16_t vbe_interface_len;
 };
+struct multiboot_mmap_entry {
+    uint32_t size;
+    uint64_t addr;
+    uint64_t len;
+    uint32_t type;
+} __attribute__((packed));
+
 typedef struct multiboot_header multiboot_header_t;
 typedef struct multiboot_info multiboot_info_t;
+typedef struct multiboot_mmap_entry multiboot_mmap_entry_t;
 
 #endif
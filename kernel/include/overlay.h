@@ -0,0 +1,13 @@
+
+
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include <stdint.h>
+#include "vfs.h"
+
+int overlay_mount(const char* path, const vfs_ops_t* lower_ops, void* lower_priv);
+
+extern const vfs_ops_t overlay_vfs_ops;
+
+#endif
@@ -0,0 +1,66 @@
+
+
+#ifndef PAGING_H
+#define PAGING_H
+
+#include <stdint.h>
+
+#define PAGE_SIZE 4096
+#define LARGE_PAGE_SIZE (4 * 1024 * 1024)
+
+#define PAGE_PRESENT 0x001
+#define PAGE_WRITE 0x002
+#define PAGE_USER 0x004
+#define PAGE_WRITETHROUGH 0x008
+#define PAGE_NOCACHE 0x010
+#define PAGE_LARGE 0x080
+#define PAGE_GLOBAL 0x100
+
+/* PAT entry 1 is reprogrammed to write-combining, so PWT alone selects it (when the CPU has PAT). */
+#define PAGE_WRITECOMBINE PAGE_WRITETHROUGH
+
+#define PF_PRESENT 0x01
+#define PF_WRITE 0x02
+
+/*
+ * Layout:
+ *   0x00000000  identity map of RAM; page 0 is left unmapped and the kernel
+ *               text/rodata are read-only
+ *   0x90000000  file mapping window (vfs_mmap)
+ *   0xA0000000  lazily populated anonymous memory (paging_alloc_lazy)
+ *   0xC0000000  higher-half alias of the first KERNEL_DIRECT_MAX of RAM
+ * Devices above RAM must be mapped explicitly with paging_map_range().
+ */
+#define MMAP_BASE 0x90000000
+#define MMAP_SIZE (256 * 1024 * 1024)
+
+#define LAZY_BASE 0xA0000000
+#define LAZY_SIZE (256 * 1024 * 1024)
+#define LAZY_MAX_REGIONS 32
+
+#define KERNEL_VIRT_BASE 0xC0000000
+#define KERNEL_DIRECT_MAX 0x30000000
+
+#define PHYS_TO_VIRT(p) ((void*)((uint32_t)(p) + KERNEL_VIRT_BASE))
+#define VIRT_TO_PHYS(v) ((uint32_t)(v) - KERNEL_VIRT_BASE)
+
+void paging_init(void);
+void paging_cpu_init(void);
+
+int paging_map(uint32_t virt, uint32_t phys, uint32_t flags);
+uint32_t paging_unmap(uint32_t virt);
+
+int paging_map_range(uint32_t virt, uint32_t phys, uint32_t size, uint32_t flags);
+int paging_unmap_range(uint32_t virt, uint32_t size);
+int paging_protect(uint32_t virt, uint32_t size, uint32_t flags);
+int paging_translate(uint32_t virt, uint32_t* phys);
+
+/* Zero-filled memory that costs nothing until touched; flags take PAGE_WRITE/PAGE_USER. */
+void* paging_alloc_lazy(uint32_t size, uint32_t flags);
+void paging_free_lazy(void* addr);
+int paging_populate(void* addr, uint32_t size);
+uint32_t paging_lazy_resident(void);
+
+int page_fault_handler(uint32_t addr, uint32_t error);
+
+#endif
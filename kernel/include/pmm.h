@@ -0,0 +1,32 @@
+
+
+#ifndef PMM_H
+#define PMM_H
+
+#include <stdint.h>
+#include "multiboot.h"
+
+#define PMM_FRAME_SIZE 4096
+
+/* Used when the boot loader passes no memory information at all. */
+#define PMM_FALLBACK_TOP (32 * 1024 * 1024)
+
+/* execute_binary() loads programs here; the region is never handed out. */
+#define USER_LOAD_BASE 0x200000
+#define USER_LOAD_END 0x400000
+
+void pmm_init(multiboot_info_t* mb_info, uint32_t magic);
+void pmm_reserve(uint32_t base, uint32_t size);
+
+uint32_t frame_alloc(void);
+void frame_free(uint32_t frame);
+
+/* Physically contiguous run of count frames ending below limit (0 = anywhere). */
+uint32_t frame_alloc_contig(uint32_t count, uint32_t limit);
+void frame_free_contig(uint32_t base, uint32_t count);
+
+uint32_t pmm_total_frames(void);
+uint32_t pmm_frame_limit(void);
+uint32_t pmm_free_frames(void);
+
+#endif
@@ -0,0 +1,103 @@
+
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+#include "arena.h"
+#include "irq.h"
+
+#define THREAD_NAME_LEN 16
+#define THREAD_STACK_SIZE (64 * 1024)
+
+/* Ticks a thread may run before it is preempted in favour of the next ready one. */
+#define SCHED_SLICE_TICKS 10
+
+/* FXSAVE image size; fpu_area has 16 bytes of slack for its alignment. */
+#define FPU_STATE_SIZE 512
+
+typedef enum {
+    THREAD_RUNNING,
+    THREAD_READY,
+    THREAD_BLOCKED,
+    THREAD_SLEEPING,
+    THREAD_DEAD
+} thread_state_t;
+
+typedef struct thread {
+    uint32_t esp;               /* saved by switch_context, must stay first */
+    int tid;
+    char name[THREAD_NAME_LEN];
+    thread_state_t state;
+    void (*entry)(void* arg);
+    void* arg;
+    uint8_t* stack;             /* fully backed; NULL for the boot thread */
+    arena_t scratch;
+    struct thread* next;        /* run queue or wait queue link */
+    struct thread* all_next;
+    uint64_t runtime;           /* ticks spent running */
+    uint32_t switches;
+    uint32_t slice;
+    int fpu_used;
+    uint8_t fpu_area[FPU_STATE_SIZE + 16];
+} thread_t;
+
+typedef struct {
+    thread_t* head;
+    thread_t* tail;
+} wait_queue_t;
+
+/* Always inlined, so the interrupts-off trace records the caller's address rather than this one. */
+static inline __attribute__((always_inline)) uint32_t irq_save(void) {
+    uint32_t flags;
+    __asm__ volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    if (flags & 0x200) irq_trace_off();
+    return flags;
+}
+
+static inline __attribute__((always_inline)) void irq_restore(uint32_t flags) {
+    if (flags & 0x200) {
+        irq_trace_on();
+        __asm__ volatile("sti" : : : "memory");
+    }
+}
+
+/* Turns the boot context into the first thread and starts the idle thread. */
+void sched_init(const char* name);
+int sched_running(void);
+/* Number of threads waiting for the CPU, not counting the idle thread. */
+int sched_runnable(void);
+thread_t* sched_current(void);
+/* First entry of the list of all threads, linked through all_next. */
+thread_t* sched_threads(void);
+uint32_t sched_switches(void);
+const char* thread_state_name(thread_state_t state);
+
+/* Starts entry(arg) in a new thread; returns its id or -1. */
+int thread_create(const char* name, void (*entry)(void* arg), void* arg);
+void thread_exit(void) __attribute__((noreturn));
+void thread_yield(void);
+void thread_sleep_ms(uint32_t ms);
+
+/* Hooks for the timer and interrupt paths. */
+void sched_tick(uint32_t ticks);
+void sched_preempt(void);
+void sched_fpu_trap(void);
+
+/*
+ * Wait queues. wait_sleep() must be called with interrupts disabled, after
+ * the caller has checked its condition, so a wakeup cannot slip in between;
+ * wait_event() wraps that pattern. Wakeups are safe from timer callbacks.
+ */
+void wait_queue_init(wait_queue_t* wq);
+void wait_sleep(wait_queue_t* wq);
+void wake_up(wait_queue_t* wq);
+void wake_up_one(wait_queue_t* wq);
+
+#define wait_event(wq, cond) do {           \
+    uint32_t __flags = irq_save();          \
+    while (!(cond)) wait_sleep(wq);         \
+    irq_restore(__flags);                   \
+} while (0)
+
+#endif
@@ -0,0 +1,88 @@
+
+
+#ifndef SMP_H
+#define SMP_H
+
+#include <stdint.h>
+#include "gdt.h"
+#include "spinlock.h"
+
+/*
+ * Multiprocessor bring-up. smp_init() finds the CPUs in the ACPI MADT and
+ * starts each application processor (AP) with INIT-SIPI-SIPI through a
+ * real-mode trampoline copied to SMP_TRAMPOLINE. Every CPU gets its own
+ * GDT and TSSs, boot stack, cpu_t and local APIC.
+ *
+ * The scheduler, softirqs and the 8259 lines stay on the bootstrap CPU;
+ * APs idle in hlt with their local APIC timer masked and only wake for
+ * IPIs. Work reaches them through smp_call(), whose function runs in
+ * interrupt context on the target CPU and must not sleep or touch
+ * scheduler state.
+ */
+
+#define SMP_MAX_CPUS 8
+#define SMP_STACK_SIZE (16 * 1024)
+/* Page the startup IPI points the AP at; must be below 1 MB and 4 KB aligned. */
+#define SMP_TRAMPOLINE 0x8000
+
+/* IPI vectors, above the PIC and LAPIC timer range. */
+#define IPI_CALL_VECTOR 0xF0
+
+/* Local APIC interrupt command register, low word. */
+#define ICR_FIXED 0x000
+#define ICR_INIT 0x500
+#define ICR_STARTUP 0x600
+#define ICR_ASSERT 0x4000
+#define ICR_PENDING 0x1000
+
+/* How long smp_call() waits for the target before giving up. */
+#define SMP_CALL_TIMEOUT_MS 100
+
+typedef struct cpu {
+    uint32_t id;                /* index into the CPU table; 0 is the bootstrap CPU */
+    uint32_t apic_id;
+    volatile int online;
+    uint8_t* stack;
+    cpu_gdt_t* gdt;
+    volatile uint32_t interrupts;
+    volatile uint32_t ipis;
+
+    /* smp_call() mailbox, guarded by call_lock on the sending side. */
+    spinlock_t call_lock;
+    void (*volatile call_fn)(void* arg);
+    void* call_arg;
+    volatile int call_done;
+} cpu_t;
+
+/* Per-CPU data of the calling CPU; NULL on the bootstrap CPU until smp_init() runs. */
+static inline cpu_t* this_cpu(void) {
+    return (cpu_t*)gdt_current()->cpu;
+}
+
+static inline uint32_t smp_cpu_id(void) {
+    cpu_t* cpu = this_cpu();
+    return cpu ? cpu->id : 0;
+}
+
+/* Needs the timer, clock and scheduler running. */
+void smp_init(void);
+/* CPUs found, including APs that did not start; those stay listed, offline. */
+int smp_cpu_count(void);
+int smp_online_count(void);
+cpu_t* smp_cpu(int id);
+
+/*
+ * Runs fn(arg) on CPU id and waits for it to finish. Returns 0, or -1 if
+ * the CPU is not online or did not answer within SMP_CALL_TIMEOUT_MS.
+ *
+ * kmalloc, pmm, the page tables, the timer wheel and the terminal only
+ * disable interrupts for exclusion, which does not keep another CPU out.
+ * They are bootstrap-CPU only, so fn must not call into them.
+ */
+int smp_call(int id, void (*fn)(void* arg), void* arg);
+void smp_send_ipi(int id, uint8_t vector);
+
+/* Interrupt path of an AP, called from isr_handler(). */
+void smp_ap_interrupt(uint8_t vector);
+
+#endif
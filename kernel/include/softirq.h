@@ -0,0 +1,78 @@
+
+
+#ifndef SOFTIRQ_H
+#define SOFTIRQ_H
+
+#include <stdint.h>
+#include "sched.h"
+
+/*
+ * Deferred interrupt work. Top halves in isr_handler() only acknowledge the
+ * hardware and raise a softirq; softirqs run on the way out of the outermost
+ * interrupt with interrupts enabled, never nested, and must not sleep. Work
+ * that may sleep or take long goes to a work queue, served by its own
+ * kernel thread.
+ */
+
+typedef enum {
+    SOFTIRQ_TIMER,              /* expired wheel timers */
+    SOFTIRQ_IRQ_EVENT,          /* irq_event() wakeups for lines that fired */
+    SOFTIRQ_COUNT
+} softirq_nr_t;
+
+/* Passes over the pending mask per interrupt exit; the rest waits for the next interrupt. */
+#define SOFTIRQ_MAX_ROUNDS 8
+
+typedef struct {
+    const char* name;
+    void (*fn)(void);
+    uint32_t raised;
+    uint32_t runs;
+    uint64_t cycles;
+    uint64_t max_cycles;
+} softirq_t;
+
+typedef struct work {
+    struct work* next;
+    void (*fn)(void* data);
+    void* data;
+    uint64_t queued_at;
+    int pending;
+} work_t;
+
+typedef struct work_queue {
+    const char* name;
+    work_t* head;
+    work_t* tail;
+    wait_queue_t wait;
+    struct work_queue* next_queue;
+    int tid;
+    uint32_t queued;
+    uint32_t done;
+    uint32_t depth;
+    uint32_t max_depth;
+    uint64_t wait_cycles;       /* queue_work() to start of fn */
+    uint64_t max_wait_cycles;
+    uint64_t run_cycles;
+} work_queue_t;
+
+/* Shared queue served by the "kworker" thread. */
+extern work_queue_t system_wq;
+
+/* Starts the system work queue; needs the scheduler. */
+void softirq_init(void);
+
+/* Safe from any context. */
+void softirq_raise(softirq_nr_t nr);
+/* Called with interrupts disabled; returns the same way. */
+void softirq_run(void);
+const softirq_t* softirq_get(softirq_nr_t nr);
+
+void work_init(work_t* work, void (*fn)(void* data), void* data);
+int work_queue_init(work_queue_t* wq, const char* name);
+/* Returns 1 if queued, 0 if the work was already pending. Safe from any context. */
+int queue_work(work_queue_t* wq, work_t* work);
+/* First registered queue; the rest are linked through next_queue. */
+work_queue_t* work_queues(void);
+
+#endif
@@ -0,0 +1,22 @@
+
+#ifndef TAR_H
+#define TAR_H
+
+#include <stdint.h>
+#include "vfs.h"
+
+int tar_index_build(void* archive);
+int tar_index_entries(void);
+
+void* tar_find(void* archive, const char* path, int* size);
+void* tar_lookup(void* archive, const char* filename);
+int tar_get_file_size(void* archive, const char* filename);
+int tar_check_path_exists(void* archive, const char* path);
+int tar_is_directory(void* archive, const char* path);
+void tar_get_directories(void* archive, char directories[][256], int* count);
+void tar_list_directory(void* archive, const char* dirpath);
+void tar_list_files(void* archive);
+
+extern const vfs_ops_t tar_vfs_ops;
+
+#endif
@@ -0,0 +1,96 @@
+
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+/* One tick per millisecond; the ms helpers below rely on it. */
+#define TIMER_HZ 1000
+
+#define PIT_FREQUENCY 1193182
+#define PIT_DIVISOR ((PIT_FREQUENCY + TIMER_HZ / 2) / TIMER_HZ)
+/* Exact tick length, since the PIT cannot hit 1 kHz precisely. */
+#define TIMER_NS_PER_TICK ((uint32_t)((uint64_t)PIT_DIVISOR * 1000000000ULL / PIT_FREQUENCY))
+
+#define TIMER_PIT_VECTOR 32
+#define TIMER_LAPIC_VECTOR 48
+#define LAPIC_SPURIOUS_VECTOR 0xFF
+
+void timer_init(void);
+void timer_tick(void);
+void timer_interrupt(void);
+void lapic_eoi(void);
+/* Whether the tick comes from the local APIC, which SMP needs. */
+int lapic_timer_running(void);
+uint32_t lapic_id(void);
+/* Writes the interrupt command register and waits until the IPI is sent. */
+void lapic_send_ipi(uint32_t apic_id, uint32_t icr);
+void timer_ap_init(void);
+const char* timer_source(void);
+
+/* Ticks since timer_init(); the 32-bit count wraps after about 49 days. */
+uint32_t timer_ticks(void);
+uint64_t timer_ticks64(void);
+
+/* Monotonic nanoseconds since timer_init(), at tick resolution. */
+uint64_t ktime_get(void);
+
+static inline uint32_t ktime_get_ms(void) {
+    return timer_ticks();
+}
+
+/*
+ * Deadline helpers for polling loops. Ticks only advance while interrupts
+ * are enabled, so these must not be used with IF clear.
+ */
+static inline uint32_t timer_deadline(uint32_t ms) {
+    return timer_ticks() + ms * (TIMER_HZ / 1000);
+}
+
+static inline int timer_expired(uint32_t deadline) {
+    return (int32_t)(timer_ticks() - deadline) >= 0;
+}
+
+/* Blocks the calling thread until a wheel timer fires; before the scheduler starts, halts instead. */
+void timer_sleep_ms(uint32_t ms);
+
+/* Idle loops call this instead of spinning; returns after the next interrupt. */
+void timer_idle(void);
+
+/*
+ * Timer wheel. Callbacks run from the timer softirq, after the tick interrupt
+ * has been acknowledged, with interrupts enabled, one at a time; they may
+ * re-arm their own timer but must not sleep.
+ */
+typedef struct timer_link {
+    struct timer_link* next;
+    struct timer_link* prev;
+} timer_link_t;
+
+typedef struct {
+    timer_link_t link;
+    uint32_t expires;
+    void (*fn)(void* data);
+    void* data;
+} ktimer_t;
+
+void timer_setup(ktimer_t* timer, void (*fn)(void* data), void* data);
+/* Arms an idle timer to fire delay_ms from now; fails if it is already pending. */
+int timer_add(ktimer_t* timer, uint32_t delay_ms);
+/* Re-arms the timer whether or not it is pending. */
+void timer_mod(ktimer_t* timer, uint32_t delay_ms);
+/* Returns 1 if the timer was pending and will no longer fire. */
+int timer_cancel(ktimer_t* timer);
+
+static inline int timer_pending(const ktimer_t* timer) {
+    return timer->link.next != 0;
+}
+
+void timer_wheel_init(void);
+void timer_wheel_advance(uint32_t now);
+/* Ticks from now until the wheel next has work, at most limit; 0 if callbacks are waiting. */
+uint32_t timer_next_expiry(uint32_t now, uint32_t limit);
+void timer_run_expired(void);
+
+#endif
@@ -0,0 +1,31 @@
+
+
+#ifndef TMPFS_H
+#define TMPFS_H
+
+#include <stdint.h>
+#include "vfs.h"
+
+#define TMPFS_MAX_INSTANCES 4
+/* Node numbers are 16 bits; nodes are allocated TMPFS_SLAB_NODES at a time. */
+#define TMPFS_MAX_NODES 65536
+#define TMPFS_SLAB_NODES 32
+#define TMPFS_MAX_NAME 64
+#define TMPFS_HASH_SIZE 4096
+
+/* Node type used by the overlay to hide lower-layer entries. */
+#define TMPFS_TYPE_WHITEOUT 3
+
+#define TMPFS_PAGE_SIZE 4096
+#define TMPFS_DIRECT_PAGES 8
+#define TMPFS_INDIRECT_PAGES (TMPFS_PAGE_SIZE / sizeof(uint8_t*))
+#define TMPFS_MAX_FILE_SIZE ((TMPFS_DIRECT_PAGES + TMPFS_INDIRECT_PAGES) * TMPFS_PAGE_SIZE)
+
+int tmpfs_mount(const char* path);
+int tmpfs_attach(vfs_mount_t* mnt);
+int tmpfs_set_backing(vfs_mount_t* mnt, uint32_t ino, const void* data, uint32_t size);
+uint32_t tmpfs_pages_used(void);
+
+extern const vfs_ops_t tmpfs_ops;
+
+#endif
@@ -0,0 +1,142 @@
+
+
+#ifndef VFS_H
+#define VFS_H
+
+#include <stdint.h>
+
+#define VFS_MAX_PATH 256
+#define VFS_MAX_NAME 128
+#define VFS_MAX_MOUNTS 8
+#define VFS_MAX_FDS 32
+#define VFS_CACHE_SIZE 64
+#define VFS_MAX_MAPS 16
+#define VFS_MAP_RESIDENT 1024
+
+#define VFS_TYPE_FILE 1
+#define VFS_TYPE_DIR 2
+
+#define VFS_O_RDONLY 0x00
+#define VFS_O_WRONLY 0x01
+#define VFS_O_RDWR 0x02
+#define VFS_O_ACCMODE 0x03
+#define VFS_O_CREAT 0x04
+#define VFS_O_TRUNC 0x08
+#define VFS_O_APPEND 0x10
+#define VFS_O_DIRECTORY 0x20
+
+#define VFS_SEEK_SET 0
+#define VFS_SEEK_CUR 1
+#define VFS_SEEK_END 2
+
+#define VFS_EINVAL -1
+#define VFS_ENOENT -2
+#define VFS_ENOTDIR -3
+#define VFS_EISDIR -4
+#define VFS_EEXIST -5
+#define VFS_EROFS -6
+#define VFS_ENOSPC -7
+#define VFS_EMFILE -8
+#define VFS_EBADF -9
+#define VFS_EIO -10
+#define VFS_EBUSY -11
+#define VFS_ENOTEMPTY -12
+
+struct vfs_mount;
+
+typedef struct {
+    struct vfs_mount* mnt;
+    uint32_t ino;
+    uint32_t size;
+    uint8_t type;
+    uint32_t fsdata[4];
+} vfs_node_t;
+
+typedef struct {
+    vfs_node_t node;
+    char path[VFS_MAX_PATH];
+    uint32_t offset;
+    uint32_t flags;
+    uint32_t cursor[4];
+    int mount_pos;
+    uint8_t used;
+} vfs_file_t;
+
+typedef struct {
+    char name[VFS_MAX_NAME];
+    uint8_t type;
+    uint32_t size;
+} vfs_dirent_t;
+
+typedef struct {
+    uint8_t type;
+    uint32_t size;
+    uint32_t ino;
+} vfs_stat_t;
+
+/*
+ * Backend operations. Paths handed to a backend are relative to its mount
+ * point, without leading or trailing slashes ("" is the mount root).
+ * Missing write-side operations make the mount read-only. open is optional
+ * and may replace file->node before the descriptor is handed out. reserve is
+ * an allocation hint for a file about to be written to the given size.
+ */
+typedef struct {
+    const char* name;
+    int (*lookup)(struct vfs_mount* mnt, const char* path, vfs_node_t* node);
+    int (*read)(vfs_file_t* file, void* buffer, uint32_t size);
+    int (*write)(vfs_file_t* file, const void* buffer, uint32_t size);
+    int (*readdir)(vfs_file_t* file, vfs_dirent_t* entry);
+    int (*create)(struct vfs_mount* mnt, const char* path, uint8_t type, vfs_node_t* node);
+    int (*unlink)(struct vfs_mount* mnt, const char* path);
+    int (*truncate)(vfs_file_t* file, uint32_t size);
+    const void* (*map)(vfs_node_t* node);
+    int (*open)(vfs_file_t* file);
+    int (*reserve)(vfs_file_t* file, uint32_t size);
+} vfs_ops_t;
+
+typedef struct vfs_mount {
+    char path[64];
+    int path_len;
+    const vfs_ops_t* ops;
+    void* priv;
+    uint8_t used;
+} vfs_mount_t;
+
+void vfs_init(void);
+int vfs_mount(const char* path, const vfs_ops_t* ops, void* priv);
+int vfs_umount(const char* path);
+vfs_mount_t* vfs_get_mount(int index);
+
+int vfs_resolve(const char* path, char* out);
+int vfs_lookup(const char* path, vfs_node_t* node);
+void vfs_cache_update(const vfs_node_t* node);
+
+int vfs_open(const char* path, uint32_t flags);
+int vfs_read(int fd, void* buffer, uint32_t size);
+int vfs_write(int fd, const void* buffer, uint32_t size);
+int vfs_seek(int fd, int offset, int whence);
+int vfs_reserve(int fd, uint32_t size);
+int vfs_close(int fd);
+int vfs_readdir(int fd, vfs_dirent_t* entry);
+int vfs_fstat(int fd, vfs_stat_t* st);
+const void* vfs_map(int fd);
+
+/*
+ * Read-only file mappings. Backends with a map op are mapped directly onto
+ * their existing pages; everything else is faulted in a page at a time
+ * through the backend read, with at most VFS_MAP_RESIDENT pages resident.
+ * length 0 maps to the end of the file.
+ */
+void* vfs_mmap(int fd, uint32_t offset, uint32_t length);
+int vfs_munmap(void* addr);
+int vfs_mmap_fault(uint32_t addr);
+uint32_t vfs_mmap_resident_pages(void);
+
+int vfs_stat(const char* path, vfs_stat_t* st);
+int vfs_mkdir(const char* path);
+int vfs_unlink(const char* path);
+
+const char* vfs_strerror(int err);
+
+#endif
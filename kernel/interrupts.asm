@@ -1,58 +1,154 @@
-
-
 [bits 32]
 extern isr_handler
-global irq1
-global irq12
+global irq_stub_table
+global irq_spurious
 
-irq1:
-    push byte 0      
-    push byte 33     
-    pusha            
+; Hardware interrupts share the exception frame layout, with a zero error code.
+; One stub per vector from 32 up; irq_dispatch() sorts out PIC lines and APIC vectors.
+%assign i 32
+%rep 224
+irq%+i:
+    push dword 0
+    push dword i
+    jmp irq_common
+%assign i i+1
+%endrep
 
-    mov ax, ds       
+irq_common:
+    pusha
+
+    mov ax, ds
     push eax
 
-    mov ax, 0x10     
+    mov ax, 0x10
     mov ds, ax
     mov es, ax
     mov fs, ax
     mov gs, ax
 
-    call isr_handler 
+    ; isr_handler(regs, entry): the entry timestamp goes by value since
+    ; every CPU takes interrupts through here.
+    rdtsc
+    push edx
+    push eax
+    lea eax, [esp + 8]
+    push eax
+    call isr_handler
+    add esp, 12
 
-    pop eax          
+    pop eax
     mov ds, ax
     mov es, ax
     mov fs, ax
     mov gs, ax
 
-    popa             
-    add esp, 8       
-    iret             
+    popa
+    add esp, 8
+    iret
+
+; The local APIC does not expect an EOI for spurious interrupts.
+irq_spurious:
+    iret
+
+; CPU exceptions. Vectors that do not push an error code get a dummy 0 so
+; every frame has the same layout (see interrupt_regs_t).
+extern exception_handler
+global isr_stub_table
 
-irq12:
-    push byte 0      
-    push byte 44     
-    pusha            
+%macro ISR_NOERR 1
+isr%1:
+    push dword 0
+    push dword %1
+    jmp isr_common
+%endmacro
 
-    mov ax, ds       
+%macro ISR_ERR 1
+isr%1:
+    push dword %1
+    jmp isr_common
+%endmacro
+
+ISR_NOERR 0
+ISR_NOERR 1
+ISR_NOERR 2
+ISR_NOERR 3
+ISR_NOERR 4
+ISR_NOERR 5
+ISR_NOERR 6
+ISR_NOERR 7
+ISR_ERR   8
+ISR_NOERR 9
+ISR_ERR   10
+ISR_ERR   11
+ISR_ERR   12
+ISR_ERR   13
+ISR_ERR   14
+ISR_NOERR 15
+ISR_NOERR 16
+ISR_ERR   17
+ISR_NOERR 18
+ISR_NOERR 19
+ISR_NOERR 20
+ISR_ERR   21
+ISR_NOERR 22
+ISR_NOERR 23
+ISR_NOERR 24
+ISR_NOERR 25
+ISR_NOERR 26
+ISR_NOERR 27
+ISR_NOERR 28
+ISR_NOERR 29
+ISR_ERR   30
+ISR_NOERR 31
+
+isr_common:
+    pusha
+
+    mov ax, ds
     push eax
 
-    mov ax, 0x10     
+    mov ax, 0x10
     mov ds, ax
     mov es, ax
     mov fs, ax
     mov gs, ax
 
-    call isr_handler 
+    push esp
+    call exception_handler
+    add esp, 4
 
-    pop eax          
+    pop eax
     mov ds, ax
     mov es, ax
     mov fs, ax
     mov gs, ax
 
-    popa             
-    add esp, 8       
-    iret             
\ No newline at end of file
+    popa
+    add esp, 8
+    iret
+
+; Entered by a task switch through the page fault gate, on the fault task's own
+; stack with the error code on top. iret switches back to the faulting context,
+; and the next fault resumes this task just after it.
+global page_fault_entry
+extern page_fault_task
+
+page_fault_entry:
+    call page_fault_task
+    add esp, 4
+    iret
+    jmp page_fault_entry
+
+isr_stub_table:
+%assign i 0
+%rep 32
+    dd isr%+i
+%assign i i+1
+%endrep
+
+irq_stub_table:
+%assign i 32
+%rep 224
+    dd irq%+i
+%assign i i+1
+%endrep
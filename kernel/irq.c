@@ -0,0 +1,257 @@
+
+
+#include <stdint.h>
+#include <io.h>
+#include "include/irq.h"
+#include "include/lib.h"
+#include "include/sched.h"
+#include "include/timer.h"
+#include "include/clock.h"
+#include "include/event.h"
+#include "include/smp.h"
+
+#define PIC1_COMMAND 0x20
+#define PIC1_DATA 0x21
+#define PIC2_COMMAND 0xA0
+#define PIC2_DATA 0xA1
+#define PIC_EOI 0x20
+#define PIC_READ_ISR 0x0B
+
+static irq_vector_t vectors[IRQ_VECTORS];
+static irq_action_t action_pool[IRQ_MAX_ACTIONS];
+
+static uint64_t handling_entry;
+
+static irqs_off_stats_t irqs_off;
+static uint64_t irqs_off_start;
+static uint32_t irqs_off_site;
+
+static int irq_hist_bucket(uint64_t cycles) {
+    uint32_t hi = (uint32_t)(cycles >> 32);
+    uint32_t lo = (uint32_t)cycles;
+    int bucket = 0;
+
+    if (hi) return IRQ_HIST_BUCKETS - 1;
+    while (lo > 1 && bucket < IRQ_HIST_BUCKETS - 1) {
+        lo >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+static void irqs_off_end(void) {
+    uint64_t cycles = clock_cycles() - irqs_off_start;
+    irqs_off_start = 0;
+
+    irqs_off.count++;
+    irqs_off.cycles += cycles;
+    if (cycles > irqs_off.max_cycles) {
+        irqs_off.max_cycles = cycles;
+        irqs_off.max_site = irqs_off_site;
+    }
+    irqs_off.hist[irq_hist_bucket(cycles)]++;
+}
+
+/* The bookkeeping below is the bootstrap CPU's; application processors are not traced. */
+void irq_trace_off(void) {
+    if (irqs_off_start || smp_cpu_id()) return;
+    irqs_off_start = clock_cycles();
+    irqs_off_site = (uint32_t)__builtin_return_address(0);
+}
+
+void irq_trace_on(void) {
+    if (irqs_off_start && !smp_cpu_id()) irqs_off_end();
+}
+
+/*
+ * Interrupts are only taken with IF set, so no section can be open here
+ * unless a cli went untraced; that stale one is closed first.
+ */
+void irq_trace_entry(uint8_t vector, uint64_t entry) {
+    handling_entry = entry;
+    if (irqs_off_start) irqs_off_end();
+    irqs_off_start = handling_entry;
+    irqs_off_site = vector;
+}
+
+uint64_t irq_entry_cycles(void) {
+    return handling_entry;
+}
+
+void irq_latency_sample(uint8_t vector, uint64_t cycles) {
+    irq_vector_t* v = &vectors[vector];
+    v->latency_count++;
+    if (cycles > v->latency_max) v->latency_max = cycles;
+    v->latency_hist[irq_hist_bucket(cycles)]++;
+}
+
+void irq_install(void) {
+    outb(PIC1_COMMAND, 0x11);
+    outb(PIC2_COMMAND, 0x11);
+
+    outb(PIC1_DATA, IRQ_VECTOR_BASE);
+    outb(PIC2_DATA, IRQ_VECTOR_BASE + 8);
+
+    outb(PIC1_DATA, 0x04);
+    outb(PIC2_DATA, 0x02);
+
+    outb(PIC1_DATA, 0x01);
+    outb(PIC2_DATA, 0x01);
+
+    /* Lines stay masked until a driver registers for them. */
+    outb(PIC1_DATA, 0xFF & ~(1 << IRQ_CASCADE));
+    outb(PIC2_DATA, 0xFF);
+}
+
+void irq_mask(uint8_t irq) {
+    if (irq >= IRQ_LINES) return;
+    uint32_t flags = irq_save();
+    if (irq < 8) {
+        outb(PIC1_DATA, inb(PIC1_DATA) | (1 << irq));
+    } else {
+        outb(PIC2_DATA, inb(PIC2_DATA) | (1 << (irq - 8)));
+    }
+    irq_restore(flags);
+}
+
+void irq_unmask(uint8_t irq) {
+    if (irq >= IRQ_LINES) return;
+    uint32_t flags = irq_save();
+    if (irq < 8) {
+        outb(PIC1_DATA, inb(PIC1_DATA) & ~(1 << irq));
+    } else {
+        outb(PIC2_DATA, inb(PIC2_DATA) & ~(1 << (irq - 8)));
+        outb(PIC1_DATA, inb(PIC1_DATA) & ~(1 << IRQ_CASCADE));
+    }
+    irq_restore(flags);
+}
+
+int irq_register_vector(uint8_t vector, irq_handler_t handler, void* ctx, const char* name) {
+    if (vector < IRQ_VECTOR_BASE || !handler) return -1;
+
+    uint32_t flags = irq_save();
+    irq_action_t* action = 0;
+    for (int i = 0; i < IRQ_MAX_ACTIONS; i++) {
+        if (!action_pool[i].handler) {
+            action = &action_pool[i];
+            break;
+        }
+    }
+    if (!action) {
+        irq_restore(flags);
+        return -1;
+    }
+
+    action->next = 0;
+    action->handler = handler;
+    action->ctx = ctx;
+    action->name = name;
+    action->count = 0;
+
+    irq_action_t** link = &vectors[vector].actions;
+    while (*link) link = &(*link)->next;
+    *link = action;
+    irq_restore(flags);
+    return 0;
+}
+
+int irq_register(uint8_t irq, irq_handler_t handler, void* ctx, const char* name) {
+    if (irq >= IRQ_LINES) return -1;
+    if (irq_register_vector(IRQ_VECTOR_BASE + irq, handler, ctx, name) < 0) return -1;
+    irq_unmask(irq);
+    return 0;
+}
+
+void irq_unregister(uint8_t irq, irq_handler_t handler, void* ctx) {
+    if (irq >= IRQ_LINES) return;
+    irq_vector_t* v = &vectors[IRQ_VECTOR_BASE + irq];
+
+    uint32_t flags = irq_save();
+    for (irq_action_t** link = &v->actions; *link; link = &(*link)->next) {
+        irq_action_t* action = *link;
+        if (action->handler == handler && action->ctx == ctx) {
+            *link = action->next;
+            action->handler = 0;
+            break;
+        }
+    }
+    if (!v->actions && irq != IRQ_CASCADE) irq_mask(irq);
+    irq_restore(flags);
+}
+
+static uint8_t pic_in_service(uint16_t command) {
+    outb(command, PIC_READ_ISR);
+    return inb(command);
+}
+
+/*
+ * A line that drops before the 8259 acknowledges it is reported as IRQ 7
+ * (or 15) with nothing in service. The master must not get an EOI for its
+ * own spurious IRQ; a spurious 15 still came through the cascade, so the
+ * master is acknowledged for that one.
+ */
+static int pic_spurious(uint8_t irq) {
+    if (irq == 7 && !(pic_in_service(PIC1_COMMAND) & 0x80)) return 1;
+    if (irq == 15 && !(pic_in_service(PIC2_COMMAND) & 0x80)) {
+        outb(PIC1_COMMAND, PIC_EOI);
+        return 1;
+    }
+    return 0;
+}
+
+void irq_dispatch(uint8_t vector) {
+    irq_vector_t* v = &vectors[vector];
+    int pic = vector >= IRQ_VECTOR_BASE && vector < IRQ_APIC_BASE;
+    uint8_t irq = vector - IRQ_VECTOR_BASE;
+
+    if (pic && pic_spurious(irq)) {
+        v->spurious++;
+        return;
+    }
+
+    uint64_t start = clock_cycles();
+    int handled = IRQ_NONE;
+    for (irq_action_t* action = v->actions; action; action = action->next) {
+        if (action->handler(action->ctx) == IRQ_HANDLED) {
+            action->count++;
+            handled = IRQ_HANDLED;
+        }
+    }
+    uint64_t cycles = clock_cycles() - start;
+
+    v->count++;
+    if (handled == IRQ_NONE) v->unhandled++;
+    v->cycles += cycles;
+    if (cycles > v->max_cycles) v->max_cycles = cycles;
+    v->duration_hist[irq_hist_bucket(cycles)]++;
+
+    if (pic) {
+        irq_event_raise(irq);
+        if (irq >= 8) outb(PIC2_COMMAND, PIC_EOI);
+        outb(PIC1_COMMAND, PIC_EOI);
+    } else {
+        lapic_eoi();
+    }
+}
+
+const irq_vector_t* irq_vector(uint8_t vector) {
+    return &vectors[vector];
+}
+
+const irqs_off_stats_t* irqs_off_stats(void) {
+    return &irqs_off;
+}
+
+void irq_reset_stats(void) {
+    uint32_t flags = irq_save();
+    for (int vec = 0; vec < IRQ_VECTORS; vec++) {
+        irq_action_t* actions = vectors[vec].actions;
+        memset(&vectors[vec], 0, sizeof(irq_vector_t));
+        vectors[vec].actions = actions;
+        for (irq_action_t* action = actions; action; action = action->next) {
+            action->count = 0;
+        }
+    }
+    memset(&irqs_off, 0, sizeof(irqs_off));
+    irq_restore(flags);
+}
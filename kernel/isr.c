@@ -2,8 +2,149 @@
 
 #include <stdint.h>
 #include <io.h>
+#include "include/idt.h"
+#include "include/arena.h"
+#include "include/paging.h"
+#include "include/timer.h"
+#include "include/sched.h"
+#include "include/gdt.h"
+#include "include/irq.h"
+#include "include/softirq.h"
+#include "include/smp.h"
 
-void isr_handler(uint32_t int_no) {
-    if (int_no >= 40) outb(0xA0, 0x20);
-    outb(0x20, 0x20);
-}
\ No newline at end of file
+extern void terminal_writestring(const char* s);
+
+static const char* exception_names[32] = {
+    "Divide error", "Debug", "NMI", "Breakpoint",
+    "Overflow", "Bound range exceeded", "Invalid opcode", "Device not available",
+    "Double fault", "Coprocessor segment overrun", "Invalid TSS", "Segment not present",
+    "Stack fault", "General protection fault", "Page fault", "Reserved",
+    "x87 floating point", "Alignment check", "Machine check", "SIMD floating point",
+    "Virtualization", "Control protection", "Reserved", "Reserved",
+    "Reserved", "Reserved", "Reserved", "Reserved",
+    "Reserved", "Reserved", "Security", "Reserved"
+};
+
+/* Interrupts nest once timer callbacks re-enable them; only the outermost may switch threads. */
+static int irq_nesting;
+
+void isr_handler(interrupt_regs_t* regs, uint64_t entry) {
+    /* Application processors only take their own tick and IPIs; the rest of this path is the BSP's. */
+    if (smp_cpu_id() != 0) {
+        smp_ap_interrupt(regs->int_no);
+        return;
+    }
+
+    irq_trace_entry(regs->int_no, entry);
+    uint32_t mark = scratch_irq_enter();
+    irq_nesting++;
+
+    irq_dispatch(regs->int_no);
+
+    /* Bottom halves run after the EOI so further interrupts can arrive meanwhile. */
+    softirq_run();
+    scratch_irq_exit(mark);
+    if (--irq_nesting == 0) sched_preempt();
+    /* iret sets IF again. */
+    irq_trace_on();
+}
+
+static void exception_reg(const char* name, uint32_t value) {
+    char buf[12];
+    buf[0] = ' ';
+    for (int i = 0; i < 8; i++) {
+        buf[1 + i] = "0123456789ABCDEF"[(value >> (28 - i * 4)) & 0xF];
+    }
+    buf[9] = '\0';
+    terminal_writestring(name);
+    terminal_writestring(buf);
+    terminal_writestring("  ");
+}
+
+static void exception_dump(interrupt_regs_t* regs, uint32_t esp, uint32_t cr2) {
+    terminal_writestring("\n*** ");
+    terminal_writestring(exception_names[regs->int_no]);
+    terminal_writestring(" ***\n");
+
+    exception_reg("EIP", regs->eip);
+    exception_reg("CS ", regs->cs);
+    exception_reg("EFL", regs->eflags);
+    exception_reg("ERR", regs->err_code);
+    terminal_writestring("\n");
+    exception_reg("EAX", regs->eax);
+    exception_reg("EBX", regs->ebx);
+    exception_reg("ECX", regs->ecx);
+    exception_reg("EDX", regs->edx);
+    terminal_writestring("\n");
+    exception_reg("ESI", regs->esi);
+    exception_reg("EDI", regs->edi);
+    exception_reg("EBP", regs->ebp);
+    exception_reg("ESP", esp);
+    terminal_writestring("\n");
+    exception_reg("DS ", regs->ds);
+    if (regs->int_no == 14) {
+        exception_reg("CR2", cr2);
+        terminal_writestring((regs->err_code & PF_WRITE) ? "(write, " : "(read, ");
+        terminal_writestring((regs->err_code & PF_PRESENT) ? "protection)" : "not present)");
+    }
+    terminal_writestring("\n");
+}
+
+static void exception_halt(void) {
+    terminal_writestring("System halted.\n");
+    for (;;) {
+        __asm__ volatile("cli; hlt");
+    }
+}
+
+void exception_handler(interrupt_regs_t* regs) {
+    uint32_t cr2 = 0;
+
+    if (regs->int_no == 7) {
+        sched_fpu_trap();
+        return;
+    }
+    if (regs->int_no == 14) {
+        __asm__ volatile("mov %%cr2, %0" : "=r"(cr2));
+        if (page_fault_handler(cr2, regs->err_code) == 0) return;
+    }
+
+    /* pusha saved ESP before the CPU frame; no privilege change, so the faulting ESP is just above it. */
+    exception_dump(regs, (uint32_t)&regs->eflags + 4, cr2);
+    if (regs->int_no == 1 || regs->int_no == 3) return;
+    exception_halt();
+}
+
+/*
+ * Page faults once fault_task_init() has run: entered by a task switch from
+ * page_fault_entry, on the fault task's stack. The faulting context sits in
+ * this CPU's kernel TSS and is resumed by the task switch back.
+ */
+void page_fault_task(uint32_t err) {
+    uint32_t cr2;
+    __asm__ volatile("mov %%cr2, %0" : "=r"(cr2));
+    if (page_fault_handler(cr2, err) == 0) return;
+
+    tss_t* tss = &gdt_current()->tss;
+    interrupt_regs_t regs;
+    regs.ds = tss->ds;
+    regs.edi = tss->edi;
+    regs.esi = tss->esi;
+    regs.ebp = tss->ebp;
+    regs.esp = tss->esp;
+    regs.ebx = tss->ebx;
+    regs.edx = tss->edx;
+    regs.ecx = tss->ecx;
+    regs.eax = tss->eax;
+    regs.int_no = 14;
+    regs.err_code = err;
+    regs.eip = tss->eip;
+    regs.cs = tss->cs;
+    regs.eflags = tss->eflags;
+
+    exception_dump(&regs, tss->esp, cr2);
+    if (tss->esp - (uint32_t)PAGE_SIZE < cr2 && cr2 < tss->esp + (uint32_t)PAGE_SIZE) {
+        terminal_writestring("Kernel stack overflow.\n");
+    }
+    exception_halt();
+}
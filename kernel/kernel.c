@@ -5,6 +5,22 @@
 #include <stddef.h>
 #include "include/version.h"
 #include "include/lib.h"
+#include "include/lz4.h"
+#include "include/tar.h"
+#include "include/vfs.h"
+#include "include/tmpfs.h"
+#include "include/overlay.h"
+#include "include/paging.h"
+#include "include/pmm.h"
+#include "include/arena.h"
+#include "include/timer.h"
+#include "include/clock.h"
+#include "include/acpi.h"
+#include "include/sched.h"
+#include "include/softirq.h"
+#include "include/irq.h"
+#include "include/keyboard.h"
+#include "include/smp.h"
 
 static inline void outb(uint16_t port, uint8_t val) {
     __asm__ volatile("outb %0, %1" : : "a"(val), "Nd"(port));
@@ -48,8 +64,8 @@ void kmain(multiboot_info_t* mb_info, uint32_t magic);
 
 const multiboot_header_t __attribute__((section(".multiboot"))) header = {
     .magic = MULTIBOOT_HEADER_MAGIC,
-    .flags = 0,
-    .checksum = -(MULTIBOOT_HEADER_MAGIC + 0)
+    .flags = MULTIBOOT_PAGE_ALIGN | MULTIBOOT_MEMORY_INFO,
+    .checksum = -(MULTIBOOT_HEADER_MAGIC + MULTIBOOT_PAGE_ALIGN + MULTIBOOT_MEMORY_INFO)
 };
 
 #define VIDEO_MEMORY 0xB8000
@@ -196,7 +212,7 @@ void terminal_set_background_rgb(uint8_t r, uint8_t g, uint8_t b) {
     }
 }
 
-void terminal_putchar(char c) {
+static void terminal_putchar_locked(char c) {
     if (term_capture_enabled && term_capture_buffer && term_capture_size > 0) {
         if (c == '\b') {
             if (term_capture_pos > 0) term_capture_pos--;
@@ -238,6 +254,13 @@ void terminal_putchar(char c) {
     terminal_update_cursor();
 }
 
+/* The shell and kernel threads share the cursor, so output is written with interrupts off. */
+void terminal_putchar(char c) {
+    uint32_t flags = irq_save();
+    terminal_putchar_locked(c);
+    irq_restore(flags);
+}
+
 void terminal_putchar_at(int col, int row, char c) {
     if (row >= 0 && row < VGA_HEIGHT && col >= 0 && col < VGA_WIDTH) {
         video_memory[row * VGA_WIDTH + col] = (uint16_t)c | (uint16_t)current_attr << 8;
@@ -252,6 +275,7 @@ char terminal_getchar_at(int col, int row) {
 }
 
 void terminal_writestring(const char* s) {
+    uint32_t flags = irq_save();
     while (*s) {
         if (*s == '\033' && *(s+1) == '[') {
             s += 2;
@@ -272,15 +296,17 @@ void terminal_writestring(const char* s) {
                 if (*s == 'm') s++;
             }
         } else {
-            terminal_putchar(*s);
+            terminal_putchar_locked(*s);
             s++;
         }
     }
+    irq_restore(flags);
 }
 
 void terminal_display_time() {
-    int hours, minutes, seconds;
-    rtc_get_time(&hours, &minutes, &seconds);
+    clock_tm_t tm;
+    clock_to_tm(clock_realtime(), &tm);
+    int hours = tm.hour, minutes = tm.minute, seconds = tm.second;
 
     int saved_col = term_col;
     int saved_row = term_row;
@@ -313,20 +339,65 @@ void terminal_display_time() {
 }
 
 void init_gdt();
+void fault_task_init(void (*entry)(void));
+extern void page_fault_entry();
 void idt_init();
-void irq_install();
 extern void ata_init();
 extern int ata_detect_disks();
+extern int atapi_detect_drives();
 extern void shell_main();
-extern void init_kernel_commands();
 
 void* tar_archive = 0;
-extern char _binary_modules_tar_start[];
+uint32_t tar_archive_size = 0;
+extern char _binary_modules_tar_lz4_start[];
+extern char _binary_modules_tar_lz4_end[];
 
-void kmain(multiboot_info_t* mb_info, uint32_t magic) {
-    (void)magic;
-    (void)mb_info;
+#define INITRD_MAX_SIZE (16 * 1024 * 1024)
+
+static void* initrd_load(void) {
+    uint8_t* image = (uint8_t*)_binary_modules_tar_lz4_start;
+    uint32_t image_size = (uint32_t)(_binary_modules_tar_lz4_end - _binary_modules_tar_lz4_start);
+    char buf[16];
+
+    if (!lz4_is_frame(image, image_size)) {
+        tar_archive_size = image_size;
+        return image;
+    }
+
+    uint32_t size = INITRD_MAX_SIZE;
+    if (lz4_frame_content_size(image, image_size, &size) == 0 && size > INITRD_MAX_SIZE) {
+        terminal_writestring("Initrd: archive too large\n");
+        return 0;
+    }
 
+    uint32_t pages = (size + PMM_FRAME_SIZE - 1) / PMM_FRAME_SIZE;
+    uint8_t* dest = (uint8_t*)frame_alloc_contig(pages, 0);
+    if (!dest) {
+        terminal_writestring("Initrd: out of memory\n");
+        return 0;
+    }
+
+    int n = lz4_decompress_frame(image, image_size, dest, size);
+    if (n < 0) {
+        terminal_writestring("Initrd: corrupt LZ4 image\n");
+        frame_free_contig((uint32_t)dest, pages);
+        return 0;
+    }
+    uint32_t used = ((uint32_t)n + PMM_FRAME_SIZE - 1) / PMM_FRAME_SIZE;
+    frame_free_contig((uint32_t)dest + used * PMM_FRAME_SIZE, pages - used);
+
+    terminal_writestring("Initrd: ");
+    itoa((int)(image_size / 1024), buf);
+    terminal_writestring(buf);
+    terminal_writestring(" KB -> ");
+    itoa(n / 1024, buf);
+    terminal_writestring(buf);
+    terminal_writestring(" KB\n");
+    tar_archive_size = (uint32_t)n;
+    return dest;
+}
+
+void kmain(multiboot_info_t* mb_info, uint32_t magic) {
     terminal_initialize();
 
     terminal_writestring("Lakos OS v");
@@ -336,14 +407,37 @@ void kmain(multiboot_info_t* mb_info, uint32_t magic) {
     init_gdt();
     idt_init();
     irq_install();
-
-    tar_archive = (void*)&_binary_modules_tar_start;
+    pmm_init(mb_info, magic);
+    paging_init();
+    fault_task_init(page_fault_entry);
+    scratch_init();
+    timer_init();
+    /* Before clock_init(), which looks up the HPET in the ACPI tables. */
+    acpi_init();
+    clock_init();
+    sched_init("shell");
+    softirq_init();
+    /* The 8042 is configured before IRQ 1 is live, so its replies are not taken for scancodes. */
+    mouse_install();
+    keyboard_install();
+    smp_init();
+
+    tar_archive = initrd_load();
+    tar_index_build(tar_archive);
+
+    vfs_init();
+    if (tar_archive) {
+        overlay_mount("/", &tar_vfs_ops, tar_archive);
+    } else {
+        tmpfs_mount("/");
+    }
+    tmpfs_mount("/home");
+    tmpfs_mount("/tmp");
 
     ata_init();
     ata_detect_disks();
+    atapi_detect_drives();
 
-    __asm__ volatile("sti");
-    init_kernel_commands();
     shell_main();
 
     while(1) { __asm__ volatile("hlt"); }
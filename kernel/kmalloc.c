@@ -0,0 +1,442 @@
+
+
+#include <stdint.h>
+#include <stddef.h>
+#include "include/lib.h"
+#include "include/pmm.h"
+#include "include/kmalloc.h"
+#include "include/sched.h"
+
+extern void terminal_writestring(const char* s);
+
+/*
+ * Small objects live in one-page slabs. The slab header sits at the start
+ * of the page, so kfree() finds it by rounding the pointer down. Large
+ * objects get a contiguous page run with the same header in front, which
+ * keeps the returned pointer inside the first page.
+ *
+ * Every object is preceded by a kmalloc_hdr_t recording its size and call
+ * site, which is what the per-site and per-subsystem accounting runs on.
+ */
+#define KMALLOC_SLAB_MAGIC 0x534C4142
+#define KMALLOC_LARGE_MAGIC 0x4C415247
+
+#define KMALLOC_LIVE 0xA1
+#define KMALLOC_FREED 0xF7
+#define KMALLOC_GUARD 0xA110CA7E
+
+#define KMALLOC_RZ_SIZE 8
+#define KMALLOC_RZ_BYTE 0xA5
+#define KMALLOC_POISON 0x6B
+
+typedef struct kmalloc_slab {
+    uint32_t magic;
+    uint16_t cls;
+    uint16_t in_use;
+    uint32_t pages;
+    void* free;
+    struct kmalloc_slab* next;
+    struct kmalloc_slab* prev;
+} kmalloc_slab_t;
+
+typedef struct {
+    uint32_t size;
+    uint32_t seq;
+    uint16_t site;
+    uint8_t tag;
+    uint8_t state;
+    uint32_t guard;
+} kmalloc_hdr_t;
+
+#define KMALLOC_OVERHEAD (sizeof(kmalloc_hdr_t) + (KMALLOC_REDZONE ? KMALLOC_RZ_SIZE : 0))
+
+typedef struct {
+    kmalloc_slab_t* partial;
+    kmalloc_slab_t* empty;
+    uint16_t size;
+    uint16_t per_slab;
+} kmalloc_cache_t;
+
+static kmalloc_cache_t caches[KMALLOC_CLASSES];
+static int kmalloc_ready;
+
+static kmalloc_stats_t stats;
+static kmalloc_site_t sites[KMALLOC_MAX_SITES];
+static uint32_t alloc_seq;
+static uint32_t leak_seq;
+static int leak_active;
+
+static const char* tag_names[KM_TAG_COUNT] = {
+    "other", "mm", "fs", "net", "shell", "driver"
+};
+
+static inline __attribute__((always_inline)) uint32_t kmalloc_lock(void) {
+    return irq_save();
+}
+
+static inline __attribute__((always_inline)) void kmalloc_unlock(uint32_t flags) {
+    irq_restore(flags);
+}
+
+static void kmalloc_init(void) {
+    for (int i = 0; i < KMALLOC_CLASSES; i++) {
+        caches[i].size = 1 << (KMALLOC_MIN_SHIFT + i);
+        caches[i].per_slab = (PMM_FRAME_SIZE - KMALLOC_HEADER_SIZE) / caches[i].size;
+        caches[i].partial = NULL;
+        caches[i].empty = NULL;
+    }
+    kmalloc_ready = 1;
+}
+
+static void kmalloc_list_remove(kmalloc_slab_t** head, kmalloc_slab_t* slab) {
+    if (slab->prev) slab->prev->next = slab->next;
+    else *head = slab->next;
+    if (slab->next) slab->next->prev = slab->prev;
+    slab->next = slab->prev = NULL;
+}
+
+static void kmalloc_list_push(kmalloc_slab_t** head, kmalloc_slab_t* slab) {
+    slab->prev = NULL;
+    slab->next = *head;
+    if (*head) (*head)->prev = slab;
+    *head = slab;
+}
+
+static kmalloc_slab_t* kmalloc_slab_new(int cls) {
+    kmalloc_slab_t* slab = (kmalloc_slab_t*)frame_alloc();
+    if (!slab) return NULL;
+
+    kmalloc_cache_t* c = &caches[cls];
+    slab->magic = KMALLOC_SLAB_MAGIC;
+    slab->cls = cls;
+    slab->in_use = 0;
+    slab->pages = 1;
+    slab->free = NULL;
+    slab->next = slab->prev = NULL;
+
+    uint8_t* obj = (uint8_t*)slab + KMALLOC_HEADER_SIZE;
+    for (int i = c->per_slab - 1; i >= 0; i--) {
+        void** o = (void**)(obj + i * c->size);
+        *o = slab->free;
+        slab->free = o;
+    }
+    stats.slab_pages++;
+    stats.class_slabs[cls]++;
+    return slab;
+}
+
+static void* kmalloc_small(int cls) {
+    kmalloc_cache_t* c = &caches[cls];
+    kmalloc_slab_t* slab = c->partial;
+
+    if (!slab) {
+        if (c->empty) {
+            slab = c->empty;
+            c->empty = NULL;
+        } else {
+            slab = kmalloc_slab_new(cls);
+            if (!slab) return NULL;
+        }
+        kmalloc_list_push(&c->partial, slab);
+    }
+
+    void** obj = (void**)slab->free;
+    slab->free = *obj;
+    slab->in_use++;
+    stats.class_in_use[cls]++;
+    if (!slab->free) kmalloc_list_remove(&c->partial, slab);
+    return obj;
+}
+
+static void kmalloc_small_free(kmalloc_slab_t* slab, void* ptr) {
+    kmalloc_cache_t* c = &caches[slab->cls];
+    int was_full = slab->free == NULL;
+
+    *(void**)ptr = slab->free;
+    slab->free = ptr;
+    slab->in_use--;
+    stats.class_in_use[slab->cls]--;
+
+    if (was_full) kmalloc_list_push(&c->partial, slab);
+    if (slab->in_use == 0) {
+        kmalloc_list_remove(&c->partial, slab);
+        /* Keep one empty slab per class so alloc/free pairs do not bounce pages. */
+        if (c->empty) {
+            stats.slab_pages--;
+            stats.class_slabs[slab->cls]--;
+            frame_free((uint32_t)slab);
+        } else {
+            c->empty = slab;
+        }
+    }
+}
+
+static void* kmalloc_large(uint32_t size) {
+    uint32_t pages = (size + KMALLOC_HEADER_SIZE + PMM_FRAME_SIZE - 1) / PMM_FRAME_SIZE;
+    kmalloc_slab_t* slab = (kmalloc_slab_t*)frame_alloc_contig(pages, 0);
+    if (!slab) return NULL;
+
+    slab->magic = KMALLOC_LARGE_MAGIC;
+    slab->cls = 0;
+    slab->in_use = 1;
+    slab->pages = pages;
+    slab->free = NULL;
+    slab->next = slab->prev = NULL;
+    stats.large_pages += pages;
+    return (uint8_t*)slab + KMALLOC_HEADER_SIZE;
+}
+
+static kmalloc_slab_t* kmalloc_slab_of(void* ptr) {
+    kmalloc_slab_t* slab = (kmalloc_slab_t*)((uint32_t)ptr & ~(PMM_FRAME_SIZE - 1));
+    if (slab->magic == KMALLOC_SLAB_MAGIC) {
+        uint32_t offset = (uint32_t)ptr - (uint32_t)slab - KMALLOC_HEADER_SIZE;
+        if (offset % caches[slab->cls].size == 0) return slab;
+    } else if (slab->magic == KMALLOC_LARGE_MAGIC) {
+        if ((uint8_t*)ptr == (uint8_t*)slab + KMALLOC_HEADER_SIZE) return slab;
+    }
+    return NULL;
+}
+
+static void kmalloc_error(const char* what, void* ptr) {
+    char buf[16];
+    terminal_writestring("kmalloc: ");
+    terminal_writestring(what);
+    terminal_writestring(" at 0x");
+    for (int i = 0; i < 8; i++) {
+        buf[i] = "0123456789ABCDEF"[((uint32_t)ptr >> (28 - i * 4)) & 0xF];
+    }
+    buf[8] = '\0';
+    terminal_writestring(buf);
+    terminal_writestring("\n");
+}
+
+static void* kmalloc_raw(uint32_t size) {
+    if (!kmalloc_ready) kmalloc_init();
+    if (size > KMALLOC_MAX_SMALL) return kmalloc_large(size);
+
+    int cls = 0;
+    while ((1u << (KMALLOC_MIN_SHIFT + cls)) < size) cls++;
+    return kmalloc_small(cls);
+}
+
+static void kfree_raw(kmalloc_slab_t* slab, void* ptr) {
+    if (slab->magic == KMALLOC_LARGE_MAGIC) {
+        slab->magic = 0;
+        stats.large_pages -= slab->pages;
+        frame_free_contig((uint32_t)slab, slab->pages);
+    } else {
+        kmalloc_small_free(slab, ptr);
+    }
+}
+
+/* Sites are keyed by the (file, line) of the call; slot 0 absorbs overflow. */
+static uint16_t kmalloc_site(const char* file, int line, int tag) {
+    uint32_t h = ((uint32_t)file ^ ((uint32_t)line * 2654435761u)) % (KMALLOC_MAX_SITES - 1);
+    for (int i = 0; i < KMALLOC_MAX_SITES - 1; i++) {
+        uint16_t idx = 1 + (h + i) % (KMALLOC_MAX_SITES - 1);
+        kmalloc_site_t* s = &sites[idx];
+        if (s->file == file && s->line == line) return idx;
+        if (!s->file) {
+            s->file = file;
+            s->line = line;
+            s->tag = tag;
+            return idx;
+        }
+    }
+    sites[0].file = "(other sites)";
+    return 0;
+}
+
+static void kmalloc_account(kmalloc_hdr_t* hdr, int sign) {
+    kmalloc_site_t* s = &sites[hdr->site];
+    uint32_t size = hdr->size;
+    int leak = leak_active && hdr->seq >= leak_seq;
+
+    if (sign > 0) {
+        s->live_bytes += size;
+        s->live_count++;
+        s->allocs++;
+        if (s->live_bytes > s->peak_bytes) s->peak_bytes = s->live_bytes;
+        if (leak) {
+            s->leak_bytes += size;
+            s->leak_count++;
+        }
+
+        stats.live_bytes += size;
+        stats.live_count++;
+        stats.allocs++;
+        if (stats.live_bytes > stats.peak_bytes) stats.peak_bytes = stats.live_bytes;
+        stats.tag_live[hdr->tag] += size;
+        if (stats.tag_live[hdr->tag] > stats.tag_peak[hdr->tag]) {
+            stats.tag_peak[hdr->tag] = stats.tag_live[hdr->tag];
+        }
+    } else {
+        s->live_bytes -= size;
+        s->live_count--;
+        if (leak) {
+            s->leak_bytes -= size;
+            s->leak_count--;
+        }
+
+        stats.live_bytes -= size;
+        stats.live_count--;
+        stats.frees++;
+        stats.tag_live[hdr->tag] -= size;
+    }
+}
+
+static void* kmalloc_locked(uint32_t size, int tag, const char* file, int line) {
+    if (size == 0) return NULL;
+    if (tag < 0 || tag >= KM_TAG_COUNT) tag = KM_OTHER;
+
+    kmalloc_hdr_t* hdr = kmalloc_raw(size + KMALLOC_OVERHEAD);
+    if (!hdr) {
+        stats.failures++;
+        return NULL;
+    }
+
+    hdr->size = size;
+    hdr->seq = alloc_seq++;
+    hdr->site = kmalloc_site(file, line, tag);
+    hdr->tag = tag;
+    hdr->state = KMALLOC_LIVE;
+    hdr->guard = KMALLOC_GUARD;
+#if KMALLOC_REDZONE
+    memset((uint8_t*)(hdr + 1) + size, KMALLOC_RZ_BYTE, KMALLOC_RZ_SIZE);
+#endif
+    kmalloc_account(hdr, 1);
+    return hdr + 1;
+}
+
+/* Validates ptr and returns its header, or NULL after reporting the problem. */
+static kmalloc_hdr_t* kmalloc_check(void* ptr, kmalloc_slab_t** slab) {
+    kmalloc_hdr_t* hdr = (kmalloc_hdr_t*)ptr - 1;
+    *slab = kmalloc_slab_of(hdr);
+    if (!*slab) {
+        kmalloc_error("invalid pointer", ptr);
+        return NULL;
+    }
+    if (hdr->state == KMALLOC_FREED) {
+        kmalloc_error("double free", ptr);
+        return NULL;
+    }
+    if (hdr->state != KMALLOC_LIVE || hdr->guard != KMALLOC_GUARD) {
+        kmalloc_error("header overwritten", ptr);
+        return NULL;
+    }
+#if KMALLOC_REDZONE
+    for (int i = 0; i < KMALLOC_RZ_SIZE; i++) {
+        if (((uint8_t*)ptr)[hdr->size + i] != KMALLOC_RZ_BYTE) {
+            kmalloc_error("red zone after object overwritten", ptr);
+            return NULL;
+        }
+    }
+#endif
+    return hdr;
+}
+
+void* kmalloc_at(uint32_t size, int tag, const char* file, int line) {
+    uint32_t flags = kmalloc_lock();
+    void* ptr = kmalloc_locked(size, tag, file, line);
+    kmalloc_unlock(flags);
+    return ptr;
+}
+
+void* kzalloc_at(uint32_t size, int tag, const char* file, int line) {
+    void* ptr = kmalloc_at(size, tag, file, line);
+    if (ptr) memset(ptr, 0, size);
+    return ptr;
+}
+
+void kfree(void* ptr) {
+    if (!ptr) return;
+    uint32_t flags = kmalloc_lock();
+
+    kmalloc_slab_t* slab;
+    kmalloc_hdr_t* hdr = kmalloc_check(ptr, &slab);
+    if (hdr) {
+        kmalloc_account(hdr, -1);
+#if KMALLOC_REDZONE
+        memset(ptr, KMALLOC_POISON, hdr->size);
+#endif
+        hdr->state = KMALLOC_FREED;
+        kfree_raw(slab, hdr);
+    }
+    kmalloc_unlock(flags);
+}
+
+void* krealloc_at(void* ptr, uint32_t size, int tag, const char* file, int line) {
+    if (!ptr) return kmalloc_at(size, tag, file, line);
+    if (size == 0) {
+        kfree(ptr);
+        return NULL;
+    }
+
+    uint32_t flags = kmalloc_lock();
+    kmalloc_slab_t* slab;
+    kmalloc_hdr_t* hdr = kmalloc_check(ptr, &slab);
+    if (!hdr) {
+        kmalloc_unlock(flags);
+        return NULL;
+    }
+
+    uint32_t capacity = slab->magic == KMALLOC_LARGE_MAGIC
+                            ? slab->pages * PMM_FRAME_SIZE - KMALLOC_HEADER_SIZE
+                            : caches[slab->cls].size;
+    if (size + KMALLOC_OVERHEAD <= capacity) {
+        /* Shrinking or growing within the slot: just move the accounting. */
+        kmalloc_account(hdr, -1);
+        hdr->size = size;
+#if KMALLOC_REDZONE
+        memset((uint8_t*)ptr + size, KMALLOC_RZ_BYTE, KMALLOC_RZ_SIZE);
+#endif
+        kmalloc_account(hdr, 1);
+        stats.allocs--;
+        sites[hdr->site].allocs--;
+        stats.frees--;
+        kmalloc_unlock(flags);
+        return ptr;
+    }
+    uint32_t old_size = hdr->size;
+    kmalloc_unlock(flags);
+
+    void* grown = kmalloc_at(size, tag, file, line);
+    if (!grown) return NULL;
+    memcpy(grown, ptr, old_size);
+    kfree(ptr);
+    return grown;
+}
+
+void kmalloc_get_stats(kmalloc_stats_t* out) {
+    uint32_t flags = kmalloc_lock();
+    *out = stats;
+    kmalloc_unlock(flags);
+}
+
+const kmalloc_site_t* kmalloc_get_site(int index) {
+    if (index < 0 || index >= KMALLOC_MAX_SITES || !sites[index].file) return NULL;
+    return &sites[index];
+}
+
+const char* kmalloc_tag_name(int tag) {
+    return tag >= 0 && tag < KM_TAG_COUNT ? tag_names[tag] : "?";
+}
+
+uint32_t kmalloc_class_size(int cls) {
+    return 1u << (KMALLOC_MIN_SHIFT + cls);
+}
+
+void kmalloc_leak_mark(void) {
+    uint32_t flags = kmalloc_lock();
+    for (int i = 0; i < KMALLOC_MAX_SITES; i++) {
+        sites[i].leak_bytes = 0;
+        sites[i].leak_count = 0;
+    }
+    leak_seq = alloc_seq;
+    leak_active = 1;
+    kmalloc_unlock(flags);
+}
+
+int kmalloc_leak_active(void) {
+    return leak_active;
+}
@@ -0,0 +1,198 @@
+
+
+#include <stdint.h>
+#include "include/timer.h"
+#include "include/softirq.h"
+
+/*
+ * Classic cascading wheel: 256 one-tick slots, then four levels of 64 slots
+ * each covering 64 times the span of the level below. Inserting is a shift
+ * and a list push; each tick empties one slot, and every 256 ticks one
+ * higher-level slot is redistributed downwards.
+ */
+#define TVR_BITS 8
+#define TVN_BITS 6
+#define TVR_SIZE (1 << TVR_BITS)
+#define TVN_SIZE (1 << TVN_BITS)
+#define TVR_MASK (TVR_SIZE - 1)
+#define TVN_MASK (TVN_SIZE - 1)
+
+static timer_link_t tv1[TVR_SIZE];
+static timer_link_t tvn[4][TVN_SIZE];
+static timer_link_t expired;
+static uint32_t wheel_base;
+static int running;
+
+static inline __attribute__((always_inline)) uint32_t timer_lock(void) {
+    return irq_save();
+}
+
+static inline __attribute__((always_inline)) void timer_unlock(uint32_t flags) {
+    irq_restore(flags);
+}
+
+static void link_init(timer_link_t* head) {
+    head->next = head->prev = head;
+}
+
+static void link_push(timer_link_t* head, timer_link_t* link) {
+    link->prev = head->prev;
+    link->next = head;
+    head->prev->next = link;
+    head->prev = link;
+}
+
+static void link_remove(timer_link_t* link) {
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+    link->next = link->prev = 0;
+}
+
+void timer_wheel_init(void) {
+    for (int i = 0; i < TVR_SIZE; i++) link_init(&tv1[i]);
+    for (int l = 0; l < 4; l++) {
+        for (int i = 0; i < TVN_SIZE; i++) link_init(&tvn[l][i]);
+    }
+    link_init(&expired);
+    wheel_base = timer_ticks() + 1;
+}
+
+static void timer_enqueue(ktimer_t* timer) {
+    uint32_t expires = timer->expires;
+    uint32_t delta = expires - wheel_base;
+    timer_link_t* slot;
+
+    if ((int32_t)delta < 0) {
+        slot = &tv1[wheel_base & TVR_MASK];
+    } else if (delta < TVR_SIZE) {
+        slot = &tv1[expires & TVR_MASK];
+    } else {
+        int level = 0;
+        while (level < 3 && delta >= 1u << (TVR_BITS + (level + 1) * TVN_BITS)) level++;
+        slot = &tvn[level][(expires >> (TVR_BITS + level * TVN_BITS)) & TVN_MASK];
+    }
+    link_push(slot, &timer->link);
+}
+
+/* Moves every timer in one higher-level slot down to where it now belongs. */
+static int timer_cascade(int level) {
+    int index = (wheel_base >> (TVR_BITS + level * TVN_BITS)) & TVN_MASK;
+    timer_link_t* head = &tvn[level][index];
+
+    while (head->next != head) {
+        timer_link_t* link = head->next;
+        link_remove(link);
+        timer_enqueue((ktimer_t*)link);
+    }
+    return index;
+}
+
+/* Called from the tick with interrupts off; due timers move to the expired list. */
+void timer_wheel_advance(uint32_t now) {
+    while ((int32_t)(now - wheel_base) >= 0) {
+        int index = wheel_base & TVR_MASK;
+        if (index == 0) {
+            for (int level = 0; level < 4 && timer_cascade(level) == 0; level++);
+        }
+
+        timer_link_t* head = &tv1[index];
+        while (head->next != head) {
+            timer_link_t* link = head->next;
+            link_remove(link);
+            link_push(&expired, link);
+        }
+        wheel_base++;
+    }
+    if (expired.next != &expired) softirq_raise(SOFTIRQ_TIMER);
+}
+
+uint32_t timer_next_expiry(uint32_t now, uint32_t limit) {
+    if (expired.next != &expired) return 0;
+
+    int higher = 0;
+    for (int l = 0; l < 4 && !higher; l++) {
+        for (int i = 0; i < TVN_SIZE; i++) {
+            if (tvn[l][i].next != &tvn[l][i]) {
+                higher = 1;
+                break;
+            }
+        }
+    }
+
+    /* tv1 only holds timers due within 256 ticks of wheel_base; a cascade point counts as work. */
+    for (uint32_t i = 0; i < TVR_SIZE; i++) {
+        uint32_t t = wheel_base + i;
+        uint32_t ahead = t - now;
+        if ((int32_t)ahead < 0) ahead = 0;
+        if (ahead >= limit) break;
+
+        int index = t & TVR_MASK;
+        if ((index == 0 && higher) || tv1[index].next != &tv1[index]) return ahead;
+    }
+    return limit;
+}
+
+/* Runs expired callbacks; nested interrupts that get here while it is busy leave the work to it. */
+void timer_run_expired(void) {
+    uint32_t flags = timer_lock();
+    if (running || expired.next == &expired) {
+        timer_unlock(flags);
+        return;
+    }
+    running = 1;
+
+    while (expired.next != &expired) {
+        ktimer_t* timer = (ktimer_t*)expired.next;
+        link_remove(&timer->link);
+        void (*fn)(void*) = timer->fn;
+        void* data = timer->data;
+
+        irq_trace_on();
+        __asm__ volatile("sti" : : : "memory");
+        fn(data);
+        __asm__ volatile("cli" : : : "memory");
+        irq_trace_off();
+    }
+
+    running = 0;
+    timer_unlock(flags);
+}
+
+void timer_setup(ktimer_t* timer, void (*fn)(void* data), void* data) {
+    timer->link.next = timer->link.prev = 0;
+    timer->expires = 0;
+    timer->fn = fn;
+    timer->data = data;
+}
+
+static void timer_arm(ktimer_t* timer, uint32_t delay_ms) {
+    /* +1 so the partial tick already under way never counts toward the delay. */
+    timer->expires = timer_ticks() + delay_ms * (TIMER_HZ / 1000) + 1;
+    timer_enqueue(timer);
+}
+
+int timer_add(ktimer_t* timer, uint32_t delay_ms) {
+    uint32_t flags = timer_lock();
+    if (timer_pending(timer)) {
+        timer_unlock(flags);
+        return -1;
+    }
+    timer_arm(timer, delay_ms);
+    timer_unlock(flags);
+    return 0;
+}
+
+void timer_mod(ktimer_t* timer, uint32_t delay_ms) {
+    uint32_t flags = timer_lock();
+    if (timer_pending(timer)) link_remove(&timer->link);
+    timer_arm(timer, delay_ms);
+    timer_unlock(flags);
+}
+
+int timer_cancel(ktimer_t* timer) {
+    uint32_t flags = timer_lock();
+    int was_pending = timer_pending(timer);
+    if (was_pending) link_remove(&timer->link);
+    timer_unlock(flags);
+    return was_pending;
+}
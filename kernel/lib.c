@@ -129,6 +129,18 @@ void itoa(int n, char* buf) {
     }
 }
 
+/* 64-by-32 division without libgcc: two divl steps, high word first. */
+uint64_t udiv64(uint64_t n, uint32_t d, uint32_t* rem) {
+    uint32_t hi = (uint32_t)(n >> 32);
+    uint32_t lo = (uint32_t)n;
+    uint32_t q_hi = hi / d;
+    uint32_t r = hi % d;
+    uint32_t q_lo;
+    __asm__("divl %4" : "=a"(q_lo), "=d"(r) : "a"(lo), "d"(r), "rm"(d));
+    if (rem) *rem = r;
+    return ((uint64_t)q_hi << 32) | q_lo;
+}
+
 int snprintf(char* str, unsigned int size, const char* format, ...) {
 
     unsigned int i = 0;
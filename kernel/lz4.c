@@ -0,0 +1,150 @@
+
+
+#include <stdint.h>
+#include <stddef.h>
+#include "include/lz4.h"
+
+#define LZ4_FLG_VERSION_MASK 0xC0
+#define LZ4_FLG_VERSION 0x40
+#define LZ4_FLG_BLOCK_CHECKSUM 0x10
+#define LZ4_FLG_CONTENT_SIZE 0x08
+#define LZ4_FLG_CONTENT_CHECKSUM 0x04
+#define LZ4_FLG_DICT_ID 0x01
+#define LZ4_BLOCK_UNCOMPRESSED 0x80000000u
+#define LZ4_MIN_MATCH 4
+
+static uint32_t read_le32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+int lz4_is_frame(const void* src, uint32_t src_size) {
+    return src && src_size >= 7 && read_le32((const uint8_t*)src) == LZ4_FRAME_MAGIC;
+}
+
+/* Returns the header length, or -1 if the frame header is malformed. */
+static int lz4_frame_header(const uint8_t* src, uint32_t src_size, uint8_t* flg) {
+    if (!lz4_is_frame(src, src_size)) return -1;
+
+    *flg = src[4];
+    if ((*flg & LZ4_FLG_VERSION_MASK) != LZ4_FLG_VERSION) return -1;
+
+    uint32_t len = 4 + 2 + 1;
+    if (*flg & LZ4_FLG_CONTENT_SIZE) len += 8;
+    if (*flg & LZ4_FLG_DICT_ID) len += 4;
+    if (len > src_size) return -1;
+    return (int)len;
+}
+
+int lz4_frame_content_size(const void* src, uint32_t src_size, uint32_t* size) {
+    const uint8_t* p = (const uint8_t*)src;
+    uint8_t flg;
+
+    if (lz4_frame_header(p, src_size, &flg) < 0 || !(flg & LZ4_FLG_CONTENT_SIZE)) {
+        return -1;
+    }
+    if (read_le32(p + 10) != 0) {
+        return -1;
+    }
+    *size = read_le32(p + 6);
+    return 0;
+}
+
+/*
+ * Decodes one block into dst. Matches may reach back to dst_start, which lets
+ * linked blocks reference output produced by earlier blocks of the frame.
+ * Returns the number of bytes written or -1 on corrupt input.
+ */
+int lz4_decompress_block(const uint8_t* src, uint32_t src_size, uint8_t* dst_start, uint8_t* dst, uint32_t dst_cap) {
+    const uint8_t* ip = src;
+    const uint8_t* iend = src + src_size;
+    uint8_t* op = dst;
+    uint8_t* oend = dst + dst_cap;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+
+        uint32_t lit = token >> 4;
+        if (lit == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                lit += b;
+            } while (b == 255);
+        }
+        if (lit > (uint32_t)(iend - ip) || lit > (uint32_t)(oend - op)) return -1;
+        for (uint32_t i = 0; i < lit; i++) {
+            op[i] = ip[i];
+        }
+        ip += lit;
+        op += lit;
+
+        /* The last sequence carries literals only. */
+        if (ip == iend) break;
+
+        if (iend - ip < 2) return -1;
+        uint32_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (uint32_t)(op - dst_start)) return -1;
+
+        uint32_t match = token & 0x0F;
+        if (match == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                match += b;
+            } while (b == 255);
+        }
+        match += LZ4_MIN_MATCH;
+        if (match > (uint32_t)(oend - op)) return -1;
+
+        /* Byte copy on purpose: offsets shorter than the match overlap. */
+        const uint8_t* ref = op - offset;
+        for (uint32_t i = 0; i < match; i++) {
+            op[i] = ref[i];
+        }
+        op += match;
+    }
+
+    return (int)(op - dst);
+}
+
+int lz4_decompress_frame(const void* src, uint32_t src_size, void* dst, uint32_t dst_cap) {
+    const uint8_t* p = (const uint8_t*)src;
+    uint8_t* out = (uint8_t*)dst;
+    uint32_t produced = 0;
+    uint8_t flg;
+
+    int header = lz4_frame_header(p, src_size, &flg);
+    if (header < 0) return -1;
+
+    uint32_t pos = (uint32_t)header;
+    while (1) {
+        if (src_size - pos < 4) return -1;
+        uint32_t block = read_le32(p + pos);
+        pos += 4;
+        if (block == 0) break;
+
+        uint32_t len = block & ~LZ4_BLOCK_UNCOMPRESSED;
+        if (len > src_size - pos) return -1;
+
+        if (block & LZ4_BLOCK_UNCOMPRESSED) {
+            if (len > dst_cap - produced) return -1;
+            for (uint32_t i = 0; i < len; i++) {
+                out[produced + i] = p[pos + i];
+            }
+            produced += len;
+        } else {
+            int n = lz4_decompress_block(p + pos, len, out, out + produced, dst_cap - produced);
+            if (n < 0) return -1;
+            produced += (uint32_t)n;
+        }
+        pos += len;
+
+        if (flg & LZ4_FLG_BLOCK_CHECKSUM) pos += 4;
+        if (pos > src_size) return -1;
+    }
+
+    return (int)produced;
+}
@@ -0,0 +1,442 @@
+
+
+#include <stdint.h>
+#include "include/lib.h"
+#include "include/paging.h"
+#include "include/pmm.h"
+#include "include/vfs.h"
+#include "include/sched.h"
+
+extern void terminal_writestring(const char* s);
+extern char kernel_ro_start[];
+extern char kernel_ro_end[];
+
+#define CR0_WP 0x00010000
+#define CR0_PG 0x80000000
+#define CR4_PSE 0x00000010
+#define CR4_PGE 0x00000080
+
+#define CPUID_PSE (1 << 3)
+#define CPUID_PGE (1 << 13)
+#define CPUID_PAT (1 << 16)
+
+#define MSR_PAT 0x277
+/* WB, WC, UC-, UC in both halves: entry 1 becomes write-combining instead of write-through. */
+#define PAT_VALUE 0x00070106
+
+#define PAGE_FLAGS_MASK 0xFFF
+
+static uint32_t page_directory[1024] __attribute__((aligned(PAGE_SIZE)));
+static uint32_t low_table[1024] __attribute__((aligned(PAGE_SIZE)));
+static uint32_t global_flag;
+
+typedef struct {
+    uint32_t base;
+    uint32_t size;
+    uint32_t flags;
+    uint32_t resident;
+    int used;
+} lazy_region_t;
+
+static lazy_region_t lazy_regions[LAZY_MAX_REGIONS];
+static uint32_t lazy_resident;
+
+/* Page tables and lazy regions are changed by threads and by the fault task, so with interrupts off. */
+static inline __attribute__((always_inline)) uint32_t paging_lock(void) {
+    return irq_save();
+}
+
+static inline __attribute__((always_inline)) void paging_unlock(uint32_t flags) {
+    irq_restore(flags);
+}
+
+static inline void paging_invlpg(uint32_t virt) {
+    __asm__ volatile("invlpg (%0)" : : "r"(virt) : "memory");
+}
+
+/* Replaces a 4 MB page with a table of 4 KB pages covering the same memory. */
+static uint32_t* paging_split(uint32_t* pde) {
+    uint32_t frame = frame_alloc();
+    if (!frame) return 0;
+
+    uint32_t* table = (uint32_t*)frame;
+    uint32_t base = *pde & 0xFFC00000;
+    uint32_t flags = *pde & PAGE_FLAGS_MASK & ~PAGE_LARGE;
+    for (int i = 0; i < 1024; i++) {
+        table[i] = (base + i * PAGE_SIZE) | flags;
+    }
+    *pde = frame | (flags & (PAGE_USER | PAGE_WRITE)) | PAGE_PRESENT | PAGE_WRITE;
+    for (int i = 0; i < 1024; i++) {
+        paging_invlpg(base + i * PAGE_SIZE);
+    }
+    return table;
+}
+
+/* Page table covering virt, created or split out of a large page if needed. */
+static uint32_t* paging_table(uint32_t virt, int create) {
+    uint32_t* pde = &page_directory[virt >> 22];
+
+    if (*pde & PAGE_LARGE) {
+        return paging_split(pde);
+    }
+    if (!(*pde & PAGE_PRESENT)) {
+        if (!create) return 0;
+        uint32_t frame = frame_alloc();
+        if (!frame) return 0;
+        memset((void*)frame, 0, PAGE_SIZE);
+        *pde = frame | PAGE_PRESENT | PAGE_WRITE;
+    }
+    return (uint32_t*)(*pde & ~PAGE_FLAGS_MASK);
+}
+
+static int paging_map_locked(uint32_t virt, uint32_t phys, uint32_t flags) {
+    uint32_t* table = paging_table(virt, 1);
+    if (!table) return -1;
+
+    table[(virt >> 12) & 0x3FF] = (phys & ~PAGE_FLAGS_MASK) | (flags & PAGE_FLAGS_MASK & ~PAGE_LARGE) | PAGE_PRESENT;
+    paging_invlpg(virt);
+    return 0;
+}
+
+int paging_map(uint32_t virt, uint32_t phys, uint32_t flags) {
+    uint32_t irq = paging_lock();
+    int r = paging_map_locked(virt, phys, flags);
+    paging_unlock(irq);
+    return r;
+}
+
+static uint32_t paging_unmap_locked(uint32_t virt) {
+    uint32_t pde = page_directory[virt >> 22];
+    if (!(pde & PAGE_PRESENT)) return 0;
+
+    uint32_t* table = paging_table(virt, 0);
+    if (!table) return 0;
+
+    uint32_t* pte = &table[(virt >> 12) & 0x3FF];
+    if (!(*pte & PAGE_PRESENT)) return 0;
+
+    uint32_t phys = *pte & ~PAGE_FLAGS_MASK;
+    *pte = 0;
+    paging_invlpg(virt);
+    return phys;
+}
+
+/* Returns the frame that was mapped at virt, or 0. */
+uint32_t paging_unmap(uint32_t virt) {
+    uint32_t irq = paging_lock();
+    uint32_t phys = paging_unmap_locked(virt);
+    paging_unlock(irq);
+    return phys;
+}
+
+static int paging_large_fits(uint32_t virt, uint32_t phys, uint32_t remaining) {
+    return (virt & (LARGE_PAGE_SIZE - 1)) == 0 && (phys & (LARGE_PAGE_SIZE - 1)) == 0 &&
+           remaining >= LARGE_PAGE_SIZE;
+}
+
+/* Maps [virt, virt + size) to phys, using 4 MB pages wherever alignment allows. */
+int paging_map_range(uint32_t virt, uint32_t phys, uint32_t size, uint32_t flags) {
+    uint32_t offset = virt & (PAGE_SIZE - 1);
+    virt -= offset;
+    phys -= offset;
+    size = (size + offset + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+    uint32_t irq = paging_lock();
+    int r = 0;
+    while (size > 0) {
+        uint32_t* pde = &page_directory[virt >> 22];
+        if (paging_large_fits(virt, phys, size) && (!(*pde & PAGE_PRESENT) || (*pde & PAGE_LARGE))) {
+            *pde = phys | (flags & PAGE_FLAGS_MASK) | PAGE_LARGE | PAGE_PRESENT;
+            paging_invlpg(virt);
+            virt += LARGE_PAGE_SIZE;
+            phys += LARGE_PAGE_SIZE;
+            size -= LARGE_PAGE_SIZE;
+            continue;
+        }
+        if (paging_map_locked(virt, phys, flags) < 0) {
+            r = -1;
+            break;
+        }
+        virt += PAGE_SIZE;
+        phys += PAGE_SIZE;
+        size -= PAGE_SIZE;
+    }
+    paging_unlock(irq);
+    return r;
+}
+
+int paging_unmap_range(uint32_t virt, uint32_t size) {
+    uint32_t end = virt + size;
+    virt &= ~(PAGE_SIZE - 1);
+
+    uint32_t irq = paging_lock();
+    while (virt < end) {
+        uint32_t* pde = &page_directory[virt >> 22];
+        if ((*pde & PAGE_LARGE) && (virt & (LARGE_PAGE_SIZE - 1)) == 0 && end - virt >= LARGE_PAGE_SIZE) {
+            *pde = 0;
+            paging_invlpg(virt);
+            virt += LARGE_PAGE_SIZE;
+            continue;
+        }
+        if (!(*pde & PAGE_PRESENT)) {
+            virt = (virt & 0xFFC00000) + LARGE_PAGE_SIZE;
+            if (virt == 0) break;
+            continue;
+        }
+        paging_unmap_locked(virt);
+        virt += PAGE_SIZE;
+    }
+    paging_unlock(irq);
+    return 0;
+}
+
+/* Replaces the flags of every present page in the range, keeping its frame. */
+int paging_protect(uint32_t virt, uint32_t size, uint32_t flags) {
+    uint32_t end = virt + size;
+    flags &= PAGE_FLAGS_MASK & ~PAGE_LARGE;
+    virt &= ~(PAGE_SIZE - 1);
+
+    uint32_t irq = paging_lock();
+    int r = 0;
+    while (virt < end) {
+        uint32_t* pde = &page_directory[virt >> 22];
+        if (!(*pde & PAGE_PRESENT)) {
+            virt = (virt & 0xFFC00000) + LARGE_PAGE_SIZE;
+            if (virt == 0) break;
+            continue;
+        }
+        if ((*pde & PAGE_LARGE) && (virt & (LARGE_PAGE_SIZE - 1)) == 0 && end - virt >= LARGE_PAGE_SIZE) {
+            *pde = (*pde & 0xFFC00000) | flags | PAGE_LARGE | PAGE_PRESENT;
+            paging_invlpg(virt);
+            virt += LARGE_PAGE_SIZE;
+            continue;
+        }
+
+        uint32_t* table = paging_table(virt, 0);
+        if (!table) {
+            r = -1;
+            break;
+        }
+        uint32_t* pte = &table[(virt >> 12) & 0x3FF];
+        if (*pte & PAGE_PRESENT) {
+            *pte = (*pte & ~PAGE_FLAGS_MASK) | flags | PAGE_PRESENT;
+            if (flags & PAGE_USER) *pde |= PAGE_USER;
+            paging_invlpg(virt);
+        }
+        virt += PAGE_SIZE;
+    }
+    paging_unlock(irq);
+    return r;
+}
+
+int paging_translate(uint32_t virt, uint32_t* phys) {
+    uint32_t pde = page_directory[virt >> 22];
+    if (!(pde & PAGE_PRESENT)) return -1;
+    if (pde & PAGE_LARGE) {
+        *phys = (pde & 0xFFC00000) | (virt & (LARGE_PAGE_SIZE - 1));
+        return 0;
+    }
+
+    uint32_t pte = ((uint32_t*)(pde & ~PAGE_FLAGS_MASK))[(virt >> 12) & 0x3FF];
+    if (!(pte & PAGE_PRESENT)) return -1;
+    *phys = (pte & ~PAGE_FLAGS_MASK) | (virt & (PAGE_SIZE - 1));
+    return 0;
+}
+
+static lazy_region_t* paging_lazy_find(uint32_t addr) {
+    for (int i = 0; i < LAZY_MAX_REGIONS; i++) {
+        lazy_region_t* r = &lazy_regions[i];
+        if (r->used && addr >= r->base && addr - r->base < r->size) return r;
+    }
+    return 0;
+}
+
+static void* paging_alloc_lazy_locked(uint32_t size, uint32_t flags) {
+    lazy_region_t* slot = 0;
+    for (int i = 0; i < LAZY_MAX_REGIONS; i++) {
+        if (!lazy_regions[i].used) {
+            slot = &lazy_regions[i];
+            break;
+        }
+    }
+    if (!slot) return 0;
+
+    uint32_t base = LAZY_BASE + PAGE_SIZE;
+    for (int i = 0; i < LAZY_MAX_REGIONS; i++) {
+        lazy_region_t* r = &lazy_regions[i];
+        if (!r->used) continue;
+        if (base - PAGE_SIZE < r->base + r->size && r->base - PAGE_SIZE < base + size) {
+            base = r->base + r->size + PAGE_SIZE;
+            if (base + size > LAZY_BASE + LAZY_SIZE || base < LAZY_BASE) return 0;
+            i = -1;
+        }
+    }
+    if (base + size > LAZY_BASE + LAZY_SIZE) return 0;
+
+    slot->base = base;
+    slot->size = size;
+    slot->flags = (flags & (PAGE_WRITE | PAGE_USER)) | global_flag;
+    slot->resident = 0;
+    slot->used = 1;
+    return (void*)base;
+}
+
+/*
+ * Reserves size bytes of virtual space in the lazy window. Nothing is backed
+ * until first touch, when the fault handler maps a zeroed frame. Each region
+ * is preceded by an unmapped guard page, so a stack running off its bottom
+ * faults instead of silently walking into the next region.
+ */
+void* paging_alloc_lazy(uint32_t size, uint32_t flags) {
+    if (size == 0 || size > LAZY_SIZE) return 0;
+    size = (size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+    uint32_t irq = paging_lock();
+    void* addr = paging_alloc_lazy_locked(size, flags);
+    paging_unlock(irq);
+    return addr;
+}
+
+void paging_free_lazy(void* addr) {
+    uint32_t irq = paging_lock();
+    lazy_region_t* r = paging_lazy_find((uint32_t)addr);
+    if (!r || r->base != (uint32_t)addr) {
+        paging_unlock(irq);
+        return;
+    }
+
+    for (uint32_t virt = r->base; virt < r->base + r->size && r->resident; virt += PAGE_SIZE) {
+        uint32_t frame = paging_unmap_locked(virt);
+        if (frame) {
+            frame_free(frame);
+            r->resident--;
+            lazy_resident--;
+        }
+    }
+    r->used = 0;
+    paging_unlock(irq);
+}
+
+uint32_t paging_lazy_resident(void) {
+    return lazy_resident;
+}
+
+static int paging_lazy_fault_locked(uint32_t addr) {
+    lazy_region_t* r = paging_lazy_find(addr);
+    if (!r) return -1;
+
+    uint32_t frame = frame_alloc();
+    if (!frame) return -1;
+    memset((void*)frame, 0, PAGE_SIZE);
+    if (paging_map_locked(addr & ~(PAGE_SIZE - 1), frame, r->flags) < 0) {
+        frame_free(frame);
+        return -1;
+    }
+    r->resident++;
+    lazy_resident++;
+    return 0;
+}
+
+static int paging_lazy_fault(uint32_t addr) {
+    uint32_t irq = paging_lock();
+    int r = paging_lazy_fault_locked(addr);
+    paging_unlock(irq);
+    return r;
+}
+
+/*
+ * Backs every page of [addr, addr + size) inside a lazy region up front, for
+ * memory that must never fault: stacks that interrupts and exceptions are
+ * delivered on. Returns -1 if a frame could not be had.
+ */
+int paging_populate(void* addr, uint32_t size) {
+    uint32_t start = (uint32_t)addr & ~(PAGE_SIZE - 1);
+    uint32_t end = (uint32_t)addr + size;
+    int r = 0;
+    for (uint32_t virt = start; virt < end && r == 0; virt += PAGE_SIZE) {
+        uint32_t irq = paging_lock();
+        uint32_t phys;
+        if (paging_translate(virt, &phys) < 0) r = paging_lazy_fault_locked(virt);
+        paging_unlock(irq);
+    }
+    return r;
+}
+
+/* Returns 0 if the fault was resolved by populating the page. */
+int page_fault_handler(uint32_t addr, uint32_t error) {
+    if (error & PF_PRESENT) return -1;
+    if (addr >= LAZY_BASE && addr - LAZY_BASE < LAZY_SIZE) return paging_lazy_fault(addr);
+    if (addr >= MMAP_BASE && addr - MMAP_BASE < MMAP_SIZE) return vfs_mmap_fault(addr);
+    return -1;
+}
+
+static uint32_t paging_cpuid_features(void) {
+    uint32_t eax = 1, ebx, ecx, edx;
+    __asm__ volatile("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    return edx;
+}
+
+/* Paging features every CPU must turn on before it shares the page tables. */
+void paging_cpu_init(void) {
+    uint32_t features = paging_cpuid_features();
+    uint32_t cr4;
+
+    __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= CR4_PSE;
+    if (features & CPUID_PGE) {
+        cr4 |= CR4_PGE;
+        global_flag = PAGE_GLOBAL;
+    }
+    __asm__ volatile("mov %0, %%cr4" : : "r"(cr4));
+
+    if (features & CPUID_PAT) {
+        __asm__ volatile("wrmsr" : : "c"(MSR_PAT), "a"(PAT_VALUE), "d"(PAT_VALUE));
+    }
+}
+
+void paging_init(void) {
+    uint32_t cr0;
+
+    paging_cpu_init();
+
+    memset(page_directory, 0, sizeof(page_directory));
+
+    /* First 4 MB in small pages: catch NULL dereferences and write-protect the kernel image. */
+    uint32_t ro_start = (uint32_t)kernel_ro_start;
+    uint32_t ro_end = (uint32_t)kernel_ro_end;
+    low_table[0] = 0;
+    for (uint32_t i = 1; i < 1024; i++) {
+        uint32_t addr = i * PAGE_SIZE;
+        uint32_t flags = PAGE_PRESENT | global_flag;
+        if (addr < ro_start || addr >= ro_end) flags |= PAGE_WRITE;
+        low_table[i] = addr | flags;
+    }
+    page_directory[0] = (uint32_t)low_table | PAGE_PRESENT | PAGE_WRITE;
+
+    /* Everything the frame allocator can hand out must be reachable, so clip RAM to the mmap window. */
+    uint32_t top_frames = pmm_frame_limit();
+    if (top_frames > MMAP_BASE / PAGE_SIZE) {
+        pmm_reserve(MMAP_BASE, 0 - MMAP_BASE);
+        top_frames = MMAP_BASE / PAGE_SIZE;
+    }
+    uint32_t top = top_frames * PAGE_SIZE;
+    uint32_t identity = (top + LARGE_PAGE_SIZE - 1) & ~(LARGE_PAGE_SIZE - 1);
+    if (identity > LARGE_PAGE_SIZE) {
+        paging_map_range(LARGE_PAGE_SIZE, LARGE_PAGE_SIZE, identity - LARGE_PAGE_SIZE,
+                         PAGE_WRITE | global_flag);
+    }
+
+    uint32_t direct = identity < KERNEL_DIRECT_MAX ? identity : KERNEL_DIRECT_MAX;
+    paging_map_range(KERNEL_VIRT_BASE, 0, direct, PAGE_WRITE | global_flag);
+
+    __asm__ volatile("mov %0, %%cr3" : : "r"(page_directory));
+    __asm__ volatile("mov %%cr0, %0" : "=r"(cr0));
+    __asm__ volatile("mov %0, %%cr0" : : "r"(cr0 | CR0_PG | CR0_WP));
+
+    char buf[16];
+    terminal_writestring("Paging: ");
+    itoa((int)(identity / LARGE_PAGE_SIZE), buf);
+    terminal_writestring(buf);
+    terminal_writestring(" x 4 MB identity, kernel alias at 0xC0000000");
+    terminal_writestring((paging_cpuid_features() & CPUID_PAT) ? ", PAT write-combining\n" : "\n");
+}
@@ -0,0 +1,239 @@
+
+
+#include <stdint.h>
+#include "include/lib.h"
+#include "include/pmm.h"
+#include "include/sched.h"
+
+extern void terminal_writestring(const char* s);
+extern char kernel_end[];
+
+#define PMM_MAX_REGIONS 32
+
+typedef struct {
+    uint32_t first;
+    uint32_t last;
+} pmm_region_t;
+
+static pmm_region_t pmm_regions[PMM_MAX_REGIONS];
+static int pmm_region_count;
+
+/* One bit per 4 KB frame up to the top of usable memory; a set bit means the frame is in use. */
+static uint32_t* frame_bitmap;
+static uint32_t frame_limit;
+static uint32_t frame_next;
+static uint32_t frames_total;
+static uint32_t frames_free;
+
+/* Threads, the fault task and kmalloc all allocate frames, so the bitmap is updated with interrupts off. */
+static inline __attribute__((always_inline)) uint32_t pmm_lock(void) {
+    return irq_save();
+}
+
+static inline __attribute__((always_inline)) void pmm_unlock(uint32_t flags) {
+    irq_restore(flags);
+}
+
+static inline int frame_test(uint32_t frame) {
+    return frame_bitmap[frame / 32] & (1u << (frame % 32));
+}
+
+static void pmm_mark(uint32_t first, uint32_t last, int used) {
+    for (uint32_t frame = first; frame < last; frame++) {
+        if (!frame_test(frame) == !used) continue;
+        if (used) {
+            frame_bitmap[frame / 32] |= 1u << (frame % 32);
+            frames_free--;
+        } else {
+            frame_bitmap[frame / 32] &= ~(1u << (frame % 32));
+            frames_free++;
+        }
+    }
+}
+
+/* Records the whole frames inside [base, base + size), clipped to 4 GB. */
+static void pmm_add_region(uint64_t base, uint64_t size) {
+    uint64_t end = base + size;
+    if (base >= 0x100000000ULL || pmm_region_count == PMM_MAX_REGIONS) return;
+    if (end > 0x100000000ULL) end = 0x100000000ULL;
+
+    uint32_t first = (uint32_t)((base + PMM_FRAME_SIZE - 1) >> 12);
+    uint32_t last = (uint32_t)(end >> 12);
+    if (first >= last) return;
+
+    pmm_regions[pmm_region_count].first = first;
+    pmm_regions[pmm_region_count].last = last;
+    pmm_region_count++;
+    if (last > frame_limit) frame_limit = last;
+}
+
+void pmm_reserve(uint32_t base, uint32_t size) {
+    if (size == 0) return;
+    uint32_t first = base >> 12;
+    uint64_t last = ((uint64_t)base + size + PMM_FRAME_SIZE - 1) >> 12;
+    if (first >= frame_limit) return;
+    if (last > frame_limit) last = frame_limit;
+
+    uint32_t flags = pmm_lock();
+    uint32_t before = frames_free;
+    pmm_mark(first, (uint32_t)last, 1);
+    frames_total -= before - frames_free;
+    pmm_unlock(flags);
+}
+
+static void pmm_print_mb(const char* label, uint32_t frames) {
+    char buf[16];
+    terminal_writestring(label);
+    itoa((int)(frames / 256), buf);
+    terminal_writestring(buf);
+    terminal_writestring(" MB");
+}
+
+void pmm_init(multiboot_info_t* mb_info, uint32_t magic) {
+    pmm_region_count = 0;
+    frame_limit = 0;
+    frames_free = 0;
+
+    int have_info = magic == MULTIBOOT_BOOTLOADER_MAGIC && mb_info;
+    if (have_info && (mb_info->flags & MULTIBOOT_INFO_MEM_MAP)) {
+        uint32_t addr = mb_info->mmap_addr;
+        uint32_t end = addr + mb_info->mmap_length;
+        while (addr < end) {
+            multiboot_mmap_entry_t* entry = (multiboot_mmap_entry_t*)addr;
+            if (entry->type == MULTIBOOT_MEMORY_AVAILABLE) {
+                pmm_add_region(entry->addr, entry->len);
+            }
+            addr += entry->size + sizeof(entry->size);
+        }
+    } else if (have_info && (mb_info->flags & MULTIBOOT_INFO_MEMORY)) {
+        pmm_add_region(0x100000, (uint64_t)mb_info->mem_upper * 1024);
+    } else {
+        terminal_writestring("PMM: no memory map from boot loader, assuming 32 MB\n");
+        pmm_add_region(0x100000, PMM_FALLBACK_TOP - 0x100000);
+    }
+
+    multiboot_module_t* mods = 0;
+    uint32_t mods_count = 0;
+    if (have_info && (mb_info->flags & MULTIBOOT_INFO_MODS)) {
+        mods = (multiboot_module_t*)mb_info->mods_addr;
+        mods_count = mb_info->mods_count;
+    }
+
+    /* The bitmap goes in the first usable frames above the program area and any boot modules. */
+    uint32_t bitmap_bytes = (frame_limit + 31) / 32 * 4;
+    uint32_t bitmap_frames = (bitmap_bytes + PMM_FRAME_SIZE - 1) / PMM_FRAME_SIZE;
+    uint32_t floor = USER_LOAD_END;
+    if (mods_count && (uint32_t)(mods + mods_count) > floor) floor = (uint32_t)(mods + mods_count);
+    for (uint32_t i = 0; i < mods_count; i++) {
+        if (mods[i].mod_end > floor) floor = mods[i].mod_end;
+    }
+    floor = (floor + PMM_FRAME_SIZE - 1) >> 12;
+    frame_bitmap = 0;
+    for (int i = 0; i < pmm_region_count; i++) {
+        uint32_t first = pmm_regions[i].first > floor ? pmm_regions[i].first : floor;
+        if (first < pmm_regions[i].last && pmm_regions[i].last - first >= bitmap_frames) {
+            frame_bitmap = (uint32_t*)(first << 12);
+            break;
+        }
+    }
+    if (!frame_bitmap) {
+        terminal_writestring("PMM: no room for the frame bitmap\n");
+        frame_limit = 0;
+        return;
+    }
+
+    memset(frame_bitmap, 0xFF, bitmap_bytes);
+    for (int i = 0; i < pmm_region_count; i++) {
+        pmm_mark(pmm_regions[i].first, pmm_regions[i].last, 0);
+    }
+    frames_total = frames_free;
+    pmm_reserve((uint32_t)frame_bitmap, bitmap_bytes);
+
+    /* Real-mode area and BIOS data, the kernel image with its stack, and the program load area. */
+    pmm_reserve(0, (uint32_t)kernel_end);
+    pmm_reserve(USER_LOAD_BASE, USER_LOAD_END - USER_LOAD_BASE);
+
+    for (uint32_t i = 0; i < mods_count; i++) {
+        pmm_reserve(mods[i].mod_start, mods[i].mod_end - mods[i].mod_start);
+    }
+
+    frame_next = 0;
+    pmm_print_mb("Memory: ", frames_total);
+    pmm_print_mb(" usable, ", frames_free);
+    terminal_writestring(" free\n");
+}
+
+uint32_t frame_alloc(void) {
+    uint32_t flags = pmm_lock();
+    uint32_t words = (frame_limit + 31) / 32;
+    for (uint32_t n = 0; n < words; n++) {
+        uint32_t w = (frame_next / 32 + n) % words;
+        if (frame_bitmap[w] == 0xFFFFFFFF) continue;
+
+        for (uint32_t bit = 0; bit < 32; bit++) {
+            uint32_t frame = w * 32 + bit;
+            if (frame < frame_limit && !frame_test(frame)) {
+                frame_bitmap[w] |= 1u << bit;
+                frames_free--;
+                frame_next = frame + 1;
+                pmm_unlock(flags);
+                return frame << 12;
+            }
+        }
+    }
+    pmm_unlock(flags);
+    return 0;
+}
+
+void frame_free(uint32_t frame) {
+    frame_free_contig(frame, 1);
+}
+
+uint32_t frame_alloc_contig(uint32_t count, uint32_t limit) {
+    if (count == 0) return 0;
+    uint32_t top = limit ? limit >> 12 : frame_limit;
+    if (top > frame_limit) top = frame_limit;
+
+    uint32_t flags = pmm_lock();
+    uint32_t run = 0;
+    for (uint32_t frame = 0; frame < top; frame++) {
+        if (run == 0 && frame % 32 == 0 && frame_bitmap[frame / 32] == 0xFFFFFFFF) {
+            frame += 31;
+            continue;
+        }
+        if (frame_test(frame)) {
+            run = 0;
+            continue;
+        }
+        if (++run == count) {
+            uint32_t first = frame + 1 - count;
+            pmm_mark(first, frame + 1, 1);
+            pmm_unlock(flags);
+            return first << 12;
+        }
+    }
+    pmm_unlock(flags);
+    return 0;
+}
+
+void frame_free_contig(uint32_t base, uint32_t count) {
+    uint32_t first = base >> 12;
+    if (first + count > frame_limit) return;
+    uint32_t flags = pmm_lock();
+    pmm_mark(first, first + count, 0);
+    if (first < frame_next) frame_next = first;
+    pmm_unlock(flags);
+}
+
+uint32_t pmm_total_frames(void) {
+    return frames_total;
+}
+
+/* One past the highest usable frame number. */
+uint32_t pmm_frame_limit(void) {
+    return frame_limit;
+}
+
+uint32_t pmm_free_frames(void) {
+    return frames_free;
+}
@@ -0,0 +1,390 @@
+
+
+#include <stdint.h>
+#include "include/lib.h"
+#include "include/sched.h"
+#include "include/timer.h"
+#include "include/paging.h"
+#include "include/kmalloc.h"
+
+extern void terminal_writestring(const char* s);
+extern void switch_context(uint32_t* prev_esp, uint32_t next_esp);
+
+#define CR0_MP 0x02
+#define CR0_EM 0x04
+#define CR0_TS 0x08
+#define CR0_NE 0x20
+#define CR4_OSFXSR 0x200
+#define CPUID_FXSR (1 << 24)
+
+static thread_t* current;
+static thread_t* idle_thread;
+static thread_t* all_threads;
+static thread_t* zombies;
+static wait_queue_t run_queue;
+static int ready_count;
+static int next_tid;
+static volatile int need_resched;
+static uint32_t total_switches;
+
+/* Lazy FPU switching: the registers hold fpu_owner's state, and CR0.TS is set whenever anyone else runs. */
+static thread_t* fpu_owner;
+static int has_fxsr;
+
+static inline uint8_t* fpu_state(thread_t* t) {
+    return (uint8_t*)(((uint32_t)t->fpu_area + 15) & ~15);
+}
+
+static void fpu_save(thread_t* t) {
+    if (has_fxsr) {
+        __asm__ volatile("fxsave (%0)" : : "r"(fpu_state(t)) : "memory");
+    } else {
+        __asm__ volatile("fnsave (%0)" : : "r"(fpu_state(t)) : "memory");
+    }
+}
+
+static void fpu_restore(thread_t* t) {
+    if (has_fxsr) {
+        __asm__ volatile("fxrstor (%0)" : : "r"(fpu_state(t)) : "memory");
+    } else {
+        __asm__ volatile("frstor (%0)" : : "r"(fpu_state(t)) : "memory");
+    }
+}
+
+static void fpu_init(void) {
+    uint32_t eax = 1, ebx, ecx, edx, cr0, cr4;
+    __asm__ volatile("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    has_fxsr = (edx & CPUID_FXSR) != 0;
+
+    __asm__ volatile("mov %%cr0, %0" : "=r"(cr0));
+    cr0 = (cr0 & ~(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE;
+    __asm__ volatile("mov %0, %%cr0" : : "r"(cr0));
+    if (has_fxsr) {
+        __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+        __asm__ volatile("mov %0, %%cr4" : : "r"(cr4 | CR4_OSFXSR));
+    }
+    __asm__ volatile("fninit");
+}
+
+/* Device-not-available trap: hands the FPU to the running thread on its first FPU instruction. */
+void sched_fpu_trap(void) {
+    __asm__ volatile("clts");
+    if (!current || fpu_owner == current) return;
+
+    if (fpu_owner) fpu_save(fpu_owner);
+    if (current->fpu_used) {
+        fpu_restore(current);
+    } else {
+        __asm__ volatile("fninit");
+        current->fpu_used = 1;
+    }
+    fpu_owner = current;
+}
+
+static void queue_push(wait_queue_t* q, thread_t* t) {
+    t->next = 0;
+    if (q->tail) {
+        q->tail->next = t;
+    } else {
+        q->head = t;
+    }
+    q->tail = t;
+}
+
+static thread_t* queue_pop(wait_queue_t* q) {
+    thread_t* t = q->head;
+    if (t) {
+        q->head = t->next;
+        if (!q->head) q->tail = 0;
+        t->next = 0;
+    }
+    return t;
+}
+
+static void make_ready(thread_t* t) {
+    t->state = THREAD_READY;
+    queue_push(&run_queue, t);
+    ready_count++;
+    if (current == idle_thread) need_resched = 1;
+}
+
+/* Frees threads that have exited; never called on the exiting thread's own stack. */
+static void sched_reap(void) {
+    while (zombies) {
+        thread_t* t = zombies;
+        zombies = t->next;
+
+        thread_t** link = &all_threads;
+        while (*link != t) link = &(*link)->all_next;
+        *link = t->all_next;
+
+        paging_free_lazy(t->stack);
+        arena_destroy(&t->scratch);
+        kfree(t);
+    }
+}
+
+/*
+ * Picks the next thread and switches to it. Called with interrupts disabled;
+ * the caller has already set current->state if it is giving up the CPU.
+ */
+static void schedule(void) {
+    thread_t* prev = current;
+    need_resched = 0;
+
+    if (prev->state == THREAD_RUNNING) {
+        if (prev == idle_thread) {
+            prev->state = THREAD_READY;
+        } else {
+            make_ready(prev);
+        }
+    }
+
+    thread_t* next = queue_pop(&run_queue);
+    if (next) {
+        ready_count--;
+    } else {
+        next = idle_thread;
+    }
+    next->state = THREAD_RUNNING;
+    next->slice = SCHED_SLICE_TICKS;
+    if (next == prev) return;
+
+    next->switches++;
+    total_switches++;
+    current = next;
+    scratch_set_thread_arena(next->scratch.base ? &next->scratch : 0);
+    if (next == fpu_owner) {
+        __asm__ volatile("clts");
+    } else {
+        uint32_t cr0;
+        __asm__ volatile("mov %%cr0, %0" : "=r"(cr0));
+        __asm__ volatile("mov %0, %%cr0" : : "r"(cr0 | CR0_TS));
+    }
+
+    switch_context(&prev->esp, next->esp);
+    sched_reap();
+}
+
+/* First code run by every new thread; switch_context returns here with interrupts disabled. */
+static void thread_start(void) {
+    sched_reap();
+    irq_trace_on();
+    __asm__ volatile("sti");
+    current->entry(current->arg);
+    thread_exit();
+}
+
+static thread_t* thread_alloc(const char* name) {
+    thread_t* t = kzalloc(sizeof(thread_t));
+    if (!t) return 0;
+    t->tid = next_tid++;
+    strncpy(t->name, name, THREAD_NAME_LEN - 1);
+    t->name[THREAD_NAME_LEN - 1] = '\0';
+    return t;
+}
+
+static void thread_link(thread_t* t) {
+    t->all_next = all_threads;
+    all_threads = t;
+}
+
+static thread_t* thread_spawn(const char* name, void (*entry)(void* arg), void* arg) {
+    thread_t* t = thread_alloc(name);
+    if (!t) return 0;
+
+    /*
+     * Interrupt frames land on this stack, and a #PF during their delivery
+     * would lose an interrupt that was already acknowledged, so every page is
+     * backed now. The lazy region keeps its unmapped guard page below.
+     */
+    t->stack = paging_alloc_lazy(THREAD_STACK_SIZE, PAGE_WRITE);
+    if (!t->stack) {
+        kfree(t);
+        return 0;
+    }
+    if (paging_populate(t->stack, THREAD_STACK_SIZE) < 0) {
+        paging_free_lazy(t->stack);
+        kfree(t);
+        return 0;
+    }
+    if (arena_init(&t->scratch, SCRATCH_THREAD_SIZE) < 0) {
+        paging_free_lazy(t->stack);
+        kfree(t);
+        return 0;
+    }
+    t->entry = entry;
+    t->arg = arg;
+
+    /* Frame popped by switch_context: EFLAGS, edi, esi, ebx, ebp, return address. */
+    uint32_t* sp = (uint32_t*)(t->stack + THREAD_STACK_SIZE);
+    *--sp = 0;
+    *--sp = (uint32_t)thread_start;
+    *--sp = 0;
+    *--sp = 0;
+    *--sp = 0;
+    *--sp = 0;
+    *--sp = 0x2;
+    t->esp = (uint32_t)sp;
+    return t;
+}
+
+static void idle_loop(void* arg) {
+    (void)arg;
+    for (;;) {
+        timer_idle();
+    }
+}
+
+void sched_init(const char* name) {
+    fpu_init();
+
+    thread_t* boot = thread_alloc(name);
+    if (!boot) {
+        terminal_writestring("Sched: out of memory\n");
+        return;
+    }
+    boot->state = THREAD_RUNNING;
+    boot->slice = SCHED_SLICE_TICKS;
+    boot->fpu_used = 1;
+
+    idle_thread = thread_spawn("idle", idle_loop, 0);
+    if (!idle_thread) {
+        terminal_writestring("Sched: cannot create idle thread\n");
+        kfree(boot);
+        return;
+    }
+    idle_thread->state = THREAD_READY;
+    thread_link(idle_thread);
+    thread_link(boot);
+
+    fpu_owner = boot;
+    current = boot;
+}
+
+int sched_running(void) {
+    return current != 0;
+}
+
+int sched_runnable(void) {
+    return ready_count;
+}
+
+thread_t* sched_current(void) {
+    return current;
+}
+
+thread_t* sched_threads(void) {
+    return all_threads;
+}
+
+uint32_t sched_switches(void) {
+    return total_switches;
+}
+
+const char* thread_state_name(thread_state_t state) {
+    switch (state) {
+        case THREAD_RUNNING: return "running";
+        case THREAD_READY: return "ready";
+        case THREAD_BLOCKED: return "blocked";
+        case THREAD_SLEEPING: return "sleeping";
+        case THREAD_DEAD: return "dead";
+    }
+    return "?";
+}
+
+int thread_create(const char* name, void (*entry)(void* arg), void* arg) {
+    if (!current) return -1;
+    thread_t* t = thread_spawn(name, entry, arg);
+    if (!t) return -1;
+
+    uint32_t flags = irq_save();
+    thread_link(t);
+    make_ready(t);
+    irq_restore(flags);
+    return t->tid;
+}
+
+void thread_exit(void) {
+    __asm__ volatile("cli");
+    irq_trace_off();
+    if (fpu_owner == current) fpu_owner = 0;
+    current->state = THREAD_DEAD;
+    current->next = zombies;
+    zombies = current;
+    schedule();
+    for (;;) {
+        __asm__ volatile("cli; hlt");
+    }
+}
+
+void thread_yield(void) {
+    uint32_t flags = irq_save();
+    schedule();
+    irq_restore(flags);
+}
+
+static void sleep_timeout(void* data) {
+    thread_t* t = data;
+    uint32_t flags = irq_save();
+    if (t->state == THREAD_SLEEPING) make_ready(t);
+    irq_restore(flags);
+}
+
+void thread_sleep_ms(uint32_t ms) {
+    ktimer_t timer;
+    uint32_t flags = irq_save();
+
+    timer_setup(&timer, sleep_timeout, current);
+    timer_add(&timer, ms);
+    current->state = THREAD_SLEEPING;
+    schedule();
+
+    irq_restore(flags);
+}
+
+/* Charges elapsed ticks to the running thread and asks for a switch when its slice is used up. */
+void sched_tick(uint32_t ticks) {
+    if (!current) return;
+    current->runtime += ticks;
+    if (!ready_count) return;
+
+    if (current == idle_thread || current->slice <= ticks) {
+        current->slice = 0;
+        need_resched = 1;
+    } else {
+        current->slice -= ticks;
+    }
+}
+
+/* Called on the way out of the outermost interrupt, with interrupts disabled. */
+void sched_preempt(void) {
+    if (need_resched && current) schedule();
+}
+
+void wait_queue_init(wait_queue_t* wq) {
+    wq->head = 0;
+    wq->tail = 0;
+}
+
+void wait_sleep(wait_queue_t* wq) {
+    current->state = THREAD_BLOCKED;
+    queue_push(wq, current);
+    schedule();
+}
+
+void wake_up(wait_queue_t* wq) {
+    uint32_t flags = irq_save();
+    thread_t* t;
+    while ((t = queue_pop(wq)) != 0) {
+        make_ready(t);
+    }
+    irq_restore(flags);
+}
+
+void wake_up_one(wait_queue_t* wq) {
+    uint32_t flags = irq_save();
+    thread_t* t = queue_pop(wq);
+    if (t) make_ready(t);
+    irq_restore(flags);
+}
@@ -6,6 +6,9 @@
 #include "include/version.h"
 #include "include/lib.h"
 #include "include/commands.h"
+#include "include/timer.h"
+#include "include/event.h"
+#include "include/keyboard.h"
 
 extern void terminal_writestring(const char* s);
 extern void terminal_putchar(char c);
@@ -29,11 +32,20 @@ unsigned char kbd_map_shift[128] = {
 static int shift_pressed = 0;
 static int caps_locked = 0;
 
+/*
+ * The prompt is driven by event tasks: one handles keystrokes as IRQ 1
+ * reports them, one redraws the status-bar clock once a second. Commands
+ * run inside the keyboard task and keep the loop going while they wait.
+ */
+static event_task_t kbd_task;
+static event_task_t clock_task;
+static int command_running;
+
 void read_line(char* buffer, int max, int echo) {
     int ptr = 0;
     while (1) {
-        if (inb(0x64) & 0x1) {
-            uint8_t scancode = inb(0x60);
+        uint8_t scancode;
+        if (kbd_read(&scancode)) {
             if ((scancode & 0x7F) == 42 || (scancode & 0x7F) == 54) {
                 shift_pressed = !(scancode & 0x80);
             } else if (scancode == 58) {
@@ -61,6 +73,9 @@ void read_line(char* buffer, int max, int echo) {
                     if (echo) terminal_putchar(c);
                 }
             }
+        } else {
+            /* The event stays pending if IRQ 1 fires between the empty read and the wait. */
+            event_loop_wait(irq_event(1), 0);
         }
     }
 }
@@ -80,9 +95,10 @@ static const char* available_commands[] = {
     "help", "man", "cls", "ver", "pwd", "ls", "cd", "echo", "uname", "date", 
     "cat", "mkdir", "disks", "read_sector", "write_sector", "mount",
     "useradd", "passwd", "login", "userdel", "crypt", "whoami", 
-    "touch", "rm", "cp", "shutdown", "reboot", "gui", "hello", "test", "editor", "calc", "asm", "colorb", "lsh"
+    "touch", "rm", "cp", "shutdown", "reboot", "gui", "hello", "test", "editor", "calc", "asm", "colorb", "lsh", "iostat", "cdrom",
+    "tar", "meminfo", "ps", "irqstat", "softirq", "cpus"
 };
-static int commands_count = 36;
+#define COMMANDS_COUNT ((int)(sizeof(available_commands) / sizeof(available_commands[0])))
 
 // Arrow key scancodes
 #define KEY_UP 72
@@ -245,7 +261,7 @@ int find_command_matches(const char* prefix, char matches[][32]) {
     int match_count = 0;
     int prefix_len = strlen(prefix);
 
-    for (int i = 0; i < commands_count; i++) {
+    for (int i = 0; i < COMMANDS_COUNT; i++) {
         if (strncmp(available_commands[i], prefix, prefix_len) == 0) {
             strcpy(matches[match_count], available_commands[i]);
             match_count++;
@@ -323,7 +339,8 @@ void perform_completion() {
         }
     }
 
-    char matches[10][32];
+    /* An empty word matches every command. */
+    char matches[COMMANDS_COUNT][32];
     int match_count = 0;
 
     if (is_cd_command) {
@@ -441,6 +458,45 @@ void shell_handle_key(char c) {
     }
 }
 
+static void shell_kbd_task(event_task_t* task) {
+    uint8_t scancode;
+    while (kbd_read(&scancode)) {
+        if ((scancode & 0x7F) == 42 || (scancode & 0x7F) == 54) {
+            shift_pressed = !(scancode & 0x80);
+        } else if (scancode == 58) {
+            if (!(scancode & 0x80)) caps_locked = !caps_locked;
+        } else if (!(scancode & 0x80)) {
+            if (scancode == KEY_UP) {
+                get_previous_history();
+            } else if (scancode == KEY_DOWN) {
+                get_next_history();
+            } else if (scancode == KEY_LEFT) {
+                move_cursor_left();
+            } else if (scancode == KEY_RIGHT) {
+                move_cursor_right();
+            } else if (scancode == KEY_TAB) {
+                perform_completion();
+            } else {
+                int is_letter = (scancode >= 16 && scancode <= 25) || (scancode >= 30 && scancode <= 38) || (scancode >= 44 && scancode <= 50);
+                int uppercase = shift_pressed || (caps_locked && is_letter);
+                char c = uppercase ? kbd_map_shift[scancode] : kbd_map[scancode];
+                if (c != 0) {
+                    command_running = 1;
+                    shell_handle_key(c);
+                    command_running = 0;
+                }
+            }
+        }
+    }
+    event_task_wait(task, irq_event(1), 0);
+}
+
+static void shell_clock_task(event_task_t* task) {
+    /* Commands that wait keep the loop running; leave their screen alone. */
+    if (!command_running) terminal_display_time();
+    event_task_sleep(task, 1000);
+}
+
 // ГЛАВНАЯ ФУНКЦИЯ ШЕЛЛА
 void shell_main() {
     terminal_writestring("Shell start\n");
@@ -497,36 +553,12 @@ void shell_main() {
 
     display_prompt();
 
-    terminal_display_time();
-
-    while(1) {
-
-        terminal_display_time();
+    event_task_init(&kbd_task, "keyboard", shell_kbd_task, 0);
+    event_task_init(&clock_task, "clock", shell_clock_task, 0);
+    event_task_start(&kbd_task);
+    event_task_start(&clock_task);
 
-        if (inb(0x64) & 0x1) {
-            uint8_t scancode = inb(0x60);
-            if ((scancode & 0x7F) == 42 || (scancode & 0x7F) == 54) {
-                shift_pressed = !(scancode & 0x80);
-            } else if (scancode == 58) {
-                if (!(scancode & 0x80)) caps_locked = !caps_locked;
-            } else if (!(scancode & 0x80)) {
-                if (scancode == KEY_UP) {
-                    get_previous_history();
-                } else if (scancode == KEY_DOWN) {
-                    get_next_history();
-                } else if (scancode == KEY_LEFT) {
-                    move_cursor_left();
-                } else if (scancode == KEY_RIGHT) {
-                    move_cursor_right();
-                } else if (scancode == KEY_TAB) {
-                    perform_completion();
-                } else {
-                    int is_letter = (scancode >= 16 && scancode <= 25) || (scancode >= 30 && scancode <= 38) || (scancode >= 44 && scancode <= 50);
-                    int uppercase = shift_pressed || (caps_locked && is_letter);
-                    char c = uppercase ? kbd_map_shift[scancode] : kbd_map[scancode];
-                    if (c != 0) shell_handle_key(c);
-                }
-            }
-        }
+    while (1) {
+        event_loop_idle();
     }
 }
@@ -0,0 +1,255 @@
+
+
+#include <stdint.h>
+#include "include/smp.h"
+#include "include/acpi.h"
+#include "include/lib.h"
+#include "include/irq.h"
+#include "include/timer.h"
+#include "include/clock.h"
+#include "include/paging.h"
+#include "include/kmalloc.h"
+#include "include/idt.h"
+
+extern void terminal_writestring(const char* s);
+extern uint8_t ap_trampoline_start[];
+extern uint8_t ap_trampoline_params[];
+extern uint8_t ap_trampoline_end[];
+
+#define CR0_TS 0x08
+
+/* Filled in for each AP before its startup IPI; see the end of trampoline.asm. */
+typedef struct {
+    uint32_t cr0;
+    uint32_t cr3;
+    uint32_t cr4;
+    uint32_t stack;
+    uint32_t entry;
+    uint32_t cpu;
+} __attribute__((packed)) smp_trampoline_t;
+
+/* smp_start_ap() failures; only one where no startup IPI was sent frees the slot again. */
+#define SMP_START_NOMEM -1
+#define SMP_START_TIMEOUT -2
+
+static cpu_t cpus[SMP_MAX_CPUS];
+static int cpu_count = 1;
+
+static void smp_delay_us(uint32_t us) {
+    uint64_t cycles = udiv64((uint64_t)us * clock_tsc_khz(), 1000, 0);
+    uint64_t start = clock_cycles();
+    while (clock_cycles() - start < cycles) {
+        __asm__ volatile("pause");
+    }
+}
+
+static void smp_call_run(cpu_t* cpu) {
+    cpu->ipis++;
+    void (*fn)(void*) = cpu->call_fn;
+    if (!fn) return;
+    cpu->call_fn = 0;
+    fn(cpu->call_arg);
+    __asm__ volatile("" : : : "memory");
+    cpu->call_done = 1;
+}
+
+static int smp_call_irq(void* ctx) {
+    (void)ctx;
+    smp_call_run(this_cpu());
+    return IRQ_HANDLED;
+}
+
+void smp_ap_interrupt(uint8_t vector) {
+    cpu_t* cpu = this_cpu();
+    cpu->interrupts++;
+    if (vector == IPI_CALL_VECTOR) smp_call_run(cpu);
+    lapic_eoi();
+}
+
+/* First C code on an AP, on its own stack with paging on and interrupts off. */
+static void ap_main(cpu_t* cpu) {
+    gdt_cpu_init(cpu->gdt, cpu->gdt->fault_stack);
+    idt_cpu_init();
+    paging_cpu_init();
+    timer_ap_init();
+
+    /* Normally a no-op; see the claim in trampoline.asm for when it is not. */
+    cpu->apic_id = lapic_id();
+    cpu->online = 1;
+    for (;;) {
+        __asm__ volatile("sti; hlt");
+    }
+}
+
+static int smp_start_ap(cpu_t* cpu) {
+    cpu->stack = kmalloc(SMP_STACK_SIZE);
+    cpu->gdt = kzalloc(sizeof(cpu_gdt_t));
+    uint8_t* fault_stack = kmalloc(FAULT_STACK_SIZE);
+    if (!cpu->stack || !cpu->gdt || !fault_stack) {
+        kfree(cpu->stack);
+        kfree(cpu->gdt);
+        kfree(fault_stack);
+        return SMP_START_NOMEM;
+    }
+    cpu->gdt->fault_stack = fault_stack;
+    cpu->gdt->cpu = cpu;
+    spin_lock_init(&cpu->call_lock);
+
+    smp_trampoline_t* params = (smp_trampoline_t*)(SMP_TRAMPOLINE + (ap_trampoline_params - ap_trampoline_start));
+    uint32_t cr0, cr3, cr4;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(cr0));
+    __asm__ volatile("mov %%cr3, %0" : "=r"(cr3));
+    __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+    params->cr0 = cr0 & ~CR0_TS;
+    params->cr3 = cr3;
+    params->cr4 = cr4;
+    params->stack = ((uint32_t)cpu->stack + SMP_STACK_SIZE) & ~15;
+    params->entry = (uint32_t)ap_main;
+    params->cpu = (uint32_t)cpu;
+
+    /* INIT, then up to two startup IPIs, as the MP specification has it. */
+    lapic_send_ipi(cpu->apic_id, ICR_INIT | ICR_ASSERT);
+    timer_sleep_ms(10);
+    for (int attempt = 0; attempt < 2 && !cpu->online; attempt++) {
+        lapic_send_ipi(cpu->apic_id, ICR_STARTUP | ICR_ASSERT | (SMP_TRAMPOLINE >> 12));
+        smp_delay_us(200);
+    }
+
+    uint32_t deadline = timer_deadline(100);
+    while (!cpu->online && !timer_expired(deadline)) {
+        timer_idle();
+    }
+    if (cpu->online) return 0;
+
+    /*
+     * Send it back to wait-for-SIPI and clear the entry, so that it cannot
+     * come up late on the next AP's parameters. Its stack and GDT stay
+     * allocated, and its slot is never reused.
+     */
+    lapic_send_ipi(cpu->apic_id, ICR_INIT | ICR_ASSERT);
+    params->entry = 0;
+    return SMP_START_TIMEOUT;
+}
+
+void smp_init(void) {
+    cpu_t* boot = &cpus[0];
+    boot->id = 0;
+    boot->apic_id = lapic_id();
+    boot->online = 1;
+    boot->gdt = gdt_boot();
+    spin_lock_init(&boot->call_lock);
+    boot->gdt->cpu = boot;
+
+    irq_register_vector(IPI_CALL_VECTOR, smp_call_irq, 0, "ipi-call");
+
+    if (!lapic_timer_running()) {
+        terminal_writestring("SMP: no local APIC timer, bootstrap CPU only\n");
+        return;
+    }
+    if (acpi_init() < 0) {
+        terminal_writestring("SMP: no ACPI tables, bootstrap CPU only\n");
+        return;
+    }
+    const acpi_madt_t* madt = (const acpi_madt_t*)acpi_find_table("APIC");
+    if (!madt) {
+        terminal_writestring("SMP: no MADT, bootstrap CPU only\n");
+        return;
+    }
+
+    memcpy((void*)SMP_TRAMPOLINE, ap_trampoline_start, ap_trampoline_end - ap_trampoline_start);
+
+    const uint8_t* p = (const uint8_t*)(madt + 1);
+    const uint8_t* end = (const uint8_t*)madt + madt->header.length;
+    int failed = 0;
+    while (p + sizeof(acpi_madt_entry_t) <= end) {
+        const acpi_madt_entry_t* e = (const acpi_madt_entry_t*)p;
+        if (e->length < sizeof(acpi_madt_entry_t)) break;
+        p += e->length;
+
+        if (e->type != MADT_LAPIC) continue;
+        const acpi_madt_lapic_t* l = (const acpi_madt_lapic_t*)e;
+        if (!(l->flags & MADT_LAPIC_ENABLED) || l->apic_id == boot->apic_id) continue;
+        if (cpu_count == SMP_MAX_CPUS) {
+            terminal_writestring("SMP: more CPUs than SMP_MAX_CPUS, ignoring the rest\n");
+            break;
+        }
+
+        cpu_t* cpu = &cpus[cpu_count];
+        cpu->id = cpu_count;
+        cpu->apic_id = l->apic_id;
+        int r = smp_start_ap(cpu);
+        if (r == SMP_START_NOMEM) {
+            memset(cpu, 0, sizeof(cpu_t));
+            failed++;
+            continue;
+        }
+        cpu_count++;
+        if (r < 0) failed++;
+    }
+
+    char buf[12];
+    int online = smp_online_count();
+    terminal_writestring("SMP: ");
+    itoa(online, buf);
+    terminal_writestring(buf);
+    terminal_writestring(online == 1 ? " CPU online" : " CPUs online");
+    if (failed) {
+        terminal_writestring(", ");
+        itoa(failed, buf);
+        terminal_writestring(buf);
+        terminal_writestring(" did not start");
+    }
+    terminal_writestring("\n");
+}
+
+int smp_cpu_count(void) {
+    return cpu_count;
+}
+
+int smp_online_count(void) {
+    int online = 0;
+    for (int i = 0; i < cpu_count; i++) {
+        if (cpus[i].online) online++;
+    }
+    return online;
+}
+
+cpu_t* smp_cpu(int id) {
+    if (id < 0 || id >= cpu_count) return 0;
+    return &cpus[id];
+}
+
+void smp_send_ipi(int id, uint8_t vector) {
+    cpu_t* cpu = smp_cpu(id);
+    if (cpu && cpu->online) lapic_send_ipi(cpu->apic_id, ICR_FIXED | ICR_ASSERT | vector);
+}
+
+int smp_call(int id, void (*fn)(void* arg), void* arg) {
+    cpu_t* cpu = smp_cpu(id);
+    if (!cpu || !cpu->online) return -1;
+
+    if (cpu == this_cpu() || (id == 0 && !this_cpu())) {
+        uint32_t flags = irq_save();
+        fn(arg);
+        irq_restore(flags);
+        return 0;
+    }
+
+    /* Interrupts stay off while waiting, so the target's answer cannot be delayed by our own handlers. */
+    uint32_t flags = spin_lock_irqsave(&cpu->call_lock);
+    cpu->call_arg = arg;
+    cpu->call_done = 0;
+    __asm__ volatile("" : : : "memory");
+    cpu->call_fn = fn;
+    smp_send_ipi(id, IPI_CALL_VECTOR);
+
+    uint64_t timeout = (uint64_t)clock_tsc_khz() * SMP_CALL_TIMEOUT_MS;
+    uint64_t start = clock_cycles();
+    while (!cpu->call_done && clock_cycles() - start < timeout) {
+        __asm__ volatile("pause");
+    }
+    int done = cpu->call_done;
+    if (!done) cpu->call_fn = 0;
+    spin_unlock_irqrestore(&cpu->call_lock, flags);
+    return done ? 0 : -1;
+}
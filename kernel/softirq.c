@@ -0,0 +1,154 @@
+
+
+#include <stdint.h>
+#include "include/softirq.h"
+#include "include/sched.h"
+#include "include/timer.h"
+#include "include/event.h"
+#include "include/clock.h"
+
+extern void terminal_writestring(const char* s);
+
+static softirq_t softirqs[SOFTIRQ_COUNT] = {
+    [SOFTIRQ_TIMER] = { "timer", timer_run_expired, 0, 0, 0, 0 },
+    [SOFTIRQ_IRQ_EVENT] = { "irq-event", irq_event_run, 0, 0, 0, 0 },
+};
+
+static volatile uint32_t softirq_pending;
+static int softirq_active;
+
+work_queue_t system_wq;
+static work_queue_t* queue_list;
+
+void softirq_raise(softirq_nr_t nr) {
+    uint32_t flags = irq_save();
+    softirq_pending |= 1u << nr;
+    softirqs[nr].raised++;
+    irq_restore(flags);
+}
+
+/*
+ * Runs raised softirqs with interrupts enabled. An interrupt arriving
+ * meanwhile only adds to the pending mask, which is picked up by the next
+ * round here; after SOFTIRQ_MAX_ROUNDS the remainder waits for the next
+ * interrupt exit, so an interrupt storm cannot keep threads off the CPU.
+ */
+void softirq_run(void) {
+    if (softirq_active || !softirq_pending) return;
+    softirq_active = 1;
+
+    for (int round = 0; round < SOFTIRQ_MAX_ROUNDS && softirq_pending; round++) {
+        uint32_t todo = softirq_pending;
+        softirq_pending = 0;
+        irq_trace_on();
+        __asm__ volatile("sti" : : : "memory");
+
+        for (int nr = 0; nr < SOFTIRQ_COUNT; nr++) {
+            if (!(todo & (1u << nr))) continue;
+            softirq_t* s = &softirqs[nr];
+            uint64_t start = clock_cycles();
+            s->fn();
+            uint64_t cycles = clock_cycles() - start;
+            s->runs++;
+            s->cycles += cycles;
+            if (cycles > s->max_cycles) s->max_cycles = cycles;
+        }
+
+        __asm__ volatile("cli" : : : "memory");
+        irq_trace_off();
+    }
+
+    softirq_active = 0;
+}
+
+const softirq_t* softirq_get(softirq_nr_t nr) {
+    return &softirqs[nr];
+}
+
+void work_init(work_t* work, void (*fn)(void* data), void* data) {
+    work->next = 0;
+    work->fn = fn;
+    work->data = data;
+    work->queued_at = 0;
+    work->pending = 0;
+}
+
+int queue_work(work_queue_t* wq, work_t* work) {
+    uint32_t flags = irq_save();
+    if (work->pending) {
+        irq_restore(flags);
+        return 0;
+    }
+
+    work->pending = 1;
+    work->next = 0;
+    work->queued_at = clock_cycles();
+    if (wq->tail) {
+        wq->tail->next = work;
+    } else {
+        wq->head = work;
+    }
+    wq->tail = work;
+    wq->queued++;
+    if (++wq->depth > wq->max_depth) wq->max_depth = wq->depth;
+    irq_restore(flags);
+
+    wake_up_one(&wq->wait);
+    return 1;
+}
+
+static void work_queue_thread(void* arg) {
+    work_queue_t* wq = arg;
+
+    for (;;) {
+        wait_event(&wq->wait, wq->head != 0);
+
+        uint32_t flags = irq_save();
+        work_t* work = wq->head;
+        wq->head = work->next;
+        if (!wq->head) wq->tail = 0;
+        wq->depth--;
+        /* Cleared before running so the work may queue itself again. */
+        work->pending = 0;
+        void (*fn)(void*) = work->fn;
+        void* data = work->data;
+        uint64_t start = clock_cycles();
+        uint64_t waited = start - work->queued_at;
+        irq_restore(flags);
+
+        fn(data);
+
+        uint64_t ran = clock_cycles() - start;
+        flags = irq_save();
+        wq->done++;
+        wq->wait_cycles += waited;
+        if (waited > wq->max_wait_cycles) wq->max_wait_cycles = waited;
+        wq->run_cycles += ran;
+        irq_restore(flags);
+    }
+}
+
+int work_queue_init(work_queue_t* wq, const char* name) {
+    wq->name = name;
+    wq->head = wq->tail = 0;
+    wait_queue_init(&wq->wait);
+    wq->queued = wq->done = wq->depth = wq->max_depth = 0;
+    wq->wait_cycles = wq->max_wait_cycles = wq->run_cycles = 0;
+
+    wq->tid = thread_create(name, work_queue_thread, wq);
+    if (wq->tid < 0) return -1;
+
+    wq->next_queue = queue_list;
+    queue_list = wq;
+    return 0;
+}
+
+work_queue_t* work_queues(void) {
+    return queue_list;
+}
+
+void softirq_init(void) {
+    if (work_queue_init(&system_wq, "kworker") < 0) {
+        terminal_writestring("Softirq: cannot start kworker\n");
+    }
+}
@@ -5,9 +5,15 @@ global _start
 extern kmain
 
 _start:
-    mov esp, 0x200000
-    mov ebp, 0x200000
-    push ebx
+    mov esp, stack_top
+    mov ebp, esp
     push eax
+    push ebx
     call kmain
-    hlt
\ No newline at end of file
+    hlt
+
+section .bss
+align 16
+stack_bottom:
+    resb 0x20000
+stack_top:
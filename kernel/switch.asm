@@ -0,0 +1,26 @@
+[BITS 32]
+global switch_context
+
+; void switch_context(uint32_t* prev_esp, uint32_t next_esp)
+; Saves the callee-saved registers and EFLAGS on the current stack, stores
+; the stack pointer through prev_esp and resumes the thread whose stack was
+; saved as next_esp. New threads get a frame in the same layout.
+switch_context:
+    mov eax, [esp + 4]
+    mov edx, [esp + 8]
+
+    push ebp
+    push ebx
+    push esi
+    push edi
+    pushfd
+
+    mov [eax], esp
+    mov esp, edx
+
+    popfd
+    pop edi
+    pop esi
+    pop ebx
+    pop ebp
+    ret
@@ -0,0 +1,371 @@
+
+
+#include <stdint.h>
+#include <io.h>
+#include "include/lib.h"
+#include "include/timer.h"
+#include "include/clock.h"
+#include "include/paging.h"
+#include "include/sched.h"
+#include "include/event.h"
+#include "include/irq.h"
+
+extern void terminal_writestring(const char* s);
+
+#define PIT_CHANNEL0 0x40
+#define PIT_COMMAND 0x43
+#define PIT_MODE_RATE 0x34
+#define PIT_MODE_ONESHOT 0x30
+#define PIT_LATCH 0x00
+
+#define CPUID_APIC (1 << 9)
+#define MSR_APIC_BASE 0x1B
+#define APIC_BASE_ENABLE 0x800
+
+#define LAPIC_ID 0x020
+#define LAPIC_EOI 0x0B0
+#define LAPIC_SVR 0x0F0
+#define LAPIC_LVT_TIMER 0x320
+#define LAPIC_LVT_LINT0 0x350
+#define LAPIC_LVT_LINT1 0x360
+#define LAPIC_ICR_LOW 0x300
+#define LAPIC_ICR_HIGH 0x310
+#define LAPIC_ICR_PENDING 0x1000
+#define LAPIC_TIMER_INIT 0x380
+#define LAPIC_TIMER_CURRENT 0x390
+#define LAPIC_TIMER_DIVIDE 0x3E0
+
+#define LAPIC_SVR_ENABLE 0x100
+#define LAPIC_LVT_MASKED 0x10000
+#define LAPIC_LVT_PERIODIC 0x20000
+#define LAPIC_DELIVERY_EXTINT 0x700
+#define LAPIC_DELIVERY_NMI 0x400
+#define LAPIC_DIVIDE_16 0x3
+
+#define LAPIC_CALIBRATE_TICKS 20
+
+/* Longest idle sleep; the PIT one-shot is further limited by its 16-bit counter. */
+#define TIMER_IDLE_MAX_TICKS (10 * TIMER_HZ)
+
+static volatile uint64_t jiffies;
+static volatile uint32_t* lapic;
+static int using_lapic;
+static uint32_t lapic_per_tick;
+
+/* Set while the periodic tick is stopped and a one-shot of oneshot_count counts is armed. */
+static int tickless;
+static uint32_t oneshot_ticks;
+static uint32_t oneshot_count;
+static uint32_t tick_carry;
+
+static inline uint32_t lapic_read(uint32_t reg) {
+    return lapic[reg / 4];
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value) {
+    lapic[reg / 4] = value;
+}
+
+void lapic_eoi(void) {
+    if (lapic) lapic_write(LAPIC_EOI, 0);
+}
+
+int lapic_timer_running(void) {
+    return using_lapic;
+}
+
+uint32_t lapic_id(void) {
+    return lapic ? lapic_read(LAPIC_ID) >> 24 : 0;
+}
+
+void lapic_send_ipi(uint32_t apic_id, uint32_t icr) {
+    uint32_t flags = irq_save();
+    lapic_write(LAPIC_ICR_HIGH, apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, icr);
+    while (lapic_read(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING) {
+        __asm__ volatile("pause");
+    }
+    irq_restore(flags);
+}
+
+static void timer_advance(uint32_t ticks) {
+    jiffies += ticks;
+    clock_update();
+    sched_tick(ticks);
+    timer_wheel_advance((uint32_t)jiffies);
+}
+
+void timer_tick(void) {
+    timer_advance(1);
+}
+
+uint32_t timer_ticks(void) {
+    return (uint32_t)jiffies;
+}
+
+uint64_t timer_ticks64(void) {
+    uint64_t a, b;
+    /* The tick can land between the two halves of the read; retry until stable. */
+    do {
+        a = jiffies;
+        b = jiffies;
+    } while (a != b);
+    return a;
+}
+
+uint64_t ktime_get(void) {
+    return timer_ticks64() * TIMER_NS_PER_TICK;
+}
+
+static void timer_wake(void* data) {
+    *(volatile int*)data = 1;
+}
+
+void timer_sleep_ms(uint32_t ms) {
+    if (sched_running()) {
+        thread_sleep_ms(ms);
+        return;
+    }
+
+    volatile int done = 0;
+    ktimer_t timer;
+
+    timer_setup(&timer, timer_wake, (void*)&done);
+    timer_add(&timer, ms);
+    while (!done) {
+        timer_idle();
+    }
+}
+
+const char* timer_source(void) {
+    return using_lapic ? "local APIC" : "PIT";
+}
+
+static void pit_program(uint8_t mode, uint16_t count) {
+    outb(PIT_COMMAND, mode);
+    outb(PIT_CHANNEL0, count & 0xFF);
+    outb(PIT_CHANNEL0, count >> 8);
+}
+
+static uint16_t pit_read_count(void) {
+    outb(PIT_COMMAND, PIT_LATCH);
+    uint8_t lo = inb(PIT_CHANNEL0);
+    uint8_t hi = inb(PIT_CHANNEL0);
+    return ((uint16_t)hi << 8) | lo;
+}
+
+static int timer_irq(void* ctx) {
+    (void)ctx;
+    timer_interrupt();
+    return IRQ_HANDLED;
+}
+
+static void pit_init(void) {
+    pit_program(PIT_MODE_RATE, PIT_DIVISOR);
+    irq_register(0, timer_irq, 0, "timer");
+}
+
+/* Stops the periodic tick and arms a single interrupt ticks from now. */
+static void timer_oneshot(uint32_t ticks) {
+    if (using_lapic) {
+        oneshot_count = ticks * lapic_per_tick;
+        lapic_write(LAPIC_LVT_TIMER, TIMER_LAPIC_VECTOR);
+        lapic_write(LAPIC_TIMER_INIT, oneshot_count);
+    } else {
+        oneshot_count = ticks * PIT_DIVISOR;
+        pit_program(PIT_MODE_ONESHOT, oneshot_count);
+    }
+    oneshot_ticks = ticks;
+    tickless = 1;
+}
+
+/*
+ * Accounts the ticks that passed while the one-shot was armed and restarts
+ * the periodic tick. Once the one-shot has fired the LAPIC counter reads 0
+ * and the PIT one wraps above the programmed count; otherwise the remaining
+ * count says how far we got, and the part short of a whole tick is carried
+ * over so frequent early wakeups do not make jiffies fall behind. This also
+ * copes with a periodic interrupt that was already pending when the
+ * one-shot was armed.
+ */
+static void timer_resume_periodic(void) {
+    uint32_t per_tick = using_lapic ? lapic_per_tick : PIT_DIVISOR;
+    uint32_t elapsed_ticks = oneshot_ticks;
+
+    uint32_t remaining = using_lapic ? lapic_read(LAPIC_TIMER_CURRENT) : pit_read_count();
+    if (remaining > 0 && remaining <= oneshot_count) {
+        uint32_t counts = oneshot_count - remaining + tick_carry;
+        elapsed_ticks = counts / per_tick;
+        tick_carry = counts % per_tick;
+    }
+
+    if (using_lapic) {
+        lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_PERIODIC | TIMER_LAPIC_VECTOR);
+        lapic_write(LAPIC_TIMER_INIT, lapic_per_tick);
+    } else {
+        pit_program(PIT_MODE_RATE, PIT_DIVISOR);
+    }
+    tickless = 0;
+    if (elapsed_ticks) timer_advance(elapsed_ticks);
+}
+
+/*
+ * Entry latency of a periodic tick. The counter reloads as the interrupt is
+ * raised, so what it has counted since tells how long ago that was. One-shot
+ * wakeups come out of hlt, where nothing can hold interrupts off, and the
+ * LAPIC one-shot counter stops at zero anyway, so those are not sampled.
+ * A tick held off for more than a whole period is seen modulo the period,
+ * but then the interrupts-off trace has the culprit.
+ */
+static void timer_trace_latency(void) {
+    uint32_t khz = clock_tsc_khz();
+    if (!khz || tickless) return;
+
+    uint32_t per_tick, counts;
+    if (using_lapic) {
+        per_tick = lapic_per_tick;
+        counts = per_tick - lapic_read(LAPIC_TIMER_CURRENT);
+    } else {
+        per_tick = PIT_DIVISOR;
+        counts = per_tick - pit_read_count();
+    }
+    uint64_t now = clock_cycles();
+    /* counts run from per_tick down over one tick period. */
+    uint64_t cycles_per_tick = udiv64((uint64_t)khz * 1000, TIMER_HZ, 0);
+    uint64_t since_raised = udiv64((uint64_t)counts * cycles_per_tick, per_tick, 0);
+    uint64_t since_entry = now - irq_entry_cycles();
+    uint64_t latency = since_raised > since_entry ? since_raised - since_entry : 0;
+    irq_latency_sample(using_lapic ? TIMER_LAPIC_VECTOR : TIMER_PIT_VECTOR, latency);
+}
+
+void timer_interrupt(void) {
+    timer_trace_latency();
+    if (tickless) {
+        timer_resume_periodic();
+    } else {
+        timer_tick();
+    }
+}
+
+/*
+ * Halts until the next interrupt. When no timer is due for more than a tick,
+ * the periodic tick is replaced by a one-shot for the next deadline, so an
+ * idle machine takes no timer interrupts at all in between. If another
+ * thread is ready, the CPU goes to it instead, and if event tasks became
+ * ready for the caller to run, it returns at once.
+ */
+void timer_idle(void) {
+    uint32_t flags = irq_save();
+    if (sched_runnable()) {
+        irq_restore(flags | 0x200);
+        thread_yield();
+        return;
+    }
+    if (event_loop_pending()) {
+        irq_restore(flags | 0x200);
+        return;
+    }
+
+    uint32_t max = TIMER_IDLE_MAX_TICKS;
+    if (using_lapic) {
+        if (max > 0xFFFFFFFF / lapic_per_tick) max = 0xFFFFFFFF / lapic_per_tick;
+    } else if (max > 0xFFFF / PIT_DIVISOR) {
+        max = 0xFFFF / PIT_DIVISOR;
+    }
+
+    uint32_t sleep = timer_next_expiry(timer_ticks(), max);
+    if (sleep > 1) timer_oneshot(sleep);
+
+    irq_trace_on();
+    __asm__ volatile("sti; hlt; cli");
+    irq_trace_off();
+    if (tickless) timer_resume_periodic();
+    irq_restore(flags | 0x200);
+}
+
+static int lapic_present(void) {
+    uint32_t eax = 1, ebx, ecx, edx;
+    __asm__ volatile("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    return (edx & CPUID_APIC) != 0;
+}
+
+/*
+ * Counts LAPIC timer decrements over a few PIT ticks, then switches the tick
+ * source to the LAPIC in periodic mode and masks the PIT. LINT0 stays in
+ * ExtINT mode so the 8259 keeps delivering the keyboard and other IRQs.
+ */
+static int lapic_timer_init(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(MSR_APIC_BASE));
+    if (!(lo & APIC_BASE_ENABLE)) return 0;
+
+    uint32_t base = lo & 0xFFFFF000;
+    if (paging_map_range(base, base, PAGE_SIZE, PAGE_WRITE | PAGE_NOCACHE) < 0) return 0;
+    lapic = (volatile uint32_t*)base;
+
+    if (irq_register_vector(TIMER_LAPIC_VECTOR, timer_irq, 0, "lapic-timer") < 0) return 0;
+
+    lapic_write(LAPIC_LVT_LINT0, LAPIC_DELIVERY_EXTINT);
+    lapic_write(LAPIC_LVT_LINT1, LAPIC_DELIVERY_NMI);
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_DIVIDE_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED | TIMER_LAPIC_VECTOR);
+
+    uint32_t start = timer_ticks();
+    while (timer_ticks() == start) {
+        __asm__ volatile("hlt");
+    }
+    lapic_write(LAPIC_TIMER_INIT, 0xFFFFFFFF);
+    start = timer_ticks();
+    while (timer_ticks() - start < LAPIC_CALIBRATE_TICKS) {
+        __asm__ volatile("hlt");
+    }
+    uint32_t elapsed = 0xFFFFFFFF - lapic_read(LAPIC_TIMER_CURRENT);
+    uint32_t per_tick = elapsed / LAPIC_CALIBRATE_TICKS;
+    if (per_tick == 0) {
+        lapic_write(LAPIC_TIMER_INIT, 0);
+        return 0;
+    }
+
+    uint32_t flags = irq_save();
+    irq_mask(0);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_PERIODIC | TIMER_LAPIC_VECTOR);
+    lapic_write(LAPIC_TIMER_INIT, per_tick);
+    lapic_per_tick = per_tick;
+    irq_restore(flags);
+    return 1;
+}
+
+/*
+ * Local APIC of an application processor. LINT0 stays masked: only the
+ * bootstrap CPU takes the 8259's interrupts. The timer is set up with the
+ * bootstrap CPU's divider but left masked, since an AP has no timers of its
+ * own; a periodic tick would only wake an idle CPU for nothing.
+ */
+void timer_ap_init(void) {
+    lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_LVT_LINT1, LAPIC_DELIVERY_NMI);
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_DIVIDE_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED | TIMER_LAPIC_VECTOR);
+    lapic_write(LAPIC_TIMER_INIT, 0);
+}
+
+/* Starts the tick and enables interrupts; everything after this may sleep. */
+void timer_init(void) {
+    timer_wheel_init();
+    pit_init();
+    __asm__ volatile("sti");
+
+    if (lapic_present()) using_lapic = lapic_timer_init();
+
+    char buf[16];
+    terminal_writestring("Timer: ");
+    terminal_writestring(timer_source());
+    terminal_writestring(", ");
+    itoa(TIMER_HZ, buf);
+    terminal_writestring(buf);
+    terminal_writestring(" Hz\n");
+}
@@ -0,0 +1,77 @@
+; Application processor startup. smp.c copies this block to SMP_TRAMPOLINE
+; and fills in the parameters at its end; a startup IPI then starts the AP
+; here in real mode with CS:IP = 0x0800:0000. Everything is addressed
+; through its copy, hence REL().
+global ap_trampoline_start
+global ap_trampoline_params
+global ap_trampoline_end
+
+%define TRAMPOLINE_BASE 0x8000
+%define REL(x) (TRAMPOLINE_BASE + (x) - ap_trampoline_start)
+
+[bits 16]
+ap_trampoline_start:
+    cli
+    cld
+    xor ax, ax
+    mov ds, ax
+    lgdt [REL(ap_gdt_ptr)]
+
+    mov eax, cr0
+    or eax, 1
+    mov cr0, eax
+    jmp dword 0x08:REL(ap_protected)
+
+[bits 32]
+ap_protected:
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+
+    ; Claim the parameters. An AP that finds them already taken, or cleared
+    ; after a failed start, parks here without touching any stack.
+    xor ebx, ebx
+    xchg ebx, [REL(ap_entry)]
+    test ebx, ebx
+    jz .halt
+
+    ; Same paging setup as the bootstrap CPU, then onto the AP's own stack.
+    mov eax, [REL(ap_cr4)]
+    mov cr4, eax
+    mov eax, [REL(ap_cr3)]
+    mov cr3, eax
+    mov eax, [REL(ap_cr0)]
+    mov cr0, eax
+
+    mov esp, [REL(ap_stack)]
+    push dword [REL(ap_cpu)]
+    call ebx
+
+.halt:
+    cli
+    hlt
+    jmp .halt
+
+; Flat code and data, enough to reach the kernel's own GDT.
+align 8
+ap_gdt:
+    dq 0
+    dq 0x00CF9A000000FFFF
+    dq 0x00CF92000000FFFF
+ap_gdt_ptr:
+    dw ap_gdt_ptr - ap_gdt - 1
+    dd REL(ap_gdt)
+
+; Layout matches smp_trampoline_t in smp.c.
+align 4
+ap_trampoline_params:
+ap_cr0:   dd 0
+ap_cr3:   dd 0
+ap_cr4:   dd 0
+ap_stack: dd 0
+ap_entry: dd 0
+ap_cpu:   dd 0
+ap_trampoline_end:
@@ -13,8 +13,9 @@ char current_user[32] = "";
 
 extern void terminal_writestring(const char*);
 extern void terminal_putchar(char c);
-extern void ata_read_sector(uint8_t drive, uint32_t lba, uint16_t* buffer);
-extern void ata_write_sector(uint8_t drive, uint32_t lba, uint16_t* buffer);
+extern int ata_read_sector(uint8_t drive, uint32_t lba, uint16_t* buffer);
+extern int ata_write_sector(uint8_t drive, uint32_t lba, uint16_t* buffer);
+extern int ata_flush(uint8_t drive);
 extern int ata_identify(uint8_t drive);
 
 #define USER_DATA_LBA 100
@@ -93,6 +94,7 @@ void save_users() {
     memcpy(buffer, &user_count, sizeof(int));
     memcpy((char*)buffer + sizeof(int), users, sizeof(user_t) * MAX_USERS);
     ata_write_sector(0, USER_DATA_LBA, buffer);
+    ata_flush(0);
 }
 
 void create_default_users() {